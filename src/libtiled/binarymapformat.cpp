@@ -0,0 +1,457 @@
+/*
+ * binarymapformat.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "binarymapformat.h"
+
+#include "compression.h"
+#include "gidmapper.h"
+#include "map.h"
+#include "mapreader.h"
+#include "mapwriter.h"
+#include "savefile.h"
+#include "tilelayer.h"
+
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QtEndian>
+
+#include <algorithm>
+
+using namespace Tiled;
+
+namespace {
+
+/*
+ * File layout, all numbers are little-endian:
+ *
+ * Header:
+ *   char[4]  magic "TMB\0"
+ *   quint32  format version
+ *   quint64  offset of the directory
+ *
+ * Followed by the embedded TMX and the tile layer data blocks, and finally
+ * the directory:
+ *   quint8   layer data format of the map (used when saving as TMX/JSON)
+ *   qint32   compression level of the map
+ *   quint8   compression of the blocks (BlockCompression)
+ *   quint64  offset of the embedded TMX
+ *   quint64  size of the embedded TMX
+ *   quint32  number of tilesets, followed by the first GID of each tileset
+ *   quint32  number of tile layers, and for each tile layer:
+ *     quint32  number of blocks, and for each block:
+ *       qint32   x, y, width and height
+ *       quint64  offset of the block data
+ *       quint32  size of the block data
+ */
+
+const char Magic[4] = { 'T', 'M', 'B', '\0' };
+const quint32 FormatVersion = 1;
+const int HeaderSize = 16;
+const int DirectoryOffsetPosition = 8;
+
+// Size of the blocks in which the tile layer data is stored
+const int BlockSize = 64;
+
+enum BlockCompression : quint8 {
+    Uncompressed        = 0,
+    ZlibCompressed      = 1,
+    ZstandardCompressed = 2,
+};
+
+struct BlockEntry
+{
+    QRect bounds;
+    quint64 offset;
+    quint32 size;
+};
+
+// The GidMapper handles compression based on the layer data format
+Map::LayerDataFormat formatForCompression(BlockCompression compression)
+{
+    switch (compression) {
+    case ZlibCompressed:
+        return Map::Base64Zlib;
+    case ZstandardCompressed:
+        return Map::Base64Zstandard;
+    case Uncompressed:
+        break;
+    }
+    return Map::Base64;
+}
+
+// Uses the compression method matching the map's layer data format
+BlockCompression compressionForFormat(Map::LayerDataFormat format)
+{
+    switch (format) {
+    case Map::Base64Zstandard:
+        if (compressionSupported(Zstandard))
+            return ZstandardCompressed;
+        Q_FALLTHROUGH();
+    case Map::Base64Gzip:
+    case Map::Base64Zlib:
+        return ZlibCompressed;
+    case Map::XML:
+    case Map::Base64:
+    case Map::CSV:
+        break;
+    }
+    return Uncompressed;
+}
+
+int floorDiv(int value, int divisor)
+{
+    return value >= 0 ? value / divisor : -1 - (-(value + 1) / divisor);
+}
+
+/**
+ * Returns the blocks covering the non-empty chunks of the given layer,
+ * sorted by their position.
+ */
+QVector<QRect> blocksToWrite(const TileLayer &tileLayer)
+{
+    QSet<QPoint> blocks;
+
+    const auto chunks = tileLayer.sortedChunksToWrite(QSize(CHUNK_SIZE, CHUNK_SIZE));
+    for (const QRect &chunk : chunks)
+        blocks.insert(QPoint(floorDiv(chunk.x(), BlockSize),
+                             floorDiv(chunk.y(), BlockSize)));
+
+    QVector<QPoint> sortedBlocks(blocks.cbegin(), blocks.cend());
+    std::sort(sortedBlocks.begin(), sortedBlocks.end(), [] (QPoint a, QPoint b) {
+        return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    });
+
+    const bool infinite = tileLayer.map()->infinite();
+    const QRect layerRect(0, 0, tileLayer.width(), tileLayer.height());
+
+    QVector<QRect> rects;
+    rects.reserve(sortedBlocks.size());
+
+    for (const QPoint &block : std::as_const(sortedBlocks)) {
+        QRect rect(block.x() * BlockSize, block.y() * BlockSize, BlockSize, BlockSize);
+        if (!infinite)
+            rect &= layerRect;
+        if (!rect.isEmpty())
+            rects.append(rect);
+    }
+
+    return rects;
+}
+
+} // anonymous namespace
+
+BinaryMapFormat::BinaryMapFormat(QObject *parent)
+    : MapFormat(parent)
+{
+}
+
+std::unique_ptr<Map> BinaryMapFormat::read(const QString &fileName)
+{
+    return readMap(fileName, QRect());
+}
+
+/**
+ * Reads the map from the given \a fileName, but only decodes the tile layer
+ * data in the blocks overlapping \a region. Tiles outside of that region
+ * may be left empty.
+ */
+std::unique_ptr<Map> BinaryMapFormat::readRegion(const QString &fileName,
+                                                 const QRect &region)
+{
+    return readMap(fileName, region);
+}
+
+std::unique_ptr<Map> BinaryMapFormat::readMap(const QString &fileName,
+                                              const QRect &region)
+{
+    mError.setLocalData(QString());
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        mError.setLocalData(QCoreApplication::translate("File Errors", "Could not open file for reading."));
+        return nullptr;
+    }
+
+    // The file is mapped into memory when possible, which avoids copying the
+    // tile layer data, or reading the parts that are not needed
+    const qint64 fileSize = file.size();
+    const uchar *mapped = fileSize > 0 ? file.map(0, fileSize) : nullptr;
+
+    QByteArray contents;
+    if (mapped)
+        contents = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), fileSize);
+    else
+        contents = file.readAll();
+
+    if (contents.size() < HeaderSize || !contents.startsWith(QByteArray::fromRawData(Magic, 4))) {
+        mError.setLocalData(tr("Not a Tiled binary map file."));
+        return nullptr;
+    }
+
+    const char *data = contents.constData();
+    const quint32 version = qFromLittleEndian<quint32>(data + 4);
+    if (version != FormatVersion) {
+        mError.setLocalData(tr("Unsupported binary map file version: %1").arg(version));
+        return nullptr;
+    }
+
+    auto corrupt = [this] {
+        mError.setLocalData(tr("Corrupt binary map file."));
+        return nullptr;
+    };
+
+    const quint64 size = quint64(contents.size());
+    const quint64 directoryOffset = qFromLittleEndian<quint64>(data + DirectoryOffsetPosition);
+    if (directoryOffset < quint64(HeaderSize) || directoryOffset >= size)
+        return corrupt();
+
+    QDataStream directory(QByteArray::fromRawData(data + directoryOffset,
+                                                  size - directoryOffset));
+    directory.setByteOrder(QDataStream::LittleEndian);
+
+    quint8 layerDataFormat;
+    qint32 compressionLevel;
+    quint8 compression;
+    quint64 metadataOffset;
+    quint64 metadataSize;
+    quint32 tilesetCount;
+
+    directory >> layerDataFormat >> compressionLevel >> compression
+              >> metadataOffset >> metadataSize >> tilesetCount;
+
+    if (directory.status() != QDataStream::Ok ||
+            metadataOffset > size || metadataSize > size - metadataOffset ||
+            compression > ZstandardCompressed || layerDataFormat > Map::CSV) {
+        return corrupt();
+    }
+
+    const auto blockCompression = static_cast<BlockCompression>(compression);
+    if (blockCompression == ZstandardCompressed && !compressionSupported(Zstandard)) {
+        mError.setLocalData(tr("Compression method '%1' not supported").arg(QLatin1String("zstd")));
+        return nullptr;
+    }
+
+    QVector<unsigned> firstGids;
+    for (quint32 i = 0; i < tilesetCount && directory.status() == QDataStream::Ok; ++i) {
+        quint32 firstGid;
+        directory >> firstGid;
+        firstGids.append(firstGid);
+    }
+
+    // Everything except for the tile layer data is read from the embedded TMX
+    QBuffer metadata;
+    metadata.setData(QByteArray::fromRawData(data + metadataOffset, metadataSize));
+    metadata.open(QIODevice::ReadOnly);
+
+    MapReader reader;
+    std::unique_ptr<Map> map(reader.readMap(&metadata, QFileInfo(fileName).absolutePath()));
+    if (!map) {
+        mError.setLocalData(reader.errorString());
+        return nullptr;
+    }
+
+    map->setLayerDataFormat(static_cast<Map::LayerDataFormat>(layerDataFormat));
+    map->setCompressionLevel(compressionLevel);
+
+    if (directory.status() != QDataStream::Ok || firstGids.size() != map->tilesetCount())
+        return corrupt();
+
+    GidMapper gidMapper;
+    for (int i = 0; i < firstGids.size(); ++i)
+        gidMapper.insert(firstGids.at(i), map->tilesetAt(i));
+
+    quint32 tileLayerCount;
+    directory >> tileLayerCount;
+
+    const Map::LayerDataFormat format = formatForCompression(blockCompression);
+    LayerIterator it(map.get(), Layer::TileLayerType);
+
+    for (quint32 i = 0; i < tileLayerCount; ++i) {
+        auto tileLayer = static_cast<TileLayer*>(it.next());
+        if (!tileLayer)
+            return corrupt();
+
+        quint32 blockCount;
+        directory >> blockCount;
+
+        QVector<GidMapper::EncodedLayerData> blocks;
+
+        for (quint32 b = 0; b < blockCount && directory.status() == QDataStream::Ok; ++b) {
+            qint32 x, y, width, height;
+            quint64 offset;
+            quint32 blockSize;
+            directory >> x >> y >> width >> height >> offset >> blockSize;
+
+            if (offset > size || blockSize > size - offset)
+                return corrupt();
+
+            const QRect bounds(x, y, width, height);
+            if (!region.isNull() && !bounds.intersects(region))
+                continue;
+
+            blocks.append({ bounds, QByteArray::fromRawData(data + offset, blockSize) });
+        }
+
+        if (directory.status() != QDataStream::Ok)
+            return corrupt();
+
+        const auto error = gidMapper.decodeLayerData(*tileLayer, blocks, format,
+                                                     GidMapper::NotEncoded);
+
+        switch (error) {
+        case GidMapper::CorruptLayerData:
+            mError.setLocalData(tr("Corrupt layer data for layer '%1'").arg(tileLayer->name()));
+            return nullptr;
+        case GidMapper::TileButNoTilesets:
+            mError.setLocalData(tr("Tile used but no tilesets specified"));
+            return nullptr;
+        case GidMapper::InvalidTile:
+            mError.setLocalData(tr("Invalid tile: %1").arg(gidMapper.invalidTile()));
+            return nullptr;
+        case GidMapper::NoError:
+            break;
+        }
+    }
+
+    return map;
+}
+
+bool BinaryMapFormat::write(const Map *map, const QString &fileName, Options options)
+{
+    mError.setLocalData(QString());
+
+    SaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        mError.setLocalData(QCoreApplication::translate("File Errors", "Could not open file for writing."));
+        return false;
+    }
+
+    QIODevice *device = file.device();
+    QDataStream stream(device);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    // The directory offset is filled in at the end
+    stream.writeRawData(Magic, 4);
+    stream << FormatVersion << quint64(0);
+
+    // Everything except for the tile layer data is stored as TMX
+    const quint64 metadataOffset = quint64(device->pos());
+
+    MapWriter writer;
+    writer.setMinimizeOutput(options.testFlag(WriteMinimized));
+    writer.setTileLayerDataEnabled(false);
+    writer.writeMap(map, device, QFileInfo(fileName).absolutePath());
+
+    const quint64 metadataSize = quint64(device->pos()) - metadataOffset;
+
+    // The tile layer data is encoded and compressed in parallel, one layer
+    // at a time
+    const BlockCompression compression = compressionForFormat(map->layerDataFormat());
+    const Map::LayerDataFormat format = formatForCompression(compression);
+    const GidMapper gidMapper(map->tilesets());
+
+    QVector<QVector<BlockEntry>> layerBlocks;
+
+    LayerIterator it(map, Layer::TileLayerType);
+    while (auto tileLayer = static_cast<TileLayer*>(it.next())) {
+        const auto blocks = blocksToWrite(*tileLayer);
+        const auto blockData = gidMapper.encodeLayerData(*tileLayer, format, blocks,
+                                                         map->compressionLevel(),
+                                                         GidMapper::NotEncoded);
+
+        QVector<BlockEntry> entries;
+        entries.reserve(blocks.size());
+
+        for (qsizetype i = 0; i < blocks.size(); ++i) {
+            const QByteArray &block = blockData.at(i);
+            entries.append({ blocks.at(i), quint64(device->pos()), quint32(block.size()) });
+            device->write(block);
+        }
+
+        layerBlocks.append(entries);
+    }
+
+    const quint64 directoryOffset = quint64(device->pos());
+
+    stream << quint8(map->layerDataFormat())
+           << qint32(map->compressionLevel())
+           << quint8(compression)
+           << metadataOffset
+           << metadataSize;
+
+    // Same assignment of first GIDs as done by the GidMapper
+    stream << quint32(map->tilesetCount());
+    unsigned firstGid = 1;
+    for (const SharedTileset &tileset : map->tilesets()) {
+        stream << quint32(firstGid);
+        firstGid += tileset->nextTileId();
+    }
+
+    stream << quint32(layerBlocks.size());
+    for (const QVector<BlockEntry> &entries : std::as_const(layerBlocks)) {
+        stream << quint32(entries.size());
+        for (const BlockEntry &entry : entries) {
+            stream << qint32(entry.bounds.x()) << qint32(entry.bounds.y())
+                   << qint32(entry.bounds.width()) << qint32(entry.bounds.height())
+                   << entry.offset << entry.size;
+        }
+    }
+
+    device->seek(DirectoryOffsetPosition);
+    stream << directoryOffset;
+
+    if (file.error() != QFileDevice::NoError) {
+        mError.setLocalData(file.errorString());
+        return false;
+    }
+
+    if (!file.commit()) {
+        mError.setLocalData(file.errorString());
+        return false;
+    }
+
+    return true;
+}
+
+bool BinaryMapFormat::supportsFile(const QString &fileName) const
+{
+    if (!fileName.endsWith(QLatin1String(".tmb"), Qt::CaseInsensitive))
+        return false;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return file.read(4) == QByteArray::fromRawData(Magic, 4);
+}
+
+#include "moc_binarymapformat.cpp"
@@ -0,0 +1,82 @@
+/*
+ * binarymapformat.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "mapformat.h"
+#include "tiled_global.h"
+
+#include <QRect>
+#include <QThreadStorage>
+
+namespace Tiled {
+
+/**
+ * A reader and writer for Tiled's binary .tmb map format.
+ *
+ * The file starts with a small header pointing to a directory at the end
+ * of the file. Everything except the tile layer data is stored as embedded
+ * TMX. The tile layer data is stored in blocks of up to 64x64 tiles, each
+ * of which is either uncompressed or compressed on its own, as listed in the
+ * directory along with the first global tile ID of each tileset.
+ *
+ * When reading, the file is memory-mapped and the blocks of each layer are
+ * decoded in parallel, straight from the mapped memory. Only the blocks
+ * overlapping a certain region can be read using readRegion().
+ */
+class TILEDSHARED_EXPORT BinaryMapFormat : public MapFormat
+{
+    Q_OBJECT
+    Q_INTERFACES(Tiled::MapFormat)
+
+public:
+    BinaryMapFormat(QObject *parent = nullptr);
+
+    std::unique_ptr<Map> read(const QString &fileName) override;
+    std::unique_ptr<Map> readRegion(const QString &fileName, const QRect &region);
+
+    bool write(const Map *map, const QString &fileName, Options options) override;
+
+    QString nameFilter() const override { return tr("Tiled binary map files (*.tmb)"); }
+
+    QString shortName() const override { return QStringLiteral("tmb"); }
+
+    bool supportsFile(const QString &fileName) const override;
+
+    Capabilities capabilities() const override { return ReadWrite | ReadInBackground; }
+
+    QString errorString() const override { return mError.localData(); }
+
+private:
+    std::unique_ptr<Map> readMap(const QString &fileName, const QRect &region);
+
+    // Per thread, since maps may be read from multiple threads at once
+    QThreadStorage<QString> mError;
+};
+
+} // namespace Tiled
@@ -44,7 +44,8 @@ public:
         NoCapability    = 0x0,
         Read            = 0x1,
         Write           = 0x2,
-        ReadWrite       = Read | Write
+        ReadWrite       = Read | Write,
+        ReadInBackground = 0x4      // read may be called from worker threads
     };
     Q_DECLARE_FLAGS(Capabilities, Capability)
 
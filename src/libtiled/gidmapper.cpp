@@ -33,7 +33,12 @@
 #include "tiled.h"
 #include "tileset.h"
 
+#include <QtConcurrent>
+#include <QtEndian>
+
 #include <algorithm>
+#include <array>
+#include <limits>
 
 using namespace Tiled;
 
@@ -44,6 +49,129 @@ const unsigned FlippedAntiDiagonallyFlag = 0x20000000;
 
 const unsigned RotatedHexagonal120Flag   = 0x10000000;
 
+const unsigned GidFlagsMask = FlippedHorizontallyFlag |
+                              FlippedVerticallyFlag |
+                              FlippedAntiDiagonallyFlag |
+                              RotatedHexagonal120Flag;
+
+static int cellFlagsFromGid(unsigned gid)
+{
+    int flags = 0;
+    if (gid & FlippedHorizontallyFlag)
+        flags |= Cell::FlippedHorizontally;
+    if (gid & FlippedVerticallyFlag)
+        flags |= Cell::FlippedVertically;
+    if (gid & FlippedAntiDiagonallyFlag)
+        flags |= Cell::FlippedAntiDiagonally;
+    if (gid & RotatedHexagonal120Flag)
+        flags |= Cell::RotatedHexagonal120;
+    return flags;
+}
+
+static unsigned gidFlags(const Cell &cell)
+{
+    unsigned flags = 0;
+    if (cell.flippedHorizontally())
+        flags |= FlippedHorizontallyFlag;
+    if (cell.flippedVertically())
+        flags |= FlippedVerticallyFlag;
+    if (cell.flippedAntiDiagonally())
+        flags |= FlippedAntiDiagonallyFlag;
+    if (cell.rotatedHexagonal120())
+        flags |= RotatedHexagonal120Flag;
+    return flags;
+}
+
+static constexpr std::array<signed char, 256> makeBase64DecodeTable()
+{
+    std::array<signed char, 256> table {};
+    for (std::size_t i = 0; i < table.size(); ++i)
+        table[i] = -1;
+
+    constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                "abcdefghijklmnopqrstuvwxyz"
+                                "0123456789+/";
+    for (int i = 0; i < 64; ++i)
+        table[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+
+    return table;
+}
+
+// Maps each base64 character to its 6-bit value, or to -1 for characters
+// that are not part of the alphabet.
+static constexpr std::array<signed char, 256> base64DecodeTable = makeBase64DecodeTable();
+
+/**
+ * Decodes the base64 encoded \a input into \a output, which needs to have
+ * room for at least 3/4 of the input size. Returns the number of bytes
+ * written.
+ *
+ * Like QByteArray::fromBase64, characters outside of the base64 alphabet
+ * (such as the whitespace around the layer data in TMX files, and padding)
+ * are skipped. Most of the input is handled four characters at a time,
+ * without intermediate buffers.
+ */
+static qsizetype decodeBase64(const QByteArray &input, char *output)
+{
+    const auto *in = reinterpret_cast<const unsigned char*>(input.constData());
+    const auto *inEnd = in + input.size();
+    auto *out = reinterpret_cast<unsigned char*>(output);
+
+    unsigned bits = 0;
+    int sextets = 0;
+
+    while (in != inEnd) {
+        // Fast path for complete groups of valid characters
+        if (sextets == 0) {
+            while (inEnd - in >= 4) {
+                const int a = base64DecodeTable[in[0]];
+                const int b = base64DecodeTable[in[1]];
+                const int c = base64DecodeTable[in[2]];
+                const int d = base64DecodeTable[in[3]];
+
+                if ((a | b | c | d) < 0)
+                    break;
+
+                const unsigned group = a << 18 | b << 12 | c << 6 | d;
+                out[0] = static_cast<unsigned char>(group >> 16);
+                out[1] = static_cast<unsigned char>(group >> 8);
+                out[2] = static_cast<unsigned char>(group);
+
+                in += 4;
+                out += 3;
+            }
+
+            if (in == inEnd)
+                break;
+        }
+
+        const int value = base64DecodeTable[*in++];
+        if (value < 0)
+            continue;
+
+        bits = bits << 6 | value;
+        if (++sextets == 4) {
+            out[0] = static_cast<unsigned char>(bits >> 16);
+            out[1] = static_cast<unsigned char>(bits >> 8);
+            out[2] = static_cast<unsigned char>(bits);
+            out += 3;
+
+            bits = 0;
+            sextets = 0;
+        }
+    }
+
+    // Write out any complete bytes left in an unfinished group
+    if (sextets == 2) {
+        *out++ = static_cast<unsigned char>(bits >> 4);
+    } else if (sextets == 3) {
+        *out++ = static_cast<unsigned char>(bits >> 10);
+        *out++ = static_cast<unsigned char>(bits >> 2);
+    }
+
+    return out - reinterpret_cast<unsigned char*>(output);
+}
+
 /**
  * Default constructor. Use \l insert to initialize the gid mapper
  * incrementally.
@@ -65,6 +193,36 @@ GidMapper::GidMapper(const QVector<SharedTileset> &tilesets)
     }
 }
 
+/**
+ * Insert the given \a tileset with \a firstGid as its first global ID.
+ */
+void GidMapper::insert(unsigned firstGid, const SharedTileset &tileset)
+{
+    auto it = std::lower_bound(mTilesets.begin(), mTilesets.end(), firstGid,
+                               [] (const TilesetEntry &entry, unsigned gid) {
+        return entry.firstGid < gid;
+    });
+
+    if (it != mTilesets.end() && it->firstGid == firstGid)
+        it->tileset = tileset;
+    else
+        mTilesets.insert(it, TilesetEntry { firstGid, tileset });
+}
+
+/**
+ * Returns the index of the tileset entry containing the given \a gid (with
+ * its flags cleared), or -1 when it lies before the first tileset.
+ */
+int GidMapper::findTilesetEntry(unsigned gid) const
+{
+    const auto it = std::upper_bound(mTilesets.begin(), mTilesets.end(), gid,
+                                     [] (unsigned gid, const TilesetEntry &entry) {
+        return gid < entry.firstGid;
+    });
+
+    return static_cast<int>(std::distance(mTilesets.begin(), it)) - 1;
+}
+
 /**
  * Returns the cell data matched by the given \a gid. The \a ok parameter
  * indicates whether an error occurred.
@@ -81,10 +239,7 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
     result.setRotatedHexagonal120(gid & RotatedHexagonal120Flag);
 
     // Clear the flags
-    gid &= ~(FlippedHorizontallyFlag |
-             FlippedVerticallyFlag |
-             FlippedAntiDiagonallyFlag |
-             RotatedHexagonal120Flag);
+    gid &= ~GidFlagsMask;
 
     if (gid == 0) {
         ok = true;
@@ -92,14 +247,14 @@ Cell GidMapper::gidToCell(unsigned gid, bool &ok) const
         ok = false;
     } else {
         // Find the tileset containing this tile
-        QMap<unsigned, SharedTileset>::const_iterator i = mFirstGidToTileset.upperBound(gid);
-        if (i == mFirstGidToTileset.begin()) {
+        const int index = findTilesetEntry(gid);
+        if (index == -1) {
             // Invalid global tile ID, since it lies before the first tileset
             ok = false;
         } else {
-            --i; // Navigate one tileset back since upper bound finds the next
-            int tileId = gid - i.key();
-            const SharedTileset &tileset = i.value();
+            const TilesetEntry &entry = mTilesets.at(index);
+            int tileId = gid - entry.firstGid;
+            const SharedTileset &tileset = entry.tileset;
 
             result.setTile(tileset.data(), tileId);
             ok = true;
@@ -122,28 +277,24 @@ unsigned GidMapper::cellToGid(const Cell &cell) const
     if (cell.isEmpty())
         return 0;
 
-    const Tileset *tileset = cell.tileset();
-
-    // Find the first GID for the tileset
-    QMap<unsigned, SharedTileset>::const_iterator i = mFirstGidToTileset.begin();
-    QMap<unsigned, SharedTileset>::const_iterator i_end = mFirstGidToTileset.end();
-    while (i != i_end && i.value() != tileset)
-        ++i;
-
-    if (i == i_end) // tileset not found
+    const unsigned first = firstGid(cell.tileset());
+    if (first == 0) // tileset not found
         return 0;
 
-    unsigned gid = i.key() + cell.tileId();
-    if (cell.flippedHorizontally())
-        gid |= FlippedHorizontallyFlag;
-    if (cell.flippedVertically())
-        gid |= FlippedVerticallyFlag;
-    if (cell.flippedAntiDiagonally())
-        gid |= FlippedAntiDiagonallyFlag;
-    if (cell.rotatedHexagonal120())
-        gid |= RotatedHexagonal120Flag;
+    return (first + cell.tileId()) | gidFlags(cell);
+}
+
+/**
+ * Returns the first global ID of the given \a tileset, or 0 when the
+ * tileset isn't known.
+ */
+unsigned GidMapper::firstGid(const Tileset *tileset) const
+{
+    for (const TilesetEntry &entry : mTilesets)
+        if (entry.tileset == tileset)
+            return entry.firstGid;
 
-    return gid;
+    return 0;
 }
 
 /**
@@ -153,7 +304,8 @@ unsigned GidMapper::cellToGid(const Cell &cell) const
  */
 QByteArray GidMapper::encodeLayerData(const TileLayer &tileLayer,
                                       Map::LayerDataFormat format,
-                                      QRect bounds, int compressionLevel) const
+                                      QRect bounds, int compressionLevel,
+                                      Encoding encoding) const
 {
     Q_ASSERT(format != Map::XML);
     Q_ASSERT(format != Map::CSV);
@@ -161,16 +313,42 @@ QByteArray GidMapper::encodeLayerData(const TileLayer &tileLayer,
     if (bounds.isEmpty())
         bounds = QRect(0, 0, tileLayer.width(), tileLayer.height());
 
-    QByteArray tileData;
-    tileData.reserve(bounds.width() * bounds.height() * 4);
+    // The buffer starts out zeroed, so empty areas can be skipped
+    QByteArray tileData(bounds.width() * bounds.height() * 4, '\0');
+    char *out = tileData.data();
+
+    // Consecutive tiles tend to come from the same tileset, so the first gid
+    // of the last seen tileset is remembered.
+    const Tileset *lastTileset = nullptr;
+    unsigned lastFirstGid = 0;
 
     for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
-        for (int x = bounds.left(); x <= bounds.right(); ++x) {
-            const unsigned gid = cellToGid(tileLayer.cellAt(x, y));
-            tileData.append(static_cast<char>(gid));
-            tileData.append(static_cast<char>(gid >> 8));
-            tileData.append(static_cast<char>(gid >> 16));
-            tileData.append(static_cast<char>(gid >> 24));
+        for (int x = bounds.left(); x <= bounds.right(); ) {
+            const int chunkEnd = std::min(bounds.right(), x | CHUNK_MASK);
+            const Chunk *chunk = tileLayer.findChunk(x, y);
+
+            if (!chunk) {
+                out += (chunkEnd - x + 1) * 4;
+                x = chunkEnd + 1;
+                continue;
+            }
+
+            for (; x <= chunkEnd; ++x, out += 4) {
+                const Cell &cell = chunk->cellAt(x & CHUNK_MASK, y & CHUNK_MASK);
+                if (cell.isEmpty())
+                    continue;
+
+                if (cell.tileset() != lastTileset) {
+                    lastTileset = cell.tileset();
+                    lastFirstGid = firstGid(lastTileset);
+                }
+
+                if (lastFirstGid == 0)  // tileset not found
+                    continue;
+
+                const unsigned gid = (lastFirstGid + cell.tileId()) | gidFlags(cell);
+                qToLittleEndian<quint32>(gid, out);
+            }
         }
     }
 
@@ -181,20 +359,135 @@ QByteArray GidMapper::encodeLayerData(const TileLayer &tileLayer,
     else if (format == Map::Base64Zstandard)
         tileData = compress(tileData, Zstandard, compressionLevel);
 
+    if (encoding == NotEncoded)
+        return tileData;
+
     return tileData.toBase64();
 }
 
+/**
+ * Encodes the given \a chunks of \a tileLayer, returning the encoded data
+ * for each chunk in the same order.
+ *
+ * Since the chunks are independent, they are encoded and compressed in
+ * parallel. The output is identical to encoding each chunk separately.
+ */
+QVector<QByteArray> GidMapper::encodeLayerData(const TileLayer &tileLayer,
+                                               Map::LayerDataFormat format,
+                                               const QVector<QRect> &chunks,
+                                               int compressionLevel,
+                                               Encoding encoding) const
+{
+    auto encode = [&] (const QRect &bounds) {
+        return encodeLayerData(tileLayer, format, bounds, compressionLevel, encoding);
+    };
+
+    return QtConcurrent::blockingMapped<QVector<QByteArray>>(chunks, encode);
+}
+
+/**
+ * Decodes the given base64 encoded \a layerData, optionally compressed
+ * according to \a format, and places the cells on \a tileLayer within
+ * \a bounds.
+ */
 GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
                                                   const QByteArray &layerData,
                                                   Map::LayerDataFormat format,
                                                   QRect bounds) const
+{
+    return decodeLayerData(tileLayer, { EncodedLayerData { bounds, layerData } }, format);
+}
+
+/**
+ * Decodes multiple blocks of layer data, usually the chunks of an infinite
+ * tile layer, and places their cells on \a tileLayer.
+ *
+ * The blocks are independent, so they are decoded in parallel. Only placing
+ * the resulting cells on the layer happens on the calling thread, in the
+ * order in which the blocks were given.
+ */
+GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
+                                                  const QVector<EncodedLayerData> &layerData,
+                                                  Map::LayerDataFormat format,
+                                                  Encoding encoding) const
 {
     Q_ASSERT(format != Map::XML);
     Q_ASSERT(format != Map::CSV);
 
-    QByteArray decodedData = QByteArray::fromBase64(layerData);
+    struct DecodedLayerData
+    {
+        QVector<Cell> cells;
+        QVector<int> maxTileIds;
+        unsigned invalidTile = 0;
+        DecodeError error = NoError;
+    };
+
+    auto decode = [this, format, encoding] (const EncodedLayerData &encoded) {
+        DecodedLayerData decoded;
+        decoded.error = decodeCells(encoded, format, encoding,
+                                    decoded.cells,
+                                    decoded.maxTileIds,
+                                    decoded.invalidTile);
+        return decoded;
+    };
+
+    QVector<DecodedLayerData> decodedLayerData;
+    if (layerData.size() == 1)
+        decodedLayerData.append(decode(layerData.first()));
+    else
+        decodedLayerData = QtConcurrent::blockingMapped<QVector<DecodedLayerData>>(layerData, decode);
+
+    for (qsizetype i = 0; i < decodedLayerData.size(); ++i) {
+        const DecodedLayerData &decoded = decodedLayerData.at(i);
+
+        if (decoded.error != NoError) {
+            mInvalidTile = decoded.invalidTile;
+            return decoded.error;
+        }
+
+        // Adjust the next tile IDs, in order to preserve tile references
+        // even to tilesets that failed to load.
+        for (qsizetype t = 0; t < decoded.maxTileIds.size(); ++t) {
+            const int maxTileId = decoded.maxTileIds.at(t);
+            if (maxTileId >= 0) {
+                const SharedTileset &tileset = mTilesets.at(t).tileset;
+                tileset->setNextTileId(std::max(tileset->nextTileId(), maxTileId + 1));
+            }
+        }
+
+        tileLayer.setCells(layerData.at(i).bounds, decoded.cells.constData());
+    }
+
+    return NoError;
+}
+
+/**
+ * Decodes a single block of layer data into \a cells, which will contain
+ * the cells row by row.
+ *
+ * This function does not modify the gid mapper or the tilesets, so that it
+ * can be called from multiple threads. The highest tile ID referenced in
+ * each tileset is stored in \a maxTileIds (indexed like mTilesets), and the
+ * offending gid is stored in \a invalidTile in case of an invalid tile.
+ */
+GidMapper::DecodeError GidMapper::decodeCells(const EncodedLayerData &layerData,
+                                              Map::LayerDataFormat format,
+                                              Encoding encoding,
+                                              QVector<Cell> &cells,
+                                              QVector<int> &maxTileIds,
+                                              unsigned &invalidTile) const
+{
+    const QRect &bounds = layerData.bounds;
     const int size = bounds.width() * bounds.height() * 4;
 
+    QByteArray decodedData;
+    if (encoding == NotEncoded) {
+        decodedData = layerData.data;
+    } else {
+        decodedData.resize(layerData.data.size() / 4 * 3 + 3);
+        decodedData.resize(decodeBase64(layerData.data, decodedData.data()));
+    }
+
     if (format == Map::Base64Gzip)
         decodedData = decompress(decodedData, size, Gzip);
     else if (format == Map::Base64Zlib)
@@ -205,30 +498,54 @@ GidMapper::DecodeError GidMapper::decodeLayerData(TileLayer &tileLayer,
     if (size != decodedData.length())
         return CorruptLayerData;
 
+    maxTileIds.fill(-1, mTilesets.size());
+    cells.resize(size / 4);
+
     const unsigned char *data = reinterpret_cast<const unsigned char*>(decodedData.constData());
-    int x = bounds.x();
-    int y = bounds.y();
-    bool ok;
-
-    for (int i = 0; i < size - 3; i += 4) {
-        const unsigned gid = data[i] |
-                             data[i + 1] << 8 |
-                             data[i + 2] << 16 |
-                             data[i + 3] << 24;
-
-        const Cell result = gidToCell(gid, ok);
-        if (!ok) {
-            mInvalidTile = gid;
-            return isEmpty() ? TileButNoTilesets : InvalidTile;
+    Cell *cell = cells.data();
+
+    // Consecutive tiles tend to come from the same tileset, so the last
+    // found tileset is checked before searching for another one.
+    Tileset *tileset = nullptr;
+    int *maxTileId = nullptr;
+    unsigned firstGid = 0;
+    unsigned nextFirstGid = 0;
+
+    for (int i = 0; i < size - 3; i += 4, ++cell) {
+        const unsigned flaggedGid = data[i] |
+                                    data[i + 1] << 8 |
+                                    data[i + 2] << 16 |
+                                    data[i + 3] << 24;
+
+        const unsigned gid = flaggedGid & ~GidFlagsMask;
+        const int flags = cellFlagsFromGid(flaggedGid);
+
+        if (gid == 0) {
+            if (flags)
+                cell->setFlags(flags);
+            continue;
         }
 
-        tileLayer.setCell(x, y, result);
-
-        x++;
-        if (x > bounds.right()) {
-            x = bounds.x();
-            y++;
+        if (gid < firstGid || gid >= nextFirstGid) {
+            const int index = findTilesetEntry(gid);
+            if (index == -1) {
+                invalidTile = flaggedGid;
+                return isEmpty() ? TileButNoTilesets : InvalidTile;
+            }
+
+            const TilesetEntry &entry = mTilesets.at(index);
+            tileset = entry.tileset.data();
+            maxTileId = maxTileIds.data() + index;
+            firstGid = entry.firstGid;
+            nextFirstGid = index + 1 < mTilesets.size() ? mTilesets.at(index + 1).firstGid
+                                                        : std::numeric_limits<unsigned>::max();
         }
+
+        const int tileId = static_cast<int>(gid - firstGid);
+        *maxTileId = std::max(*maxTileId, tileId);
+
+        cell->setTile(tileset, tileId);
+        cell->setFlags(flags);
     }
 
     return NoError;
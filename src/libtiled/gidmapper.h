@@ -31,7 +31,7 @@
 #include "map.h"
 #include "tilelayer.h"
 
-#include <QMap>
+#include <QVector>
 
 namespace Tiled {
 
@@ -51,10 +51,26 @@ public:
     Cell gidToCell(unsigned gid, bool &ok) const;
     unsigned cellToGid(const Cell &cell) const;
 
+    /**
+     * Whether the (optionally compressed) layer data is base64 encoded.
+     * Binary file formats can store the data without encoding.
+     */
+    enum Encoding {
+        Base64Encoded,
+        NotEncoded
+    };
+
     QByteArray encodeLayerData(const TileLayer &tileLayer,
                                Map::LayerDataFormat format,
                                QRect bounds = QRect(),
-                               int compressionLevel = -1) const;
+                               int compressionLevel = -1,
+                               Encoding encoding = Base64Encoded) const;
+
+    QVector<QByteArray> encodeLayerData(const TileLayer &tileLayer,
+                                        Map::LayerDataFormat format,
+                                        const QVector<QRect> &chunks,
+                                        int compressionLevel = -1,
+                                        Encoding encoding = Base64Encoded) const;
 
     enum DecodeError {
         NoError = 0,
@@ -63,34 +79,57 @@ public:
         InvalidTile
     };
 
+    /**
+     * A block of still encoded layer data, along with the area it covers.
+     */
+    struct EncodedLayerData
+    {
+        QRect bounds;
+        QByteArray data;
+    };
+
     DecodeError decodeLayerData(TileLayer &tileLayer,
                                 const QByteArray &layerData,
                                 Map::LayerDataFormat format,
                                 QRect bounds) const;
 
+    DecodeError decodeLayerData(TileLayer &tileLayer,
+                                const QVector<EncodedLayerData> &layerData,
+                                Map::LayerDataFormat format,
+                                Encoding encoding = Base64Encoded) const;
+
     unsigned invalidTile() const;
 
 private:
-    QMap<unsigned, SharedTileset> mFirstGidToTileset;
+    struct TilesetEntry
+    {
+        unsigned firstGid;
+        SharedTileset tileset;
+    };
+
+    int findTilesetEntry(unsigned gid) const;
+    unsigned firstGid(const Tileset *tileset) const;
+
+    DecodeError decodeCells(const EncodedLayerData &layerData,
+                            Map::LayerDataFormat format,
+                            Encoding encoding,
+                            QVector<Cell> &cells,
+                            QVector<int> &maxTileIds,
+                            unsigned &invalidTile) const;
+
+    // Sorted by first gid, allowing a binary search for the tileset of a gid
+    QVector<TilesetEntry> mTilesets;
 
     mutable unsigned mInvalidTile = 0;
 };
 
 
-/**
- * Insert the given \a tileset with \a firstGid as its first global ID.
- */
-inline void GidMapper::insert(unsigned firstGid, const SharedTileset &tileset)
-{
-    mFirstGidToTileset.insert(firstGid, tileset);
-}
-
 /**
  * Clears the gid mapper, so that it can be reused.
  */
 inline void GidMapper::clear()
 {
-    mFirstGidToTileset.clear();
+    mTilesets.clear();
 }
 
 /**
@@ -98,7 +137,7 @@ inline void GidMapper::clear()
  */
 inline bool GidMapper::isEmpty() const
 {
-    return mFirstGidToTileset.isEmpty();
+    return mTilesets.isEmpty();
 }
 
 /**
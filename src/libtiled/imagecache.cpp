@@ -28,27 +28,24 @@
 
 #include "imagecache.h"
 
+#include "filesystemwatcher.h"
 #include "logginginterface.h"
 #include "mapformat.h"
 #include "minimaprenderer.h"
 
 #include <QBitmap>
+#include <QCache>
 #include <QCoreApplication>
 #include <QFileInfo>
+#include <QMutex>
+#include <QPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent>
 
 namespace Tiled {
 
-struct LoadedPixmap
-{
-    explicit LoadedPixmap(const LoadedImage &cachedImage);
-
-    operator const QPixmap &() const { return pixmap; }
-
-    QPixmap pixmap;
-    QDateTime lastModified;
-};
-
-
 LoadedImage::LoadedImage()
     : LoadedImage(QImage(), QDateTime())
 {}
@@ -59,87 +56,359 @@ LoadedImage::LoadedImage(QImage image, const QDateTime &lastModified)
 {}
 
 
-LoadedPixmap::LoadedPixmap(const LoadedImage &cachedImage)
-    : pixmap(QPixmap::fromImage(cachedImage))
-    , lastModified(cachedImage.lastModified)
-{}
+namespace {
+
+/**
+ * Returns the watcher used to remove images from the cache when their file
+ * changes. May only be used from the thread of the application instance.
+ */
+FileSystemWatcher *imageFileWatcher()
+{
+    static QPointer<FileSystemWatcher> watcher;
+
+    if (!watcher) {
+        watcher = new FileSystemWatcher(QCoreApplication::instance());
+        QObject::connect(watcher, &FileSystemWatcher::fileChanged,
+                         watcher, [] (const QString &path) { ImageCache::remove(path); });
+    }
+
+    return watcher;
+}
+
+/**
+ * Starts or stops watching the given file. The calls are always queued to the
+ * thread of the application instance, so they are processed in order even
+ * when made from different threads.
+ */
+void setWatched(const QString &fileName, bool watched)
+{
+    QCoreApplication *app = QCoreApplication::instance();
+    if (!app || fileName.startsWith(QLatin1Char(':')))
+        return;
+
+    QMetaObject::invokeMethod(app, [fileName, watched] {
+        if (watched)
+            imageFileWatcher()->addPath(fileName);
+        else
+            imageFileWatcher()->removePath(fileName);
+    }, Qt::QueuedConnection);
+}
+
+/**
+ * A cached image, along with its pixmap once it has been requested. The file
+ * is watched for as long as it is part of the cache.
+ */
+struct CachedImage
+{
+    CachedImage(const QString &fileName, const LoadedImage &image);
+    ~CachedImage();
+
+    Q_DISABLE_COPY(CachedImage)
+
+    qsizetype cost() const;
+
+    const QString fileName;
+    const LoadedImage image;
+    QPixmap pixmap;
+};
+
+CachedImage::CachedImage(const QString &fileName, const LoadedImage &image)
+    : fileName(fileName)
+    , image(image)
+{
+    setWatched(fileName, true);
+}
+
+CachedImage::~CachedImage()
+{
+    setWatched(fileName, false);
+}
+
+/**
+ * Returns the cost of this entry in KB.
+ */
+qsizetype CachedImage::cost() const
+{
+    const qint64 pixmapBytes = qint64(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+    return qMax<qint64>(1, (image.image.sizeInBytes() + pixmapBytes) / 1024);
+}
+
+/**
+ * Images are preloaded using a separate pool, since its tasks never wait on
+ * anything. This way they can't be starved by threads waiting for them.
+ */
+QThreadPool *preloadPool()
+{
+    static QThreadPool pool;
+    return &pool;
+}
+
+} // anonymous namespace
+
+static const qint64 DefaultMaxMemory = qint64(512) * 1024 * 1024;
+
+// Protects the cache. The images are loaded without holding the lock, but a
+// file being loaded or converted to a pixmap by one thread is waited for by
+// other threads. Files that are queued for preloading are marked as loading by
+// a null thread. The file each thread is waiting for is tracked, so that
+// threads rendering maps that refer to each other can't wait on each other.
+static QMutex sMutex;
+static QWaitCondition sLoadingFinished;
+static QHash<QString, QThread*> sLoadingImages;
+static QHash<QThread*, QString> sWaitingThreads;
+static QCache<QString, CachedImage> sCache { DefaultMaxMemory / 1024 };
+
+/**
+ * Returns whether \a waitingThread is waiting, directly or through other
+ * threads, for a file being loaded by \a thread.
+ */
+static bool isWaitingFor(QThread *waitingThread, QThread *thread)
+{
+    while (waitingThread) {
+        if (waitingThread == thread)
+            return true;
+
+        const auto it = sWaitingThreads.constFind(waitingThread);
+        if (it == sWaitingThreads.constEnd())
+            return false;
+
+        waitingThread = sLoadingImages.value(it.value());
+    }
+
+    return false;
+}
+
+/**
+ * Waits until no other thread is loading the given file and marks it as being
+ * loaded by the current thread. Expects the lock to be held.
+ *
+ * Returns false when the file is already being loaded by the current thread,
+ * or by a thread that is waiting for the current thread. This happens when
+ * map files refer to each other as image, in which case waiting would never
+ * finish.
+ */
+static bool beginLoading(const QString &fileName)
+{
+    QThread *currentThread = QThread::currentThread();
+
+    while (sLoadingImages.contains(fileName)) {
+        if (isWaitingFor(sLoadingImages.value(fileName), currentThread))
+            return false;
+
+        sWaitingThreads.insert(currentThread, fileName);
+        sLoadingFinished.wait(&sMutex);
+        sWaitingThreads.remove(currentThread);
+    }
+
+    sLoadingImages.insert(fileName, currentThread);
+    return true;
+}
 
+static void reportRecursion(const QString &fileName)
+{
+    ERROR(QCoreApplication::translate("Tiled::ImageCache",
+                                      "Recursive metatile map detected: %1")
+          .arg(fileName), OpenFile { fileName });
+}
 
-QHash<QString, LoadedImage> ImageCache::sLoadedImages;
-QHash<QString, LoadedPixmap> ImageCache::sLoadedPixmaps;
+/**
+ * Removes the loading mark of the given file and wakes up any threads waiting
+ * for it. Expects the lock to be held.
+ */
+static void finishLoading(const QString &fileName)
+{
+    sLoadingImages.remove(fileName);
+    sLoadingFinished.wakeAll();
+}
 
 LoadedImage ImageCache::loadImage(const QString &fileName)
 {
     if (fileName.isEmpty())
         return {};
 
-    auto it = sLoadedImages.find(fileName);
+    QMutexLocker locker(&sMutex);
 
-    QFileInfo info(fileName);
-    bool found = it != sLoadedImages.end();
-    bool old = found && it.value().lastModified < info.lastModified();
+    if (!beginLoading(fileName)) {
+        locker.unlock();
+        reportRecursion(fileName);
+        return {};
+    }
 
-    if (old)
-        remove(fileName);
+    const LoadedImage loadedImage = cachedOrDecodedImage(fileName, locker);
+    finishLoading(fileName);
 
-    if (old || !found) {
-        QImage image(fileName);
+    return loadedImage;
+}
+
+/**
+ * Loads the image on the global thread pool. Like loadImage(), map files are
+ * rendered when they can't be loaded as image.
+ */
+QFuture<LoadedImage> ImageCache::loadImageAsync(const QString &fileName)
+{
+    return QtConcurrent::run([fileName] { return loadImage(fileName); });
+}
+
+/**
+ * Starts loading the given image in the background, unless it is already
+ * cached or being loaded. A later call to loadImage() or loadPixmap() will
+ * wait for it to finish rather than loading it again.
+ *
+ * Map files are not rendered in the background, since a map referring to
+ * another map that is being rendered could otherwise cause a deadlock. They
+ * are rendered when the image is requested.
+ */
+void ImageCache::preloadImage(const QString &fileName)
+{
+    if (fileName.isEmpty())
+        return;
 
-        // If the image failed to load, try to load and render a map file
-        if (image.isNull())
-            image = renderMap(fileName);
+    {
+        QMutexLocker locker(&sMutex);
+        if (sLoadingImages.contains(fileName) || sCache.contains(fileName))
+            return;
 
-        it = sLoadedImages.insert(fileName, LoadedImage(image, info.lastModified()));
+        sLoadingImages.insert(fileName, nullptr);
     }
 
-    return it.value();
+    preloadPool()->start([fileName] {
+        const LoadedImage loadedImage = decodeImage(fileName, false);
+
+        QMutexLocker locker(&sMutex);
+        insert(fileName, loadedImage);
+        finishLoading(fileName);
+    });
 }
 
+/**
+ * Returns the pixmap for the given image. Like the image itself, the pixmap
+ * is only converted once, even when it is requested by multiple threads at
+ * the same time.
+ */
 QPixmap ImageCache::loadPixmap(const QString &fileName)
 {
     if (fileName.isEmpty())
         return {};
 
-    auto it = sLoadedPixmaps.find(fileName);
+    QMutexLocker locker(&sMutex);
 
-    bool found = it != sLoadedPixmaps.end();
-    bool old = found && it.value().lastModified < QFileInfo(fileName).lastModified();
+    if (const CachedImage *cached = sCache.object(fileName))
+        if (!cached->pixmap.isNull())
+            return cached->pixmap;
 
-    if (old)
-        remove(fileName);
-    if (old || !found)
-        it = sLoadedPixmaps.insert(fileName, LoadedPixmap(loadImage(fileName)));
+    if (!beginLoading(fileName)) {
+        locker.unlock();
+        reportRecursion(fileName);
+        return {};
+    }
 
-    return it.value();
+    // Another thread may have converted the image while we were waiting
+    if (const CachedImage *cached = sCache.object(fileName)) {
+        if (!cached->pixmap.isNull()) {
+            const QPixmap pixmap = cached->pixmap;
+            finishLoading(fileName);
+            return pixmap;
+        }
+    }
+
+    const LoadedImage loadedImage = cachedOrDecodedImage(fileName, locker);
+
+    // Converting the image is done without holding the lock
+    locker.unlock();
+    const QPixmap pixmap = QPixmap::fromImage(loadedImage.image);
+    locker.relock();
+
+    // Re-inserting the entry updates its cost
+    if (CachedImage *cached = sCache.take(fileName)) {
+        if (cached->pixmap.isNull() && cached->image.image.cacheKey() == loadedImage.image.cacheKey())
+            cached->pixmap = pixmap;
+        sCache.insert(fileName, cached, cached->cost());
+    }
+
+    finishLoading(fileName);
+
+    return pixmap;
 }
 
 void ImageCache::remove(const QString &fileName)
 {
-    sLoadedImages.remove(fileName);
-    sLoadedPixmaps.remove(fileName);
+    QMutexLocker locker(&sMutex);
+    sCache.remove(fileName);
 }
 
-QImage ImageCache::renderMap(const QString &fileName)
+/**
+ * Sets the maximum amount of memory in bytes used by the cached images and
+ * pixmaps. The least recently used ones are evicted when necessary, though
+ * their memory is only freed once they are no longer used elsewhere.
+ */
+void ImageCache::setMaxMemory(qint64 bytes)
 {
-    if (fileName.isEmpty())
-        return {};
+    QMutexLocker locker(&sMutex);
+    sCache.setMaxCost(qMax<qint64>(1, bytes / 1024));
+}
 
-    static QSet<QString> loadingMaps;
+qint64 ImageCache::maxMemory()
+{
+    QMutexLocker locker(&sMutex);
+    return qint64(sCache.maxCost()) * 1024;
+}
 
-    if (loadingMaps.contains(fileName)) {
-        ERROR(QCoreApplication::translate("Tiled::ImageCache",
-                                          "Recursive metatile map detected: %1")
-              .arg(fileName), OpenFile { fileName });
-        return {};
-    }
+/**
+ * Returns the cached image, or decodes it without holding the lock and adds
+ * it to the cache. The file is expected to have been marked as loading by the
+ * current thread.
+ */
+LoadedImage ImageCache::cachedOrDecodedImage(const QString &fileName,
+                                             QMutexLocker<QMutex> &locker)
+{
+    if (const CachedImage *cached = sCache.object(fileName))
+        return cached->image;
+
+    locker.unlock();
+    const LoadedImage loadedImage = decodeImage(fileName, true);
+    locker.relock();
+
+    insert(fileName, loadedImage);
+    return loadedImage;
+}
+
+/**
+ * Loads the image. Can be called without holding the lock.
+ */
+LoadedImage ImageCache::decodeImage(const QString &fileName, bool renderMaps)
+{
+    const QDateTime lastModified = QFileInfo(fileName).lastModified();
+    QImage image(fileName);
+
+    // If the image failed to load, try to load and render a map file
+    if (image.isNull() && renderMaps)
+        image = renderMap(fileName);
+
+    return LoadedImage(image, lastModified);
+}
 
-    loadingMaps.insert(fileName);
+/**
+ * Adds the loaded image to the cache. Expects the lock to be held.
+ */
+void ImageCache::insert(const QString &fileName, const LoadedImage &loadedImage)
+{
+    // Failures are not cached, since a missing file can't be watched
+    if (loadedImage.image.isNull())
+        return;
 
+    auto cached = new CachedImage(fileName, loadedImage);
+    sCache.insert(fileName, cached, cached->cost());
+}
+
+QImage ImageCache::renderMap(const QString &fileName)
+{
+    if (fileName.isEmpty())
+        return {};
+
+    // Recursion, also through other threads, is detected by beginLoading()
     QString errorString;
     auto map = Tiled::readMap(fileName, &errorString);
 
-    loadingMaps.remove(fileName);
-
     if (!map) {
         ERROR(QCoreApplication::translate("Tiled::ImageCache",
                                           "Failed to read metatile map %1: %2")
@@ -32,8 +32,9 @@
 
 #include <QColor>
 #include <QDateTime>
-#include <QHash>
+#include <QFuture>
 #include <QImage>
+#include <QMutex>
 #include <QPixmap>
 #include <QString>
 
@@ -50,22 +51,33 @@ struct LoadedImage
     QDateTime lastModified;
 };
 
-struct LoadedPixmap;
-class Map;
-
+/**
+ * Caches loaded images and pixmaps by file name. The cache can be used from
+ * multiple threads, in which case each image is only loaded once.
+ *
+ * The least recently used images are evicted when the cache grows beyond its
+ * maximum memory use. Cached files are watched for changes, upon which they
+ * are removed from the cache.
+ */
 class TILEDSHARED_EXPORT ImageCache
 {
 public:
     static LoadedImage loadImage(const QString &fileName);
+    static QFuture<LoadedImage> loadImageAsync(const QString &fileName);
+    static void preloadImage(const QString &fileName);
     static QPixmap loadPixmap(const QString &fileName);
 
     static void remove(const QString &fileName);
 
+    static void setMaxMemory(qint64 bytes);
+    static qint64 maxMemory();
+
 private:
+    static LoadedImage cachedOrDecodedImage(const QString &fileName,
+                                            QMutexLocker<QMutex> &locker);
+    static LoadedImage decodeImage(const QString &fileName, bool renderMaps);
+    static void insert(const QString &fileName, const LoadedImage &loadedImage);
     static QImage renderMap(const QString &fileName);
-
-    static QHash<QString, LoadedImage> sLoadedImages;
-    static QHash<QString, LoadedPixmap> sLoadedPixmaps;
 };
 
 } // namespace Tiled
@@ -39,6 +39,8 @@
 
 #include <QtMath>
 
+#include <iterator>
+
 using namespace Tiled;
 
 Map::Map()
@@ -483,8 +485,26 @@ Layer *Map::findLayerById(int layerId) const
     return nullptr;
 }
 
+/**
+ * Returns the object with the given \a objectId, or nullptr when no object on
+ * this map has this id. When several objects share the id, the first one in
+ * layer and object order is returned.
+ *
+ * This is a constant-time lookup, since the objects are indexed by their id
+ * as they are added to or removed from the map.
+ */
 MapObject *Map::findObjectById(int objectId) const
 {
+    if (objectId == 0)
+        return nullptr;
+
+    const auto range = mObjectsById.equal_range(objectId);
+    if (range.first == range.second)
+        return nullptr;
+    if (std::next(range.first) == range.second)
+        return *range.first;
+
+    // The index doesn't know the order of duplicates, so fall back to a scan
     for (Layer *layer : objectGroups()) {
         for (MapObject *mapObject : static_cast<ObjectGroup*>(layer)->objects()) {
             if (mapObject->id() == objectId)
@@ -494,6 +514,25 @@ MapObject *Map::findObjectById(int objectId) const
     return nullptr;
 }
 
+/**
+ * Adds the \a object to the id index. Objects without an id are not indexed.
+ */
+void Map::registerObject(MapObject *object)
+{
+    if (object->id() != 0 && !mObjectsById.contains(object->id(), object))
+        mObjectsById.insert(object->id(), object);
+}
+
+/**
+ * Removes the \a object from the id index. Needs to be called before the id
+ * of the object changes.
+ */
+void Map::unregisterObject(MapObject *object)
+{
+    if (object->id() != 0)
+        mObjectsById.remove(object->id(), object);
+}
+
 /**
  * Returns the area occupied by tiles. Usually simply matches the map size,
  * but for infinite maps it returns a rough (chunks based) bounding rectangle
@@ -37,6 +37,7 @@
 #include <QColor>
 #include <QList>
 #include <QMargins>
+#include <QMultiHash>
 #include <QSharedPointer>
 #include <QSize>
 #include <QVector>
@@ -329,9 +330,14 @@ public:
 
 private:
     friend class GroupLayer;    // so it can call adoptLayer
+    friend class MapObject;     // so it can update the object id index
+    friend class ObjectGroup;   // so it can update the object id index
 
     void adoptLayer(Layer &layer);
 
+    void registerObject(MapObject *object);
+    void unregisterObject(MapObject *object);
+
     void recomputeDrawMargins() const;
 
     Parameters mParameters;
@@ -342,6 +348,7 @@ private:
 
     QList<Layer*> mLayers;
     QVector<SharedTileset> mTilesets;
+    QMultiHash<int, MapObject*> mObjectsById;
 
     int mNextLayerId = 1;
     int mNextObjectId = 1;
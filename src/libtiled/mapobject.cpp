@@ -240,6 +240,25 @@ Map *MapObject::map() const
     return mObjectGroup ? mObjectGroup->map() : nullptr;
 }
 
+/**
+ * Sets the id of this object.
+ */
+void MapObject::setId(int id)
+{
+    if (mId == id)
+        return;
+
+    // Keep the object id index of the map up to date
+    Map *map = this->map();
+    if (map)
+        map->unregisterObject(this);
+
+    mId = id;
+
+    if (map)
+        map->registerObject(this);
+}
+
 /*
  * Returns the effective alignment for this object on the given \a map.
  *
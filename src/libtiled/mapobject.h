@@ -265,12 +265,6 @@ private:
 inline int MapObject::id() const
 { return mId; }
 
-/**
- * Sets the id of this object.
- */
-inline void MapObject::setId(int id)
-{ mId = id; }
-
 /**
  * Sets the id back to 0. Mostly used when a new id should be assigned
  * after the object has been cloned.
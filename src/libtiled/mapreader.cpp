@@ -33,6 +33,7 @@
 #include "compression.h"
 #include "gidmapper.h"
 #include "grouplayer.h"
+#include "imagecache.h"
 #include "imagelayer.h"
 #include "objectgroup.h"
 #include "objecttemplate.h"
@@ -52,6 +53,7 @@
 #include <QXmlStreamReader>
 
 #include <memory>
+#include <utility>
 
 using namespace Tiled;
 using namespace Tiled::Internal;
@@ -106,9 +108,8 @@ private:
                            QStringView encoding,
                            QRect bounds);
     void decodeBinaryLayerData(TileLayer &tileLayer,
-                               const QByteArray &data,
-                               Map::LayerDataFormat format,
-                               QRect bounds);
+                               const QVector<GidMapper::EncodedLayerData> &layerData,
+                               Map::LayerDataFormat format);
     void decodeCSVLayerData(TileLayer &tileLayer,
                             QStringView text,
                             QRect bounds);
@@ -145,6 +146,7 @@ private:
     QDir mPath;
     std::unique_ptr<Map> mMap;
     GidMapper mGidMapper;
+    QVector<GidMapper::EncodedLayerData> mPendingLayerData;
     bool mReadingExternalTileset;
 
     QXmlStreamReader xml;
@@ -644,6 +646,9 @@ void MapReaderPrivate::readTilesetImage(Tileset &tileset)
     Q_ASSERT(xml.isStartElement() && xml.name() == QLatin1String("image"));
 
     tileset.setImageReference(readImage());
+
+    // Start loading the image while the rest of the file is being read
+    ImageCache::preloadImage(urlToLocalFileOrQrc(tileset.imageSource()));
 }
 
 ImageReference MapReaderPrivate::readImage()
@@ -966,6 +971,14 @@ void MapReaderPrivate::readTileLayerData(TileLayer &tileLayer)
                       layerDataFormat,
                       encoding,
                       QRect(0, 0, tileLayer.width(), tileLayer.height()));
+
+    // Binary data of all chunks is decoded at once, which allows it to
+    // happen in parallel
+    if (!mPendingLayerData.isEmpty()) {
+        const auto layerData = std::exchange(mPendingLayerData, {});
+        if (!xml.hasError())
+            decodeBinaryLayerData(tileLayer, layerData, layerDataFormat);
+    }
 }
 
 void MapReaderPrivate::readTileLayerRect(TileLayer &tileLayer,
@@ -1015,10 +1028,7 @@ void MapReaderPrivate::readTileLayerRect(TileLayer &tileLayer,
             }
         } else if (xml.isCharacters() && !xml.isWhitespace()) {
             if (encoding == QLatin1String("base64")) {
-                decodeBinaryLayerData(tileLayer,
-                                      xml.text().toLatin1(),
-                                      layerDataFormat,
-                                      bounds);
+                mPendingLayerData.append({ bounds, xml.text().toLatin1() });
             } else if (encoding == QLatin1String("csv")) {
                 decodeCSVLayerData(tileLayer, xml.text(), bounds);
             }
@@ -1027,13 +1037,12 @@ void MapReaderPrivate::readTileLayerRect(TileLayer &tileLayer,
 }
 
 void MapReaderPrivate::decodeBinaryLayerData(TileLayer &tileLayer,
-                                             const QByteArray &data,
-                                             Map::LayerDataFormat format,
-                                             QRect bounds)
+                                             const QVector<GidMapper::EncodedLayerData> &layerData,
+                                             Map::LayerDataFormat format)
 {
     GidMapper::DecodeError error;
 
-    error = mGidMapper.decodeLayerData(tileLayer, data, format, bounds);
+    error = mGidMapper.decodeLayerData(tileLayer, layerData, format);
 
     switch (error) {
     case GidMapper::CorruptLayerData:
@@ -40,6 +40,7 @@
 #include "tilelayer.h"
 
 #include <QCache>
+#include <QMutex>
 #include <QPaintEngine>
 #include <QPainter>
 #include <QVector2D>
@@ -84,17 +85,24 @@ static bool needsTint(const QColor &color)
             color != QColor(255, 255, 255, 255);
 }
 
+// Cache for up to 100 MB of tinted pixmaps, since tinting is expensive
+static const qsizetype TintCacheSize = 100 * 1024;
+
 static QPixmap tinted(const QPixmap &pixmap, const QRect &rect, const QColor &color)
 {
     if (pixmap.isNull() || !needsTint(color))
         return pixmap;
 
-    // Cache for up to 100 MB of tinted pixmaps, since tinting is expensive
-    static QCache<TintedKey, QPixmap> cache { 100 * 1024 };
+    // The mutex allows rendering from multiple threads
+    static QCache<TintedKey, QPixmap> cache { TintCacheSize };
+    static QMutex cacheMutex;
 
     const TintedKey tintedKey { pixmap.cacheKey(), rect, color };
-    if (auto cached = cache.object(tintedKey))
-        return *cached;
+    {
+        QMutexLocker locker(&cacheMutex);
+        if (auto cached = cache.object(tintedKey))
+            return *cached;
+    }
 
     QPixmap resultImage = pixmap.copy(rect);
 
@@ -125,11 +133,104 @@ static QPixmap tinted(const QPixmap &pixmap, const QRect &rect, const QColor &co
 
     painter.end();
 
+    QMutexLocker locker(&cacheMutex);
     cache.insert(tintedKey, new QPixmap(resultImage), cost(resultImage));
 
     return resultImage;
 }
 
+/**
+ * Returns whether the whole \a image should be tinted when drawing tiles
+ * from it, so that the tinted version can be shared by all tiles referring
+ * to the same image.
+ *
+ * Images too large for the tint cache would be tinted again for each batch
+ * of tiles, so for those only the source rect of each tile is tinted.
+ */
+static bool tintWholeImage(const QPixmap &image, const QColor &color)
+{
+    return !needsTint(color) || cost(image) <= TintCacheSize;
+}
+
+/**
+ * Draws the given \a fragment with only its source rect of the \a image
+ * tinted.
+ */
+static void drawTintedFragment(QPainter *painter,
+                               QPainter::PixmapFragment fragment,
+                               const QPixmap &image,
+                               const QColor &color)
+{
+    const QRect sourceRect = QRectF(fragment.sourceLeft, fragment.sourceTop,
+                                    fragment.width, fragment.height).toAlignedRect();
+    fragment.sourceLeft -= sourceRect.x();
+    fragment.sourceTop -= sourceRect.y();
+
+    painter->drawPixmapFragments(&fragment, 1, tinted(image, sourceRect, color));
+}
+
+// Limits the downscaled versions of an image to 1/32 of its size
+static const int MaxMipLevel = 5;
+
+/**
+ * Returns the given \a pixmap scaled down by a factor of two, \a level
+ * times. Each level is made from the previous one by averaging 2x2 blocks,
+ * so tiles aligned to the level do not bleed into each other.
+ */
+static QPixmap scaledDown(const QPixmap &pixmap, int level)
+{
+    if (level == 0 || pixmap.isNull())
+        return pixmap;
+
+    // Cache for up to 100 MB of scaled pixmaps, which will often cover all
+    // the levels of the tileset images in use. The mutex allows rendering
+    // from multiple threads.
+    static QCache<std::pair<qint64, int>, QPixmap> cache { 100 * 1024 };
+    static QMutex cacheMutex;
+
+    const std::pair<qint64, int> key { pixmap.cacheKey(), level };
+    {
+        QMutexLocker locker(&cacheMutex);
+        if (auto cached = cache.object(key))
+            return *cached;
+    }
+
+    QImage image = scaledDown(pixmap, level - 1).toImage();
+
+    // Drop any odd row or column, to scale by exactly half
+    if (image.width() % 2 || image.height() % 2)
+        image = image.copy(0, 0, image.width() & ~1, image.height() & ~1);
+
+    image = image.scaled(image.size() / 2, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+    const QPixmap result = QPixmap::fromImage(std::move(image));
+
+    QMutexLocker locker(&cacheMutex);
+    cache.insert(key, new QPixmap(result), cost(result));
+
+    return result;
+}
+
+/**
+ * Returns the level of the downscaled image to use when drawing the part
+ * \a rect of an image at the given \a scale. This is the smallest version
+ * of the image that still has at least the resolution needed, and in which
+ * the \a rect is aligned to whole pixels.
+ */
+static int mipLevel(qreal scale, const QRect &rect)
+{
+    int level = 0;
+
+    while (level < MaxMipLevel && scale * (2 << level) <= 1) {
+        const int mask = (2 << level) - 1;
+        if ((rect.x() | rect.y() | rect.width() | rect.height()) & mask)
+            break;
+        ++level;
+    }
+
+    return level;
+}
+
 MapRenderer::~MapRenderer()
 {}
 
@@ -408,8 +509,10 @@ CellRenderer::CellRenderer(QPainter *painter, const MapRenderer *renderer, const
     : mPainter(painter)
     , mRenderer(renderer)
     , mTile(nullptr)
+    , mShowCollisionShapes(renderer->flags().testFlag(ShowTileCollisionShapes))
     , mIsOpenGL(hasOpenGLEngine(painter))
     , mTintColor(tintColor)
+    , mDeviceScale(renderer->painterScale() * painter->device()->devicePixelRatioF())
 {
 }
 
@@ -417,8 +520,9 @@ CellRenderer::CellRenderer(QPainter *painter, const MapRenderer *renderer, const
  * Renders a \a cell with the given \a origin at \a pos, taking into account
  * the flipping and tile offset.
  *
- * For performance reasons, the actual drawing is delayed until a different
- * kind of tile has to be drawn. For this reason it is necessary to call
+ * For performance reasons, the actual drawing is delayed until a tile from a
+ * different source image has to be drawn, so that all tiles sharing a tileset
+ * image are drawn in a single call. For this reason it is necessary to call
  * flush when finished doing drawCell calls. This function is also called by
  * the destructor so usually an explicit call is not needed.
  *
@@ -441,19 +545,16 @@ void CellRenderer::render(const Cell &cell, const QPointF &screenPos, const QSiz
         return;
     }
 
-    // The USHRT_MAX limit is rather arbitrary but avoids a crash in
-    // drawPixmapFragments for a large number of fragments.
-    if (mTile != tile || mFragments.size() == USHRT_MAX)
-        flush();
-
     const QPixmap &image = tile->image();
-    QRect imageRect = tile->imageRect();
+
+    // Tiles with collision shapes to paint are batched per tile, since the
+    // shapes are painted for each fragment after drawing the batch.
+    const Tile *collisionTile = hasCollisionShapes(tile) ? tile : nullptr;
+
+    const QRect imageRect = tile->imageRect();
     if (imageRect.isEmpty())
         return;
 
-    if (needsTint(mTintColor))
-        imageRect.moveTopLeft(QPoint(0, 0));
-
     const QPoint offset = tile->offset();
     const QPointF sizeHalf { size.width() / 2, size.height() / 2 };
 
@@ -507,9 +608,44 @@ void CellRenderer::render(const Cell &cell, const QPointF &screenPos, const QSiz
         fragment.x += halfDiff;
     }
 
+    // When zoomed out, draw from a downscaled version of the image, which
+    // is both faster and smoother. Not done when painting collision shapes,
+    // since those rely on the fragment size.
+    QPixmap sourceImage = image;
+
+    if (!collisionTile) {
+        const qreal scale = mDeviceScale * std::min(std::abs(fragment.scaleX),
+                                                    std::abs(fragment.scaleY));
+        const int level = mipLevel(scale, imageRect);
+
+        if (level > 0) {
+            if (image.cacheKey() != mMipSourceKey || level != mMipLevel) {
+                mMipSourceKey = image.cacheKey();
+                mMipLevel = level;
+                mMipImage = scaledDown(image, level);
+            }
+
+            const int factor = 1 << level;
+            sourceImage = mMipImage;
+            fragment.sourceLeft /= factor;
+            fragment.sourceTop /= factor;
+            fragment.width /= factor;
+            fragment.height /= factor;
+            fragment.scaleX *= factor;
+            fragment.scaleY *= factor;
+        }
+    }
+
     fragment.scaleX *= flippedHorizontally ? -1 : 1;
     fragment.scaleY *= flippedVertically ? -1 : 1;
 
+    // The USHRT_MAX limit is rather arbitrary but avoids a crash in
+    // drawPixmapFragments for a large number of fragments.
+    if (sourceImage.cacheKey() != mImage.cacheKey() ||
+            mTile != collisionTile ||
+            mFragments.size() == USHRT_MAX)
+        flush();
+
     // Avoid using drawPixmapFragments with OpenGL in Qt 6.4.1 and above
     // (https://bugreports.qt.io/browse/QTBUG-111416)
 #if QT_VERSION < QT_VERSION_CHECK(6, 4, 1) || QT_VERSION >= QT_VERSION_CHECK(6, 5, 0)
@@ -517,7 +653,8 @@ void CellRenderer::render(const Cell &cell, const QPointF &screenPos, const QSiz
 #else
     if (!mIsOpenGL && fragment.scaleX > 0 && fragment.scaleY > 0) {
 #endif
-        mTile = tile;
+        mImage = sourceImage;
+        mTile = collisionTile;
         mFragments.append(fragment);
         return;
     }
@@ -535,18 +672,22 @@ void CellRenderer::render(const Cell &cell, const QPointF &screenPos, const QSiz
 
     const QRectF target(fragment.width * -0.5, fragment.height * -0.5,
                         fragment.width, fragment.height);
-    const QRectF source(fragment.sourceLeft, fragment.sourceTop,
-                        fragment.width, fragment.height);
+    QRectF source(fragment.sourceLeft, fragment.sourceTop,
+                  fragment.width, fragment.height);
+
+    QRect tintRect = sourceImage.rect();
+    if (!tintWholeImage(sourceImage, mTintColor)) {
+        tintRect = source.toAlignedRect();
+        source.translate(-tintRect.topLeft());
+    }
 
     mPainter->setTransform(transform);
-    mPainter->drawPixmap(target, tinted(image, tile->imageRect(), mTintColor), source);
+    mPainter->drawPixmap(target, tinted(sourceImage, tintRect, mTintColor), source);
     mPainter->setTransform(oldTransform);
 
     // A bit of a hack to still draw tile collision shapes when requested
-    if (mRenderer->flags().testFlag(ShowTileCollisionShapes)
-            && tile->objectGroup()
-            && !tile->objectGroup()->objects().isEmpty()) {
-        mTile = tile;
+    if (collisionTile) {
+        mTile = collisionTile;
         mFragments.append(fragment);
         paintTileCollisionShapes();
         mTile = nullptr;
@@ -559,25 +700,37 @@ void CellRenderer::render(const Cell &cell, const QPointF &screenPos, const QSiz
  */
 void CellRenderer::flush()
 {
-    if (!mTile)
+    if (mFragments.isEmpty())
         return;
 
-    mPainter->drawPixmapFragments(mFragments.constData(),
-                                  mFragments.size(),
-                                  tinted(mTile->image(),
-                                         mTile->imageRect(),
-                                         mTintColor));
+    if (tintWholeImage(mImage, mTintColor)) {
+        mPainter->drawPixmapFragments(mFragments.constData(),
+                                      mFragments.size(),
+                                      tinted(mImage, mImage.rect(), mTintColor));
+    } else {
+        for (const QPainter::PixmapFragment &fragment : std::as_const(mFragments))
+            drawTintedFragment(mPainter, fragment, mImage, mTintColor);
+    }
 
-    if (mRenderer->flags().testFlag(ShowTileCollisionShapes)
-            && mTile->objectGroup()
-            && !mTile->objectGroup()->objects().isEmpty()) {
+    if (mTile)
         paintTileCollisionShapes();
-    }
 
+    mImage = QPixmap();
     mTile = nullptr;
     mFragments.clear();
 }
 
+/**
+ * Returns whether the collision shapes of the given \a tile should be
+ * painted on top of it.
+ */
+bool CellRenderer::hasCollisionShapes(const Tile *tile) const
+{
+    return mShowCollisionShapes
+            && tile->objectGroup()
+            && !tile->objectGroup()->objects().isEmpty();
+}
+
 /**
  * Returns a transform that rotates by \a rotation degrees around the given
  * \a position.
@@ -340,14 +340,23 @@ public:
     void flush();
 
 private:
+    bool hasCollisionShapes(const Tile *tile) const;
     void paintTileCollisionShapes();
 
     QPainter * const mPainter;
     const MapRenderer * const mRenderer;
-    const Tile *mTile;
+    QPixmap mImage;         // source image of the pending fragments
+    const Tile *mTile;      // set when collision shapes need to be painted
     QVector<QPainter::PixmapFragment> mFragments;
+    const bool mShowCollisionShapes;
     const bool mIsOpenGL;
     const QColor mTintColor;
+    const qreal mDeviceScale;
+
+    // Last downscaled image, to avoid looking it up for each tile
+    qint64 mMipSourceKey = 0;
+    int mMipLevel = 0;
+    QPixmap mMipImage;
 };
 
 } // namespace Tiled
@@ -510,7 +510,15 @@ QVariant MapToVariantConverter::toVariant(const TileLayer &tileLayer,
         QVariantList chunkVariants;
 
         const auto chunks = tileLayer.sortedChunksToWrite(chunkSize);
-        for (const QRect &rect : chunks) {
+
+        // Binary chunk data is encoded up front, which allows it to happen
+        // in parallel
+        QVector<QByteArray> encodedChunks;
+        if (format != Map::XML && format != Map::CSV)
+            encodedChunks = mGidMapper.encodeLayerData(tileLayer, format, chunks, compressionLevel);
+
+        for (qsizetype i = 0; i < chunks.size(); ++i) {
+            const QRect &rect = chunks.at(i);
             QVariantMap chunkVariant;
 
             chunkVariant[QStringLiteral("x")] = rect.x();
@@ -518,7 +526,10 @@ QVariant MapToVariantConverter::toVariant(const TileLayer &tileLayer,
             chunkVariant[QStringLiteral("width")] = rect.width();
             chunkVariant[QStringLiteral("height")] = rect.height();
 
-            addTileLayerData(chunkVariant, tileLayer, format, compressionLevel, rect);
+            if (encodedChunks.isEmpty())
+                addTileLayerData(chunkVariant, tileLayer, format, compressionLevel, rect);
+            else
+                chunkVariant[QStringLiteral("data")] = encodedChunks.at(i);
 
             chunkVariants.append(chunkVariant);
         }
@@ -753,6 +764,17 @@ void MapToVariantConverter::addTileLayerData(QVariantMap &variant,
     switch (format) {
     case Map::XML:
     case Map::CSV: {
+        if (mPackedTileData) {
+            QVector<unsigned> gids;
+            gids.reserve(bounds.width() * bounds.height());
+            for (int y = bounds.top(); y <= bounds.bottom(); ++y)
+                for (int x = bounds.left(); x <= bounds.right(); ++x)
+                    gids.append(mGidMapper.cellToGid(tileLayer.cellAt(x, y)));
+
+            variant[QStringLiteral("data")] = QVariant::fromValue(gids);
+            break;
+        }
+
         QVariantList tileVariants;
         for (int y = bounds.top(); y <= bounds.bottom(); ++y)
             for (int x = bounds.left(); x <= bounds.right(); ++x)
@@ -62,6 +62,14 @@ public:
     QVariant toVariant(const Tileset &tileset, const QDir &directory);
     QVariant toVariant(const ObjectTemplate &objectTemplate, const QDir &directory);
 
+    /**
+     * Sets whether CSV tile layer data is stored as a QVector<unsigned> of
+     * GIDs rather than as a QVariantList, which takes a lot less memory.
+     * Only enable this when the result is passed to code that supports it,
+     * like the VariantToMapConverter.
+     */
+    void setPackedTileData(bool packedTileData) { mPackedTileData = packedTileData; }
+
 private:
     QVariant toVariant(const Tileset &tileset, int firstGid) const;
     QVariant toVariant(const Properties &properties) const;
@@ -88,6 +96,7 @@ private:
                        const Properties &properties) const;
 
     int mVersion;
+    bool mPackedTileData = false;
     QDir mDir;
     GidMapper mGidMapper;
 };
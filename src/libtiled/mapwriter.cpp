@@ -77,6 +77,7 @@ public:
     int mCompressionlevel { -1 };
     bool mDtdEnabled { false };
     bool mMinimize { false };
+    bool mTileLayerDataEnabled { true };
     QSize mChunkSize { CHUNK_SIZE, CHUNK_SIZE };
 
 private:
@@ -86,6 +87,7 @@ private:
     void writeLayers(QXmlStreamWriter &w, const QList<Layer *> &layers);
     void writeTileLayer(QXmlStreamWriter &w, const TileLayer &tileLayer);
     void writeTileLayerData(QXmlStreamWriter &w, const TileLayer &tileLayer, QRect bounds);
+    void writeBinaryLayerData(QXmlStreamWriter &w, const QByteArray &encodedData);
     void writeLayerAttributes(QXmlStreamWriter &w, const Layer &layer);
     void writeObjectGroup(QXmlStreamWriter &w, const ObjectGroup &objectGroup);
     void writeObject(QXmlStreamWriter &w, const MapObject &mapObject);
@@ -540,6 +542,11 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
     writeLayerAttributes(w, tileLayer);
     writeProperties(w, tileLayer.properties());
 
+    if (!mTileLayerDataEnabled) {
+        w.writeEndElement(); // </layer>
+        return;
+    }
+
     QString encoding;
     QString compression;
 
@@ -566,14 +573,30 @@ void MapWriterPrivate::writeTileLayer(QXmlStreamWriter &w,
 
     if (tileLayer.map()->infinite()) {
         const auto chunks = tileLayer.sortedChunksToWrite(mChunkSize);
-        for (const QRect &rect : chunks) {
+
+        // Binary chunk data is encoded up front, which allows it to happen
+        // in parallel
+        QVector<QByteArray> encodedChunks;
+        if (mLayerDataFormat != Map::XML && mLayerDataFormat != Map::CSV) {
+            encodedChunks = mGidMapper.encodeLayerData(tileLayer,
+                                                       mLayerDataFormat,
+                                                       chunks,
+                                                       mCompressionlevel);
+        }
+
+        for (qsizetype i = 0; i < chunks.size(); ++i) {
+            const QRect &rect = chunks.at(i);
+
             w.writeStartElement(QStringLiteral("chunk"));
             w.writeAttribute(QStringLiteral("x"), QString::number(rect.x()));
             w.writeAttribute(QStringLiteral("y"), QString::number(rect.y()));
             w.writeAttribute(QStringLiteral("width"), QString::number(rect.width()));
             w.writeAttribute(QStringLiteral("height"), QString::number(rect.height()));
 
-            writeTileLayerData(w, tileLayer, rect);
+            if (encodedChunks.isEmpty())
+                writeTileLayerData(w, tileLayer, rect);
+            else
+                writeBinaryLayerData(w, encodedChunks.at(i));
 
             w.writeEndElement(); // </chunk>
         }
@@ -619,19 +642,23 @@ void MapWriterPrivate::writeTileLayerData(QXmlStreamWriter &w,
 
         w.writeCharacters(chunkData);
     } else {
-        QByteArray chunkData = mGidMapper.encodeLayerData(tileLayer,
-                                                          mLayerDataFormat,
-                                                          bounds,
-                                                          mCompressionlevel);
+        writeBinaryLayerData(w, mGidMapper.encodeLayerData(tileLayer,
+                                                           mLayerDataFormat,
+                                                           bounds,
+                                                           mCompressionlevel));
+    }
+}
 
-        if (!mMinimize)
-            w.writeCharacters(QLatin1String("\n   "));
+void MapWriterPrivate::writeBinaryLayerData(QXmlStreamWriter &w,
+                                            const QByteArray &encodedData)
+{
+    if (!mMinimize)
+        w.writeCharacters(QLatin1String("\n   "));
 
-        w.writeCharacters(QString::fromLatin1(chunkData));
+    w.writeCharacters(QString::fromLatin1(encodedData));
 
-        if (!mMinimize)
-            w.writeCharacters(QLatin1String("\n  "));
-    }
+    if (!mMinimize)
+        w.writeCharacters(QLatin1String("\n  "));
 }
 
 void MapWriterPrivate::writeLayerAttributes(QXmlStreamWriter &w,
@@ -1122,3 +1149,13 @@ bool MapWriter::minimizeOutput() const
 {
     return d->mMinimize;
 }
+
+void MapWriter::setTileLayerDataEnabled(bool enabled)
+{
+    d->mTileLayerDataEnabled = enabled;
+}
+
+bool MapWriter::isTileLayerDataEnabled() const
+{
+    return d->mTileLayerDataEnabled;
+}
@@ -118,6 +118,13 @@ public:
     void setMinimizeOutput(bool enabled);
     bool minimizeOutput() const;
 
+    /**
+     * Sets whether the data of tile layers is written. Can be disabled by
+     * formats that store the tile layer data separately.
+     */
+    void setTileLayerDataEnabled(bool enabled);
+    bool isTileLayerDataEnabled() const;
+
 private:
     Q_DISABLE_COPY(MapWriter)
 
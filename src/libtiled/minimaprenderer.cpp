@@ -120,7 +120,63 @@ static void extendMapRect(QRect &mapBoundingRect, const MapRenderer &renderer)
     mapBoundingRect = rect.toAlignedRect();
 }
 
+/**
+ * Returns the transform from map pixel coordinates to the coordinates of an
+ * image of the given \a imageSize, as used when rendering the minimap.
+ */
+QTransform MiniMapRenderer::transform(QSize imageSize, RenderFlags renderFlags) const
+{
+    return transform(imageSize, renderedRect(renderFlags));
+}
+
+/**
+ * Returns the part of the map that is rendered, in pixel coordinates.
+ */
+QRect MiniMapRenderer::renderedRect(RenderFlags renderFlags) const
+{
+    QRect mapBoundingRect = mRenderer->mapBoundingRect();
+
+    if (renderFlags.testFlag(IncludeOverhangingTiles))
+        extendMapRect(mapBoundingRect, *mRenderer);
+
+    if (!renderFlags.testFlag(IgnoreOffsetsAndImages))
+        mMap->adjustBoundingRectForOffsetsAndImageLayers(mapBoundingRect);
+
+    return mapBoundingRect;
+}
+
+QTransform MiniMapRenderer::transform(QSize imageSize, const QRect &renderedRect)
+{
+    const QSize mapSize = renderedRect.size();
+
+    // Determine the largest possible scale
+    const qreal scale = qMin(static_cast<qreal>(imageSize.width()) / mapSize.width(),
+                             static_cast<qreal>(imageSize.height()) / mapSize.height());
+
+    // Center the map in the requested size
+    const QSize scaledMapSize = mapSize * scale;
+    const QPointF centerOffset((imageSize.width() - scaledMapSize.width()) / 2,
+                               (imageSize.height() - scaledMapSize.height()) / 2);
+
+    QTransform transform;
+    transform.translate(centerOffset.x(), centerOffset.y());
+    transform.scale(scale, scale);
+    transform.translate(-renderedRect.x(), -renderedRect.y());
+    return transform;
+}
+
 void MiniMapRenderer::renderToImage(QImage &image, RenderFlags renderFlags) const
+{
+    renderToImage(image, renderFlags, QRegion());
+}
+
+/**
+ * Renders only the part of the \a image within the \a exposed region,
+ * leaving the rest of the image untouched. The whole image is rendered when
+ * \a exposed is empty.
+ */
+void MiniMapRenderer::renderToImage(QImage &image, RenderFlags renderFlags,
+                                    const QRegion &exposed) const
 {
     if (!mMap)
         return;
@@ -133,36 +189,34 @@ void MiniMapRenderer::renderToImage(QImage &image, RenderFlags renderFlags) cons
     const bool drawTileGrid = renderFlags.testFlag(RenderFlag::DrawGrid);
     const bool visibleLayersOnly = renderFlags.testFlag(RenderFlag::IgnoreInvisibleLayer);
 
-    QRect mapBoundingRect = mRenderer->mapBoundingRect();
-
-    if (renderFlags.testFlag(IncludeOverhangingTiles))
-        extendMapRect(mapBoundingRect, *mRenderer);
-
-    if (!renderFlags.testFlag(IgnoreOffsetsAndImages))
-        mMap->adjustBoundingRectForOffsetsAndImageLayers(mapBoundingRect);
-
-    QSize mapSize = mapBoundingRect.size();
-
-    // Determine the largest possible scale
-    const qreal scale = qMin(static_cast<qreal>(image.width()) / mapSize.width(),
-                             static_cast<qreal>(image.height()) / mapSize.height());
+    const QRect mapBoundingRect = renderedRect(renderFlags);
+    const QTransform transform = MiniMapRenderer::transform(image.size(), mapBoundingRect);
+    const qreal scale = transform.m11();
 
+    QColor backgroundColor = Qt::transparent;
     if (renderFlags.testFlag(DrawBackground) && mMap->backgroundColor().isValid())
-        image.fill(mMap->backgroundColor());
-    else
-        image.fill(Qt::transparent);
+        backgroundColor = mMap->backgroundColor();
+
+    if (exposed.isEmpty())
+        image.fill(backgroundColor);
 
     QPainter painter(&image);
     painter.setRenderHints(QPainter::SmoothPixmapTransform, renderFlags.testFlag(SmoothPixmapTransform));
 
-    // Center the map in the requested size
-    const QSize scaledMapSize = mapSize * scale;
-    const QPointF centerOffset((image.width() - scaledMapSize.width()) / 2,
-                               (image.height() - scaledMapSize.height()) / 2);
+    // Only the exposed part of the map needs to be drawn
+    QRectF exposedRect;
+
+    if (!exposed.isEmpty()) {
+        painter.setCompositionMode(QPainter::CompositionMode_Source);
+        for (const QRect &rect : exposed)
+            painter.fillRect(rect, backgroundColor);
+        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+        painter.setClipRegion(exposed);
 
-    painter.translate(centerOffset);
-    painter.scale(scale, scale);
-    painter.translate(-mapBoundingRect.topLeft());
+        exposedRect = transform.inverted().mapRect(QRectF(exposed.boundingRect()));
+    }
+
+    painter.setTransform(transform);
 
     mRenderer->setPainterScale(scale);
 
@@ -178,13 +232,16 @@ void MiniMapRenderer::renderToImage(QImage &image, RenderFlags renderFlags) cons
         painter.setOpacity(layerOpacity);
         painter.translate(offset);
 
+        const QRectF layerExposedRect = exposedRect.isNull() ? QRectF()
+                                                             : exposedRect.translated(-offset);
+
         switch (layer->layerType()) {
         case Layer::TileLayerType: {
             if (drawTileLayers) {
                 painter.setCompositionMode(compositionMode);
 
                 const TileLayer *tileLayer = static_cast<const TileLayer*>(layer);
-                mRenderer->drawTileLayer(&painter, tileLayer);
+                mRenderer->drawTileLayer(&painter, tileLayer, layerExposedRect);
             }
             break;
         }
@@ -228,7 +285,7 @@ void MiniMapRenderer::renderToImage(QImage &image, RenderFlags renderFlags) cons
                 painter.setCompositionMode(compositionMode);
 
                 const ImageLayer *imageLayer = static_cast<const ImageLayer*>(layer);
-                mRenderer->drawImageLayer(&painter, imageLayer);
+                mRenderer->drawImageLayer(&painter, imageLayer, layerExposedRect);
             }
             break;
         }
@@ -33,6 +33,8 @@
 #include "tiled_global.h"
 
 #include <QImage>
+#include <QRegion>
+#include <QTransform>
 
 #include <functional>
 #include <memory>
@@ -73,8 +75,14 @@ public:
     QImage render(QSize size, RenderFlags renderFlags) const;
 
     void renderToImage(QImage &image, RenderFlags renderFlags) const;
+    void renderToImage(QImage &image, RenderFlags renderFlags, const QRegion &exposed) const;
+
+    QTransform transform(QSize imageSize, RenderFlags renderFlags) const;
 
 private:
+    QRect renderedRect(RenderFlags renderFlags) const;
+    static QTransform transform(QSize imageSize, const QRect &renderedRect);
+
     const Map *mMap;
     std::unique_ptr<MapRenderer> mRenderer;
     QColor mGridColor = QColorConstants::Black;
@@ -68,8 +68,12 @@ void ObjectGroup::insertObject(int index, MapObject *object)
 {
     mObjects.insert(index, object);
     object->setObjectGroup(this);
-    if (mMap && object->id() == 0)
-        object->setId(mMap->takeNextObjectId());
+
+    if (mMap) {
+        if (object->id() == 0)
+            object->setId(mMap->takeNextObjectId());
+        mMap->registerObject(object);
+    }
 }
 
 int ObjectGroup::removeObject(MapObject *object)
@@ -85,9 +89,28 @@ int ObjectGroup::removeObject(MapObject *object)
 void ObjectGroup::removeObjectAt(int index)
 {
     MapObject *object = mObjects.takeAt(index);
+    if (mMap)
+        mMap->unregisterObject(object);
     object->setObjectGroup(nullptr);
 }
 
+void ObjectGroup::setMap(Map *map)
+{
+    if (mMap == map)
+        return;
+
+    // Keep the object id index of the maps up to date
+    if (mMap)
+        for (MapObject *object : std::as_const(mObjects))
+            mMap->unregisterObject(object);
+
+    Layer::setMap(map);
+
+    if (map)
+        for (MapObject *object : std::as_const(mObjects))
+            map->registerObject(object);
+}
+
 void ObjectGroup::moveObjects(int from, int to, int count)
 {
     // It's an error when 'to' lies within the moving range of objects
@@ -179,6 +179,7 @@ public:
     QList<MapObject*>::const_iterator end() const { return mObjects.end(); }
 
 protected:
+    void setMap(Map *map) override;
     ObjectGroup *initializeClone(ObjectGroup *clone) const;
 
 private:
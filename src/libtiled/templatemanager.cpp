@@ -29,6 +29,7 @@
 
 #include <QFile>
 #include <QFileInfo>
+#include <QThread>
 
 using namespace Tiled;
 
@@ -63,6 +64,7 @@ TemplateManager::~TemplateManager()
 
 ObjectTemplate *TemplateManager::loadObjectTemplate(const QString &fileName, QString *error)
 {
+    QMutexLocker locker(&mMutex);
     ObjectTemplate *objectTemplate = findObjectTemplate(fileName);
 
     if (!objectTemplate) {
@@ -74,7 +76,14 @@ ObjectTemplate *TemplateManager::loadObjectTemplate(const QString &fileName, QSt
             newTemplate = std::make_unique<ObjectTemplate>(fileName);
 
         // Watch the file, regardless of whether the parse was successful.
-        mWatcher->addPath(fileName);
+        // The watcher can only be used from its own thread.
+        if (QThread::currentThread() == thread()) {
+            mWatcher->addPath(fileName);
+        } else {
+            QMetaObject::invokeMethod(this, [this, fileName] {
+                mWatcher->addPath(fileName);
+            }, Qt::QueuedConnection);
+        }
 
         objectTemplate = newTemplate.get();
         mObjectTemplates.insert(fileName, newTemplate.release());
@@ -26,6 +26,7 @@
 
 #include <QHash>
 #include <QObject>
+#include <QRecursiveMutex>
 
 namespace Tiled {
 
@@ -61,6 +62,7 @@ private:
     void pathsChanged(const QStringList &paths);
 
     QHash<QString, ObjectTemplate*> mObjectTemplates;
+    QRecursiveMutex mMutex;     // allows loading maps on multiple threads
     FileSystemWatcher *mWatcher;
 
     static TemplateManager *mInstance;
@@ -68,6 +70,7 @@ private:
 
 inline ObjectTemplate *TemplateManager::findObjectTemplate(const QString &fileName)
 {
+    QMutexLocker locker(&mMutex);
     return mObjectTemplates.value(fileName);
 }
 
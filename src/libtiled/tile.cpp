@@ -30,6 +30,7 @@
 
 #include "objectgroup.h"
 #include "tileset.h"
+#include "tilesetmanager.h"
 
 #include <QBitmap>
 
@@ -58,6 +59,8 @@ Tile::Tile(const QPixmap &image, int id, Tileset *tileset):
 
 Tile::~Tile()
 {
+    if (isAnimated())
+        TilesetManager::instance()->removeAnimatedTile(this);
 }
 
 /**
@@ -189,7 +192,14 @@ void Tile::swapObjectGroup(std::unique_ptr<ObjectGroup> &objectGroup)
 void Tile::setFrames(const QVector<Frame> &frames)
 {
     resetAnimation();
+
+    const bool wasAnimated = isAnimated();
     mFrames = frames;
+
+    if (isAnimated() && !wasAnimated)
+        TilesetManager::instance()->addAnimatedTile(this);
+    else if (!isAnimated() && wasAnimated)
+        TilesetManager::instance()->removeAnimatedTile(this);
 }
 
 /**
@@ -255,5 +265,8 @@ Tile *Tile::clone(Tileset *tileset) const
     c->mCurrentFrameIndex = mCurrentFrameIndex;
     c->mUnusedTime = mUnusedTime;
 
+    if (c->isAnimated())
+        TilesetManager::instance()->addAnimatedTile(c);
+
     return c;
 }
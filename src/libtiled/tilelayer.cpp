@@ -32,9 +32,11 @@
 #include "containerhelpers.h"
 #include "hex.h"
 #include "tile.h"
+#include "tileregion.h"
 
 #include <algorithm>
 #include <memory>
+#include <utility>
 
 #include <QSet>
 
@@ -83,55 +85,378 @@ QRegion Chunk::region(std::function<bool (const Cell &)> condition) const
     return region;
 }
 
+/**
+ * Packs the given \a cell into 32 bits, adding its tileset to the tileset
+ * table when necessary. Returns false when the cell can't be packed.
+ */
+bool Chunk::pack(const Cell &cell, quint32 &packed)
+{
+    const auto flags = static_cast<quint32>(cell._flags) << FlagsShift;
+
+    if (!cell._tileset) {
+        if (cell._tileId != -1)
+            return false;
+
+        packed = flags;
+        return true;
+    }
+
+    if (cell._tileId < 0 || static_cast<quint32>(cell._tileId) > TileIdMask)
+        return false;
+
+    int index = mTilesets.indexOf(cell._tileset);
+    if (index == -1) {
+        if (mTilesets.size() == MaxTilesets) {
+            compactTilesets();
+            if (mTilesets.size() == MaxTilesets)
+                return false;
+        }
+
+        index = mTilesets.size();
+        mTilesets.append(cell._tileset);
+    }
+
+    packed = flags
+            | static_cast<quint32>(index + 1) << TilesetIndexShift
+            | static_cast<quint32>(cell._tileId);
+    return true;
+}
+
+/**
+ * Removes tilesets that are no longer referred to from the tileset table.
+ */
+void Chunk::compactTilesets()
+{
+    QVector<Tileset*> tilesets;
+
+    for (quint32 &packed : mPacked) {
+        const quint32 index = (packed & TilesetIndexMask) >> TilesetIndexShift;
+        if (!index)
+            continue;
+
+        Tileset *tileset = mTilesets.at(index - 1);
+        int newIndex = tilesets.indexOf(tileset);
+        if (newIndex == -1) {
+            newIndex = tilesets.size();
+            tilesets.append(tileset);
+        }
+
+        packed = (packed & ~TilesetIndexMask)
+                | static_cast<quint32>(newIndex + 1) << TilesetIndexShift;
+    }
+
+    mTilesets.swap(tilesets);
+}
+
+/**
+ * Switches this chunk to storing full Cell instances.
+ */
+void Chunk::expand()
+{
+    QVector<Cell> cells;
+    cells.reserve(mPacked.size());
+    for (const quint32 packed : std::as_const(mPacked))
+        cells.append(unpack(packed));
+
+    mCells.swap(cells);
+    mPacked = QVector<quint32>();
+    mTilesets = QVector<Tileset*>();
+}
+
 void Chunk::setCell(int x, int y, const Cell &cell)
 {
     int index = x + y * CHUNK_SIZE;
 
-    mGrid[index] = cell;
+    if (isCompact()) {
+        quint32 packed;
+        if (pack(cell, packed)) {
+            mPacked[index] = packed;
+            return;
+        }
+
+        expand();
+    }
+
+    mCells[index] = cell;
 }
 
 bool Chunk::isEmpty() const
 {
-    for (int y = 0; y < CHUNK_SIZE; ++y) {
-        for (int x = 0; x < CHUNK_SIZE; ++x) {
-            if (!cellAt(x, y).isEmpty())
-                return false;
-        }
+    if (isCompact()) {
+        return std::none_of(mPacked.begin(), mPacked.end(), [] (quint32 packed) {
+            return packed & TilesetIndexMask;
+        });
     }
 
+    for (const Cell &cell : mCells)
+        if (!cell.isEmpty())
+            return false;
+
     return true;
 }
 
 bool Chunk::hasCell(std::function<bool (const Cell &)> condition) const
 {
-    for (const Cell &cell : mGrid)
-        if (condition(cell))
-            return true;
+    for (int y = 0; y < CHUNK_SIZE; ++y)
+        for (int x = 0; x < CHUNK_SIZE; ++x)
+            if (condition(cellAt(x, y)))
+                return true;
 
     return false;
 }
 
 void Chunk::removeReferencesToTileset(Tileset *tileset)
 {
-    for (int i = 0, i_end = mGrid.size(); i < i_end; ++i) {
-        if (mGrid.at(i).tileset() == tileset)
-            mGrid.replace(i, Cell::empty);
+    if (isCompact()) {
+        for (int i = 0; i < mTilesets.size(); ++i) {
+            if (mTilesets.at(i) != tileset)
+                continue;
+
+            const quint32 index = static_cast<quint32>(i + 1) << TilesetIndexShift;
+            for (quint32 &packed : mPacked)
+                if ((packed & TilesetIndexMask) == index)
+                    packed = 0;
+
+            mTilesets[i] = nullptr;
+        }
+        return;
+    }
+
+    for (int i = 0, i_end = mCells.size(); i < i_end; ++i) {
+        if (mCells.at(i).tileset() == tileset)
+            mCells.replace(i, Cell::empty);
     }
 }
 
 void Chunk::replaceReferencesToTileset(Tileset *oldTileset, Tileset *newTileset)
 {
-    for (Cell &cell : mGrid) {
+    if (isCompact()) {
+        std::replace(mTilesets.begin(), mTilesets.end(), oldTileset, newTileset);
+        return;
+    }
+
+    for (Cell &cell : mCells) {
         if (cell.tileset() == oldTileset)
             cell.setTile(newTileset, cell.tileId());
     }
 }
 
+ChunkDirectory::ChunkDirectory(const ChunkDirectory &other)
+    : mChunks(other.mChunks)
+    , mPositions(other.mPositions)
+    , mDenseArea(other.mDenseArea)
+    , mDense(other.mDense)
+    , mSparse(other.mSparse)
+    , mSparseCount(other.mSparseCount)
+{
+}
+
+ChunkDirectory::ChunkDirectory(ChunkDirectory &&other) noexcept
+    : mChunks(std::move(other.mChunks))
+    , mPositions(std::move(other.mPositions))
+    , mDenseArea(other.mDenseArea)
+    , mDense(std::move(other.mDense))
+    , mSparse(std::move(other.mSparse))
+    , mSparseCount(other.mSparseCount)
+{
+    other.mDenseArea = QRect();
+    other.clear();
+}
+
+ChunkDirectory &ChunkDirectory::operator=(const ChunkDirectory &other)
+{
+    if (this != &other) {
+        mChunks = other.mChunks;
+        mPositions = other.mPositions;
+        mDenseArea = other.mDenseArea;
+        mDense = other.mDense;
+        mSparse = other.mSparse;
+        mSparseCount = other.mSparseCount;
+        mLastSparseIndex.store(-1, std::memory_order_relaxed);
+    }
+    return *this;
+}
+
+ChunkDirectory &ChunkDirectory::operator=(ChunkDirectory &&other) noexcept
+{
+    if (this != &other) {
+        mChunks = std::move(other.mChunks);
+        mPositions = std::move(other.mPositions);
+        mDenseArea = other.mDenseArea;
+        mDense = std::move(other.mDense);
+        mSparse = std::move(other.mSparse);
+        mSparseCount = other.mSparseCount;
+        mLastSparseIndex.store(-1, std::memory_order_relaxed);
+        other.mDenseArea = QRect();
+        other.clear();
+    }
+    return *this;
+}
+
+static inline size_t hashChunkCoordinates(QPoint chunkCoordinates)
+{
+    quint32 h = static_cast<quint32>(chunkCoordinates.x()) * 0x9E3779B1u;
+    h ^= static_cast<quint32>(chunkCoordinates.y()) * 0x85EBCA77u;
+    h ^= h >> 15;
+    return h;
+}
+
+int ChunkDirectory::sparseIndexOf(QPoint chunkCoordinates) const
+{
+    if (mSparseCount == 0)
+        return -1;
+
+    const int last = mLastSparseIndex.load(std::memory_order_relaxed);
+    if (last != -1 && mPositions[last] == chunkCoordinates)
+        return last;
+
+    const size_t mask = mSparse.size() - 1;
+    for (size_t i = hashChunkCoordinates(chunkCoordinates) & mask; ; i = (i + 1) & mask) {
+        const int index = mSparse[i];
+        if (index == -1)
+            return -1;
+        if (mPositions[index] == chunkCoordinates) {
+            mLastSparseIndex.store(index, std::memory_order_relaxed);
+            return index;
+        }
+    }
+}
+
+/**
+ * Returns the chunk at the given chunk coordinates, creating a new empty
+ * chunk when it doesn't exist yet.
+ */
+Chunk &ChunkDirectory::findOrInsert(QPoint chunkCoordinates)
+{
+    int index = indexOf(chunkCoordinates);
+    if (index != -1)
+        return mChunks[index];
+
+    index = size();
+    mChunks.emplace_back();
+    mPositions.push_back(chunkCoordinates);
+
+    if (mDenseArea.contains(chunkCoordinates)) {
+        const QPoint p = chunkCoordinates - mDenseArea.topLeft();
+        mDense[p.y() * mDenseArea.width() + p.x()] = index;
+    } else {
+        insertSparse(index);
+        growDenseArea();
+    }
+
+    return mChunks.back();
+}
+
+/**
+ * Sets the area, in chunk coordinates, for which chunks are indexed using a
+ * plain 2D array. Areas larger than MaxDenseSize are not allowed and result
+ * in all chunks being indexed by the sparse table.
+ */
+void ChunkDirectory::setDenseArea(QRect area)
+{
+    if (area.isEmpty() || qint64(area.width()) * area.height() > MaxDenseSize)
+        area = QRect();
+
+    if (area == mDenseArea)
+        return;
+
+    mDenseArea = area;
+    rebuildIndex();
+}
+
+void ChunkDirectory::clear()
+{
+    mChunks.clear();
+    mPositions.clear();
+    std::fill(mDense.begin(), mDense.end(), -1);
+    mSparse.clear();
+    mSparseCount = 0;
+    mLastSparseIndex.store(-1, std::memory_order_relaxed);
+}
+
+void ChunkDirectory::insertSparse(int index)
+{
+    // Keep the load factor of the table at most 1/2
+    if ((mSparseCount + 1) * 2 > static_cast<int>(mSparse.size())) {
+        std::vector<int> oldSparse(std::max<size_t>(16, mSparse.size() * 2), -1);
+        oldSparse.swap(mSparse);
+
+        mSparseCount = 0;
+        for (const int oldIndex : oldSparse)
+            if (oldIndex != -1)
+                insertSparse(oldIndex);
+    }
+
+    const size_t mask = mSparse.size() - 1;
+    size_t i = hashChunkCoordinates(mPositions[index]) & mask;
+    while (mSparse[i] != -1)
+        i = (i + 1) & mask;
+
+    mSparse[i] = index;
+    ++mSparseCount;
+}
+
+void ChunkDirectory::rebuildIndex()
+{
+    mDense.assign(static_cast<size_t>(mDenseArea.width()) * mDenseArea.height(), -1);
+    mSparse.clear();
+    mSparseCount = 0;
+    mLastSparseIndex.store(-1, std::memory_order_relaxed);
+
+    for (int index = 0; index < size(); ++index) {
+        const QPoint chunkCoordinates = mPositions[index];
+        if (mDenseArea.contains(chunkCoordinates)) {
+            const QPoint p = chunkCoordinates - mDenseArea.topLeft();
+            mDense[p.y() * mDenseArea.width() + p.x()] = index;
+        } else {
+            insertSparse(index);
+        }
+    }
+}
+
+/**
+ * Grows the dense area to include all chunks, when many chunks are found
+ * outside of it and the resulting area would be reasonably well filled.
+ *
+ * The dense area starts out empty, so layers without chunks or with only a
+ * few of them don't allocate an index for their entire size.
+ */
+void ChunkDirectory::growDenseArea()
+{
+    // Only check when the number of sparse chunks reaches a power of two,
+    // and is large enough compared to the total to make rebuilding the
+    // index worth it.
+    if (mSparseCount < 4 || (mSparseCount & (mSparseCount - 1)) != 0)
+        return;
+    if (mSparseCount * 8 < size())
+        return;
+
+    int left = mDenseArea.isEmpty() ? mPositions.front().x() : mDenseArea.left();
+    int top = mDenseArea.isEmpty() ? mPositions.front().y() : mDenseArea.top();
+    int right = mDenseArea.isEmpty() ? left : mDenseArea.right();
+    int bottom = mDenseArea.isEmpty() ? top : mDenseArea.bottom();
+
+    for (const QPoint &p : mPositions) {
+        left = std::min(left, p.x());
+        top = std::min(top, p.y());
+        right = std::max(right, p.x());
+        bottom = std::max(bottom, p.y());
+    }
+
+    const qint64 area = (qint64(right) - left + 1) * (qint64(bottom) - top + 1);
+    if (area > MaxDenseSize || area > qint64(size()) * 4)
+        return;
+
+    mDenseArea = QRect(QPoint(left, top), QPoint(right, bottom));
+    rebuildIndex();
+}
+
 TileLayer::TileLayer(const QString &name, int x, int y, int width, int height)
     : Layer(TileLayerType, name, x, y)
     , mWidth(width)
     , mHeight(height)
 {
+    setSize(QSize(width, height));
 }
 
 TileLayer::TileLayer(const QString &name, QPoint position, QSize size)
@@ -181,9 +506,7 @@ QRegion TileLayer::region(std::function<bool (const Cell &)> condition) const
 {
     QRegion region;
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         region += it.value().region(condition).translated(it.key().x() * CHUNK_SIZE + mX,
                                                           it.key().y() * CHUNK_SIZE + mY);
     }
@@ -276,6 +599,97 @@ void TileLayer::setCells(int x, int y, const TileLayer *layer,
                 setCell(_x, _y, layer->cellAt(_x - x, _y - y));
 }
 
+/**
+ * Like the QRegion overload, but each row of the \a area is set in one go.
+ */
+void TileLayer::setCells(int x, int y, const TileLayer *layer,
+                         const TileRegion &area)
+{
+    QVector<Cell> cells;
+
+    area.forEachRun([&] (const QRect &run) {
+        cells.resize(run.width());
+        for (int i = 0; i < run.width(); ++i)
+            cells[i] = layer->cellAt(run.left() + i - x, run.y() - y);
+        setCells(run, cells.constData());
+    });
+}
+
+/**
+ * Equivalent to calling setCell() for each cell in \a area, but each
+ * affected chunk is only looked up once and the used tilesets are updated
+ * in one go.
+ */
+void TileLayer::setCells(QRect area, const Cell *cells)
+{
+    if (area.isEmpty())
+        return;
+
+    QHash<Tileset*, int> tilesetUseDeltas;
+
+    const int stride = area.width();
+
+    for (int chunkY = area.top() >> CHUNK_BITS; chunkY <= area.bottom() >> CHUNK_BITS; ++chunkY) {
+        for (int chunkX = area.left() >> CHUNK_BITS; chunkX <= area.right() >> CHUNK_BITS; ++chunkX) {
+            const QRect chunkRect(chunkX * CHUNK_SIZE, chunkY * CHUNK_SIZE,
+                                  CHUNK_SIZE, CHUNK_SIZE);
+            const QRect rect = chunkRect & area;
+            const QPoint chunkCoordinates(chunkX, chunkY);
+
+            if (!mChunks.find(chunkCoordinates)) {
+                // Like setCell, avoid creating chunks for empty cells
+                bool hasContent = false;
+                for (int y = rect.top(); y <= rect.bottom() && !hasContent; ++y) {
+                    const Cell *row = cells + (y - area.top()) * stride;
+                    for (int x = rect.left(); x <= rect.right(); ++x) {
+                        const Cell &cell = row[x - area.left()];
+                        if (!cell.isEmpty() || cell.checked()) {
+                            hasContent = true;
+                            break;
+                        }
+                    }
+                }
+
+                if (!hasContent)
+                    continue;
+
+                mBounds = mBounds.united(chunkRect);
+            }
+
+            Chunk &chunk = mChunks.findOrInsert(chunkCoordinates);
+
+            for (int y = rect.top(); y <= rect.bottom(); ++y) {
+                const Cell *row = cells + (y - area.top()) * stride;
+                for (int x = rect.left(); x <= rect.right(); ++x) {
+                    const Cell &cell = row[x - area.left()];
+                    Tileset *oldTileset = chunk.cellAt(x & CHUNK_MASK, y & CHUNK_MASK).tileset();
+                    Tileset *newTileset = cell.tileset();
+
+                    if (oldTileset != newTileset) {
+                        if (newTileset)
+                            ++tilesetUseDeltas[newTileset];
+                        if (oldTileset)
+                            --tilesetUseDeltas[oldTileset];
+                    }
+
+                    chunk.setCell(x & CHUNK_MASK, y & CHUNK_MASK, cell);
+                }
+            }
+        }
+    }
+
+    for (auto it = tilesetUseDeltas.cbegin(); it != tilesetUseDeltas.cend(); ++it) {
+        if (it.value() == 0)
+            continue;
+
+        auto &count = mUsedTilesets[it.key()->sharedFromThis()];
+        count += it.value();
+        Q_ASSERT(count >= 0);
+        if (count <= 0)
+            mUsedTilesets.remove(it.key()->sharedFromThis());
+    }
+}
+
 /**
  * Sets the tiles in the given \a area to \a tile. Flipping flags are
  * preserved.
@@ -321,9 +735,7 @@ void TileLayer::flip(FlipDirection direction)
 
     Q_ASSERT(direction == FlipHorizontally || direction == FlipVertically);
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         for (int y = 0; y < CHUNK_SIZE; ++y) {
             for (int x = 0; x < CHUNK_SIZE; ++x) {
                 int _x = it.key().x() * CHUNK_SIZE + x;
@@ -345,7 +757,7 @@ void TileLayer::flip(FlipDirection direction)
         }
     }
 
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 }
@@ -362,9 +774,7 @@ void TileLayer::flipHexagonal(FlipDirection direction)
 
     const unsigned char (&flipMask)[16] = (direction == FlipHorizontally ? flipMaskH : flipMaskV);
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         for (int y = 0; y < CHUNK_SIZE; ++y) {
             for (int x = 0; x < CHUNK_SIZE; ++x) {
                 int _x = it.key().x() * CHUNK_SIZE + x;
@@ -396,7 +806,7 @@ void TileLayer::flipHexagonal(FlipDirection direction)
         }
     }
 
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 }
@@ -413,9 +823,7 @@ void TileLayer::rotate(RotateDirection direction)
     int newHeight = mWidth;
     const auto newLayer = std::make_unique<TileLayer>(QString(), 0, 0, newWidth, newHeight);
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         for (int y = 0; y < CHUNK_SIZE; ++y) {
             for (int x = 0; x < CHUNK_SIZE; ++x) {
                 int _x = it.key().x() * CHUNK_SIZE + x;
@@ -447,7 +855,7 @@ void TileLayer::rotate(RotateDirection direction)
 
     mWidth = newWidth;
     mHeight = newHeight;
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 }
@@ -497,9 +905,7 @@ void TileLayer::rotateHexagonal(RotateDirection direction, Map *map)
     const unsigned char (&rotateMask)[16] =
             (direction == RotateRight) ? rotateRightMask : rotateLeftMask;
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         for (int y = 0; y < CHUNK_SIZE; ++y) {
             for (int x = 0; x < CHUNK_SIZE; ++x) {
                 int _x = it.key().x() * CHUNK_SIZE + x;
@@ -537,7 +943,7 @@ void TileLayer::rotateHexagonal(RotateDirection direction, Map *map)
 
     mWidth = newWidth;
     mHeight = newHeight;
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 
@@ -623,7 +1029,7 @@ void TileLayer::resize(QSize size, QPoint offset)
         for (int x = area.left(); x <= area.right(); ++x)
             newLayer->setCell(x, y, cellAt(x - offset.x(), y - offset.y()));
 
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
     setSize(size);
@@ -667,20 +1073,17 @@ void TileLayer::offsetTiles(QPoint offset,
         }
     }
 
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 }
 
 void TileLayer::offsetTiles(QPoint offset)
 {
-    const auto newLayer = std::make_unique<TileLayer>(QString(), 0, 0, 0, 0);
+    const auto newLayer = std::make_unique<TileLayer>(QString(), 0, 0, mWidth, mHeight);
 
     // Process only the allocated chunks
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
-
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         const QPoint p = it.key();
         const Chunk &chunk = it.value();
         const QRect r(p.x() * CHUNK_SIZE,
@@ -696,7 +1099,7 @@ void TileLayer::offsetTiles(QPoint offset)
         }
     }
 
-    mChunks = newLayer->mChunks;
+    mChunks = std::move(newLayer->mChunks);
     mBounds = newLayer->mBounds;
     mUsedTilesets = newLayer->mUsedTilesets;
 }
@@ -788,9 +1191,7 @@ QVector<QRect> TileLayer::sortedChunksToWrite(QSize chunkSize) const
     if (isNativeChunkSize)
         chunksToWrite.reserve(mChunks.size());
 
-    QHashIterator<QPoint, Chunk> it(mChunks);
-    while (it.hasNext()) {
-        it.next();
+    for (auto it = mChunks.cbegin(); it != mChunks.cend(); ++it) {
         const Chunk &chunk = it.value();
         if (chunk.isEmpty())
             continue;
@@ -43,11 +43,14 @@
 #include <QString>
 #include <QVector>
 
+#include <atomic>
 #include <functional>
+#include <vector>
 
 namespace Tiled {
 
 class Tile;
+class TileRegion;
 
 /**
  * A cell on a tile layer grid.
@@ -129,6 +132,8 @@ public:
     static Cell empty;
 
 private:
+    friend class Chunk;
+
     Tileset *_tileset = nullptr;
     int _tileId = -1;
     int _flags = 0;
@@ -161,22 +166,28 @@ inline bool Cell::refersTile(const Tile *tile) const
 
 /**
  * A Chunk is a grid of cells of size CHUNK_SIZExCHUNK_SIZE.
+ *
+ * To save memory, cells are stored packed into 32 bits each, referring to
+ * their tileset through a small table of tilesets used by this chunk. When
+ * a cell doesn't fit this compact representation (for example due to a very
+ * large tile ID), the chunk switches to storing full Cell instances.
  */
 class TILEDSHARED_EXPORT Chunk
 {
 public:
     Chunk() :
-        mGrid(CHUNK_SIZE * CHUNK_SIZE)
+        mPacked(CHUNK_SIZE * CHUNK_SIZE)
     {}
 
     QRegion region(std::function<bool (const Cell &)> condition) const;
 
-    const Cell &cellAt(int x, int y) const;
-    const Cell &cellAt(QPoint point) const;
+    Cell cellAt(int x, int y) const;
+    Cell cellAt(QPoint point) const;
 
     void setCell(int x, int y, const Cell &cell);
 
     bool isEmpty() const;
+    bool isCompact() const;
 
     bool hasCell(std::function<bool (const Cell &)> condition) const;
 
@@ -184,101 +195,200 @@ public:
 
     void replaceReferencesToTileset(Tileset *oldTileset, Tileset *newTileset);
 
-    QVector<Cell>::iterator begin() { return mGrid.begin(); }
-    QVector<Cell>::iterator end() { return mGrid.end(); }
-    QVector<Cell>::const_iterator begin() const { return mGrid.begin(); }
-    QVector<Cell>::const_iterator end() const { return mGrid.end(); }
-
 private:
-    QVector<Cell> mGrid;
+    // Layout of a packed cell
+    static constexpr quint32 TileIdBits = 18;
+    static constexpr quint32 TilesetIndexBits = 9;
+    static constexpr quint32 TilesetIndexShift = TileIdBits;
+    static constexpr quint32 FlagsShift = TileIdBits + TilesetIndexBits;
+    static constexpr quint32 TileIdMask = (1u << TileIdBits) - 1;
+    static constexpr quint32 TilesetIndexMask = ((1u << TilesetIndexBits) - 1) << TilesetIndexShift;
+    static constexpr int MaxTilesets = (1 << TilesetIndexBits) - 1;
+
+    Cell unpack(quint32 packed) const;
+    bool pack(const Cell &cell, quint32 &packed);
+    void compactTilesets();
+    void expand();
+
+    QVector<quint32> mPacked;       // Cells in compact form (when not expanded)
+    QVector<Tileset*> mTilesets;    // Tilesets referred to by packed cells
+    QVector<Cell> mCells;           // Cells in expanded form
 };
 
-inline const Cell &Chunk::cellAt(int x, int y) const
+inline Cell Chunk::unpack(quint32 packed) const
 {
-    return mGrid.at(x + y * CHUNK_SIZE);
+    Cell cell;
+
+    // Index 0 is used for cells without tileset
+    if (const quint32 index = (packed & TilesetIndexMask) >> TilesetIndexShift) {
+        cell._tileset = mTilesets.at(index - 1);
+        cell._tileId = static_cast<int>(packed & TileIdMask);
+    }
+
+    cell._flags = static_cast<int>(packed >> FlagsShift);
+    return cell;
 }
 
-inline const Cell &Chunk::cellAt(QPoint point) const
+inline Cell Chunk::cellAt(int x, int y) const
+{
+    const int index = x + y * CHUNK_SIZE;
+
+    if (!mCells.isEmpty())
+        return mCells.at(index);
+
+    return unpack(mPacked.at(index));
+}
+
+inline Cell Chunk::cellAt(QPoint point) const
 {
     return cellAt(point.x(), point.y());
 }
 
 /**
- * A tile layer is a grid of cells. Each cell refers to a specific tile, and
- * stores how the tile is flipped.
+ * Returns whether this chunk stores its cells in the compact form.
+ */
+inline bool Chunk::isCompact() const
+{
+    return mCells.isEmpty();
+}
+
+/**
+ * The chunks of a tile layer, indexed by their chunk coordinates.
  *
- * Coordinates and regions passed to function parameters are in local
- * coordinates and do not take into account the position of the layer.
+ * Chunks within a dense area (usually the bounds of the layer) are found
+ * through a 2D array of chunk indexes. Any other chunks are found through an
+ * open-addressed hash table, which also remembers the last chunk found. When
+ * enough chunks end up outside of the dense area, it is grown to include
+ * them if that doesn't waste too much memory.
+ *
+ * Chunks are never removed individually and are kept in insertion order.
  */
-class TILEDSHARED_EXPORT TileLayer : public Layer
+class TILEDSHARED_EXPORT ChunkDirectory
 {
 public:
     class iterator
     {
     public:
-        iterator(QHash<QPoint, Chunk>::iterator it, QHash<QPoint, Chunk>::iterator end)
-            : mChunkPointer(it)
-            , mChunkEndPointer(end)
-        {
-            if (it != end)
-                mCellPointer = it.value().begin();
-        }
+        iterator(ChunkDirectory *directory, int index)
+            : mDirectory(directory), mIndex(index) {}
 
-        iterator operator++(int)
-        {
-            iterator it = *this;
-            advance();
-            return it;
-        }
+        iterator &operator++() { ++mIndex; return *this; }
 
-        iterator &operator++()
-        {
-            advance();
-            return *this;
-        }
+        Chunk &operator*() const { return value(); }
 
-        Cell &operator*() { return *mCellPointer; }
+        QPoint key() const { return mDirectory->mPositions[mIndex]; }
+        Chunk &value() const { return mDirectory->mChunks[mIndex]; }
 
-        QVector<Cell>::iterator operator->() const { return mCellPointer; }
+        bool operator==(const iterator &other) const { return mIndex == other.mIndex; }
+        bool operator!=(const iterator &other) const { return mIndex != other.mIndex; }
 
-        friend bool operator==(const iterator& lhs, const iterator& rhs)
-        {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer == rhs.mChunkPointer;
+    private:
+        ChunkDirectory *mDirectory;
+        int mIndex;
+    };
 
-            return lhs.mCellPointer == rhs.mCellPointer;
-        }
+    class const_iterator
+    {
+    public:
+        const_iterator(const ChunkDirectory *directory, int index)
+            : mDirectory(directory), mIndex(index) {}
 
-        friend bool operator!=(const iterator& lhs, const iterator& rhs)
-        {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer != rhs.mChunkPointer;
+        const_iterator &operator++() { ++mIndex; return *this; }
 
-            return lhs.mCellPointer != rhs.mCellPointer;
-        }
+        const Chunk &operator*() const { return value(); }
 
-        Cell &value() const { return *mCellPointer; }
+        QPoint key() const { return mDirectory->mPositions[mIndex]; }
+        const Chunk &value() const { return mDirectory->mChunks[mIndex]; }
 
-        QPoint key() const;
+        bool operator==(const const_iterator &other) const { return mIndex == other.mIndex; }
+        bool operator!=(const const_iterator &other) const { return mIndex != other.mIndex; }
 
     private:
-        void advance();
-
-        QHash<QPoint, Chunk>::iterator mChunkPointer;
-        QHash<QPoint, Chunk>::iterator mChunkEndPointer;
-        QVector<Cell>::iterator mCellPointer;
+        const ChunkDirectory *mDirectory;
+        int mIndex;
     };
 
+    ChunkDirectory() = default;
+    ChunkDirectory(const ChunkDirectory &other);
+    ChunkDirectory(ChunkDirectory &&other) noexcept;
+
+    ChunkDirectory &operator=(const ChunkDirectory &other);
+    ChunkDirectory &operator=(ChunkDirectory &&other) noexcept;
+
+    int size() const { return static_cast<int>(mChunks.size()); }
+    bool isEmpty() const { return mChunks.empty(); }
+
+    const Chunk *find(QPoint chunkCoordinates) const;
+    Chunk &findOrInsert(QPoint chunkCoordinates);
+
+    void setDenseArea(QRect area);
+    QRect denseArea() const { return mDenseArea; }
+
+    void clear();
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, size()); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+    const_iterator cbegin() const { return begin(); }
+    const_iterator cend() const { return end(); }
+
+private:
+    int indexOf(QPoint chunkCoordinates) const;
+    int sparseIndexOf(QPoint chunkCoordinates) const;
+    void insertSparse(int index);
+    void rebuildIndex();
+    void growDenseArea();
+
+    static constexpr int MaxDenseSize = 1 << 20;
+
+    std::vector<Chunk> mChunks;
+    std::vector<QPoint> mPositions;
+
+    QRect mDenseArea;
+    std::vector<int> mDense;            // chunk index or -1, row by row
+    std::vector<int> mSparse;           // chunk index or -1, size is a power of two
+    int mSparseCount = 0;
+
+    // Last chunk found in the sparse table. Atomic since lookups may happen
+    // from multiple threads.
+    mutable std::atomic<int> mLastSparseIndex { -1 };
+};
+
+inline int ChunkDirectory::indexOf(QPoint chunkCoordinates) const
+{
+    const unsigned dx = static_cast<unsigned>(chunkCoordinates.x() - mDenseArea.x());
+    const unsigned dy = static_cast<unsigned>(chunkCoordinates.y() - mDenseArea.y());
+
+    if (dx < static_cast<unsigned>(mDenseArea.width()) && dy < static_cast<unsigned>(mDenseArea.height()))
+        return mDense[dy * mDenseArea.width() + dx];
+
+    return sparseIndexOf(chunkCoordinates);
+}
+
+inline const Chunk *ChunkDirectory::find(QPoint chunkCoordinates) const
+{
+    const int index = indexOf(chunkCoordinates);
+    return index != -1 ? &mChunks[index] : nullptr;
+}
+
+/**
+ * A tile layer is a grid of cells. Each cell refers to a specific tile, and
+ * stores how the tile is flipped.
+ *
+ * Coordinates and regions passed to function parameters are in local
+ * coordinates and do not take into account the position of the layer.
+ */
+class TILEDSHARED_EXPORT TileLayer : public Layer
+{
+public:
     class const_iterator
     {
     public:
-        const_iterator(QHash<QPoint, Chunk>::const_iterator it, QHash<QPoint, Chunk>::const_iterator end)
+        const_iterator(ChunkDirectory::const_iterator it, ChunkDirectory::const_iterator end)
             : mChunkPointer(it)
             , mChunkEndPointer(end)
-        {
-            if (it != end)
-                mCellPointer = it.value().begin();
-        }
+        {}
 
         const_iterator operator++(int)
         {
@@ -293,38 +403,38 @@ public:
             return *this;
         }
 
-        const Cell &operator*() { return *mCellPointer; }
-
-        QVector<Cell>::const_iterator operator->() const { return mCellPointer; }
+        Cell operator*() const { return value(); }
 
         friend bool operator==(const const_iterator& lhs, const const_iterator& rhs)
         {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer == rhs.mChunkPointer;
-
-            return lhs.mCellPointer == rhs.mCellPointer;
+            return lhs.mChunkPointer == rhs.mChunkPointer
+                    && lhs.mCellIndex == rhs.mCellIndex;
         }
 
         friend bool operator!=(const const_iterator& lhs, const const_iterator& rhs)
         {
-            if (lhs.mChunkPointer == lhs.mChunkEndPointer || rhs.mChunkPointer == rhs.mChunkEndPointer)
-                return lhs.mChunkPointer != rhs.mChunkPointer;
-
-            return lhs.mCellPointer != rhs.mCellPointer;
+            return !(lhs == rhs);
         }
 
-        const Cell &value() const { return *mCellPointer; }
+        Cell value() const
+        {
+            return mChunkPointer.value().cellAt(mCellIndex & CHUNK_MASK,
+                                                mCellIndex >> CHUNK_BITS);
+        }
 
         QPoint key() const;
 
     private:
         void advance();
 
-        QHash<QPoint, Chunk>::const_iterator mChunkPointer;
-        QHash<QPoint, Chunk>::const_iterator mChunkEndPointer;
-        QVector<Cell>::const_iterator mCellPointer;
+        ChunkDirectory::const_iterator mChunkPointer;
+        ChunkDirectory::const_iterator mChunkEndPointer;
+        int mCellIndex = 0;
     };
 
+    // Cells are not stored as such, so they can only be iterated as values
+    using iterator = const_iterator;
+
     /**
      * Constructor.
      */
@@ -376,8 +486,8 @@ public:
     QRegion region() const;
     QRegion modifiedRegion() const;
 
-    const Cell &cellAt(int x, int y) const;
-    const Cell &cellAt(QPoint point) const;
+    Cell cellAt(int x, int y) const;
+    Cell cellAt(QPoint point) const;
 
     void setCell(int x, int y, const Cell &cell);
 
@@ -409,6 +519,7 @@ public:
      * \a tileLayer. The tiles in \a tileLayer are offset by \a x and \a y.
      */
     void setCells(int x, int y, const TileLayer *tileLayer, const QRegion &area);
+    void setCells(int x, int y, const TileLayer *tileLayer, const TileRegion &area);
 
     /**
      * Sets the cells starting at the given position to the cells in the given
@@ -416,6 +527,12 @@ public:
      */
     void setCells(int x, int y, const TileLayer *tileLayer);
 
+    /**
+     * Sets the cells within the given \a area to the given \a cells, which
+     * are stored row by row.
+     */
+    void setCells(QRect area, const Cell *cells);
+
     void setTiles(const QRegion &area, Tile *tile);
 
     /**
@@ -515,8 +632,6 @@ public:
 
     TileLayer *clone() const override;
 
-    iterator begin() { return iterator(mChunks.begin(), mChunks.end()); }
-    iterator end() { return iterator(mChunks.end(), mChunks.end()); }
     const_iterator begin() const { return const_iterator(mChunks.begin(), mChunks.end()); }
     const_iterator end() const { return const_iterator(mChunks.end(), mChunks.end()); }
 
@@ -528,53 +643,24 @@ protected:
 private:
     int mWidth;
     int mHeight;
-    QHash<QPoint, Chunk> mChunks;
+    ChunkDirectory mChunks;
     QRect mBounds;
     QHash<SharedTileset, int> mUsedTilesets;
 };
 
-inline QPoint TileLayer::iterator::key() const
-{
-    const QPoint chunkPos = mChunkPointer.key();
-    QPoint tilePos = QPoint(chunkPos.x() * CHUNK_SIZE,
-                            chunkPos.y() * CHUNK_SIZE);
-
-    const auto index = std::distance(mChunkPointer.value().begin(), mCellPointer);
-    tilePos += QPoint(index & CHUNK_MASK, index / CHUNK_SIZE);
-
-    return tilePos;
-}
-
-inline void TileLayer::iterator::advance()
-{
-    if (mChunkPointer != mChunkEndPointer) {
-        if (++mCellPointer == mChunkPointer.value().end()) {
-            mChunkPointer++;
-            if (mChunkPointer != mChunkEndPointer)
-                mCellPointer = mChunkPointer.value().begin();
-        }
-    }
-}
-
 inline QPoint TileLayer::const_iterator::key() const
 {
     const QPoint chunkPos = mChunkPointer.key();
-    QPoint tilePos = QPoint(chunkPos.x() * CHUNK_SIZE,
-                            chunkPos.y() * CHUNK_SIZE);
-
-    const auto index = std::distance(mChunkPointer.value().begin(), mCellPointer);
-    tilePos += QPoint(index & CHUNK_MASK, index / CHUNK_SIZE);
-
-    return tilePos;
+    return QPoint(chunkPos.x() * CHUNK_SIZE + (mCellIndex & CHUNK_MASK),
+                  chunkPos.y() * CHUNK_SIZE + (mCellIndex >> CHUNK_BITS));
 }
 
 inline void TileLayer::const_iterator::advance()
 {
     if (mChunkPointer != mChunkEndPointer) {
-        if (++mCellPointer == mChunkPointer.value().end()) {
-            mChunkPointer++;
-            if (mChunkPointer != mChunkEndPointer)
-                mCellPointer = mChunkPointer.value().begin();
+        if (++mCellIndex == CHUNK_SIZE * CHUNK_SIZE) {
+            mCellIndex = 0;
+            ++mChunkPointer;
         }
     }
 }
@@ -601,14 +687,13 @@ inline bool TileLayer::contains(QPoint point) const
 inline Chunk& TileLayer::chunk(int x, int y)
 {
     const QPoint chunkCoordinates(x >> CHUNK_BITS, y >> CHUNK_BITS);
-    return mChunks[chunkCoordinates];
+    return mChunks.findOrInsert(chunkCoordinates);
 }
 
 inline const Chunk* TileLayer::findChunk(int x, int y) const
 {
     const QPoint chunkCoordinates(x >> CHUNK_BITS, y >> CHUNK_BITS);
-    auto it = mChunks.find(chunkCoordinates);
-    return it != mChunks.end() ? &it.value() : nullptr;
+    return mChunks.find(chunkCoordinates);
 }
 
 /**
@@ -632,10 +717,10 @@ inline QRegion TileLayer::modifiedRegion() const
 }
 
 /**
- * Returns a read-only reference to the cell at the given coordinates. The
- * coordinates have to be within this layer.
+ * Returns the cell at the given coordinates. The coordinates have to be
+ * within this layer.
  */
-inline const Cell &TileLayer::cellAt(int x, int y) const
+inline Cell TileLayer::cellAt(int x, int y) const
 {
     if (const Chunk *chunk = findChunk(x, y))
         return chunk->cellAt(x & CHUNK_MASK, y & CHUNK_MASK);
@@ -643,7 +728,7 @@ inline const Cell &TileLayer::cellAt(int x, int y) const
     return Cell::empty;
 }
 
-inline const Cell &TileLayer::cellAt(QPoint point) const
+inline Cell TileLayer::cellAt(QPoint point) const
 {
     return cellAt(point.x(), point.y());
 }
@@ -0,0 +1,518 @@
+/*
+ * tileregion.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "tileregion.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <climits>
+
+namespace Tiled {
+
+/**
+ * Calls \a callback for each chunk overlapping the given \a rect, with the
+ * chunk coordinates, the range of rows and the mask of columns covered by
+ * the rect within that chunk.
+ */
+template <typename Callback>
+static void forEachChunkIn(const QRect &rect, Callback callback)
+{
+    const int firstChunkX = rect.left() >> TileRegion::CHUNK_BITS;
+    const int lastChunkX = rect.right() >> TileRegion::CHUNK_BITS;
+    const int firstChunkY = rect.top() >> TileRegion::CHUNK_BITS;
+    const int lastChunkY = rect.bottom() >> TileRegion::CHUNK_BITS;
+
+    for (int chunkY = firstChunkY; chunkY <= lastChunkY; ++chunkY) {
+        const int firstRow = chunkY == firstChunkY ? rect.top() & TileRegion::CHUNK_MASK : 0;
+        const int lastRow = chunkY == lastChunkY ? rect.bottom() & TileRegion::CHUNK_MASK
+                                                 : TileRegion::CHUNK_MASK;
+
+        for (int chunkX = firstChunkX; chunkX <= lastChunkX; ++chunkX) {
+            const int firstColumn = chunkX == firstChunkX ? rect.left() & TileRegion::CHUNK_MASK : 0;
+            const int lastColumn = chunkX == lastChunkX ? rect.right() & TileRegion::CHUNK_MASK
+                                                        : TileRegion::CHUNK_MASK;
+
+            callback(QPoint(chunkX, chunkY), firstRow, lastRow,
+                     TileRegion::rowMask(firstColumn, lastColumn));
+        }
+    }
+}
+
+TileRegion::TileRegion(const QRect &rect)
+{
+    add(rect);
+}
+
+TileRegion::TileRegion(const QRegion &region)
+{
+    add(region);
+}
+
+bool TileRegion::contains(int x, int y) const
+{
+    const auto it = mChunks.constFind(QPoint(x >> CHUNK_BITS, y >> CHUNK_BITS));
+    if (it == mChunks.constEnd())
+        return false;
+    return (*it)[y & CHUNK_MASK] & (quint64(1) << (x & CHUNK_MASK));
+}
+
+bool TileRegion::intersects(const QRect &rect) const
+{
+    if (rect.isEmpty() || isEmpty())
+        return false;
+
+    bool result = false;
+
+    forEachChunkIn(rect, [&] (QPoint key, int firstRow, int lastRow, quint64 mask) {
+        if (result)
+            return;
+
+        const auto it = mChunks.constFind(key);
+        if (it == mChunks.constEnd())
+            return;
+
+        for (int row = firstRow; row <= lastRow; ++row) {
+            if ((*it)[row] & mask) {
+                result = true;
+                return;
+            }
+        }
+    });
+
+    return result;
+}
+
+bool TileRegion::intersects(const TileRegion &other) const
+{
+    // Look up the chunks of the smaller region in the larger one
+    const TileRegion &smaller = mChunks.size() <= other.mChunks.size() ? *this : other;
+    const TileRegion &larger = &smaller == this ? other : *this;
+
+    for (auto it = smaller.mChunks.cbegin(), end = smaller.mChunks.cend(); it != end; ++it) {
+        const auto otherIt = larger.mChunks.constFind(it.key());
+        if (otherIt == larger.mChunks.constEnd())
+            continue;
+
+        for (int row = 0; row < CHUNK_SIZE; ++row)
+            if ((*it)[row] & (*otherIt)[row])
+                return true;
+    }
+
+    return false;
+}
+
+QRect TileRegion::boundingRect() const
+{
+    int left = INT_MAX;
+    int top = INT_MAX;
+    int right = INT_MIN;
+    int bottom = INT_MIN;
+
+    for (auto it = mChunks.cbegin(), end = mChunks.cend(); it != end; ++it) {
+        const int chunkLeft = it.key().x() << CHUNK_BITS;
+        const int chunkTop = it.key().y() << CHUNK_BITS;
+        quint64 columns = 0;
+
+        for (int row = 0; row < CHUNK_SIZE; ++row) {
+            const quint64 bits = (*it)[row];
+            if (!bits)
+                continue;
+
+            columns |= bits;
+            top = qMin(top, chunkTop + row);
+            bottom = qMax(bottom, chunkTop + row);
+        }
+
+        left = qMin(left, chunkLeft + int(qCountTrailingZeroBits(columns)));
+        right = qMax(right, chunkLeft + CHUNK_MASK - int(qCountLeadingZeroBits(columns)));
+    }
+
+    if (left > right)
+        return QRect();
+
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
+
+qint64 TileRegion::tileCount() const
+{
+    qint64 count = 0;
+
+    for (const Chunk &chunk : mChunks)
+        for (const quint64 bits : chunk)
+            count += qPopulationCount(bits);
+
+    return count;
+}
+
+void TileRegion::add(const QRect &rect)
+{
+    if (rect.isEmpty())
+        return;
+
+    forEachChunkIn(rect, [this] (QPoint key, int firstRow, int lastRow, quint64 mask) {
+        Chunk &chunk = mChunks[key];
+        for (int row = firstRow; row <= lastRow; ++row)
+            chunk[row] |= mask;
+    });
+}
+
+void TileRegion::add(const QRegion &region)
+{
+    for (const QRect &rect : region)
+        add(rect);
+}
+
+void TileRegion::remove(const QRect &rect)
+{
+    if (rect.isEmpty() || isEmpty())
+        return;
+
+    forEachChunkIn(rect, [this] (QPoint key, int firstRow, int lastRow, quint64 mask) {
+        const auto it = mChunks.find(key);
+        if (it == mChunks.end())
+            return;
+
+        for (int row = firstRow; row <= lastRow; ++row)
+            (*it)[row] &= ~mask;
+
+        if (isChunkEmpty(*it))
+            mChunks.erase(it);
+    });
+}
+
+/**
+ * Removes all tiles outside of the given \a rect. Chunks outside of the rect
+ * are dropped without looking at them, so this is cheap compared to
+ * intersecting with a TileRegion covering the rect.
+ */
+void TileRegion::intersect(const QRect &rect)
+{
+    if (rect.isEmpty()) {
+        clear();
+        return;
+    }
+
+    const int firstChunkX = rect.left() >> CHUNK_BITS;
+    const int lastChunkX = rect.right() >> CHUNK_BITS;
+    const int firstChunkY = rect.top() >> CHUNK_BITS;
+    const int lastChunkY = rect.bottom() >> CHUNK_BITS;
+
+    for (auto it = mChunks.begin(); it != mChunks.end(); ) {
+        const QPoint key = it.key();
+
+        if (key.x() < firstChunkX || key.x() > lastChunkX ||
+                key.y() < firstChunkY || key.y() > lastChunkY) {
+            it = mChunks.erase(it);
+            continue;
+        }
+
+        // Only the chunks at the border of the rect need to be masked
+        const int firstRow = key.y() == firstChunkY ? rect.top() & CHUNK_MASK : 0;
+        const int lastRow = key.y() == lastChunkY ? rect.bottom() & CHUNK_MASK : CHUNK_MASK;
+        const int firstColumn = key.x() == firstChunkX ? rect.left() & CHUNK_MASK : 0;
+        const int lastColumn = key.x() == lastChunkX ? rect.right() & CHUNK_MASK : CHUNK_MASK;
+
+        if (firstRow != 0 || lastRow != CHUNK_MASK || firstColumn != 0 || lastColumn != CHUNK_MASK) {
+            Chunk &chunk = *it;
+            const quint64 columns = rowMask(firstColumn, lastColumn);
+
+            for (int row = 0; row < CHUNK_SIZE; ++row) {
+                if (row < firstRow || row > lastRow)
+                    chunk[row] = 0;
+                else
+                    chunk[row] &= columns;
+            }
+
+            if (isChunkEmpty(chunk)) {
+                it = mChunks.erase(it);
+                continue;
+            }
+        }
+
+        ++it;
+    }
+}
+
+/**
+ * Adds the CHUNK_SIZE tiles starting at \a x on row \a y for which the
+ * corresponding bit is set in \a bits. The \a x coordinate needs to be a
+ * multiple of CHUNK_SIZE.
+ */
+void TileRegion::addRowBits(int x, int y, quint64 bits)
+{
+    Q_ASSERT((x & CHUNK_MASK) == 0);
+
+    if (bits)
+        mChunks[QPoint(x >> CHUNK_BITS, y >> CHUNK_BITS)][y & CHUNK_MASK] |= bits;
+}
+
+void TileRegion::translate(QPoint offset)
+{
+    if (!offset.isNull())
+        *this = translated(offset);
+}
+
+TileRegion TileRegion::translated(QPoint offset) const
+{
+    if (offset.isNull())
+        return *this;
+
+    TileRegion result;
+    result.mChunks.reserve(mChunks.size());
+
+    // Offsets by whole chunks only need the chunks to be moved
+    if (!(offset.x() & CHUNK_MASK) && !(offset.y() & CHUNK_MASK)) {
+        const QPoint chunkOffset(offset.x() >> CHUNK_BITS, offset.y() >> CHUNK_BITS);
+        for (auto it = mChunks.cbegin(), end = mChunks.cend(); it != end; ++it)
+            result.mChunks.insert(it.key() + chunkOffset, it.value());
+        return result;
+    }
+
+    // Otherwise each row is split over at most two horizontally adjacent chunks
+    for (auto it = mChunks.cbegin(), end = mChunks.cend(); it != end; ++it) {
+        const int x = (it.key().x() << CHUNK_BITS) + offset.x();
+        const int chunkX = x >> CHUNK_BITS;
+        const int shift = x & CHUNK_MASK;
+
+        for (int row = 0; row < CHUNK_SIZE; ++row) {
+            const quint64 bits = (*it)[row];
+            if (!bits)
+                continue;
+
+            const int y = (it.key().y() << CHUNK_BITS) + row + offset.y();
+            const int chunkY = y >> CHUNK_BITS;
+
+            if (const quint64 low = bits << shift)
+                result.mChunks[QPoint(chunkX, chunkY)][y & CHUNK_MASK] |= low;
+
+            if (shift) {
+                if (const quint64 high = bits >> (CHUNK_SIZE - shift))
+                    result.mChunks[QPoint(chunkX + 1, chunkY)][y & CHUNK_MASK] |= high;
+            }
+        }
+    }
+
+    return result;
+}
+
+TileRegion &TileRegion::operator|=(const TileRegion &other)
+{
+    if (isEmpty())
+        return *this = other;
+
+    for (auto it = other.mChunks.cbegin(), end = other.mChunks.cend(); it != end; ++it) {
+        Chunk &chunk = mChunks[it.key()];
+        for (int row = 0; row < CHUNK_SIZE; ++row)
+            chunk[row] |= (*it)[row];
+    }
+
+    return *this;
+}
+
+TileRegion &TileRegion::operator&=(const TileRegion &other)
+{
+    for (auto it = mChunks.begin(); it != mChunks.end(); ) {
+        const auto otherIt = other.mChunks.constFind(it.key());
+        if (otherIt == other.mChunks.constEnd()) {
+            it = mChunks.erase(it);
+            continue;
+        }
+
+        for (int row = 0; row < CHUNK_SIZE; ++row)
+            (*it)[row] &= (*otherIt)[row];
+
+        if (isChunkEmpty(*it))
+            it = mChunks.erase(it);
+        else
+            ++it;
+    }
+
+    return *this;
+}
+
+TileRegion &TileRegion::operator-=(const TileRegion &other)
+{
+    for (auto it = other.mChunks.cbegin(), end = other.mChunks.cend(); it != end; ++it) {
+        const auto ownIt = mChunks.find(it.key());
+        if (ownIt == mChunks.end())
+            continue;
+
+        for (int row = 0; row < CHUNK_SIZE; ++row)
+            (*ownIt)[row] &= ~(*it)[row];
+
+        if (isChunkEmpty(*ownIt))
+            mChunks.erase(ownIt);
+    }
+
+    return *this;
+}
+
+/**
+ * Calls \a callback for each horizontal run of tiles, ordered by y and then
+ * by x. Each run is a rectangle with a height of one tile. Runs continuing
+ * over chunk borders are reported as a single run.
+ */
+void TileRegion::forEachRun(const std::function<void (const QRect &)> &callback) const
+{
+    const QVector<QPoint> keys = sortedChunkKeys();
+    QVector<const Chunk*> chunks;
+
+    for (qsizetype first = 0; first < keys.size(); ) {
+        // Find the chunks in this row of chunks
+        qsizetype last = first;
+        while (last + 1 < keys.size() && keys.at(last + 1).y() == keys.at(first).y())
+            ++last;
+
+        const int chunkTop = keys.at(first).y() << CHUNK_BITS;
+
+        chunks.clear();
+        for (qsizetype i = first; i <= last; ++i)
+            chunks.append(&*mChunks.constFind(keys.at(i)));
+
+        for (int row = 0; row < CHUNK_SIZE; ++row) {
+            const int y = chunkTop + row;
+            int runStart = 0;
+            int runEnd = 0;     // exclusive
+            bool hasRun = false;
+
+            for (qsizetype i = first; i <= last; ++i) {
+                const int chunkLeft = keys.at(i).x() << CHUNK_BITS;
+                quint64 bits = (*chunks.at(i - first))[row];
+
+                while (bits) {
+                    const int start = qCountTrailingZeroBits(bits);
+                    const quint64 inverted = ~(bits >> start);
+                    const int length = inverted ? qCountTrailingZeroBits(inverted)
+                                                : CHUNK_SIZE - start;
+
+                    if (start + length >= CHUNK_SIZE)
+                        bits = 0;
+                    else
+                        bits &= ~quint64(0) << (start + length);
+
+                    const int x = chunkLeft + start;
+                    if (hasRun && runEnd == x) {
+                        runEnd += length;
+                        continue;
+                    }
+
+                    if (hasRun)
+                        callback(QRect(runStart, y, runEnd - runStart, 1));
+
+                    runStart = x;
+                    runEnd = x + length;
+                    hasRun = true;
+                }
+            }
+
+            if (hasRun)
+                callback(QRect(runStart, y, runEnd - runStart, 1));
+        }
+
+        first = last + 1;
+    }
+}
+
+/**
+ * Returns the region as a list of non-overlapping rectangles, in the banded
+ * form expected by QRegion::setRects. Consecutive rows with the same runs
+ * are merged into a single band.
+ */
+QVector<QRect> TileRegion::rects() const
+{
+    QVector<QRect> result;
+    QVector<QRect> band;
+    QVector<QRect> row;
+    int rowY = INT_MIN;
+
+    auto finishRow = [&] {
+        if (row.isEmpty())
+            return;
+
+        const bool extendsBand = !band.isEmpty() &&
+                band.first().bottom() + 1 == rowY &&
+                band.size() == row.size() &&
+                std::equal(band.cbegin(), band.cend(), row.cbegin(),
+                           [] (const QRect &a, const QRect &b) {
+                    return a.left() == b.left() && a.right() == b.right();
+                });
+
+        if (extendsBand) {
+            for (QRect &rect : band)
+                rect.setBottom(rowY);
+        } else {
+            result.append(band);
+            band.swap(row);
+        }
+
+        row.clear();
+    };
+
+    forEachRun([&] (const QRect &run) {
+        if (run.y() != rowY) {
+            finishRow();
+            rowY = run.y();
+        }
+        row.append(run);
+    });
+
+    finishRow();
+    result.append(band);
+
+    return result;
+}
+
+QRegion TileRegion::toRegion() const
+{
+    QRegion region;
+    const QVector<QRect> rects = this->rects();
+#if QT_VERSION >= QT_VERSION_CHECK(6, 8, 0)
+    region.setRects(rects);
+#else
+    region.setRects(rects.constData(), int(rects.size()));
+#endif
+    return region;
+}
+
+bool TileRegion::isChunkEmpty(const Chunk &chunk)
+{
+    return std::all_of(chunk.cbegin(), chunk.cend(),
+                       [] (quint64 bits) { return bits == 0; });
+}
+
+QVector<QPoint> TileRegion::sortedChunkKeys() const
+{
+    QVector<QPoint> keys = mChunks.keys();
+    std::sort(keys.begin(), keys.end(), [] (QPoint a, QPoint b) {
+        return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+    });
+    return keys;
+}
+
+} // namespace Tiled
@@ -0,0 +1,129 @@
+/*
+ * tileregion.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of libtiled.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include "tiled_global.h"
+
+#include <QHash>
+#include <QPoint>
+#include <QRect>
+#include <QRegion>
+#include <QVector>
+
+#include <array>
+#include <functional>
+
+namespace Tiled {
+
+/**
+ * A set of tiles, stored as a bitmap.
+ *
+ * This is an alternative to QRegion for areas of a tile layer. The tiles are
+ * stored in chunks of 64x64 bits which are allocated on demand, so that
+ * boolean operations, containment checks and iteration are cheap regardless
+ * of how fragmented the area is.
+ *
+ * Use toRegion() and the QRegion constructor to convert at API boundaries.
+ */
+class TILEDSHARED_EXPORT TileRegion
+{
+public:
+    static const int CHUNK_BITS = 6;
+    static const int CHUNK_SIZE = 1 << CHUNK_BITS;
+    static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+    TileRegion() = default;
+    explicit TileRegion(const QRect &rect);
+    explicit TileRegion(const QRegion &region);
+
+    bool isEmpty() const { return mChunks.isEmpty(); }
+    void clear() { mChunks.clear(); }
+
+    bool contains(int x, int y) const;
+    bool contains(QPoint point) const { return contains(point.x(), point.y()); }
+
+    bool intersects(const QRect &rect) const;
+    bool intersects(const TileRegion &other) const;
+
+    QRect boundingRect() const;
+    qint64 tileCount() const;
+
+    void add(const QRect &rect);
+    void add(const QRegion &region);
+    void remove(const QRect &rect);
+    void intersect(const QRect &rect);
+
+    void addRowBits(int x, int y, quint64 bits);
+    static quint64 rowMask(int first, int last);
+
+    void translate(QPoint offset);
+    TileRegion translated(QPoint offset) const;
+
+    TileRegion &operator|=(const TileRegion &other);
+    TileRegion &operator&=(const TileRegion &other);
+    TileRegion &operator-=(const TileRegion &other);
+
+    TileRegion operator|(const TileRegion &other) const { TileRegion r = *this; r |= other; return r; }
+    TileRegion operator&(const TileRegion &other) const { TileRegion r = *this; r &= other; return r; }
+    TileRegion operator-(const TileRegion &other) const { TileRegion r = *this; r -= other; return r; }
+
+    TileRegion &operator|=(const QRect &rect) { add(rect); return *this; }
+    TileRegion &operator-=(const QRect &rect) { remove(rect); return *this; }
+    TileRegion &operator&=(const QRect &rect) { intersect(rect); return *this; }
+
+    bool operator==(const TileRegion &other) const { return mChunks == other.mChunks; }
+    bool operator!=(const TileRegion &other) const { return mChunks != other.mChunks; }
+
+    void forEachRun(const std::function<void(const QRect &run)> &callback) const;
+    QVector<QRect> rects() const;
+    QRegion toRegion() const;
+
+private:
+    // One 64-bit row per entry, with bit i representing the tile at x offset i
+    using Chunk = std::array<quint64, CHUNK_SIZE>;
+
+    static bool isChunkEmpty(const Chunk &chunk);
+
+    QVector<QPoint> sortedChunkKeys() const;
+
+    QHash<QPoint, Chunk> mChunks;
+};
+
+/**
+ * Returns a mask for a chunk row with the bits \a first up to and including
+ * \a last set.
+ */
+inline quint64 TileRegion::rowMask(int first, int last)
+{
+    const quint64 upper = last == CHUNK_MASK ? ~quint64(0)
+                                             : (quint64(1) << (last + 1)) - 1;
+    return upper & ~((quint64(1) << first) - 1);
+}
+
+} // namespace Tiled
@@ -36,6 +36,7 @@
 #include "tilesetformat.h"
 
 #include <QDebug>
+#include <QThread>
 
 namespace Tiled {
 
@@ -96,9 +97,26 @@ void TilesetManager::deleteInstance()
  */
 SharedTileset TilesetManager::loadTileset(const QString &fileName, QString *error)
 {
-    SharedTileset tileset = findTileset(fileName);
-    if (!tileset)
-        tileset = readTileset(fileName, error);
+    QThread *currentThread = QThread::currentThread();
+
+    {
+        QMutexLocker locker(&mLoadingMutex);
+
+        // Wait when another thread is loading the same tileset
+        while (mLoadingTilesets.value(fileName, currentThread) != currentThread)
+            mLoadingFinished.wait(&mLoadingMutex);
+
+        if (SharedTileset tileset = findTileset(fileName))
+            return tileset;
+
+        mLoadingTilesets.insert(fileName, currentThread);
+    }
+
+    SharedTileset tileset = readTileset(fileName, error);
+
+    QMutexLocker locker(&mLoadingMutex);
+    mLoadingTilesets.remove(fileName);
+    mLoadingFinished.wakeAll();
 
     return tileset;
 }
@@ -109,9 +127,15 @@ SharedTileset TilesetManager::loadTileset(const QString &fileName, QString *erro
  */
 SharedTileset TilesetManager::findTileset(const QString &fileName) const
 {
-    for (Tileset *tileset : mTilesets)
-        if (tileset->fileName() == fileName)
-            return tileset->sharedFromThis();
+    QMutexLocker locker(&mMutex);
+
+    for (Tileset *tileset : mTilesets) {
+        if (tileset->fileName() == fileName) {
+            // May fail when the tileset is being deleted by another thread
+            if (SharedTileset sharedTileset = tileset->sharedFromThis())
+                return sharedTileset;
+        }
+    }
 
     return SharedTileset();
 }
@@ -122,6 +146,7 @@ SharedTileset TilesetManager::findTileset(const QString &fileName) const
  */
 void TilesetManager::addTileset(Tileset *tileset)
 {
+    QMutexLocker locker(&mMutex);
     Q_ASSERT(!mTilesets.contains(tileset));
     mTilesets.append(tileset);
 }
@@ -132,11 +157,66 @@ void TilesetManager::addTileset(Tileset *tileset)
  */
 void TilesetManager::removeTileset(Tileset *tileset)
 {
+    QMutexLocker locker(&mMutex);
     Q_ASSERT(mTilesets.contains(tileset));
     mTilesets.removeOne(tileset);
 
     if (tileset->imageSource().isLocalFile())
-        mWatcher->removePath(tileset->imageSource().toLocalFile());
+        setWatched(tileset->imageSource().toLocalFile(), false);
+}
+
+/**
+ * Registers a \a tile that has animation frames.
+ */
+void TilesetManager::addAnimatedTile(Tile *tile)
+{
+    QMutexLocker locker(&mMutex);
+    if (mAnimatedTiles.contains(tile))
+        return;
+
+    mAnimatedTiles.insert(tile);
+    ++mAnimatedTilesGeneration;
+
+    // Tiles may be loaded in another thread, so start the driver from the
+    // main thread
+    if (mAnimatedTiles.size() == 1)
+        QMetaObject::invokeMethod(this, &TilesetManager::updateAnimationDriver, Qt::QueuedConnection);
+}
+
+/**
+ * Unregisters a \a tile that no longer has animation frames, or that is
+ * being deleted.
+ */
+void TilesetManager::removeAnimatedTile(Tile *tile)
+{
+    QMutexLocker locker(&mMutex);
+    if (!mAnimatedTiles.remove(tile))
+        return;
+
+    ++mAnimatedTilesGeneration;
+
+    if (mAnimatedTiles.isEmpty())
+        QMetaObject::invokeMethod(this, &TilesetManager::updateAnimationDriver, Qt::QueuedConnection);
+}
+
+/**
+ * Returns the tiles that have animation frames.
+ */
+QList<Tile*> TilesetManager::animatedTiles() const
+{
+    QMutexLocker locker(&mMutex);
+    return QList<Tile*>(mAnimatedTiles.cbegin(), mAnimatedTiles.cend());
+}
+
+/**
+ * Returns a number that changes whenever tiles gain or lose their animation
+ * frames. Can be used to know when information about the placement of
+ * animated tiles needs to be refreshed.
+ */
+quint64 TilesetManager::animatedTilesGeneration() const
+{
+    QMutexLocker locker(&mMutex);
+    return mAnimatedTilesGeneration;
 }
 
 /**
@@ -144,6 +224,7 @@ void TilesetManager::removeTileset(Tileset *tileset)
  */
 void TilesetManager::reloadImages(Tileset *tileset)
 {
+    QMutexLocker locker(&mMutex);
     if (!mTilesets.contains(tileset))
         return;
 
@@ -183,30 +264,67 @@ bool TilesetManager::reloadTilesetsOnChange() const
  */
 void TilesetManager::setAnimateTiles(bool enabled)
 {
-    // TODO: Avoid running the driver when there are no animated tiles
-    if (enabled) {
-        mAnimationDriver->start();
-    } else {
-        mAnimationDriver->stop();
+    mAnimateTiles = enabled;
+
+    if (!enabled)
         resetTileAnimations();
-    }
+
+    updateAnimationDriver();
 }
 
 bool TilesetManager::animateTiles() const
 {
-    return mAnimationDriver->state() == QAbstractAnimation::Running;
+    return mAnimateTiles;
+}
+
+/**
+ * Runs the animation driver only while tile animations are enabled and there
+ * are any animated tiles.
+ */
+void TilesetManager::updateAnimationDriver()
+{
+    bool hasAnimatedTiles;
+    {
+        QMutexLocker locker(&mMutex);
+        hasAnimatedTiles = !mAnimatedTiles.isEmpty();
+    }
+
+    if (mAnimateTiles && hasAnimatedTiles)
+        mAnimationDriver->start();
+    else
+        mAnimationDriver->stop();
 }
 
 void TilesetManager::tilesetImageSourceChanged(const Tileset &tileset,
                                                const QUrl &oldImageSource)
 {
+    QMutexLocker locker(&mMutex);
     Q_ASSERT(mTilesets.contains(const_cast<Tileset*>(&tileset)));
 
     if (oldImageSource.isLocalFile())
-        mWatcher->removePath(oldImageSource.toLocalFile());
+        setWatched(oldImageSource.toLocalFile(), false);
 
     if (tileset.imageSource().isLocalFile())
-        mWatcher->addPath(tileset.imageSource().toLocalFile());
+        setWatched(tileset.imageSource().toLocalFile(), true);
+}
+
+/**
+ * Starts or stops watching the given file. Tilesets may be loaded in another
+ * thread, while the watcher can only be used from its own thread.
+ */
+void TilesetManager::setWatched(const QString &fileName, bool watched)
+{
+    auto update = [this, fileName, watched] {
+        if (watched)
+            mWatcher->addPath(fileName);
+        else
+            mWatcher->removePath(fileName);
+    };
+
+    if (QThread::currentThread() == thread())
+        update();
+    else
+        QMetaObject::invokeMethod(this, update, Qt::QueuedConnection);
 }
 
 void TilesetManager::filesChanged(const QStringList &fileNames)
@@ -214,6 +332,7 @@ void TilesetManager::filesChanged(const QStringList &fileNames)
     for (const QString &fileName : fileNames)
         ImageCache::remove(fileName);
 
+    QMutexLocker locker(&mMutex);
     for (Tileset *tileset : std::as_const(mTilesets)) {
         const QString fileName = tileset->imageSource().toLocalFile();
         if (fileNames.contains(fileName))
@@ -230,34 +349,30 @@ void TilesetManager::filesChanged(const QStringList &fileNames)
  */
 void TilesetManager::resetTileAnimations()
 {
-    // TODO: This could be more optimal by keeping track of the list of
-    // actually animated tiles
-
-    for (Tileset *tileset : std::as_const(mTilesets)) {
-        bool imageChanged = false;
-
-        for (Tile *tile : tileset->tiles())
-            imageChanged |= tile->resetAnimation();
-
-        if (imageChanged)
-            emit repaintTileset(tileset);
+    QList<Tile*> changedTiles;
+    {
+        QMutexLocker locker(&mMutex);
+        for (Tile *tile : std::as_const(mAnimatedTiles))
+            if (tile->resetAnimation())
+                changedTiles.append(tile);
     }
+
+    if (!changedTiles.isEmpty())
+        emit repaintTiles(changedTiles);
 }
 
 void TilesetManager::advanceTileAnimations(int ms)
 {
-    // TODO: This could be more optimal by keeping track of the list of
-    // actually animated tiles
-
-    for (Tileset *tileset : std::as_const(mTilesets)) {
-        bool imageChanged = false;
-
-        for (Tile *tile : tileset->tiles())
-            imageChanged |= tile->advanceAnimation(ms);
-
-        if (imageChanged)
-            emit repaintTileset(tileset);
+    QList<Tile*> changedTiles;
+    {
+        QMutexLocker locker(&mMutex);
+        for (Tile *tile : std::as_const(mAnimatedTiles))
+            if (tile->advanceAnimation(ms))
+                changedTiles.append(tile);
     }
+
+    if (!changedTiles.isEmpty())
+        emit repaintTiles(changedTiles);
 }
 
 } // namespace Tiled
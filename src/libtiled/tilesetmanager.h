@@ -31,9 +31,16 @@
 
 #include "tileset.h"
 
-#include <QObject>
+#include <QHash>
 #include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QRecursiveMutex>
+#include <QSet>
 #include <QString>
+#include <QWaitCondition>
+
+class QThread;
 
 namespace Tiled {
 
@@ -44,6 +51,10 @@ class TileAnimationDriver;
  * The tileset manager keeps track of all tilesets used by loaded maps. It also
  * watches the tileset images for changes and will attempt to reload them when
  * they change.
+ *
+ * Tilesets can be loaded from multiple threads at the same time. In this case,
+ * a tileset that is already being loaded by another thread is waited for, so
+ * that each external tileset is only loaded once.
  */
 class TILEDSHARED_EXPORT TilesetManager : public QObject
 {
@@ -64,6 +75,13 @@ public:
     void addTileset(Tileset *tileset);
     void removeTileset(Tileset *tileset);
 
+    // Only meant to be used by the Tile class
+    void addAnimatedTile(Tile *tile);
+    void removeAnimatedTile(Tile *tile);
+
+    QList<Tile*> animatedTiles() const;
+    quint64 animatedTilesGeneration() const;
+
     void reloadImages(Tileset *tileset);
 
     void setReloadTilesetsOnChange(bool enabled);
@@ -85,20 +103,40 @@ signals:
     void tilesetImagesChanged(Tileset *tileset);
 
     /**
-     * Emitted when any images of the tiles in the given \a tileset have
-     * changed as a result of playing tile animations.
+     * Emitted when the images of the given \a tiles have changed as a result
+     * of playing tile animations.
      */
-    void repaintTileset(Tileset *tileset);
+    void repaintTiles(const QList<Tile*> &tiles);
 
 private:
     void filesChanged(const QStringList &fileNames);
+    void updateAnimationDriver();
+    void setWatched(const QString &fileName, bool watched);
 
     /**
      * The list of loaded tilesets (weak references).
      */
     QList<Tileset*> mTilesets;
+    mutable QRecursiveMutex mMutex;
+
+    /**
+     * The tiles that have animation frames, so that only these need to be
+     * looked at when playing tile animations. The generation is increased
+     * whenever this set changes.
+     */
+    QSet<Tile*> mAnimatedTiles;
+    quint64 mAnimatedTilesGeneration = 0;
+
+    /**
+     * The tilesets currently being loaded, by the thread loading them.
+     */
+    QHash<QString, QThread*> mLoadingTilesets;
+    QMutex mLoadingMutex;
+    QWaitCondition mLoadingFinished;
+
     FileSystemWatcher *mWatcher;
     TileAnimationDriver *mAnimationDriver;
+    bool mAnimateTiles = false;
 
     static TilesetManager *mInstance;
 };
@@ -45,12 +45,12 @@ TmxMapFormat::TmxMapFormat(QObject *parent)
 
 std::unique_ptr<Map> TmxMapFormat::read(const QString &fileName)
 {
-    mError.clear();
+    mError.setLocalData(QString());
 
     MapReader reader;
     std::unique_ptr<Map> map(reader.readMap(fileName));
     if (!map)
-        mError = reader.errorString();
+        mError.setLocalData(reader.errorString());
 
     return map;
 }
@@ -62,9 +62,9 @@ bool TmxMapFormat::write(const Map *map, const QString &fileName, Options option
 
     bool result = writer.writeMap(map, fileName);
     if (!result)
-        mError = writer.errorString();
+        mError.setLocalData(writer.errorString());
     else
-        mError.clear();
+        mError.setLocalData(QString());
 
     return result;
 }
@@ -82,7 +82,7 @@ QByteArray TmxMapFormat::toByteArray(const Map *map)
 
 std::unique_ptr<Map> TmxMapFormat::fromByteArray(const QByteArray &data)
 {
-    mError.clear();
+    mError.setLocalData(QString());
 
     QBuffer buffer;
     buffer.setData(data);
@@ -91,7 +91,7 @@ std::unique_ptr<Map> TmxMapFormat::fromByteArray(const QByteArray &data)
     MapReader reader;
     std::unique_ptr<Map> map(reader.readMap(&buffer));
     if (!map)
-        mError = reader.errorString();
+        mError.setLocalData(reader.errorString());
 
     return map;
 }
@@ -33,6 +33,8 @@
 #include "tiled_global.h"
 #include "tilesetformat.h"
 
+#include <QThreadStorage>
+
 namespace Tiled {
 
 class Tileset;
@@ -76,10 +78,13 @@ public:
 
     bool supportsFile(const QString &fileName) const override;
 
-    QString errorString() const override { return mError; }
+    Capabilities capabilities() const override { return ReadWrite | ReadInBackground; }
+
+    QString errorString() const override { return mError.localData(); }
 
 private:
-    QString mError;
+    // Per thread, since maps may be read from multiple threads at once
+    QThreadStorage<QString> mError;
 };
 
 /**
@@ -678,6 +678,9 @@ std::unique_ptr<TileLayer> VariantToMapConverter::toTileLayer(const QVariantMap
             return nullptr;
         }
     } else {
+        const bool binary = layerDataFormat != Map::XML && layerDataFormat != Map::CSV;
+        QVector<GidMapper::EncodedLayerData> binaryChunks;
+
         const QVariantList chunks = variantMap[QStringLiteral("chunks")].toList();
         for (const QVariant &chunkVariant : chunks) {
             const QVariantMap chunkVariantMap = chunkVariant.toMap();
@@ -687,7 +690,17 @@ std::unique_ptr<TileLayer> VariantToMapConverter::toTileLayer(const QVariantMap
             int width = chunkVariantMap[QStringLiteral("width")].toInt();
             int height = chunkVariantMap[QStringLiteral("height")].toInt();
 
-            readTileLayerData(*tileLayer, chunkData, layerDataFormat, QRect(x, y, width, height));
+            if (binary)
+                binaryChunks.append({ QRect(x, y, width, height), chunkData.toByteArray() });
+            else
+                readTileLayerData(*tileLayer, chunkData, layerDataFormat, QRect(x, y, width, height));
+        }
+
+        // Binary chunks are decoded at once, which allows it to happen in parallel
+        if (!binaryChunks.isEmpty()) {
+            const auto error = mGidMapper.decodeLayerData(*tileLayer, binaryChunks, layerDataFormat);
+            if (!checkDecodeError(error, *tileLayer))
+                return nullptr;
         }
     }
 
@@ -966,6 +979,10 @@ bool VariantToMapConverter::readTileLayerData(TileLayer &tileLayer,
     switch (layerDataFormat) {
     case Map::XML:
     case Map::CSV: {
+        // The data may have been read directly into a list of GIDs
+        if (dataVariant.userType() == qMetaTypeId<QVector<unsigned>>())
+            return readTileLayerData(tileLayer, dataVariant.value<QVector<unsigned>>(), bounds);
+
         const QVariantList dataVariantList = dataVariant.toList();
 
         if (dataVariantList.size() != bounds.width() * bounds.height()) {
@@ -1008,23 +1025,55 @@ bool VariantToMapConverter::readTileLayerData(TileLayer &tileLayer,
                                                                   layerDataFormat,
                                                                   bounds);
 
-        switch (error) {
-        case GidMapper::CorruptLayerData:
-            mError = tr("Corrupt layer data for layer '%1'").arg(tileLayer.name());
-            return false;
-        case GidMapper::TileButNoTilesets:
-            mError = tr("Tile used but no tilesets specified");
-            return false;
-        case GidMapper::InvalidTile:
-            mError = tr("Invalid tile: %1").arg(mGidMapper.invalidTile());
-            return false;
-        case GidMapper::NoError:
-            break;
+        return checkDecodeError(error, tileLayer);
+    }
+    }
+
+    return true;
+}
+
+bool VariantToMapConverter::readTileLayerData(TileLayer &tileLayer,
+                                              const QVector<unsigned> &gids,
+                                              QRect bounds)
+{
+    if (gids.size() != bounds.width() * bounds.height()) {
+        mError = tr("Corrupt layer data for layer '%1'").arg(tileLayer.name());
+        return false;
+    }
+
+    int x = bounds.x();
+    int y = bounds.y();
+    bool ok;
+
+    for (const unsigned gid : gids) {
+        tileLayer.setCell(x, y, mGidMapper.gidToCell(gid, ok));
+
+        x++;
+        if (x > bounds.right()) {
+            x = bounds.x();
+            y++;
         }
+    }
 
+    return true;
+}
+
+bool VariantToMapConverter::checkDecodeError(GidMapper::DecodeError error,
+                                             const TileLayer &tileLayer)
+{
+    switch (error) {
+    case GidMapper::CorruptLayerData:
+        mError = tr("Corrupt layer data for layer '%1'").arg(tileLayer.name());
+        return false;
+    case GidMapper::TileButNoTilesets:
+        mError = tr("Tile used but no tilesets specified");
+        return false;
+    case GidMapper::InvalidTile:
+        mError = tr("Invalid tile: %1").arg(mGidMapper.invalidTile());
+        return false;
+    case GidMapper::NoError:
         break;
     }
-    }
 
     return true;
 }
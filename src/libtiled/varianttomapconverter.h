@@ -105,6 +105,11 @@ private:
                            const QVariant &dataVariant,
                            Map::LayerDataFormat layerDataFormat,
                            QRect bounds);
+    bool readTileLayerData(TileLayer &tileLayer,
+                           const QVector<unsigned> &gids,
+                           QRect bounds);
+    bool checkDecodeError(GidMapper::DecodeError error,
+                          const TileLayer &tileLayer);
 
     Properties extractProperties(const QVariantMap &variantMap) const;
 
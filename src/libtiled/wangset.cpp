@@ -33,6 +33,9 @@
 #include <QStack>
 #include <QtMath>
 
+#include <algorithm>
+#include <numeric>
+
 namespace Tiled {
 
 /**
@@ -564,6 +567,11 @@ void WangSet::removeTileId(int tileId)
     mCellsDirty = true;
 }
 
+static int matchTableWords(int cellCount)
+{
+    return (cellCount + 63) / 64;
+}
+
 /**
  * Returns the list of WangIds and their corresponding cells, as defined by
  * this Wang set.
@@ -577,6 +585,75 @@ const QVector<WangSet::WangIdAndCell> &WangSet::wangIdsAndCells() const
     return mWangIdAndCells;
 }
 
+/**
+ * Collects the indexes into wangIdsAndCells() of the entries of which the
+ * WangId matches the given \a wangId at the indexes selected by \a mask.
+ * The indexes are stored in \a result, in ascending order.
+ *
+ * Rather than comparing each of the WangIds, this intersects precomputed sets
+ * of the entries having a certain color at a certain index, so it stays fast
+ * for large sets when only few entries match.
+ *
+ * Like wangIdsAndCells(), this may update the cached entries, so it should
+ * be called once on the main thread before calling it from multiple threads.
+ */
+void WangSet::findMatchingCells(WangId wangId, WangId mask, QVector<int> &result) const
+{
+    const int cellCount = wangIdsAndCells().size();
+
+    result.clear();
+
+    MatchBits bits(matchTableWords(cellCount));
+    if (!intersectMatchTable(wangId, mask, bits)) {
+        result.resize(cellCount);
+        std::iota(result.begin(), result.end(), 0);
+        return;
+    }
+
+    for (int w = 0; w < bits.size(); ++w) {
+        quint64 word = bits.at(w);
+        while (word) {
+            result.append(w * 64 + qCountTrailingZeroBits(word));
+            word &= word - 1;
+        }
+    }
+}
+
+/**
+ * Sets \a bits to the entries of mWangIdAndCells that match the \a wangId
+ * at the indexes selected by \a mask. Returns false when the mask selects
+ * no index at all, in which case all entries match.
+ */
+bool WangSet::intersectMatchTable(WangId wangId, WangId mask, MatchBits &bits) const
+{
+    const int words = bits.size();
+    bool constrained = false;
+
+    for (int i = 0; i < WangId::NumIndexes; ++i) {
+        if (!mask.indexColor(i))
+            continue;
+
+        const int color = wangId.indexColor(i);
+        if (color >= mMatchTableColors) {
+            // No entry has this color
+            std::fill(bits.begin(), bits.end(), 0);
+            return true;
+        }
+
+        const quint64 *colorBits = mMatchTable.constData() + (i * mMatchTableColors + color) * words;
+
+        if (constrained) {
+            for (int w = 0; w < words; ++w)
+                bits[w] &= colorBits[w];
+        } else {
+            std::copy(colorBits, colorBits + words, bits.begin());
+            constrained = true;
+        }
+    }
+
+    return constrained;
+}
+
 void WangSet::recalculateCells()
 {
     mWangIdAndCells.clear();
@@ -601,8 +678,10 @@ void WangSet::recalculateCells()
     const auto transformationFlags = tileset()->transformationFlags();
     mLastSeenTranslationFlags = transformationFlags;
 
-    if (!(transformationFlags & ~Tileset::PreferUntransformed))
+    if (!(transformationFlags & ~Tileset::PreferUntransformed)) {
+        recalculateMatchTable();
         return;
+    }
 
     // Then insert variations based on flipping
     it.toFront();
@@ -656,6 +735,35 @@ void WangSet::recalculateCells()
             mWangIdAndCells.append({wangIds[i], cells[i]});
         }
     }
+
+    recalculateMatchTable();
+}
+
+/**
+ * Indexes the WangIds of the cells by the color at each of their indexes,
+ * to speed up looking up the matching cells.
+ */
+void WangSet::recalculateMatchTable()
+{
+    int maxColor = 0;
+    for (const auto &wangIdAndCell : std::as_const(mWangIdAndCells))
+        for (int i = 0; i < WangId::NumIndexes; ++i)
+            maxColor = qMax(maxColor, wangIdAndCell.wangId.indexColor(i));
+
+    const int words = matchTableWords(mWangIdAndCells.size());
+
+    mMatchTableColors = maxColor + 1;
+    mMatchTable.fill(0, WangId::NumIndexes * mMatchTableColors * words);
+
+    for (int n = 0; n < mWangIdAndCells.size(); ++n) {
+        const WangId wangId = mWangIdAndCells.at(n).wangId;
+        const quint64 bit = quint64(1) << (n & 63);
+
+        for (int i = 0; i < WangId::NumIndexes; ++i) {
+            const int color = wangId.indexColor(i);
+            mMatchTable[(i * mMatchTableColors + color) * words + n / 64] |= bit;
+        }
+    }
 }
 
 /**
@@ -847,13 +955,14 @@ bool WangSet::wangIdIsValid(WangId wangId, int colorCount)
 bool WangSet::wangIdIsUsed(WangId wangId, WangId mask) const
 {
     mask &= typeMask();
-    const WangId maskedWangId = wangId & mask;
 
-    for (const auto &wangIdAndCell : wangIdsAndCells())
-        if ((wangIdAndCell.wangId & mask) == maskedWangId)
-            return true;
+    const int cellCount = wangIdsAndCells().size();
 
-    return false;
+    MatchBits bits(matchTableWords(cellCount));
+    if (!intersectMatchTable(wangId, mask, bits))
+        return cellCount > 0;
+
+    return std::any_of(bits.begin(), bits.end(), [] (quint64 word) { return word != 0; });
 }
 
 int WangSet::transitionPenalty(int colorA, int colorB) const
@@ -998,6 +1107,8 @@ WangSet *WangSet::clone(Tileset *tileset) const
     c->mColors = mColors;
     c->mTileIdToWangId = mTileIdToWangId;
     c->mWangIdAndCells = mWangIdAndCells;
+    c->mMatchTable = mMatchTable;
+    c->mMatchTableColors = mMatchTableColors;
     c->mMaximumColorDistance = mMaximumColorDistance;
     c->mColorDistancesDirty = mColorDistancesDirty;
     c->mCellsDirty = mCellsDirty;
@@ -36,6 +36,7 @@
 #include <QMultiHash>
 #include <QString>
 #include <QList>
+#include <QVarLengthArray>
 
 namespace Tiled {
 
@@ -294,6 +295,7 @@ public:
     };
 
     const QVector<WangIdAndCell> &wangIdsAndCells() const;
+    void findMatchingCells(WangId wangId, WangId mask, QVector<int> &result) const;
 
     QList<WangTile> sortedWangTiles() const;
 
@@ -322,12 +324,17 @@ public:
     WangSet *clone(Tileset *tileset) const;
 
 private:
+    using MatchBits = QVarLengthArray<quint64, 64>;
+
     void removeTileId(int tileId);
 
     bool cellsDirty() const;
     void recalculateCells();
+    void recalculateMatchTable();
     void recalculateColorDistances();
 
+    bool intersectMatchTable(WangId wangId, WangId mask, MatchBits &bits) const;
+
     Tileset *mTileset;
     QString mName;
     Type mType;
@@ -343,6 +350,11 @@ private:
 
     QVector<WangIdAndCell> mWangIdAndCells;
 
+    // For each index and color, a bit set of the entries in mWangIdAndCells
+    // having that color at that index.
+    QVector<quint64> mMatchTable;
+    int mMatchTableColors = 0;
+
     int mMaximumColorDistance = 0;
     bool mColorDistancesDirty = true;
     bool mCellsDirty = true;
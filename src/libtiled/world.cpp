@@ -42,11 +42,33 @@
 
 #include <QDebug>
 
+#include <algorithm>
+#include <limits>
+
 namespace Tiled {
 
+// Maps covering more cells than this are stored in a separate list
+static const int MaxCellsPerMap = 64;
+
+static QRect patternMapRect(const WorldPattern &pattern,
+                            const QRegularExpressionMatch &match)
+{
+    const int x = match.capturedView(1).toInt();
+    const int y = match.capturedView(2).toInt();
+    return QRect(QPoint(x * pattern.multiplierX,
+                        y * pattern.multiplierY) + pattern.offset,
+                 pattern.mapSize);
+}
+
 void World::setMapRect(int mapIndex, const QRect &rect)
 {
+    if (mMapIndexValid)
+        removeFromMapIndex(mapIndex);
+
     maps[mapIndex].rect = rect;
+
+    if (mMapIndexValid)
+        insertIntoMapIndex(mapIndex);
 }
 
 void World::setGridSize(QSize size)
@@ -57,6 +79,9 @@ void World::setGridSize(QSize size)
 void World::removeMap(int mapIndex)
 {
     maps.removeAt(mapIndex);
+
+    // The indexes of the following maps have changed
+    invalidateMapIndex();
 }
 
 void World::addMap(const QString &fileName, const QRect &rect)
@@ -65,6 +90,9 @@ void World::addMap(const QString &fileName, const QRect &rect)
     entry.rect = rect;
     entry.fileName = fileName;
     maps.append(entry);
+
+    if (mMapIndexValid)
+        insertIntoMapIndex(maps.size() - 1);
 }
 
 int World::mapIndex(const QString &fileName) const
@@ -107,13 +135,8 @@ QRect World::mapRect(const QString &fileName) const
 
     for (const WorldPattern &pattern : patterns) {
         QRegularExpressionMatch match = pattern.regexp.match(fileName);
-        if (match.hasMatch()) {
-            const int x = match.capturedView(1).toInt();
-            const int y = match.capturedView(2).toInt();
-            return QRect(QPoint(x * pattern.multiplierX,
-                                y * pattern.multiplierY) + pattern.offset,
-                         pattern.mapSize);
-        }
+        if (match.hasMatch())
+            return patternMapRect(pattern, match);
     }
 
     return QRect();
@@ -121,42 +144,72 @@ QRect World::mapRect(const QString &fileName) const
 
 QVector<WorldMapEntry> World::allMaps() const
 {
-    QVector<WorldMapEntry> all(maps);
-
-    if (!patterns.isEmpty()) {
-        const QDir dir(QFileInfo(fileName).dir());
-        const QStringList entries = dir.entryList(QDir::Files | QDir::Readable);
-
-        for (const WorldPattern &pattern : patterns) {
-            for (const QString &fileName : entries) {
-                QRegularExpressionMatch match = pattern.regexp.match(fileName);
-                if (match.hasMatch()) {
-                    const int x = match.capturedView(1).toInt();
-                    const int y = match.capturedView(2).toInt();
-
-                    WorldMapEntry entry;
-                    entry.fileName = dir.filePath(fileName);
-                    entry.rect = QRect(QPoint(x * pattern.multiplierX,
-                                              y * pattern.multiplierY) + pattern.offset,
-                                       pattern.mapSize);
-                    all.append(entry);
-                }
-            }
-        }
-    }
-
-    return all;
+    return maps + patternMaps();
 }
 
+/**
+ * Returns the maps of which the rectangle intersects the given \a rect, in
+ * the same order as returned by allMaps().
+ *
+ * The maps are looked up using a grid of their rectangles, which is built on
+ * first use and updated as maps are added or moved.
+ */
 QVector<WorldMapEntry> World::mapsInRect(const QRect &rect) const
 {
-    QVector<WorldMapEntry> maps(allMaps());
+    if (rect.isEmpty())
+        return {};
+
+    if (!mMapIndexValid)
+        buildMapIndex();
+
+    QVector<int> indexes;
+
+    for (int index : std::as_const(mLargeMaps))
+        if (indexedMap(index).rect.intersects(rect))
+            indexes.append(index);
+
+    auto visitCell = [&] (const QVector<int> &cell) {
+        for (int index : cell)
+            if (indexedMap(index).rect.intersects(rect))
+                indexes.append(index);
+    };
+
+    const QRect range = cellRange(rect);
+    const qint64 cellCount = (qint64(range.right()) - range.left() + 1) *
+            (qint64(range.bottom()) - range.top() + 1);
+
+    if (cellCount > mMapCells.size()) {
+        // Cheaper to go over all the occupied cells
+        for (auto it = mMapCells.cbegin(), it_end = mMapCells.cend(); it != it_end; ++it) {
+            const int x = int(quint32(it.key() >> 32));
+            const int y = int(quint32(it.key()));
+            if (range.contains(x, y))
+                visitCell(it.value());
+        }
+    } else {
+        for (int y = range.top(); y <= range.bottom(); ++y) {
+            for (int x = range.left(); x <= range.right(); ++x) {
+                const auto it = mMapCells.constFind(cellKey(x, y));
+                if (it != mMapCells.constEnd())
+                    visitCell(it.value());
+            }
+        }
+    }
+
+    // Maps spanning multiple cells are found more than once
+    const int mapCount = maps.size();
+    auto order = [mapCount] (int index) {
+        return index >= 0 ? index : mapCount - 1 - index;
+    };
+    std::sort(indexes.begin(), indexes.end(), [&] (int a, int b) { return order(a) < order(b); });
+    indexes.erase(std::unique(indexes.begin(), indexes.end()), indexes.end());
 
-    maps.erase(std::remove_if(maps.begin(), maps.end(),
-                              [&](const WorldMapEntry &mapEntry) { return !mapEntry.rect.intersects(rect); }),
-               maps.end());
+    QVector<WorldMapEntry> result;
+    result.reserve(indexes.size());
+    for (int index : std::as_const(indexes))
+        result.append(indexedMap(index));
 
-    return maps;
+    return result;
 }
 
 QVector<WorldMapEntry> World::contextMaps(const QString &fileName) const
@@ -171,20 +224,170 @@ QString World::firstMap() const
     if (!maps.isEmpty())
         return maps.first().fileName;
 
-    if (!patterns.isEmpty()) {
-        const QDir dir(QFileInfo(fileName).dir());
-        const QStringList entries = dir.entryList(QDir::Files | QDir::Readable);
+    const auto &patternMaps = this->patternMaps();
+    if (!patternMaps.isEmpty())
+        return patternMaps.first().fileName;
+
+    return QString();
+}
+
+/**
+ * Looks again for the maps matching the patterns in the world's directory.
+ * Should be called when the contents of that directory have changed.
+ *
+ * Returns whether any maps were added or removed.
+ */
+bool World::refreshPatternMaps()
+{
+    if (!mPatternMapsValid)
+        return false;
+
+    const QVector<WorldMapEntry> previousMaps = std::move(mPatternMaps);
+    mPatternMaps.clear();
+    mPatternMapsValid = false;
+
+    const auto &patternMaps = this->patternMaps();
+    const bool changed = !std::equal(previousMaps.begin(), previousMaps.end(),
+                                     patternMaps.begin(), patternMaps.end(),
+                                     [] (const WorldMapEntry &a, const WorldMapEntry &b) {
+        return a.fileName == b.fileName;
+    });
+
+    if (changed)
+        invalidateMapIndex();
+
+    return changed;
+}
+
+const QVector<WorldMapEntry> &World::patternMaps() const
+{
+    if (mPatternMapsValid)
+        return mPatternMaps;
+
+    mPatternMapsValid = true;
+
+    if (patterns.isEmpty())
+        return mPatternMaps;
+
+    const QDir dir(QFileInfo(fileName).dir());
+    const QStringList entries = dir.entryList(QDir::Files | QDir::Readable);
 
-        for (const WorldPattern &pattern : patterns) {
-            for (const QString &fileName : entries) {
-                QRegularExpressionMatch match = pattern.regexp.match(fileName);
-                if (match.hasMatch())
-                    return dir.filePath(fileName);
+    for (const WorldPattern &pattern : patterns) {
+        for (const QString &fileName : entries) {
+            QRegularExpressionMatch match = pattern.regexp.match(fileName);
+            if (match.hasMatch()) {
+                WorldMapEntry entry;
+                entry.fileName = dir.filePath(fileName);
+                entry.rect = patternMapRect(pattern, match);
+                mPatternMaps.append(entry);
             }
         }
     }
 
-    return QString();
+    return mPatternMaps;
+}
+
+const WorldMapEntry &World::indexedMap(int index) const
+{
+    return index >= 0 ? maps.at(index) : mPatternMaps.at(-1 - index);
+}
+
+void World::buildMapIndex() const
+{
+    const auto &patternMaps = this->patternMaps();
+
+    mMapCells.clear();
+    mLargeMaps.clear();
+
+    // Base the cell size on the average map size
+    qint64 totalSize = 0;
+    for (const WorldMapEntry &entry : maps)
+        totalSize += qMax(entry.rect.width(), entry.rect.height());
+    for (const WorldMapEntry &entry : patternMaps)
+        totalSize += qMax(entry.rect.width(), entry.rect.height());
+
+    const qint64 mapCount = maps.size() + patternMaps.size();
+    mMapCellSize = int(qBound<qint64>(1, mapCount > 0 ? totalSize / mapCount : 1,
+                                      std::numeric_limits<int>::max()));
+    mMapIndexValid = true;
+
+    for (int i = 0; i < maps.size(); ++i)
+        insertIntoMapIndex(i);
+    for (int i = 0; i < patternMaps.size(); ++i)
+        insertIntoMapIndex(-1 - i);
+}
+
+void World::insertIntoMapIndex(int index) const
+{
+    const QRect &rect = indexedMap(index).rect;
+    if (rect.isEmpty())
+        return;     // never intersects anything
+
+    const QRect range = cellRange(rect);
+    const qint64 cellCount = (qint64(range.right()) - range.left() + 1) *
+            (qint64(range.bottom()) - range.top() + 1);
+
+    if (cellCount > MaxCellsPerMap) {
+        mLargeMaps.append(index);
+        return;
+    }
+
+    for (int y = range.top(); y <= range.bottom(); ++y)
+        for (int x = range.left(); x <= range.right(); ++x)
+            mMapCells[cellKey(x, y)].append(index);
+}
+
+void World::removeFromMapIndex(int index) const
+{
+    const QRect &rect = indexedMap(index).rect;
+    if (rect.isEmpty())
+        return;
+
+    const QRect range = cellRange(rect);
+    const qint64 cellCount = (qint64(range.right()) - range.left() + 1) *
+            (qint64(range.bottom()) - range.top() + 1);
+
+    if (cellCount > MaxCellsPerMap) {
+        mLargeMaps.removeOne(index);
+        return;
+    }
+
+    for (int y = range.top(); y <= range.bottom(); ++y) {
+        for (int x = range.left(); x <= range.right(); ++x) {
+            auto cell = mMapCells.find(cellKey(x, y));
+            if (cell == mMapCells.end())
+                continue;
+
+            cell->removeOne(index);
+            if (cell->isEmpty())
+                mMapCells.erase(cell);
+        }
+    }
+}
+
+void World::invalidateMapIndex() const
+{
+    mMapCells.clear();
+    mLargeMaps.clear();
+    mMapIndexValid = false;
+}
+
+QRect World::cellRange(const QRect &rect) const
+{
+    auto toCell = [this] (int coordinate) {
+        // Rounds towards negative infinity
+        if (coordinate >= 0)
+            return coordinate / mMapCellSize;
+        return -1 - (-(coordinate + 1) / mMapCellSize);
+    };
+
+    return QRect(QPoint(toCell(rect.left()), toCell(rect.top())),
+                 QPoint(toCell(rect.right()), toCell(rect.bottom())));
+}
+
+quint64 World::cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
 }
 
 void World::error(const QString &message) const
@@ -31,6 +31,7 @@
 #include "object.h"
 
 #include <QCoreApplication>
+#include <QHash>
 #include <QPoint>
 #include <QRect>
 #include <QRegularExpression>
@@ -94,6 +95,8 @@ public:
     QVector<WorldMapEntry> contextMaps(const QString &fileName) const;
     QString firstMap() const;
 
+    bool refreshPatternMaps();
+
     void error(const QString &message) const;
     void warning(const QString &message) const;
     void clearErrorsAndWarnings() const;
@@ -111,6 +114,29 @@ public:
                                        QString *errorString = nullptr);
     static bool save(World &world,
                      QString *errorString = nullptr);
+
+private:
+    const QVector<WorldMapEntry> &patternMaps() const;
+    const WorldMapEntry &indexedMap(int index) const;
+
+    void buildMapIndex() const;
+    void insertIntoMapIndex(int index) const;
+    void removeFromMapIndex(int index) const;
+    void invalidateMapIndex() const;
+    QRect cellRange(const QRect &rect) const;
+
+    static quint64 cellKey(int x, int y);
+
+    // Cached maps matching the patterns, found in the world's directory
+    mutable QVector<WorldMapEntry> mPatternMaps;
+    mutable bool mPatternMapsValid = false;
+
+    // Grid of the map rectangles, referring to maps by index. Negative
+    // indexes refer to mPatternMaps, as -1 - index.
+    mutable QHash<quint64, QVector<int>> mMapCells;
+    mutable QVector<int> mLargeMaps;
+    mutable int mMapCellSize = 0;
+    mutable bool mMapIndexValid = false;
 };
 
 } // namespace Tiled
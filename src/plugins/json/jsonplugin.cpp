@@ -21,6 +21,7 @@
 
 #include "jsonplugin.h"
 
+#include "jsonstreamreader.h"
 #include "maptovariantconverter.h"
 #include "varianttomapconverter.h"
 #include "savefile.h"
@@ -53,36 +54,38 @@ JsonMapFormat::JsonMapFormat(SubFormat subFormat, QObject *parent)
 std::unique_ptr<Tiled::Map> JsonMapFormat::read(const QString &fileName)
 {
     QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        mError = QCoreApplication::translate("File Errors", "Could not open file for reading.");
+    if (!file.open(QIODevice::ReadOnly)) {
+        mError.setLocalData(QCoreApplication::translate("File Errors", "Could not open file for reading."));
         return nullptr;
     }
 
-    QByteArray contents = file.readAll();
-    if (mSubFormat == JavaScript && contents.size() > 0 && contents[0] != '{') {
+    if (mSubFormat == JavaScript && !file.peek(1).startsWith('{')) {
         // Scan past JSONP prefix; look for an open curly at the start of the line
-        int i = contents.indexOf("\n{");
-        if (i > 0) {
-            contents.remove(0, i);
-            contents = contents.trimmed(); // potential trailing whitespace
-            if (contents.endsWith(';')) contents.chop(1);
-            if (contents.endsWith(')')) contents.chop(1);
+        while (!file.atEnd()) {
+            const qint64 lineStart = file.pos();
+            if (file.readLine().startsWith('{')) {
+                file.seek(lineStart);
+                break;
+            }
         }
     }
 
-    QJsonParseError error;
-    const QJsonDocument document = QJsonDocument::fromJson(contents, &error);
+    // The map is read without building a QJsonDocument first, and with the
+    // tile layer data read directly into lists of GIDs, to limit memory usage
+    JsonStreamReader reader(&file);
+    reader.setAllowTrailingData(mSubFormat == JavaScript);
+    const QVariant variant = reader.read();
 
-    if (error.error != QJsonParseError::NoError) {
-        mError = tr("Error parsing file: %1").arg(error.errorString());
+    if (reader.hasError()) {
+        mError.setLocalData(tr("Error parsing file: %1").arg(reader.errorString()));
         return nullptr;
     }
 
     Tiled::VariantToMapConverter converter;
-    auto map = converter.toMap(document.toVariant(), QFileInfo(fileName).dir());
+    auto map = converter.toMap(variant, QFileInfo(fileName).dir());
 
     if (!map)
-        mError = converter.errorString();
+        mError.setLocalData(converter.errorString());
 
     return map;
 }
@@ -94,29 +97,23 @@ bool JsonMapFormat::write(const Tiled::Map *map,
     Tiled::SaveFile file(fileName);
 
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        mError = QCoreApplication::translate("File Errors", "Could not open file for writing.");
+        mError.setLocalData(QCoreApplication::translate("File Errors", "Could not open file for writing."));
         return false;
     }
 
+    // Tile layer data is kept as lists of GIDs and the result is written
+    // directly to the file, to limit memory usage
     Tiled::MapToVariantConverter converter;
+    converter.setPackedTileData(true);
     QVariant variant = converter.toVariant(*map, QFileInfo(fileName).dir());
 
-    JsonWriter writer;
-    writer.setAutoFormatting(!options.testFlag(WriteMinimized));
-    writer.setAutoFormattingWrapArrayCount(map->infinite() ? map->chunkSize().width() : map->width());
-
-    if (!writer.stringify(variant)) {
-        // This can only happen due to coding error
-        mError = writer.errorString();
-        return false;
-    }
-
-    QTextStream out(file.device());
     if (mSubFormat == JavaScript) {
         // Trim and escape name
         JsonWriter nameWriter;
         QString baseName = QFileInfo(fileName).baseName();
         nameWriter.stringify(baseName);
+
+        QTextStream out(file.device());
         out << "(function(name,data){\n if(typeof onTileMapLoaded === 'undefined') {\n";
         out << "  if(typeof TileMaps === 'undefined') TileMaps = {};\n";
         out << "  TileMaps[name] = data;\n";
@@ -127,18 +124,27 @@ bool JsonMapFormat::write(const Tiled::Map *map,
         out << "  module.exports = data;\n";
         out << " }})(" << nameWriter.result() << ",\n";
     }
-    out << writer.result();
-    if (mSubFormat == JavaScript) {
-        out << ");";
+
+    JsonWriter writer;
+    writer.setAutoFormatting(!options.testFlag(WriteMinimized));
+    writer.setAutoFormattingWrapArrayCount(map->infinite() ? map->chunkSize().width() : map->width());
+
+    if (!writer.stringify(variant, file.device())) {
+        // This can only happen due to coding error or a write error
+        mError.setLocalData(writer.errorString());
+        return false;
     }
 
+    if (mSubFormat == JavaScript)
+        file.device()->write(");");
+
     if (file.error() != QFileDevice::NoError) {
-        mError = tr("Error while writing file:\n%1").arg(file.errorString());
+        mError.setLocalData(tr("Error while writing file:\n%1").arg(file.errorString()));
         return false;
     }
 
     if (!file.commit()) {
-        mError = file.errorString();
+        mError.setLocalData(file.errorString());
         return false;
     }
 
@@ -202,7 +208,7 @@ bool JsonMapFormat::supportsFile(const QString &fileName) const
 
 QString JsonMapFormat::errorString() const
 {
-    return mError;
+    return mError.localData();
 }
 
 
@@ -29,6 +29,7 @@
 #include "tilesetformat.h"
 
 #include <QObject>
+#include <QThreadStorage>
 
 namespace Tiled {
 class Map;
@@ -69,8 +70,11 @@ public:
     QString shortName() const override;
     QString errorString() const override;
 
+    Capabilities capabilities() const override { return ReadWrite | ReadInBackground; }
+
 protected:
-    QString mError;
+    // Per thread, since maps may be read from multiple threads at once
+    QThreadStorage<QString> mError;
     SubFormat mSubFormat;
 };
 
@@ -0,0 +1,542 @@
+/*
+ * JSON Tiled Plugin
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jsonstreamreader.h"
+
+#include <QIODevice>
+
+#include <limits>
+
+namespace Json {
+
+static const int BufferSize = 256 * 1024;
+
+// Same limit as used by QJsonDocument
+static const int MaxDepth = 1024;
+
+JsonStreamReader::JsonStreamReader(QIODevice *device)
+    : mDevice(device)
+{
+}
+
+/**
+ * Sets whether anything other than whitespace is allowed after the JSON
+ * value. This is needed when reading JSON embedded in JavaScript.
+ */
+void JsonStreamReader::setAllowTrailingData(bool allow)
+{
+    mAllowTrailingData = allow;
+}
+
+/**
+ * Reads a JSON value from the device. Returns an invalid QVariant in case
+ * of an error, in which case errorString() describes the problem.
+ */
+QVariant JsonStreamReader::read()
+{
+    QVariant result = parseValue(Root);
+
+    if (!hasError() && !mAllowTrailingData && skipWhitespace())
+        setError(tr("garbage at the end of the document"));
+
+    if (hasError())
+        return QVariant();
+
+    return result;
+}
+
+QString JsonStreamReader::errorString() const
+{
+    return tr("%1 at offset %2").arg(mError).arg(mErrorOffset);
+}
+
+QVariant JsonStreamReader::parseValue(Context context)
+{
+    if (++mDepth > MaxDepth) {
+        setError(tr("too deeply nested document"));
+        return QVariant();
+    }
+
+    QVariant result;
+
+    skipWhitespace();
+
+    switch (peek()) {
+    case '{':
+        result = parseObject(context);
+        break;
+    case '[':
+        result = context == TileData ? parseTileData() : parseArray(context);
+        break;
+    case '"': {
+        // Base64 encoded tile data is kept as-is, to avoid a conversion
+        const QByteArray string = parseString();
+        if (context == TileData)
+            result = string;
+        else
+            result = QString::fromUtf8(string);
+        break;
+    }
+    case '-':
+    case '0': case '1': case '2': case '3': case '4':
+    case '5': case '6': case '7': case '8': case '9':
+        result = parseNumber();
+        break;
+    case 't':
+    case 'f':
+    case 'n':
+        result = parseLiteral();
+        break;
+    case -1:
+        setError(tr("unexpected end of file"));
+        break;
+    default:
+        setError(tr("illegal value"));
+        break;
+    }
+
+    --mDepth;
+    return result;
+}
+
+QVariant JsonStreamReader::parseObject(Context context)
+{
+    next();     // '{'
+
+    QVariantMap map;
+
+    skipWhitespace();
+    if (peek() == '}') {
+        next();
+        return map;
+    }
+
+    while (true) {
+        skipWhitespace();
+        if (peek() != '"') {
+            setError(tr("object is missing a name"));
+            return QVariant();
+        }
+
+        const QString key = QString::fromUtf8(parseString());
+        if (hasError() || !expect(':'))
+            return QVariant();
+
+        QVariant value = parseValue(memberContext(context, key));
+        if (hasError())
+            return QVariant();
+
+        map.insert(key, value);
+
+        skipWhitespace();
+        const int c = next();
+        if (c == ',')
+            continue;
+        if (c == '}')
+            break;
+
+        setError(tr("unterminated object"));
+        return QVariant();
+    }
+
+    return map;
+}
+
+QVariant JsonStreamReader::parseArray(Context context)
+{
+    next();     // '['
+
+    Context elementContext = Value;
+    if (context == Layers)
+        elementContext = Layer;
+    else if (context == Chunks)
+        elementContext = Chunk;
+
+    QVariantList list;
+
+    skipWhitespace();
+    if (peek() == ']') {
+        next();
+        return list;
+    }
+
+    if (!parseArrayElements(list, elementContext))
+        return QVariant();
+
+    return list;
+}
+
+/**
+ * Parses the remaining elements of an array, up to and including the
+ * closing bracket, appending them to \a list.
+ */
+bool JsonStreamReader::parseArrayElements(QVariantList &list, Context context)
+{
+    while (true) {
+        list.append(parseValue(context));
+        if (hasError())
+            return false;
+
+        skipWhitespace();
+        const int c = next();
+        if (c == ',')
+            continue;
+        if (c == ']')
+            return true;
+
+        setError(tr("unterminated array"));
+        return false;
+    }
+}
+
+/**
+ * Parses the "data" array of a tile layer or chunk directly into a list of
+ * GIDs. Falls back to a regular list in case the array contains anything
+ * other than GIDs.
+ */
+QVariant JsonStreamReader::parseTileData()
+{
+    next();     // '['
+
+    QVector<unsigned> gids;
+
+    skipWhitespace();
+    if (peek() == ']') {
+        next();
+        return QVariant::fromValue(gids);
+    }
+
+    while (true) {
+        skipWhitespace();
+
+        QVariant value;
+        const int c = peek();
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            value = parseNumber();
+            if (hasError())
+                return QVariant();
+
+            if (value.userType() == QMetaType::LongLong) {
+                const qlonglong gid = value.toLongLong();
+                if (gid >= 0 && gid <= std::numeric_limits<unsigned>::max()) {
+                    gids.append(unsigned(gid));
+                    value = QVariant();
+                }
+            }
+        } else {
+            value = parseValue(Value);
+            if (hasError())
+                return QVariant();
+        }
+
+        if (value.isValid()) {
+            // Not a GID, so continue with a regular list
+            QVariantList list;
+            list.reserve(gids.size() + 1);
+            for (const unsigned gid : std::as_const(gids))
+                list.append(qlonglong(gid));
+            list.append(value);
+
+            skipWhitespace();
+            const int end = next();
+            if (end == ']')
+                return list;
+            if (end != ',' || !parseArrayElements(list, Value)) {
+                if (!hasError())
+                    setError(tr("unterminated array"));
+                return QVariant();
+            }
+
+            return list;
+        }
+
+        skipWhitespace();
+        const int separator = next();
+        if (separator == ',')
+            continue;
+        if (separator == ']')
+            break;
+
+        setError(tr("unterminated array"));
+        return QVariant();
+    }
+
+    return QVariant::fromValue(gids);
+}
+
+/**
+ * Parses a string, returning it encoded as UTF-8.
+ */
+QByteArray JsonStreamReader::parseString()
+{
+    next();     // '"'
+
+    QByteArray result;
+
+    while (true) {
+        if (mPos >= mBuffer.size() && !fillBuffer()) {
+            setError(tr("unterminated string"));
+            return QByteArray();
+        }
+
+        // Copy characters that need no special handling in one go
+        const char *begin = mBuffer.constData() + mPos;
+        const char *end = mBuffer.constData() + mBuffer.size();
+        const char *p = begin;
+        while (p < end && *p != '"' && *p != '\\' && uchar(*p) >= 0x20)
+            ++p;
+
+        result.append(begin, p - begin);
+        mPos += p - begin;
+
+        if (p == end)
+            continue;
+
+        const int c = next();
+        if (c == '"')
+            break;
+
+        if (c != '\\') {
+            setError(tr("illegal value"));
+            return QByteArray();
+        }
+
+        switch (next()) {
+        case '"':   result.append('"'); break;
+        case '\\':  result.append('\\'); break;
+        case '/':   result.append('/'); break;
+        case 'b':   result.append('\b'); break;
+        case 'f':   result.append('\f'); break;
+        case 'n':   result.append('\n'); break;
+        case 'r':   result.append('\r'); break;
+        case 't':   result.append('\t'); break;
+        case 'u': {
+            char16_t codeUnits[2];
+            qsizetype count = 1;
+
+            if (!parseHexDigits(codeUnits[0]))
+                return QByteArray();
+
+            // Combine surrogate pairs
+            if (QChar::isHighSurrogate(codeUnits[0]) && peek() == '\\') {
+                next();
+                if (next() != 'u' || !parseHexDigits(codeUnits[1])) {
+                    if (!hasError())
+                        setError(tr("invalid escape sequence"));
+                    return QByteArray();
+                }
+                count = 2;
+            }
+
+            result.append(QString::fromUtf16(codeUnits, count).toUtf8());
+            break;
+        }
+        default:
+            setError(tr("invalid escape sequence"));
+            return QByteArray();
+        }
+    }
+
+    return result;
+}
+
+bool JsonStreamReader::parseHexDigits(char16_t &codeUnit)
+{
+    codeUnit = 0;
+
+    for (int i = 0; i < 4; ++i) {
+        const int c = next();
+        int digit;
+        if (c >= '0' && c <= '9')
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else {
+            setError(tr("invalid escape sequence"));
+            return false;
+        }
+
+        codeUnit = char16_t(codeUnit << 4 | digit);
+    }
+
+    return true;
+}
+
+/**
+ * Parses a number. Integers are returned as qlonglong when they fit, like
+ * QJsonValue::toVariant() does, and other numbers are returned as double.
+ */
+QVariant JsonStreamReader::parseNumber()
+{
+    char number[64];
+    int length = 0;
+    bool isInteger = true;
+
+    while (true) {
+        const int c = peek();
+        if ((c >= '0' && c <= '9') || c == '-' || c == '+') {
+            // part of the number
+        } else if (c == '.' || c == 'e' || c == 'E') {
+            isInteger = false;
+        } else {
+            break;
+        }
+
+        if (length == int(sizeof(number))) {
+            setError(tr("illegal number"));
+            return QVariant();
+        }
+
+        number[length++] = char(c);
+        next();
+    }
+
+    const QByteArray text = QByteArray::fromRawData(number, length);
+    bool ok;
+
+    if (isInteger) {
+        const qlonglong value = text.toLongLong(&ok);
+        if (ok)
+            return value;
+    }
+
+    const double value = text.toDouble(&ok);
+    if (!ok) {
+        setError(tr("illegal number"));
+        return QVariant();
+    }
+
+    return value;
+}
+
+QVariant JsonStreamReader::parseLiteral()
+{
+    char literal[5];
+    int length = 0;
+
+    while (length < int(sizeof(literal))) {
+        const int c = peek();
+        if (c < 'a' || c > 'z')
+            break;
+        literal[length++] = char(next());
+    }
+
+    const QByteArray text = QByteArray::fromRawData(literal, length);
+    if (text == "true")
+        return true;
+    if (text == "false")
+        return false;
+    if (text == "null")
+        return QVariant::fromValue(nullptr);
+
+    setError(tr("illegal value"));
+    return QVariant();
+}
+
+/**
+ * Determines which part of a map is being read when reading the value of
+ * the member with the given \a key, in an object read in \a context.
+ */
+JsonStreamReader::Context JsonStreamReader::memberContext(Context context,
+                                                          const QString &key)
+{
+    switch (context) {
+    case Root:
+        if (key == QLatin1String("layers"))
+            return Layers;
+        break;
+    case Layer:
+        if (key == QLatin1String("layers"))
+            return Layers;
+        if (key == QLatin1String("chunks"))
+            return Chunks;
+        if (key == QLatin1String("data"))
+            return TileData;
+        break;
+    case Chunk:
+        if (key == QLatin1String("data"))
+            return TileData;
+        break;
+    default:
+        break;
+    }
+
+    return Value;
+}
+
+bool JsonStreamReader::fillBuffer()
+{
+    mBufferOffset += mBuffer.size();
+    mBuffer = mDevice->read(BufferSize);
+    mPos = 0;
+    return !mBuffer.isEmpty();
+}
+
+int JsonStreamReader::peek()
+{
+    if (mPos >= mBuffer.size() && !fillBuffer())
+        return -1;
+    return uchar(mBuffer.at(mPos));
+}
+
+int JsonStreamReader::next()
+{
+    const int c = peek();
+    if (c != -1)
+        ++mPos;
+    return c;
+}
+
+/**
+ * Skips any whitespace. Returns whether there is more data.
+ */
+bool JsonStreamReader::skipWhitespace()
+{
+    while (true) {
+        const int c = peek();
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+            return c != -1;
+        ++mPos;
+    }
+}
+
+bool JsonStreamReader::expect(char c)
+{
+    skipWhitespace();
+    if (next() == c)
+        return true;
+
+    setError(tr("missing name separator"));
+    return false;
+}
+
+void JsonStreamReader::setError(const QString &error)
+{
+    // Only the first error is relevant
+    if (hasError())
+        return;
+
+    mError = error;
+    mErrorOffset = offset();
+}
+
+} // namespace Json
@@ -0,0 +1,98 @@
+/*
+ * JSON Tiled Plugin
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QString>
+#include <QVariant>
+
+class QIODevice;
+
+namespace Json {
+
+/**
+ * Reads a JSON map from a device, producing the same QVariant tree as
+ * QJsonDocument::toVariant() would, but without first reading the whole
+ * file and building a QJsonDocument.
+ *
+ * Tile layer data is handled specially, to avoid storing each tile as a
+ * separate QVariant. Numeric "data" arrays of tile layers and their chunks
+ * are read into a QVector<unsigned> of GIDs, and base64-encoded data is kept
+ * as QByteArray. Both are understood by the VariantToMapConverter.
+ */
+class JsonStreamReader
+{
+    Q_DECLARE_TR_FUNCTIONS(JsonStreamReader)
+
+public:
+    explicit JsonStreamReader(QIODevice *device);
+
+    void setAllowTrailingData(bool allow);
+
+    QVariant read();
+
+    bool hasError() const { return !mError.isEmpty(); }
+    QString errorString() const;
+    qint64 errorOffset() const { return mErrorOffset; }
+
+private:
+    enum Context {
+        Value,
+        Root,
+        Layers,
+        Layer,
+        Chunks,
+        Chunk,
+        TileData
+    };
+
+    QVariant parseValue(Context context);
+    QVariant parseObject(Context context);
+    QVariant parseArray(Context context);
+    bool parseArrayElements(QVariantList &list, Context context);
+    QVariant parseTileData();
+    QByteArray parseString();
+    QVariant parseNumber();
+    QVariant parseLiteral();
+    bool parseHexDigits(char16_t &codeUnit);
+
+    static Context memberContext(Context context, const QString &key);
+
+    bool fillBuffer();
+    int peek();
+    int next();
+    qint64 offset() const { return mBufferOffset + mPos; }
+    bool skipWhitespace();
+    bool expect(char c);
+    void setError(const QString &error);
+
+    QIODevice *mDevice;
+    QByteArray mBuffer;
+    int mPos = 0;
+    qint64 mBufferOffset = 0;
+    int mDepth = 0;
+    bool mAllowTrailingData = false;
+    QString mError;
+    qint64 mErrorOffset = 0;
+};
+
+} // namespace Json
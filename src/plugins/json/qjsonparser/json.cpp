@@ -10,8 +10,12 @@
 #include "json.h"
 
 #include <QDebug>
+#include <QIODevice>
 #include <qnumeric.h>
 
+// When writing to a device, the result is flushed once it reaches this size
+static const int FlushSize = 64 * 1024;
+
 /*!
   \class JsonWriter
   \reentrant
@@ -158,20 +162,23 @@ void JsonWriter::stringify(const QVariant &variant, int depth)
         m_result += QLatin1Char('[');
         QVariantList list = variant.toList();
         for (int i = 0; i < list.count(); i++) {
-            if (i != 0) {
-                m_result += QLatin1Char(',');
-                if (m_autoFormatting) {
-                    if (m_autoFormattingWrapArrayCount && i % m_autoFormattingWrapArrayCount == 0) {
-                        m_result += QLatin1Char('\n');
-                        m_result += indent;
-                    } else {
-                        m_result += QLatin1Char(' ');
-                    }
-                }
-            }
+            appendArraySeparator(i, indent);
             stringify(list[i], depth+1);
         }
         m_result += QLatin1Char(']');
+    } else if (variant.userType() == qMetaTypeId<QVector<unsigned>>()) {
+        // Compact representation of tile layer data
+        const QString indent = m_autoFormattingIndent.repeated(depth);
+        const QVector<unsigned> numbers = variant.value<QVector<unsigned>>();
+        m_result += QLatin1Char('[');
+        for (int i = 0; i < numbers.count(); i++) {
+            appendArraySeparator(i, indent);
+            m_result += QString::number(numbers[i]);
+
+            if (m_device && m_result.size() >= FlushSize)
+                flush();
+        }
+        m_result += QLatin1Char(']');
     } else if (variant.type() == QVariant::Map) {
         const QString indent = m_autoFormattingIndent.repeated(depth);
         QVariantMap map = variant.toMap();
@@ -236,6 +243,38 @@ void JsonWriter::stringify(const QVariant &variant, int depth)
         qWarning() << "JsonWriter::stringify - " << msg;
         m_result += QLatin1String("null");
     }
+
+    if (m_device && m_result.size() >= FlushSize)
+        flush();
+}
+
+/*! \internal
+  Inserts the separator before the array element at \a index.
+ */
+void JsonWriter::appendArraySeparator(int index, const QString &indent)
+{
+    if (index == 0)
+        return;
+
+    m_result += QLatin1Char(',');
+    if (m_autoFormatting) {
+        if (m_autoFormattingWrapArrayCount && index % m_autoFormattingWrapArrayCount == 0) {
+            m_result += QLatin1Char('\n');
+            m_result += indent;
+        } else {
+            m_result += QLatin1Char(' ');
+        }
+    }
+}
+
+/*! \internal
+  Writes the pending result to the device as UTF-8.
+ */
+void JsonWriter::flush()
+{
+    if (m_device->write(m_result.toUtf8()) == -1 && m_errorString.isEmpty())
+        m_errorString = m_device->errorString();
+    m_result.clear();
 }
 
 /*!
@@ -285,6 +324,25 @@ bool JsonWriter::stringify(const QVariant &var)
     return m_errorString.isEmpty();
 }
 
+/*!
+  Converts the variant \a var into JSON and writes it to \a device, encoded as
+  UTF-8.
+
+  Unlike stringify(const QVariant &), the result is written out as it is
+  produced, rather than being kept in memory. Hence result() will be empty
+  afterwards.
+ */
+bool JsonWriter::stringify(const QVariant &var, QIODevice *device)
+{
+    m_errorString.clear();
+    m_result.clear();
+    m_device = device;
+    stringify(var, 0 /* depth */);
+    flush();
+    m_device = nullptr;
+    return m_errorString.isEmpty();
+}
+
 /*!
   Returns the result of the last stringify() call.
 
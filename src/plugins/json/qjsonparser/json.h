@@ -12,6 +12,8 @@
 #include <QByteArray>
 #include <QVariant>
 
+class QIODevice;
+
 class JsonWriter
 {
 public:
@@ -19,6 +21,7 @@ public:
     ~JsonWriter();
 
     bool stringify(const QVariant &variant);
+    bool stringify(const QVariant &variant, QIODevice *device);
 
     QString result() const;
 
@@ -34,7 +37,10 @@ public:
 
 private:
     void stringify(const QVariant &variant, int depth);
+    void appendArraySeparator(int index, const QString &indent);
+    void flush();
 
+    QIODevice *m_device = nullptr;
     QString m_result;
     QString m_errorString;
     bool m_autoFormatting = false;
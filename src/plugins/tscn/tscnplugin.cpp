@@ -965,7 +965,7 @@ bool TscnPlugin::write(const Map *map, const QString &fileName, Options options)
             auto bounds = layer->bounds();
             for (int y = bounds.y(); y < bounds.y() + bounds.height(); ++y) {
                 for (int x = bounds.x(); x < bounds.x() + bounds.width(); ++x) {
-                    auto& cell = layer->cellAt(x, y);
+                    const auto &cell = layer->cellAt(x, y);
 
                     if (!cell.isEmpty()) {
                         auto resPath = imageSourceToRes(cell.tile()->tileset(), assetInfo.resRoot);
@@ -255,21 +255,14 @@ ObjectGroup *AbstractObjectTool::currentObjectGroup() const
 QList<MapObject*> AbstractObjectTool::mapObjectsAt(const QPointF &pos) const
 {
     const QTransform viewTransform = mapScene()->views().first()->transform();
-    const QList<QGraphicsItem *> items = mapScene()->items(pos,
-                                                           Qt::IntersectsItemShape,
-                                                           Qt::DescendingOrder,
-                                                           viewTransform);
 
     QList<MapObject*> objectList;
 
-    for (auto item : items) {
-        if (!item->isEnabled())
-            continue;
-
-        MapObjectItem *objectItem = qgraphicsitem_cast<MapObjectItem*>(item);
-        if (objectItem && objectItem->mapObject()->objectGroup()->isUnlocked())
+    mapScene()->visitMapObjectItemsAt(pos, viewTransform, [&] (MapObjectItem *objectItem) {
+        if (objectItem->isEnabled() && objectItem->mapObject()->objectGroup()->isUnlocked())
             objectList.append(objectItem->mapObject());
-    }
+        return true;
+    });
 
     filterMapObjects(objectList);
     return objectList;
@@ -278,41 +271,40 @@ QList<MapObject*> AbstractObjectTool::mapObjectsAt(const QPointF &pos) const
 MapObject *AbstractObjectTool::topMostMapObjectAt(const QPointF &pos) const
 {
     const QTransform viewTransform = mapScene()->views().first()->transform();
-    const QList<QGraphicsItem *> items = mapScene()->items(pos,
-                                                           Qt::IntersectsItemShape,
-                                                           Qt::DescendingOrder,
-                                                           viewTransform);
     const SelectionBehavior behavior = selectionBehavior();
 
+    MapObject *found = nullptr;
     MapObject *topMost = nullptr;
 
-    for (QGraphicsItem *item : items) {
-        if (!item->isEnabled())
-            continue;
-
-        MapObjectItem *objectItem = qgraphicsitem_cast<MapObjectItem*>(item);
-        if (!objectItem)
-            continue;
+    mapScene()->visitMapObjectItemsAt(pos, viewTransform, [&] (MapObjectItem *objectItem) {
+        if (!objectItem->isEnabled())
+            return true;
 
         auto mapObject = objectItem->mapObject();
         if (!mapObject->objectGroup()->isUnlocked())
-            continue;
+            return true;
 
-        // Return immediately when we don't care if the layer is selected
-        if (behavior == AllLayers)
-            return mapObject;
+        // Stop immediately when we don't care if the layer is selected
+        if (behavior == AllLayers) {
+            found = mapObject;
+            return false;
+        }
 
         // Return this object instead of the top-most one if it is from a selected layer
         for (Layer *layer : mapDocument()->selectedLayers()) {
-            if (layer->isParentOrSelf(mapObject->objectGroup()))
-                return mapObject;
+            if (layer->isParentOrSelf(mapObject->objectGroup())) {
+                found = mapObject;
+                return false;
+            }
         }
 
         if (!topMost && behavior != SelectedLayers)
             topMost = mapObject;
-    }
 
-    return topMost;
+        return true;
+    });
+
+    return found ? found : topMost;
 }
 
 void AbstractObjectTool::duplicateObjects()
@@ -100,7 +100,7 @@ void AbstractTileSelectionTool::mousePressed(QGraphicsSceneMouseEvent *event)
         }
 
         // Right mouse button clears selection
-        changeSelectedArea(QRegion());
+        changeSelectedArea(TileRegion());
         return;
     }
 
@@ -184,22 +184,23 @@ void AbstractTileSelectionTool::applySelectionPreview()
     if (!document)
         return;
 
-    auto selectedArea = document->selectedArea();
+    const TileRegion preview(selectionPreviewRegion());
+    TileRegion selectedArea = document->selectedTiles();
 
     switch (mSelectionMode) {
-    case Replace:   selectedArea = selectionPreviewRegion(); break;
-    case Add:       selectedArea += selectionPreviewRegion(); break;
-    case Subtract:  selectedArea -= selectionPreviewRegion(); break;
-    case Intersect: selectedArea &= selectionPreviewRegion(); break;
+    case Replace:   selectedArea = preview; break;
+    case Add:       selectedArea |= preview; break;
+    case Subtract:  selectedArea -= preview; break;
+    case Intersect: selectedArea &= preview; break;
     }
 
     changeSelectedArea(selectedArea);
 }
 
-void AbstractTileSelectionTool::changeSelectedArea(const QRegion &region)
+void AbstractTileSelectionTool::changeSelectedArea(const TileRegion &region)
 {
     MapDocument *document = mapDocument();
-    if (!document || document->selectedArea() == region)
+    if (!document || document->selectedTiles() == region)
         return;
 
     QUndoCommand *cmd = new ChangeSelectedArea(document, region);
@@ -29,6 +29,7 @@ class QActionGroup;
 namespace Tiled {
 
 class MapDocument;
+class TileRegion;
 
 class AbstractTileSelectionTool : public AbstractTileTool
 {
@@ -66,7 +67,7 @@ protected:
     void setSelectionPreview(const QRegion &region);
     void applySelectionPreview();
 
-    void changeSelectedArea(const QRegion &region);
+    void changeSelectedArea(const TileRegion &region);
 
     void updateBrushVisibility() override;
 
@@ -157,7 +157,7 @@ void AbstractTileTool::keyPressed(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Escape) {
         MapDocument *document = mapDocument();
-        if (document && !document->selectedArea().isEmpty()) {
+        if (document && !document->selectedTiles().isEmpty()) {
             QUndoCommand *cmd = new ChangeSelectedArea(document, QRegion());
             document->undoStack()->push(cmd);
             return;
@@ -37,28 +37,36 @@
 #include <QtConcurrent>
 
 #include <algorithm>
+#include <limits>
+#include <optional>
 #include <random>
 
 namespace Tiled {
 
+// Number of rows of a rule's match region that are matched as one work item
+static const int matchBandHeight = 32;
+
+// Positions at which each tile occurs on an input layer
+using TilePositions = QHash<QPair<const Tileset*, int>, QVector<QPoint>>;
+
 static int wrap(int value, int bound)
 {
     return (value % bound + bound) % bound;
 }
 
-static const Cell &getWrappedCell(int x, int y, const TileLayer &tileLayer)
+static Cell getWrappedCell(int x, int y, const TileLayer &tileLayer)
 {
     return tileLayer.cellAt(wrap(x, tileLayer.width()),
                             wrap(y, tileLayer.height()));
 }
 
-static const Cell &getBoundCell(int x, int y, const TileLayer &tileLayer)
+static Cell getBoundCell(int x, int y, const TileLayer &tileLayer)
 {
     return tileLayer.cellAt(qBound(0, x, tileLayer.width() - 1),
                             qBound(0, y, tileLayer.height() - 1));
 }
 
-static const Cell &getCell(int x, int y, const TileLayer &tileLayer)
+static Cell getCell(int x, int y, const TileLayer &tileLayer)
 {
     return tileLayer.cellAt(x, y);
 }
@@ -130,8 +138,11 @@ struct ApplyContext
     // These regions store which parts of the map have already been altered by
     // exactly this rule. We store all the altered parts to make sure there are
     // no overlaps of the same rule applied to (neighbouring) places.
-    QHash<const Layer*, QRegion> appliedRegions;
+    QHash<const Layer*, TileRegion> appliedRegions;
 
+    // Collects the applied region, which is only converted to a QRegion once
+    // all rules have been applied
+    TileRegion appliedTiles;
     QRegion *appliedRegion;
 };
 
@@ -809,6 +820,53 @@ bool AutoMapper::compileRule(QVector<RuleInputSet> &inputSets,
     return !inputSets.isEmpty();
 }
 
+/**
+ * Discards the cached compiled rules when they do not apply to the input
+ * layers of the given \a context. Needs to be called before matching any
+ * rules.
+ */
+void AutoMapper::updateCompiledRules(const AutoMappingContext &context) const
+{
+    QStringList missingInputLayers;
+    for (const QString &name : std::as_const(mRuleMapSetup.mInputLayerNames))
+        if (!context.inputLayers.contains(name))
+            missingInputLayers.append(name);
+    missingInputLayers.sort();
+
+    if (mCompiledRules.size() == mRules.size() && mCompiledMissingInputLayers == missingInputLayers)
+        return;
+
+    mCompiledRules.clear();
+    mCompiledRules.resize(mRules.size());
+    mCompiledMissingInputLayers = missingInputLayers;
+}
+
+/**
+ * Returns the compiled input sets of the given \a rule, referring to the
+ * input layers of the given \a context. Returns an empty list when the rule
+ * can never match.
+ *
+ * The rule is only compiled the first time. Since each rule has its own
+ * cache entry, this function may be called for different rules in parallel.
+ */
+QVector<RuleInputSet> AutoMapper::compiledInputSets(const Rule &rule,
+                                                    const AutoMappingContext &context) const
+{
+    CompiledRule &compiled = mCompiledRules[&rule - mRules.data()];
+    if (!compiled.compiled) {
+        compileRule(compiled.inputSets, rule, context);
+        compiled.compiled = true;
+    }
+
+    // Refer to the input layers of the current target map
+    QVector<RuleInputSet> inputSets = compiled.inputSets;
+    for (RuleInputSet &inputSet : inputSets)
+        for (RuleInputLayer &layer : inputSet.layers)
+            layer.targetLayer = context.inputLayers.value(layer.layerName, &dummy);
+
+    return inputSets;
+}
+
 /**
  * After optimization, only one of \a anyOf or \a noneOf can contain any cells.
  *
@@ -887,6 +945,7 @@ bool AutoMapper::compileInputSet(RuleInputSet &index,
 
         RuleInputLayer layer;
         layer.targetLayer = context.inputLayers.value(conditions.layerName, &dummy);
+        layer.layerName = conditions.layerName;
 
         forEachPointInRegion(inputRegion, [&] (int x, int y) {
             anyOf.clear();
@@ -1117,6 +1176,8 @@ void AutoMapper::autoMap(const QRegion &where,
 
     ApplyContext applyContext { appliedRegion };
 
+    updateCompiledRules(context);
+
     if (mOptions.matchInOrder) {
         for (const Rule &rule : mRules) {
             if (rule.options.disabled)
@@ -1128,21 +1189,120 @@ void AutoMapper::autoMap(const QRegion &where,
             applyContext.appliedRegions.clear();
         }
     } else {
-        auto collectMatches = [&] (const Rule &rule) {
+        struct PreparedRule
+        {
+            QVector<RuleInputSet> inputSets;
+            QRegion matchRegion;
+            QVector<QPoint> candidates;
+            bool useCandidates = false;
+        };
+
+        struct MatchJob
+        {
+            int ruleIndex;
+            QRect rect;     // rect of the rule's match region
+            int top;        // first row of the band to match
+            int bottom;     // last row of the band to match
+        };
+
+        // Index where the tiles occur on the input layers, so that rules can
+        // be matched only at the offsets where their anchor tile occurs. This
+        // is not possible when cells are read from wrapped or clamped
+        // positions.
+        QHash<const TileLayer*, TilePositions> tilePositions;
+        const bool useAnchors = get == &getCell;
+
+        if (useAnchors) {
+            int maxRuleWidth = 0;
+            int maxRuleHeight = 0;
+            for (const Rule &rule : mRules) {
+                const QRect bounds = rule.inputRegion.boundingRect();
+                maxRuleWidth = qMax(maxRuleWidth, bounds.width());
+                maxRuleHeight = qMax(maxRuleHeight, bounds.height());
+            }
+
+            // Only the cells that could be read while matching are indexed
+            QRegion indexRegion;
+            for (const QRect &rect : applyRegion)
+                indexRegion |= rect.adjusted(-maxRuleWidth, -maxRuleHeight, maxRuleWidth, maxRuleHeight);
+
+            QVector<const TileLayer*> inputLayers;
+            for (const TileLayer *tileLayer : std::as_const(context.inputLayers))
+                if (!inputLayers.contains(tileLayer))
+                    inputLayers.append(tileLayer);
+
+            const auto positions = QtConcurrent::blockingMapped<QVector<TilePositions>>(inputLayers, [&] (const TileLayer *tileLayer) {
+                return indexTilePositions(tileLayer, indexRegion);
+            });
+
+            for (int i = 0; i < inputLayers.size(); ++i)
+                tilePositions.insert(inputLayers.at(i), positions.at(i));
+        }
+
+        auto prepare = [&] (const Rule &rule) {
+            PreparedRule prepared;
+            if (rule.options.disabled || (!rule.outputSet && rule.outputSets.isEmpty()))
+                return prepared;
+
+            prepared.inputSets = compiledInputSets(rule, context);
+            if (prepared.inputSets.isEmpty())
+                return prepared;
+
+            prepared.matchRegion = ruleMatchRegion(rule, applyRegion, context);
+
+            // Only use the anchor offsets when there are fewer of them than
+            // positions in the match region
+            if (useAnchors) {
+                qsizetype area = 0;
+                for (const QRect &rect : prepared.matchRegion)
+                    area += qsizetype(rect.width()) * rect.height();
+
+                prepared.useCandidates = anchorOffsets(prepared.inputSets, tilePositions,
+                                                       area / 2, prepared.candidates);
+                if (!prepared.useCandidates)
+                    prepared.candidates.clear();
+            }
+
+            return prepared;
+        };
+        const auto preparedRules = QtConcurrent::blockingMapped<QVector<PreparedRule>>(mRules, prepare);
+
+        // Split the match region of each rule into bands, so that rule sets
+        // with only a few heavy rules are also matched in parallel. The jobs
+        // are in matching order, so concatenating their matches results in
+        // the same positions as matching each rule serially.
+        QVector<MatchJob> jobs;
+        for (int i = 0; i < preparedRules.size(); ++i) {
+            for (const QRect &rect : preparedRules[i].matchRegion) {
+                for (int top = rect.top(); top <= rect.bottom(); top += matchBandHeight)
+                    jobs.append({ i, rect, top, qMin(top + matchBandHeight - 1, rect.bottom()) });
+            }
+        }
+
+        auto collectMatches = [&] (const MatchJob &job) {
+            const PreparedRule &prepared = preparedRules[job.ruleIndex];
             QVector<QPoint> positions;
-            if (!rule.options.disabled)
-                matchRule(rule, applyRegion, get, [&] (QPoint pos) { positions.append(pos); }, context);
+            matchRuleInRect(mRules[job.ruleIndex],
+                            prepared.inputSets,
+                            job.rect, job.top, job.bottom, get,
+                            [&] (QPoint pos) { positions.append(pos); },
+                            prepared.useCandidates ? &prepared.candidates : nullptr);
             return positions;
         };
-        auto result = QtConcurrent::blockingMapped(mRules, collectMatches);
+        const auto result = QtConcurrent::blockingMapped<QVector<QVector<QPoint>>>(jobs, collectMatches);
 
-        for (size_t i = 0; i < mRules.size(); ++i) {
+        int job = 0;
+        for (int i = 0; i < preparedRules.size(); ++i) {
             const Rule &rule = mRules[i];
-            for (const QPoint pos : result[i])
-                applyRule(rule, pos, applyContext, context);
+            for (; job < jobs.size() && jobs[job].ruleIndex == i; ++job)
+                for (const QPoint pos : result[job])
+                    applyRule(rule, pos, applyContext, context);
             applyContext.appliedRegions.clear();
         }
     }
+
+    if (appliedRegion)
+        *appliedRegion |= applyContext.appliedTiles.toRegion();
 }
 
 static bool cellMatches(const MatchCell &matchCell, const Cell &cell)
@@ -1200,6 +1360,118 @@ static bool matchRuleAtOffset(const QVector<RuleInputSet> &inputSets, QPoint off
                        [=] (const RuleInputSet &index) { return matchInputIndex(index, offset, getCell); });
 }
 
+static bool isBefore(QPoint a, QPoint b)
+{
+    return a.y() < b.y() || (a.y() == b.y() && a.x() < b.x());
+}
+
+/**
+ * Records at which positions within \a region each tile occurs on the given
+ * \a tileLayer.
+ */
+static TilePositions indexTilePositions(const TileLayer *tileLayer, const QRegion &region)
+{
+    TilePositions positions;
+
+    for (const QRect &rect : region.intersected(tileLayer->localBounds())) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y) {
+            for (int x = rect.left(); x <= rect.right(); ++x) {
+                const Cell cell = tileLayer->cellAt(x, y);
+                if (!cell.isEmpty())
+                    positions[qMakePair(cell.tileset(), cell.tileId())].append(QPoint(x, y));
+            }
+        }
+    }
+
+    return positions;
+}
+
+/**
+ * Determines the offsets at which any of the given \a inputSets could match,
+ * based on where the tiles occur that are required at the most selective
+ * position of each input set (its anchor). The offsets are sorted by row.
+ *
+ * Returns false when an input set does not require a specific tile at any
+ * position, or when there would be more than \a maxCount offsets to check.
+ */
+static bool anchorOffsets(const QVector<RuleInputSet> &inputSets,
+                          const QHash<const TileLayer*, TilePositions> &tilePositions,
+                          qsizetype maxCount,
+                          QVector<QPoint> &offsets)
+{
+    static const TilePositions noTiles;
+
+    struct Anchor
+    {
+        const TilePositions *tiles;
+        QPoint pos;
+        qsizetype firstCell;
+        qsizetype cellCount;
+    };
+
+    qsizetype totalCount = 0;
+
+    for (const RuleInputSet &inputSet : inputSets) {
+        std::optional<Anchor> best;
+        qsizetype bestCount = 0;
+
+        qsizetype nextPos = 0;
+        qsizetype nextCell = 0;
+
+        for (const RuleInputLayer &layer : inputSet.layers) {
+            const auto it = tilePositions.constFind(layer.targetLayer);
+            const TilePositions &tiles = it != tilePositions.constEnd() ? *it : noTiles;
+
+            for (auto p = std::exchange(nextPos, nextPos + layer.posCount); p < nextPos; ++p) {
+                const RuleInputLayerPos &pos = inputSet.positions[p];
+                const auto firstCell = std::exchange(nextCell, nextCell + pos.anyCount + pos.noneCount);
+
+                // Only positions that require a specific tile can be anchors
+                if (pos.anyCount == 0)
+                    continue;
+
+                qsizetype count = 0;
+                bool required = true;
+
+                for (auto c = firstCell; c < firstCell + pos.anyCount; ++c) {
+                    const MatchCell &cell = inputSet.cells[c];
+                    if (cell.isEmpty()) {
+                        required = false;
+                        break;
+                    }
+                    count += tiles.value(qMakePair(cell.tileset(), cell.tileId())).size();
+                }
+
+                if (required && (!best || count < bestCount)) {
+                    best = Anchor { &tiles, QPoint(pos.x, pos.y), firstCell, pos.anyCount };
+                    bestCount = count;
+                }
+            }
+        }
+
+        if (!best)
+            return false;
+
+        totalCount += bestCount;
+        if (totalCount > maxCount)
+            return false;
+
+        const Anchor &anchor = *best;
+        const MatchCell *cells = inputSet.cells.constData() + anchor.firstCell;
+
+        for (qsizetype c = 0; c < anchor.cellCount; ++c) {
+            const auto positions = anchor.tiles->value(qMakePair(cells[c].tileset(), cells[c].tileId()));
+            for (const QPoint position : positions)
+                offsets.append(position - anchor.pos);
+        }
+    }
+
+    std::sort(offsets.begin(), offsets.end(), isBefore);
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    return true;
+}
+
 void AutoMapper::matchRule(const Rule &rule,
                            const QRegion &matchRegion,
                            GetCell getCell,
@@ -1209,10 +1481,23 @@ void AutoMapper::matchRule(const Rule &rule,
     if (!rule.outputSet && rule.outputSets.isEmpty())
         return;
 
-    QVector<RuleInputSet> inputSets;
-    if (!compileRule(inputSets, rule, context))
+    const QVector<RuleInputSet> inputSets = compiledInputSets(rule, context);
+    if (inputSets.isEmpty())
         return;
 
+    const QRegion region = ruleMatchRegion(rule, matchRegion, context);
+    for (const QRect &rect : region)
+        matchRuleInRect(rule, inputSets, rect, rect.top(), rect.bottom(), getCell, matched);
+}
+
+/**
+ * Returns the region of offsets at which the \a rule needs to be matched, in
+ * order to cover the given \a matchRegion.
+ */
+QRegion AutoMapper::ruleMatchRegion(const Rule &rule,
+                                    const QRegion &matchRegion,
+                                    const AutoMappingContext &context) const
+{
     const QRect inputBounds = rule.inputRegion.boundingRect();
 
     // This is really the rule size - 1, since when applying the rule we will
@@ -1220,34 +1505,86 @@ void AutoMapper::matchRule(const Rule &rule,
     const int ruleWidth = inputBounds.right() - inputBounds.left();
     const int ruleHeight = inputBounds.bottom() - inputBounds.top();
 
-    QRegion ruleMatchRegion;
+    QRegion region;
 
     for (const QRect &rect : matchRegion) {
         // Expand each rect, making sure that there is at least one tile
         // overlap with the rule at all sides.
-        ruleMatchRegion |= rect.adjusted(-ruleWidth, -ruleHeight, 0, 0);
+        region |= rect.adjusted(-ruleWidth, -ruleHeight, 0, 0);
     }
 
     // When we're not matching a rule outside the map, we reduce the region in
     // in which it is applied accordingly.
     if (!mOptions.matchOutsideMap && !context.targetMap->infinite()) {
-        ruleMatchRegion &= QRect(0, 0,
-                                 context.targetMap->width() - ruleWidth,
-                                 context.targetMap->height() - ruleHeight);
+        region &= QRect(0, 0,
+                        context.targetMap->width() - ruleWidth,
+                        context.targetMap->height() - ruleHeight);
     }
 
-    for (const QRect &rect : ruleMatchRegion) {
-        const int startX = rect.left() + (rect.left() + rule.options.offsetX) % rule.options.modX;
-        const int startY = rect.top() + (rect.top() + rule.options.offsetY) % rule.options.modY;
+    return region;
+}
 
-        for (int y = startY; y <= rect.bottom(); y += rule.options.modY) {
-            for (int x = startX; x <= rect.right(); x += rule.options.modX) {
-                if (rule.options.skipChance != 0.0 && randomDouble() < rule.options.skipChance)
-                    continue;
+/**
+ * Matches the compiled \a inputSets of the \a rule at the offsets within the
+ * rows \a top to \a bottom of \a rect, which is part of the rule's match
+ * region.
+ *
+ * When \a candidates is given, only those offsets are checked. They need to
+ * be sorted by row.
+ *
+ * Calls \a matched for each matching location.
+ */
+void AutoMapper::matchRuleInRect(const Rule &rule,
+                                 const QVector<RuleInputSet> &inputSets,
+                                 const QRect &rect, int top, int bottom,
+                                 GetCell getCell,
+                                 const std::function<void (QPoint)> &matched,
+                                 const QVector<QPoint> *candidates)
+{
+    const int startX = rect.left() + (rect.left() + rule.options.offsetX) % rule.options.modX;
+    int startY = rect.top() + (rect.top() + rule.options.offsetY) % rule.options.modY;
 
-                if (matchRuleAtOffset(inputSets, QPoint(x, y), getCell))
-                    matched(QPoint(x, y));
-            }
+    // When matching only a band of the rect, continue the rows of the rect
+    if (startY < top) {
+        const int modY = static_cast<int>(rule.options.modY);
+        startY += (top - startY + modY - 1) / modY * modY;
+    }
+
+    if (candidates) {
+        const int modX = static_cast<int>(rule.options.modX);
+        const int modY = static_cast<int>(rule.options.modY);
+
+        auto it = std::lower_bound(candidates->begin(), candidates->end(),
+                                   QPoint(std::numeric_limits<int>::min(), startY), isBefore);
+        const auto end = std::upper_bound(it, candidates->end(),
+                                          QPoint(std::numeric_limits<int>::max(), bottom), isBefore);
+
+        for (; it != end; ++it) {
+            const QPoint offset = *it;
+
+            // Only consider the offsets that would be visited by the full scan
+            if (offset.x() < startX || offset.x() > rect.right())
+                continue;
+            if ((offset.x() - startX) % modX || (offset.y() - startY) % modY)
+                continue;
+
+            if (rule.options.skipChance != 0.0 && randomDouble() < rule.options.skipChance)
+                continue;
+
+            if (matchRuleAtOffset(inputSets, offset, getCell))
+                matched(offset);
+        }
+
+        return;
+    }
+
+    for (int y = startY; y <= bottom; y += rule.options.modY) {
+        for (int x = startX; x <= rect.right(); x += rule.options.modX) {
+            if (rule.options.skipChance != 0.0 && randomDouble() < rule.options.skipChance)
+                continue;
+
+            if (matchRuleAtOffset(inputSets, QPoint(x, y), getCell))
+                matched(QPoint(x, y));
         }
     }
 }
@@ -1265,7 +1602,7 @@ void AutoMapper::applyRule(const Rule &rule, QPoint pos,
         randomOutputSet = &rule.outputSets.pick();
 
     if (rule.options.noOverlappingOutput) {
-        QHash<const Layer*, QRegion> ruleRegionInLayer;
+        QHash<const Layer*, TileRegion> ruleRegionInLayer;
 
         if (rule.outputSet)
             collectLayerOutputRegions(rule, *rule.outputSet, context, ruleRegionInLayer);
@@ -1279,9 +1616,9 @@ void AutoMapper::applyRule(const Rule &rule, QPoint pos,
 
             auto base = it.base();
             const Layer *layer = base.key();
-            QRegion &region = base.value();
+            TileRegion &region = base.value();
 
-            region.translate(pos.x(), pos.y());
+            region.translate(pos);
 
             if (applyContext.appliedRegions[layer].intersects(region))
                 return; // Don't apply the rule
@@ -1293,7 +1630,7 @@ void AutoMapper::applyRule(const Rule &rule, QPoint pos,
 
             auto base = it.base();
             const Layer *layer = base.key();
-            const QRegion &region = base.value();
+            const TileRegion &region = base.value();
 
             applyContext.appliedRegions[layer] |= region;
         }
@@ -1306,7 +1643,7 @@ void AutoMapper::applyRule(const Rule &rule, QPoint pos,
         copyMapRegion(rule, pos, *randomOutputSet, context);
 
     if (applyContext.appliedRegion)
-        *applyContext.appliedRegion |= rule.outputRegion.translated(pos.x(), pos.y());
+        applyContext.appliedTiles.add(rule.outputRegion.translated(pos.x(), pos.y()));
 }
 
 /**
@@ -1319,7 +1656,7 @@ void AutoMapper::applyRule(const Rule &rule, QPoint pos,
 void AutoMapper::collectLayerOutputRegions(const Rule &rule,
                                            const RuleOutputSet &outputSet,
                                            AutoMappingContext &context,
-                                           QHash<const Layer*, QRegion> &ruleRegionInLayer) const
+                                           QHash<const Layer*, TileRegion> &ruleRegionInLayer) const
 {
     // TODO: Very slow to re-calculate the entire region for each rule output
     // layer here, each time a rule has a match. These regions are also
@@ -1327,15 +1664,15 @@ void AutoMapper::collectLayerOutputRegions(const Rule &rule,
 
     for (const auto &tileOutput : outputSet.tileOutputs) {
         const Layer *targetLayer = context.outputTileLayers.value(tileOutput.name);
-        QRegion &outputLayerRegion = ruleRegionInLayer[targetLayer];
-        outputLayerRegion |= tileOutput.tileLayer->region() & rule.outputRegion;
+        TileRegion &outputLayerRegion = ruleRegionInLayer[targetLayer];
+        outputLayerRegion |= TileRegion(tileOutput.tileLayer->region() & rule.outputRegion);
     }
 
     for (const auto &objectOutput : outputSet.objectOutputs) {
         const Layer *targetLayer = context.outputTileLayers.value(objectOutput.name);
-        QRegion &outputLayerRegion = ruleRegionInLayer[targetLayer];
+        TileRegion &outputLayerRegion = ruleRegionInLayer[targetLayer];
         for (const MapObject *mapObject : objectOutput.objects)
-            outputLayerRegion |= objectTileRect(*mRulesMapRenderer, *mapObject);
+            outputLayerRegion.add(objectTileRect(*mRulesMapRenderer, *mapObject));
     }
 }
 
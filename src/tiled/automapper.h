@@ -25,6 +25,7 @@
 #include "randompicker.h"
 #include "tilededitor_global.h"
 #include "tilelayer.h"
+#include "tileregion.h"
 #include "tileset.h"
 
 #include <QCoreApplication>
@@ -171,6 +172,7 @@ struct RuleInputLayer
 {
     const TileLayer *targetLayer = nullptr;   // reference to layer in target map
     int posCount = 0;
+    QString layerName;                        // name of the layer in target map
 };
 
 struct RuleInputLayerPos
@@ -321,7 +323,7 @@ public:
         int autoMappingRadius = 0;
     };
 
-    using GetCell = const Cell &(*)(int x, int y, const TileLayer &tileLayer);
+    using GetCell = Cell (*)(int x, int y, const TileLayer &tileLayer);
 
     /**
      * Constructs an AutoMapper.
@@ -381,6 +383,12 @@ private:
         RandomPicker<RuleOutputSet> outputSets;
     };
 
+    struct CompiledRule
+    {
+        QVector<RuleInputSet> inputSets;
+        bool compiled = false;
+    };
+
     void setupRuleMapProperties();
     void setupInputLayerProperties(InputLayer &inputLayer);
     static void setupOutputSetProperties(OutputSet &outputSet, RuleMapSetup &setup);
@@ -398,6 +406,9 @@ private:
     bool compileRule(QVector<RuleInputSet> &inputSets,
                      const Rule &rule,
                      const AutoMappingContext &context) const;
+    void updateCompiledRules(const AutoMappingContext &context) const;
+    QVector<RuleInputSet> compiledInputSets(const Rule &rule,
+                                            const AutoMappingContext &context) const;
     bool compileInputSet(RuleInputSet &index,
                          const InputSet &inputSet,
                          const QRegion &inputRegion,
@@ -446,6 +457,17 @@ private:
                    const std::function<void (QPoint)> &matched,
                    const AutoMappingContext &context) const;
 
+    QRegion ruleMatchRegion(const Rule &rule,
+                            const QRegion &matchRegion,
+                            const AutoMappingContext &context) const;
+
+    static void matchRuleInRect(const Rule &rule,
+                                const QVector<RuleInputSet> &inputSets,
+                                const QRect &rect, int top, int bottom,
+                                GetCell getCell,
+                                const std::function<void (QPoint)> &matched,
+                                const QVector<QPoint> *candidates = nullptr);
+
     /**
      * Applies the given \a rule at the given \a pos.
      */
@@ -455,7 +477,7 @@ private:
     void collectLayerOutputRegions(const Rule &rule,
                                    const RuleOutputSet &outputSet,
                                    AutoMappingContext &context,
-                                   QHash<const Layer *, QRegion> &ruleRegionInLayer) const;
+                                   QHash<const Layer *, TileRegion> &ruleRegionInLayer) const;
 
     void addWarning(const QString &text,
                     std::function<void()> callback = std::function<void()>());
@@ -473,6 +495,15 @@ private:
      */
     std::vector<Rule> mRules;
 
+    /**
+     * Caches the compiled input sets of each rule, since compiling them is
+     * relatively expensive. The compiled rules only depend on which input
+     * layers are missing from the target map, so they are kept as long as
+     * the same input layers are missing.
+     */
+    mutable std::vector<CompiledRule> mCompiledRules;
+    mutable QStringList mCompiledMissingInputLayers;
+
     Options mOptions;
 
     /**
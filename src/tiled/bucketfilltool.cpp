@@ -106,10 +106,7 @@ void BucketFillTool::tilePositionChanged(QPoint tilePos)
             }
 
             if (computeRegion) {
-                const auto condition = [&](const Cell &cell) {
-                    return mMatchCells.contains(cell);
-                };
-                mFillRegion = regionComputer.computePaintableFillRegion(tilePos, condition);
+                mFillRegion = regionComputer.computePaintableFillRegion(tilePos, mMatchCells);
             } else {
                 mFillRegion = QRegion();
             }
@@ -29,6 +29,13 @@ using namespace Tiled;
 ChangeSelectedArea::ChangeSelectedArea(MapDocument *mapDocument,
                                        const QRegion &newSelection,
                                        QUndoCommand *parent)
+    : ChangeSelectedArea(mapDocument, TileRegion(newSelection), parent)
+{
+}
+
+ChangeSelectedArea::ChangeSelectedArea(MapDocument *mapDocument,
+                                       const TileRegion &newSelection,
+                                       QUndoCommand *parent)
     : QUndoCommand(QCoreApplication::translate("Undo Commands",
                                                "Change Selection"),
                    parent)
@@ -49,7 +56,7 @@ void ChangeSelectedArea::redo()
 
 void ChangeSelectedArea::swapSelection()
 {
-    const QRegion oldSelection = mMapDocument->selectedArea();
-    mMapDocument->setSelectedArea(mSelection);
+    const TileRegion oldSelection = mMapDocument->selectedTiles();
+    mMapDocument->setSelectedTiles(mSelection);
     mSelection = oldSelection;
 }
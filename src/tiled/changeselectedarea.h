@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "tileregion.h"
 #include "undocommands.h"
 
 #include <QRegion>
@@ -39,6 +40,9 @@ public:
     ChangeSelectedArea(MapDocument *mapDocument,
                        const QRegion &selection,
                        QUndoCommand *parent = nullptr);
+    ChangeSelectedArea(MapDocument *mapDocument,
+                       const TileRegion &selection,
+                       QUndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
@@ -49,7 +53,7 @@ private:
     void swapSelection();
 
     MapDocument *mMapDocument;
-    QRegion mSelection;
+    TileRegion mSelection;
 };
 
 } // namespace Tiled
@@ -55,19 +55,32 @@
 #include <QDialogButtonBox>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QMenu>
 #include <QMessageBox>
+#include <QProgressBar>
 #include <QScrollBar>
 #include <QStackedLayout>
 #include <QTabBar>
 #include <QUndoGroup>
 #include <QUndoStack>
 #include <QVBoxLayout>
+#include <QtConcurrent>
 
 using namespace Tiled;
 
+namespace {
+
+struct ReadMapResult
+{
+    std::unique_ptr<Map> map;
+    QString error;
+};
+
+} // anonymous namespace
+
 
 DocumentManager *DocumentManager::mInstance;
 
@@ -92,6 +105,8 @@ DocumentManager::DocumentManager(QObject *parent)
     , mFileChangedWarning(new FileChangedWarning(mWidget))
     , mBrokenLinksModel(new BrokenLinksModel(this))
     , mBrokenLinksWidget(new BrokenLinksWidget(mBrokenLinksModel, mWidget))
+    , mLoadingIndicator(new QWidget(mWidget))
+    , mLoadingLabel(new QLabel(mLoadingIndicator))
     , mMapEditor(nullptr) // todo: look into removing this
     , mUndoGroup(new QUndoGroup(this))
     , mFileSystemWatcher(new FileSystemWatcher(this))
@@ -113,6 +128,16 @@ DocumentManager::DocumentManager(QObject *parent)
 
     mFileChangedWarning->setVisible(false);
 
+    auto loadingProgress = new QProgressBar(mLoadingIndicator);
+    loadingProgress->setRange(0, 0);    // busy indicator
+    loadingProgress->setTextVisible(false);
+    loadingProgress->setMaximumWidth(Utils::dpiScaled(120));
+
+    auto loadingLayout = new QHBoxLayout(mLoadingIndicator);
+    loadingLayout->addWidget(mLoadingLabel, 1);
+    loadingLayout->addWidget(loadingProgress);
+    mLoadingIndicator->setVisible(false);
+
     connect(mFileChangedWarning, &FileChangedWarning::reload, this, &DocumentManager::reloadCurrentDocument);
     connect(mFileChangedWarning, &FileChangedWarning::ignore, this, &DocumentManager::hideChangedWarning);
 
@@ -123,6 +148,7 @@ DocumentManager::DocumentManager(QObject *parent)
     vertical->addWidget(mTabBar);
     vertical->addWidget(mFileChangedWarning);
     vertical->addWidget(mBrokenLinksWidget);
+    vertical->addWidget(mLoadingIndicator);
     vertical->setContentsMargins(0, 0, 0, 0);
     vertical->setSpacing(0);
 
@@ -289,6 +315,11 @@ DocumentManager::DocumentManager(QObject *parent)
 
 DocumentManager::~DocumentManager()
 {
+    // Background reads can't be canceled, but they need to finish before the
+    // formats and tilesets they use go away
+    for (const BackgroundLoad &load : std::as_const(mBackgroundLoads))
+        load.future.waitForFinished();
+
     // All documents should be closed gracefully beforehand
     Q_ASSERT(mDocuments.isEmpty());
     Q_ASSERT(mTilesetDocumentsModel->rowCount() == 0);
@@ -630,21 +661,24 @@ static bool isDocumentChangedOnDisk(Document *document)
     return document->changedOnDisk();
 }
 
+static FileFormat *findReadableFormat(const QString &fileName)
+{
+    // Try to find a plugin that implements support for this format
+    return PluginManager::find<FileFormat>([&](FileFormat *format) {
+        return format->hasCapabilities(FileFormat::Read) && format->supportsFile(fileName);
+    });
+}
+
 DocumentPtr DocumentManager::loadDocument(const QString &fileName,
                                           FileFormat *fileFormat,
                                           QString *error)
 {
     // Try to find it in already loaded documents
-    QString canonicalFilePath = QFileInfo(fileName).canonicalFilePath();
-    if (Document *doc = mDocumentByFileName.value(canonicalFilePath))
-        return doc->sharedFromThis();
+    if (DocumentPtr document = loadedDocument(fileName))
+        return document;
 
-    if (!fileFormat) {
-        // Try to find a plugin that implements support for this format
-        fileFormat = PluginManager::find<FileFormat>([&](FileFormat *format) {
-            return format->hasCapabilities(FileFormat::Read) && format->supportsFile(fileName);
-        });
-    }
+    if (!fileFormat)
+        fileFormat = findReadableFormat(fileName);
 
     if (!fileFormat) {
         if (error)
@@ -668,6 +702,115 @@ DocumentPtr DocumentManager::loadDocument(const QString &fileName,
     return document;
 }
 
+/**
+ * Returns the document for the given file when it is already loaded, or null
+ * otherwise.
+ */
+DocumentPtr DocumentManager::loadedDocument(const QString &fileName) const
+{
+    const QString canonicalFilePath = QFileInfo(fileName).canonicalFilePath();
+    if (Document *doc = mDocumentByFileName.value(canonicalFilePath))
+        return doc->sharedFromThis();
+    return DocumentPtr();
+}
+
+/**
+ * Loads the given file on a worker thread, to keep the UI responsive while
+ * reading large maps. This includes loading the external tilesets and their
+ * images.
+ *
+ * The \a callback is called from the event loop once loading finished,
+ * unless the \a context has been destroyed by then. When loading failed,
+ * the document is null and the \a error is passed instead. Loading the same
+ * file multiple times at once only reads it once.
+ *
+ * Files in formats that can't be read in the background, tilesets and
+ * already loaded files are loaded immediately, but the callback is still
+ * called from the event loop.
+ */
+void DocumentManager::loadDocumentInBackground(const QString &fileName,
+                                               FileFormat *fileFormat,
+                                               QObject *context,
+                                               const LoadCallback &callback)
+{
+    Q_ASSERT(context);
+
+    const QString canonicalFilePath = QFileInfo(fileName).canonicalFilePath();
+
+    auto it = mBackgroundLoads.find(canonicalFilePath);
+    if (it != mBackgroundLoads.end()) {
+        it->callbacks.append({ context, callback });
+        return;
+    }
+
+    if (!fileFormat)
+        fileFormat = findReadableFormat(fileName);
+
+    auto mapFormat = qobject_cast<MapFormat*>(fileFormat);
+
+    if (!mapFormat || !mapFormat->hasCapabilities(FileFormat::ReadInBackground) ||
+            canonicalFilePath.isEmpty() || mDocumentByFileName.contains(canonicalFilePath)) {
+        QString error;
+        const DocumentPtr document = loadDocument(fileName, fileFormat, &error);
+        QMetaObject::invokeMethod(context, [=] { callback(document, error); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+
+    BackgroundLoad &load = mBackgroundLoads[canonicalFilePath];
+    load.fileName = fileName;
+    load.callbacks.append({ context, callback });
+
+    auto watcher = new QFutureWatcher<ReadMapResult>(this);
+
+    connect(watcher, &QFutureWatcherBase::finished, this, [=] {
+        ReadMapResult result = watcher->future().takeResult();
+        watcher->deleteLater();
+
+        const BackgroundLoad load = mBackgroundLoads.take(canonicalFilePath);
+        updateLoadingIndicator();
+
+        DocumentPtr document;
+
+        // The file may have been loaded in another way in the meantime
+        if (DocumentPtr loaded = loadedDocument(canonicalFilePath)) {
+            document = loaded;
+            result.error.clear();
+        } else if (result.map) {
+            document = MapDocument::fromLoadedMap(std::move(result.map),
+                                                  load.fileName, mapFormat);
+        }
+
+        for (const auto &[callbackContext, loadCallback] : load.callbacks)
+            if (callbackContext)
+                loadCallback(document, result.error);
+    });
+
+    const QFuture<ReadMapResult> future = QtConcurrent::run([fileName, mapFormat] {
+        ReadMapResult result;
+        result.map = mapFormat->read(fileName);
+        if (!result.map)
+            result.error = mapFormat->errorString();
+        return result;
+    });
+
+    load.future = future;
+    watcher->setFuture(future);
+
+    updateLoadingIndicator();
+}
+
+void DocumentManager::updateLoadingIndicator()
+{
+    QStringList fileNames;
+    for (const BackgroundLoad &load : std::as_const(mBackgroundLoads))
+        fileNames.append(QFileInfo(load.fileName).fileName());
+    fileNames.sort();
+
+    mLoadingLabel->setText(tr("Loading %1...").arg(fileNames.join(QStringLiteral(", "))));
+    mLoadingIndicator->setVisible(!fileNames.isEmpty());
+}
+
 /**
  * Save the given document with the given file name.
  *
@@ -24,6 +24,7 @@
 #include "mapdocument.h"
 #include "tilesetdocument.h"
 
+#include <QFuture>
 #include <QHash>
 #include <QIcon>
 #include <QList>
@@ -32,6 +33,9 @@
 #include <QPointer>
 #include <QVector>
 
+#include <functional>
+
+class QLabel;
 class QTabWidget;
 class QUndoGroup;
 class QStackedLayout;
@@ -110,6 +114,15 @@ public:
     DocumentPtr loadDocument(const QString &fileName,
                              FileFormat *fileFormat = nullptr,
                              QString *error = nullptr);
+    DocumentPtr loadedDocument(const QString &fileName) const;
+
+    using LoadCallback = std::function<void(const DocumentPtr &document,
+                                            const QString &error)>;
+
+    void loadDocumentInBackground(const QString &fileName,
+                                  FileFormat *fileFormat,
+                                  QObject *context,
+                                  const LoadCallback &callback);
 
     bool saveDocument(Document *document);
     bool saveDocument(Document *document, const QString &fileName);
@@ -228,6 +241,15 @@ private:
     void registerDocument(Document *document);
     void unregisterDocument(Document *document);
 
+    void updateLoadingIndicator();
+
+    struct BackgroundLoad
+    {
+        QString fileName;
+        QVector<QPair<QPointer<QObject>, LoadCallback>> callbacks;
+        QFuture<void> future;
+    };
+
     QIcon mLockedIcon;
 
     QVector<DocumentPtr> mDocuments;
@@ -240,6 +262,8 @@ private:
     FileChangedWarning *mFileChangedWarning;
     BrokenLinksModel *mBrokenLinksModel;
     BrokenLinksWidget *mBrokenLinksWidget;
+    QWidget *mLoadingIndicator;
+    QLabel *mLoadingLabel;
     QStackedLayout *mEditorStack;
     MapEditor *mMapEditor;
 
@@ -248,6 +272,7 @@ private:
     QUndoGroup *mUndoGroup;
     FileSystemWatcher *mFileSystemWatcher;
     QHash<QString, Document*> mDocumentByFileName;
+    QHash<QString, BackgroundLoad> mBackgroundLoads;   // by canonical path
 
     static DocumentManager *mInstance;
 
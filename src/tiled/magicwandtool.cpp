@@ -54,11 +54,7 @@ void MagicWandTool::tilePositionChanged(QPoint tilePos)
     if (!mMatchCells.contains(targetCell))
         mMatchCells.append(targetCell);
 
-    const auto condition = [&](const Cell &cell) {
-        return mMatchCells.contains(cell);
-    };
-
-    setSelectionPreview(tilePainter.computeFillRegion(tilePos, condition));
+    setSelectionPreview(tilePainter.computeFillRegion(tilePos, mMatchCells));
 }
 
 void MagicWandTool::languageChanged()
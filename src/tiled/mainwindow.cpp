@@ -970,7 +970,7 @@ void MainWindow::dropEvent(QDropEvent *e)
         if (localFile.isEmpty())
             continue;
 
-        openFile(localFile);
+        openFile(localFile, nullptr, true);
     }
 }
 
@@ -1033,7 +1033,8 @@ void MainWindow::initializeSession()
         restoreSession();
 }
 
-bool MainWindow::openFile(const QString &fileName, FileFormat *fileFormat)
+bool MainWindow::openFile(const QString &fileName, FileFormat *fileFormat,
+                          bool inBackground)
 {
     if (fileName.isEmpty())
         return false;
@@ -1059,7 +1060,7 @@ bool MainWindow::openFile(const QString &fileName, FileFormat *fileFormat)
 
             // Try to open the first map in the world, if the current map
             // isn't already part of this world.
-            return openFile(worldDocument->world()->firstMap());
+            return openFile(worldDocument->world()->firstMap(), nullptr, inBackground);
         }
     }
 
@@ -1067,9 +1068,23 @@ bool MainWindow::openFile(const QString &fileName, FileFormat *fileFormat)
     if (mDocumentManager->switchToDocument(fileName))
         return true;
 
+    if (inBackground) {
+        mDocumentManager->loadDocumentInBackground(fileName, fileFormat, this,
+                                                   [=] (const DocumentPtr &document, const QString &error) {
+            addLoadedDocument(fileName, document, error);
+        });
+        return true;
+    }
+
     QString error;
     DocumentPtr document = mDocumentManager->loadDocument(fileName, fileFormat, &error);
+    return addLoadedDocument(fileName, document, error);
+}
 
+bool MainWindow::addLoadedDocument(const QString &fileName,
+                                   const DocumentPtr &document,
+                                   const QString &error)
+{
     if (!document) {
         // HACK: Templates can't open as documents, but we can instead show
         // them in the Template Editor.
@@ -1084,6 +1099,10 @@ bool MainWindow::openFile(const QString &fileName, FileFormat *fileFormat)
         return false;
     }
 
+    // It may have been opened while it was loading in the background
+    if (mDocumentManager->switchToDocument(document.data()))
+        return true;
+
     mDocumentManager->addDocument(document);
 
     if (auto mapDocument = qobject_cast<MapDocument*>(document.data())) {
@@ -1126,7 +1145,7 @@ void MainWindow::openFileDialog()
     lastUsedOpenFilter = selectedFilter;
 
     for (const QString &fileName : fileNames)
-        openFile(fileName, fileFormat);
+        openFile(fileName, fileFormat, true);
 }
 
 void MainWindow::openFileInProject()
@@ -2102,7 +2121,7 @@ void MainWindow::openRecentFile()
 {
     QAction *action = qobject_cast<QAction *>(sender());
     if (action)
-        openFile(action->data().toString());
+        openFile(action->data().toString(), nullptr, true);
 }
 
 void MainWindow::reopenClosedFile()
@@ -2110,7 +2129,7 @@ void MainWindow::reopenClosedFile()
     const auto &recentFiles = Session::current().recentFiles;
     for (const QString &file : recentFiles) {
         if (mDocumentManager->findDocument(file) == -1) {
-            openFile(file);
+            openFile(file, nullptr, true);
             break;
         }
     }
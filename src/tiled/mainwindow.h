@@ -92,9 +92,14 @@ public:
      * When a \a format is given, it is used to open the file. Otherwise, a
      * format is searched using MapFormat::supportsFile.
      *
-     * @return whether the file was successfully opened
+     * When \a inBackground is set, maps are read on a worker thread and the
+     * document is added once it has been loaded.
+     *
+     * @return whether the file was successfully opened, or whether loading
+     *         was started when loading in the background
      */
-    bool openFile(const QString &fileName, FileFormat *fileFormat = nullptr);
+    bool openFile(const QString &fileName, FileFormat *fileFormat = nullptr,
+                  bool inBackground = false);
 
     WorldDocument *createNewWorld(const QString &suggestedFileName = QString());
 
@@ -182,6 +187,9 @@ private:
     void openForum();
     void showDonationPopup();
     void aboutTiled();
+    bool addLoadedDocument(const QString &fileName,
+                           const DocumentPtr &document,
+                           const QString &error);
     void openRecentFile();
     void reopenClosedFile();
     void openRecentProject();
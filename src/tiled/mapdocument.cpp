@@ -229,6 +229,17 @@ MapDocumentPtr MapDocument::load(const QString &fileName,
         return MapDocumentPtr();
     }
 
+    return fromLoadedMap(std::move(map), fileName, format);
+}
+
+/**
+ * Returns a MapDocument instance for a \a map that was read from the given
+ * \a fileName using the given \a format.
+ */
+MapDocumentPtr MapDocument::fromLoadedMap(std::unique_ptr<Map> map,
+                                          const QString &fileName,
+                                          MapFormat *format)
+{
     map->fileName = fileName;
 
     MapDocumentPtr document = MapDocumentPtr::create(std::move(map));
@@ -390,7 +401,7 @@ static bool visibleIn(const QRectF &area, MapObject *object,
 
 void MapDocument::resizeMap(QSize size, QPoint offset, bool removeObjects)
 {
-    const QRegion movedSelection = selectedArea().translated(offset);
+    const TileRegion movedSelection = selectedTiles().translated(offset);
     const QRect newArea = QRect(-offset, size);
     const QRectF visibleArea = renderer()->boundingRect(newArea);
 
@@ -1215,11 +1226,31 @@ void MapDocument::replaceObjectTemplate(const ObjectTemplate *oldObjectTemplate,
 
 void MapDocument::setSelectedArea(const QRegion &selection)
 {
-    if (mSelectedArea != selection) {
-        const QRegion oldSelectedArea = mSelectedArea;
-        mSelectedArea = selection;
-        emit selectedAreaChanged(mSelectedArea, oldSelectedArea);
+    setSelectedTiles(TileRegion(selection));
+}
+
+void MapDocument::setSelectedTiles(const TileRegion &selection)
+{
+    if (mSelectedTiles != selection) {
+        const TileRegion oldSelectedTiles = mSelectedTiles;
+        mSelectedTiles = selection;
+        mSelectedArea = QRegion();
+        mSelectedAreaValid = false;
+        emit selectedAreaChanged(mSelectedTiles, oldSelectedTiles);
+    }
+}
+
+/**
+ * A fragmented selection makes for an expensive QRegion, so it is only built
+ * when something asks for it.
+ */
+const QRegion &MapDocument::selectedArea() const
+{
+    if (!mSelectedAreaValid) {
+        mSelectedArea = mSelectedTiles.toRegion();
+        mSelectedAreaValid = true;
     }
+    return mSelectedArea;
 }
 
 static QList<Layer *> sortLayers(const Map &map, const QList<Layer *> &layers)
@@ -28,6 +28,7 @@
 #include "mapformat.h"
 #include "tiled.h"
 #include "tilededitor_global.h"
+#include "tileregion.h"
 #include "tileset.h"
 
 #include <QList>
@@ -102,6 +103,9 @@ public:
     static MapDocumentPtr load(const QString &fileName,
                                MapFormat *format,
                                QString *error = nullptr);
+    static MapDocumentPtr fromLoadedMap(std::unique_ptr<Map> map,
+                                        const QString &fileName,
+                                        MapFormat *format);
 
     MapFormat *readerFormat() const;
     void setReaderFormat(MapFormat *format);
@@ -217,14 +221,22 @@ public:
     void createRenderer();
 
     /**
-     * Returns the selected area of tiles.
+     * Returns the selected area of tiles. It is converted from the selected
+     * tiles on first use, so prefer selectedTiles() where possible.
      */
-    const QRegion &selectedArea() const { return mSelectedArea; }
+    const QRegion &selectedArea() const;
+
+    /**
+     * Returns the selected area of tiles as a TileRegion, which is cheaper to
+     * combine with other areas and to check for contained tiles.
+     */
+    const TileRegion &selectedTiles() const { return mSelectedTiles; }
 
     /**
      * Sets the selected area of tiles.
      */
     void setSelectedArea(const QRegion &selection);
+    void setSelectedTiles(const TileRegion &selection);
 
     /**
      * Returns the list of selected objects.
@@ -277,8 +289,8 @@ signals:
      * Emitted when the selected tile region changes. Sends the currently
      * selected region and the previously selected region.
      */
-    void selectedAreaChanged(const QRegion &newSelection,
-                             const QRegion &oldSelection);
+    void selectedAreaChanged(const TileRegion &newSelection,
+                             const TileRegion &oldSelection);
 
     /**
      * Emitted when the list of selected layers changes.
@@ -408,7 +420,9 @@ private:
     QString mWriterFormat;
     std::unique_ptr<Map> mMap;
     LayerModel *mLayerModel;
-    QRegion mSelectedArea;
+    mutable QRegion mSelectedArea;     // converted from mSelectedTiles on demand
+    mutable bool mSelectedAreaValid = true;
+    TileRegion mSelectedTiles;
     QList<Layer*> mSelectedLayers;
     QList<MapObject*> mSelectedObjects;
     QList<MapObject*> mAboutToBeSelectedObjects;
@@ -380,7 +380,7 @@ void MapDocumentActionHandler::populateMoveToLayerMenu(QMenu *menu, const Object
  */
 static bool isTileSelectionLocked(const MapDocument &mapDocument)
 {
-    if (!mapDocument.selectedArea().isEmpty())
+    if (!mapDocument.selectedTiles().isEmpty())
         for (Layer *layer : mapDocument.selectedLayers())
             if (layer->isTileLayer() && !layer->isUnlocked())
                 return true;
@@ -402,7 +402,7 @@ void MapDocumentActionHandler::cut()
     QUndoStack *stack = mMapDocument->undoStack();
     stack->beginMacro(tr("Cut"));
     delete_();
-    if (!mMapDocument->selectedArea().isEmpty())
+    if (!mMapDocument->selectedTiles().isEmpty())
         mMapDocument->undoStack()->push(new ChangeSelectedArea(mMapDocument, QRegion()));
     stack->endMacro();
 }
@@ -532,11 +532,11 @@ void MapDocumentActionHandler::selectInverse()
         return;
 
     if (TileLayer *tileLayer = layer->asTileLayer()) {
-        QRegion all = tileLayer->rect();
+        QRect all = tileLayer->rect();
         if (mMapDocument->map()->infinite())
             all = tileLayer->bounds();
 
-        QUndoCommand *command = new ChangeSelectedArea(mMapDocument, all - mMapDocument->selectedArea());
+        QUndoCommand *command = new ChangeSelectedArea(mMapDocument, TileRegion(all) - mMapDocument->selectedTiles());
         mMapDocument->undoStack()->push(command);
     } else if (ObjectGroup *objectGroup = layer->asObjectGroup()) {
         const auto &allObjects = objectGroup->objects();
@@ -556,7 +556,7 @@ void MapDocumentActionHandler::selectNone()
     if (!mMapDocument)
         return;
 
-    if (!mMapDocument->selectedArea().isEmpty()) {
+    if (!mMapDocument->selectedTiles().isEmpty()) {
         QUndoCommand *command = new ChangeSelectedArea(mMapDocument, QRegion());
         mMapDocument->undoStack()->push(command);
     }
@@ -590,7 +590,7 @@ void MapDocumentActionHandler::cropToSelection()
     if (!mMapDocument)
         return;
 
-    const QRect bounds = mMapDocument->selectedArea().boundingRect();
+    const QRect bounds = mMapDocument->selectedTiles().boundingRect();
     if (bounds.isNull())
         return;
 
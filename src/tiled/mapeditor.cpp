@@ -510,7 +510,7 @@ Editor::StandardActions MapEditor::enabledStandardActions() const
     if (mCurrentMapDocument) {
         Layer *currentLayer = mCurrentMapDocument->currentLayer();
         bool objectsSelected = !mCurrentMapDocument->selectedObjects().isEmpty();
-        bool areaSelected = !mCurrentMapDocument->selectedArea().isEmpty();
+        bool areaSelected = !mCurrentMapDocument->selectedTiles().isEmpty();
 
         if ((currentLayer && areaSelected) || objectsSelected)
             standardActions |= CutAction | CopyAction | DeleteAction;
@@ -732,7 +732,7 @@ void MapEditor::paste(ClipboardManager::PasteFlags flags)
 
     if (hasTileLayers && !(flags & ClipboardManager::PasteInPlace)) {
         // Reset tile selection and paste into the stamp brush
-        if (!mCurrentMapDocument->selectedArea().isEmpty()) {
+        if (!mCurrentMapDocument->selectedTiles().isEmpty()) {
             QUndoCommand *command = new ChangeSelectedArea(mCurrentMapDocument, QRegion());
             mCurrentMapDocument->undoStack()->push(command);
         }
@@ -45,10 +45,13 @@
 
 #include <QCursor>
 #include <QGraphicsSceneMouseEvent>
+#include <QGraphicsView>
 #include <QPen>
 #include <QStyleOptionGraphicsItem>
 #include <QWidget>
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 
 namespace Tiled {
@@ -56,6 +59,15 @@ namespace Tiled {
 static const qreal darkeningFactor = 0.6;
 static const qreal opacityFactor = 0.4;
 
+// Object groups with this many objects only get items for the objects in view
+static const int lazyObjectItemsThreshold = 5000;
+
+static qreal scaleOf(const QTransform &transform)
+{
+    return std::sqrt(transform.m11() * transform.m11() +
+                     transform.m12() * transform.m12());
+}
+
 class TileGridItem : public QGraphicsObject
 {
     Q_OBJECT
@@ -251,10 +263,10 @@ void MapItem::setShowTileCollisionShapes(bool enabled)
 {
     mapDocument()->renderer()->setFlag(ShowTileCollisionShapes, enabled);
 
-    for (MapObjectItem *item : std::as_const(mObjectItems))
-        if (Tile *tile = item->mapObject()->cell().tile())
-            if (tile->objectGroup() && !tile->objectGroup()->isEmpty())
-                item->syncWithMapObject();
+    syncObjectItemsIf([] (const MapObject *mapObject) {
+        const Tile *tile = mapObject->cell().tile();
+        return tile && tile->objectGroup() && !tile->objectGroup()->isEmpty();
+    });
 
     for (LayerItem *item : std::as_const(mLayerItems))
         if (item->layer()->isTileLayer())
@@ -275,6 +287,161 @@ void MapItem::updateLayerPositions()
         mTileGridItem->updateOffset();
         mObjectSelectionItem->updateItemPositions();
     }
+
+    updateObjectItemsInView();
+}
+
+/**
+ * Creates the items for the objects of large object groups that are near the
+ * view, and deletes those that are far out of view.
+ *
+ * Object groups with fewer objects always have an item for each object.
+ */
+void MapItem::updateObjectItemsInView()
+{
+    if (mLazyObjectGroups.isEmpty())
+        return;
+
+    const QGraphicsScene *mapScene = scene();
+    if (!mapScene)
+        return;
+
+    const QRectF viewRect = static_cast<const MapScene*>(mapScene)->viewRect();
+    if (viewRect.isEmpty())
+        return;
+
+    const auto views = mapScene->views();
+    const qreal scale = views.isEmpty() ? 1.0 : scaleOf(views.first()->transform());
+
+    // Keep the items in a larger area than where they get created, to avoid
+    // creating and deleting the same items while panning
+    const qreal margin = qMax(viewRect.width(), viewRect.height()) / 4;
+    const QRectF createRect = viewRect.adjusted(-margin, -margin, margin, margin);
+    const QRectF keepRect = viewRect.adjusted(-margin * 4, -margin * 4, margin * 4, margin * 4);
+
+    for (auto it = mObjectItems.begin(); it != mObjectItems.end(); ) {
+        ObjectGroup *objectGroup = it.key()->objectGroup();
+
+        if (mLazyObjectGroups.contains(objectGroup)) {
+            const ObjectGroupItem *ogItem = objectGroupItem(objectGroup);
+            const QRectF rect = ogItem->mapRectFromScene(keepRect);
+
+            if (!ogItem->objectIndex().intersects(it.key(), rect, scale)) {
+                delete it.value();
+                it = mObjectItems.erase(it);
+                continue;
+            }
+        }
+
+        ++it;
+    }
+
+    for (ObjectGroup *objectGroup : std::as_const(mLazyObjectGroups)) {
+        ObjectGroupItem *ogItem = objectGroupItem(objectGroup);
+        const QRectF rect = ogItem->mapRectFromScene(createRect);
+
+        QList<MapObject*> objects = ogItem->objectIndex().objects(rect, scale);
+        objects.erase(std::remove_if(objects.begin(), objects.end(),
+                                     [this] (MapObject *object) { return mObjectItems.contains(object); }),
+                      objects.end());
+
+        createObjectItems(ogItem, objects);
+    }
+}
+
+/**
+ * Calls \a visit for the items of the objects at the given scene position
+ * \a pos, from top to bottom. The \a viewTransform is used to determine the
+ * shape of objects that ignore the view transformation.
+ *
+ * Stops as soon as \a visit returns false, in which case this function
+ * returns false.
+ */
+bool MapItem::visitObjectItemsAt(const QPointF &pos,
+                                 const QTransform &viewTransform,
+                                 const ObjectItemVisitor &visit)
+{
+    return visitObjectItemsMatching(QRectF(pos, QSizeF()), viewTransform,
+                                    [&] (MapObjectItem *item, const QTransform &sceneToItem) {
+        return item->contains(sceneToItem.map(pos));
+    }, visit);
+}
+
+/**
+ * Calls \a visit for the items of the objects within the given scene
+ * \a rect, from top to bottom. Whether objects need to be fully contained is
+ * determined by the selection \a mode.
+ *
+ * Stops as soon as \a visit returns false, in which case this function
+ * returns false.
+ */
+bool MapItem::visitObjectItemsIn(const QRectF &rect,
+                                 Qt::ItemSelectionMode mode,
+                                 const QTransform &viewTransform,
+                                 const ObjectItemVisitor &visit)
+{
+    QPainterPath path;
+    path.addRect(rect);
+
+    return visitObjectItemsMatching(rect, viewTransform,
+                                    [&] (MapObjectItem *item, const QTransform &sceneToItem) {
+        return item->collidesWithPath(sceneToItem.map(path), mode);
+    }, visit);
+}
+
+/**
+ * Looks up the objects near the given scene \a rect in the spatial index of
+ * each visible object group, and calls \a visit for the items of those for
+ * which \a matches returns true, from top to bottom.
+ *
+ * Candidates that don't have an item yet get one, so that they can be tested
+ * against their exact shape. The candidates are tested in order, so when
+ * \a visit stops the iteration, the objects below are not tested at all.
+ */
+bool MapItem::visitObjectItemsMatching(const QRectF &rect,
+                                       const QTransform &viewTransform,
+                                       const std::function<bool (MapObjectItem *, const QTransform &)> &matches,
+                                       const ObjectItemVisitor &visit)
+{
+    const qreal scale = scaleOf(viewTransform);
+
+    LayerIterator iterator(mapDocument()->map(), Layer::ObjectGroupType);
+    iterator.toBack();
+    while (auto objectGroup = static_cast<ObjectGroup*>(iterator.previous())) {
+        ObjectGroupItem *ogItem = objectGroupItem(objectGroup);
+        if (!ogItem || !ogItem->isVisible())
+            continue;
+
+        const QRectF localRect = ogItem->mapRectFromScene(rect);
+        const auto candidates = ogItem->objectIndex().objects(localRect, scale);
+
+        if (mLazyObjectGroups.contains(objectGroup)) {
+            QList<MapObject*> missing;
+            for (MapObject *object : candidates)
+                if (!mObjectItems.contains(object))
+                    missing.append(object);
+            createObjectItems(ogItem, missing);
+        }
+
+        QList<MapObjectItem*> items;
+
+        for (MapObject *object : candidates) {
+            MapObjectItem *item = mObjectItems.value(object);
+            if (item && item->isVisible())
+                items.append(item);
+        }
+
+        std::stable_sort(items.begin(), items.end(),
+                         [] (MapObjectItem *a, MapObjectItem *b) { return a->zValue() > b->zValue(); });
+
+        for (MapObjectItem *item : std::as_const(items)) {
+            const QTransform deviceToItem = item->deviceTransform(viewTransform).inverted();
+            if (matches(item, viewTransform * deviceToItem) && !visit(item))
+                return false;
+        }
+    }
+
+    return true;
 }
 
 QRectF MapItem::boundingRect() const
@@ -350,6 +517,7 @@ void MapItem::repaintRegion(const QRegion &region, TileLayer *tileLayer)
 
     for (const QRect &r : region) {
         QRectF boundingRect = renderer->boundingRect(r).marginsAdded(margins);
+        tileLayerItem->invalidateRenderCache(boundingRect);
         tileLayerItem->update(boundingRect);
     }
 }
@@ -378,12 +546,10 @@ void MapItem::documentChanged(const ChangeEvent &change)
             const auto typeId = objectsChange.objects.first()->typeId();
             if (typeId == Object::MapObjectType) {
                 for (Object *object : objectsChange.objects)
-                    mObjectItems.value(static_cast<MapObject*>(object))->syncWithMapObject();
+                    syncObjectItem(static_cast<MapObject*>(object));
             } else if (typeId == Object::TileType) {
                 if (mapDocument()->renderer()->testFlag(ShowTileObjectOutlines))
-                    for (MapObjectItem *item : std::as_const(mObjectItems))
-                        if (item->mapObject()->isTileObject())
-                            item->syncWithMapObject();
+                    syncObjectItemsIf([] (const MapObject *mapObject) { return mapObject->isTileObject(); });
             }
         }
 
@@ -514,6 +680,7 @@ void MapItem::layerAdded(Layer *layer)
 
     updateBoundingRect();
     updateSelectedLayersHighlight();
+    updateObjectItemsInView();
 }
 
 void MapItem::layerAboutToBeRemoved(GroupLayer *parentLayer, int index)
@@ -595,7 +762,8 @@ void MapItem::updateLayerItems(Layer *layer)
     case Layer::ObjectGroupType:
         for (MapObject *mapObject : static_cast<const ObjectGroup&>(*layer)) {
             if (mapObject->isTileObject())
-                mObjectItems.value(mapObject)->update();
+                if (MapObjectItem *item = mObjectItems.value(mapObject))
+                    item->update();
         }
         break;
     case Layer::GroupLayerType:
@@ -627,11 +795,9 @@ void MapItem::adaptToTilesetTileSizeChanges(Tileset *tileset)
         if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
             tli->syncWithTileLayer();
 
-    for (MapObjectItem *item : std::as_const(mObjectItems)) {
-        const Cell &cell = item->mapObject()->cell();
-        if (cell.tileset() == tileset)
-            item->syncWithMapObject();
-    }
+    syncObjectItemsIf([tileset] (const MapObject *mapObject) {
+        return mapObject->cell().tileset() == tileset;
+    });
 }
 
 void MapItem::adaptToTileSizeChanges(Tile *tile)
@@ -640,11 +806,9 @@ void MapItem::adaptToTileSizeChanges(Tile *tile)
         if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
             tli->syncWithTileLayer();
 
-    for (MapObjectItem *item : std::as_const(mObjectItems)) {
-        const Cell &cell = item->mapObject()->cell();
-        if (cell.tile() == tile)
-            item->syncWithMapObject();
-    }
+    syncObjectItemsIf([tile] (const MapObject *mapObject) {
+        return mapObject->cell().tile() == tile;
+    });
 }
 
 void MapItem::tileObjectGroupChanged(Tile *tile)
@@ -652,11 +816,46 @@ void MapItem::tileObjectGroupChanged(Tile *tile)
     if (!Preferences::instance()->showTileCollisionShapes())
         return;
 
-    for (MapObjectItem *item : std::as_const(mObjectItems)) {
-        const Cell &cell = item->mapObject()->cell();
-        if (cell.tile() == tile)
-            item->syncWithMapObject();
-    }
+    for (QGraphicsItem *item : std::as_const(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            if (tli->tileLayer()->referencesTileset(tile->tileset()))
+                tli->invalidateRenderCache();
+
+    syncObjectItemsIf([tile] (const MapObject *mapObject) {
+        return mapObject->cell().tile() == tile;
+    });
+}
+
+/**
+ * Discards the cached renderings of the tile layers referring to the given
+ * \a tileset, for example because its images have changed.
+ */
+void MapItem::repaintTileset(Tileset *tileset)
+{
+    for (QGraphicsItem *item : std::as_const(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            if (tli->tileLayer()->referencesTileset(tileset))
+                tli->invalidateRenderCache();
+}
+
+/**
+ * Repaints the parts of the map showing any of the given \a tiles, for
+ * example because they advanced to another frame of their animation.
+ */
+void MapItem::repaintTiles(const QList<Tile*> &tiles)
+{
+    if (!mapDocument()->renderer()->testFlag(ShowTileAnimations))
+        return;
+
+    const QSet<const Tile*> tileSet(tiles.cbegin(), tiles.cend());
+
+    for (QGraphicsItem *item : std::as_const(mLayerItems))
+        if (TileLayerItem *tli = dynamic_cast<TileLayerItem*>(item))
+            tli->repaintTiles(tileSet);
+
+    for (MapObjectItem *item : std::as_const(mObjectItems))
+        if (tileSet.contains(item->mapObject()->cell().tile()))
+            item->update();
 }
 
 void MapItem::tilesetReplaced(int index, Tileset *tileset)
@@ -671,32 +870,31 @@ void MapItem::tilesetReplaced(int index, Tileset *tileset)
 void MapItem::objectsInserted(ObjectGroup *objectGroup, int first, int last)
 {
     // Find the object group item for the object group
-    auto ogItem = static_cast<ObjectGroupItem*>(mLayerItems.value(objectGroup));
+    auto ogItem = objectGroupItem(objectGroup);
     Q_ASSERT(ogItem);
 
-    const ObjectGroup::DrawOrder drawOrder = objectGroup->drawOrder();
+    const bool lazy = mLazyObjectGroups.contains(objectGroup);
 
     for (int i = first; i <= last; ++i) {
         MapObject *object = objectGroup->objectAt(i);
 
-        MapObjectItem *item = new MapObjectItem(object, mapDocument(), ogItem);
-        if (drawOrder == ObjectGroup::TopDownOrder)
-            item->setZValue(item->y());
-        else
-            item->setZValue(i);
+        MapObjectItem::updateIndex(ogItem->objectIndex(), object, mapDocument());
 
-        mObjectItems.insert(object, item);
+        if (!lazy)
+            createObjectItem(object, ogItem, i);
     }
+
+    if (lazy)
+        updateObjectItemsInView();
 }
 
 /**
- * Removes the map object items related to the given objects.
+ * Removes the map object item related to the given object.
  */
 void MapItem::deleteObjectItem(MapObject *object)
 {
-    auto item = mObjectItems.take(object);
-    Q_ASSERT(item);
-    delete item;
+    objectGroupItem(object->objectGroup())->objectIndex().remove(object);
+    delete mObjectItems.take(object);
 }
 
 /**
@@ -704,14 +902,84 @@ void MapItem::deleteObjectItem(MapObject *object)
  */
 void MapItem::syncObjectItems(const QList<MapObject*> &objects)
 {
-    for (MapObject *object : objects) {
-        MapObjectItem *item = mObjectItems.value(object);
-        Q_ASSERT(item);
+    for (MapObject *object : objects)
+        syncObjectItem(object);
+}
 
+/**
+ * Updates the spatial index entry of the given object, as well as its item
+ * when it has one.
+ */
+void MapItem::syncObjectItem(MapObject *object)
+{
+    if (ObjectGroupItem *ogItem = objectGroupItem(object->objectGroup()))
+        MapObjectItem::updateIndex(ogItem->objectIndex(), object, mapDocument());
+
+    if (MapObjectItem *item = mObjectItems.value(object))
         item->syncWithMapObject();
+}
+
+/**
+ * Updates the objects for which the given \a condition returns true.
+ */
+void MapItem::syncObjectItemsIf(const std::function<bool (const MapObject *)> &condition)
+{
+    for (LayerItem *layerItem : std::as_const(mLayerItems)) {
+        if (!layerItem->layer()->isObjectGroup())
+            continue;
+
+        const auto ogItem = static_cast<ObjectGroupItem*>(layerItem);
+        for (MapObject *object : ogItem->objectGroup()->objects())
+            if (condition(object))
+                syncObjectItem(object);
     }
 }
 
+MapObjectItem *MapItem::createObjectItem(MapObject *object,
+                                         ObjectGroupItem *ogItem,
+                                         int index)
+{
+    MapObjectItem *item = new MapObjectItem(object, mapDocument(), ogItem);
+    if (ogItem->objectGroup()->drawOrder() == ObjectGroup::TopDownOrder)
+        item->setZValue(item->y());
+    else
+        item->setZValue(index);
+
+    mObjectItems.insert(object, item);
+    return item;
+}
+
+/**
+ * Creates items for the given \a objects, which are part of the object group
+ * of \a ogItem.
+ */
+void MapItem::createObjectItems(ObjectGroupItem *ogItem, const QList<MapObject *> &objects)
+{
+    if (objects.isEmpty())
+        return;
+
+    const ObjectGroup *objectGroup = ogItem->objectGroup();
+
+    if (objectGroup->drawOrder() == ObjectGroup::TopDownOrder) {
+        for (MapObject *object : objects)
+            createObjectItem(object, ogItem, 0);
+        return;
+    }
+
+    // Look up the index of the objects in a single pass
+    QSet<MapObject*> pending(objects.begin(), objects.end());
+    const auto &allObjects = objectGroup->objects();
+
+    for (int i = 0; i < allObjects.size() && !pending.isEmpty(); ++i)
+        if (pending.remove(allObjects.at(i)))
+            createObjectItem(allObjects.at(i), ogItem, i);
+}
+
+ObjectGroupItem *MapItem::objectGroupItem(ObjectGroup *objectGroup) const
+{
+    return static_cast<ObjectGroupItem*>(mLayerItems.value(objectGroup));
+}
+
 /**
  * Updates the Z value of the objects when appropriate.
  */
@@ -721,18 +989,14 @@ void MapItem::objectsIndexChanged(ObjectGroup *objectGroup,
     if (objectGroup->drawOrder() != ObjectGroup::IndexOrder)
         return;
 
-    for (int i = first; i <= last; ++i) {
-        MapObjectItem *item = mObjectItems.value(objectGroup->objectAt(i));
-        Q_ASSERT(item);
-
-        item->setZValue(i);
-    }
+    for (int i = first; i <= last; ++i)
+        if (MapObjectItem *item = mObjectItems.value(objectGroup->objectAt(i)))
+            item->setZValue(i);
 }
 
 void MapItem::syncAllObjectItems()
 {
-    for (MapObjectItem *item : std::as_const(mObjectItems))
-        item->syncWithMapObject();
+    syncObjectItemsIf([] (const MapObject *) { return true; });
 }
 
 void MapItem::setObjectLineWidth(qreal lineWidth)
@@ -740,12 +1004,11 @@ void MapItem::setObjectLineWidth(qreal lineWidth)
     mapDocument()->renderer()->setObjectLineWidth(lineWidth);
 
     // Changing the line width can change the size of the object items
-    for (MapObjectItem *item : std::as_const(mObjectItems)) {
-        if (item->mapObject()->cell().isEmpty()) {
-            item->syncWithMapObject();
+    syncObjectItemsIf([] (const MapObject *mapObject) { return mapObject->cell().isEmpty(); });
+
+    for (MapObjectItem *item : std::as_const(mObjectItems))
+        if (item->mapObject()->cell().isEmpty())
             item->update();
-        }
-    }
 }
 
 void MapItem::setShowTileObjectOutlines(bool enabled)
@@ -784,20 +1047,21 @@ LayerItem *MapItem::createLayerItem(Layer *layer)
 
     case Layer::ObjectGroupType: {
         auto og = static_cast<ObjectGroup*>(layer);
-        const ObjectGroup::DrawOrder drawOrder = og->drawOrder();
         ObjectGroupItem *ogItem = new ObjectGroupItem(og, parent);
-        int objectIndex = 0;
-        for (MapObject *object : og->objects()) {
-            MapObjectItem *item = new MapObjectItem(object, mapDocument(),
-                                                    ogItem);
-            if (drawOrder == ObjectGroup::TopDownOrder)
-                item->setZValue(item->y());
-            else
-                item->setZValue(objectIndex);
 
-            mObjectItems.insert(object, item);
-            ++objectIndex;
+        for (MapObject *object : og->objects())
+            MapObjectItem::updateIndex(ogItem->objectIndex(), object, mapDocument());
+
+        // For large object groups, items are only created for the objects in
+        // view (see updateObjectItemsInView)
+        if (og->objectCount() >= lazyObjectItemsThreshold) {
+            mLazyObjectGroups.insert(og);
+        } else {
+            int objectIndex = 0;
+            for (MapObject *object : og->objects())
+                createObjectItem(object, ogItem, objectIndex++);
         }
+
         layerItem = ogItem;
         break;
     }
@@ -840,6 +1104,7 @@ void MapItem::deleteLayerItems(Layer *layer)
         // Delete any object items
         for (auto object : static_cast<ObjectGroup*>(layer)->objects())
             delete mObjectItems.take(object);
+        mLazyObjectGroups.remove(static_cast<ObjectGroup*>(layer));
         break;
     case Layer::GroupLayerType:
         // Recurse into group layers
@@ -24,7 +24,9 @@
 
 #include <QGraphicsObject>
 #include <QMap>
+#include <QSet>
 
+#include <functional>
 #include <memory>
 
 namespace Tiled {
@@ -42,6 +44,7 @@ class LayerChangeEvent;
 class LayerItem;
 class MapObjectItem;
 class MapScene;
+class ObjectGroupItem;
 class ObjectSelectionItem;
 class TileGridItem;
 class TileSelectionItem;
@@ -73,8 +76,21 @@ public:
 
     void setDisplayMode(DisplayMode displayMode);
     void setShowTileCollisionShapes(bool enabled);
+    void repaintTileset(Tileset *tileset);
+    void repaintTiles(const QList<Tile*> &tiles);
 
     void updateLayerPositions();
+    void updateObjectItemsInView();
+
+    using ObjectItemVisitor = std::function<bool (MapObjectItem *)>;
+
+    bool visitObjectItemsAt(const QPointF &pos,
+                            const QTransform &viewTransform,
+                            const ObjectItemVisitor &visit);
+    bool visitObjectItemsIn(const QRectF &rect,
+                            Qt::ItemSelectionMode mode,
+                            const QTransform &viewTransform,
+                            const ObjectItemVisitor &visit);
 
     // QGraphicsItem
     QRectF boundingRect() const override;
@@ -120,8 +136,19 @@ private:
     void objectsInserted(ObjectGroup *objectGroup, int first, int last);
     void deleteObjectItem(MapObject *object);
     void syncObjectItems(const QList<MapObject*> &objects);
+    void syncObjectItem(MapObject *object);
+    void syncObjectItemsIf(const std::function<bool (const MapObject *)> &condition);
     void objectsIndexChanged(ObjectGroup *objectGroup, int first, int last);
 
+    MapObjectItem *createObjectItem(MapObject *object, ObjectGroupItem *ogItem, int index);
+    void createObjectItems(ObjectGroupItem *ogItem, const QList<MapObject*> &objects);
+    ObjectGroupItem *objectGroupItem(ObjectGroup *objectGroup) const;
+
+    bool visitObjectItemsMatching(const QRectF &rect,
+                                  const QTransform &viewTransform,
+                                  const std::function<bool (MapObjectItem *, const QTransform &)> &matches,
+                                  const ObjectItemVisitor &visit);
+
     void syncAllObjectItems();
 
     void setObjectLineWidth(qreal lineWidth);
@@ -142,6 +169,7 @@ private:
     std::unique_ptr<ObjectSelectionItem> mObjectSelectionItem;
     QMap<Layer*, LayerItem*> mLayerItems;
     QMap<MapObject*, MapObjectItem*> mObjectItems;
+    QSet<ObjectGroup*> mLazyObjectGroups;
     DisplayMode mDisplayMode;
     QRectF mBoundingRect;
     bool mIsHovered = false;
@@ -0,0 +1,259 @@
+/*
+ * mapobjectindex.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapobjectindex.h"
+
+#include <cmath>
+
+using namespace Tiled;
+
+// Objects covering more cells than this are stored in a separate list
+static const int MaxCellsPerObject = 64;
+
+// Limits the cell coordinates, to avoid overflows for extreme coordinates
+static const int MaxCellCoordinate = 1 << 20;
+
+static bool overlaps(const QRectF &a, const QRectF &b)
+{
+    // Unlike QRectF::intersects, this also works for empty rectangles
+    return a.left() <= b.right() && b.left() <= a.right() &&
+            a.top() <= b.bottom() && b.top() <= a.bottom();
+}
+
+QRectF MapObjectIndex::Entry::boundsAtScale(qreal scale) const
+{
+    if (!fixedSize)
+        return bounds;
+
+    return QRectF(anchor + bounds.topLeft() / scale,
+                  bounds.size() / scale);
+}
+
+MapObjectIndex::MapObjectIndex(qreal cellSize)
+    : mCellSize(cellSize)
+{
+    Q_ASSERT(cellSize > 0);
+}
+
+/**
+ * Inserts the \a object with the given \a bounds, or updates its bounds when
+ * it was already part of the index.
+ */
+void MapObjectIndex::insert(MapObject *object, const QRectF &bounds)
+{
+    Entry entry;
+    entry.bounds = bounds.normalized();
+    insertEntry(object, entry);
+}
+
+/**
+ * Inserts an \a object that is displayed at a fixed size. The \a deviceBounds
+ * are relative to the \a anchor and in device pixels.
+ */
+void MapObjectIndex::insertFixedSize(MapObject *object,
+                                     const QPointF &anchor,
+                                     const QRectF &deviceBounds)
+{
+    Entry entry;
+    entry.bounds = deviceBounds.normalized();
+    entry.anchor = anchor;
+    entry.fixedSize = true;
+    insertEntry(object, entry);
+
+    const qreal extent = qMax(qMax(qAbs(entry.bounds.left()), qAbs(entry.bounds.right())),
+                              qMax(qAbs(entry.bounds.top()), qAbs(entry.bounds.bottom())));
+    mMaxFixedSizeExtent = qMax(mMaxFixedSizeExtent, extent);
+}
+
+void MapObjectIndex::insertEntry(MapObject *object, Entry entry)
+{
+    entry.cells = cellRange(entry.fixedSize ? QRectF(entry.anchor, QSizeF())
+                                            : entry.bounds);
+    entry.large = qint64(entry.cells.width()) * entry.cells.height() > MaxCellsPerObject;
+
+    auto it = mEntries.find(object);
+    if (it != mEntries.end()) {
+        // Only the bounds need updating when the object stays in the same cells
+        if (it->cells == entry.cells && it->large == entry.large) {
+            *it = entry;
+            return;
+        }
+
+        remove(object);
+    }
+
+    if (entry.large) {
+        mLargeObjects.append(object);
+    } else {
+        for (int y = entry.cells.top(); y <= entry.cells.bottom(); ++y)
+            for (int x = entry.cells.left(); x <= entry.cells.right(); ++x)
+                mCells[cellKey(x, y)].append(object);
+    }
+
+    mEntries.insert(object, entry);
+}
+
+void MapObjectIndex::remove(MapObject *object)
+{
+    const auto it = mEntries.constFind(object);
+    if (it == mEntries.constEnd())
+        return;
+
+    const Entry &entry = *it;
+
+    if (entry.large) {
+        mLargeObjects.removeOne(object);
+    } else {
+        for (int y = entry.cells.top(); y <= entry.cells.bottom(); ++y) {
+            for (int x = entry.cells.left(); x <= entry.cells.right(); ++x) {
+                auto cell = mCells.find(cellKey(x, y));
+                if (cell == mCells.end())
+                    continue;
+
+                cell->removeOne(object);
+                if (cell->isEmpty())
+                    mCells.erase(cell);
+            }
+        }
+    }
+
+    mEntries.erase(it);
+}
+
+void MapObjectIndex::clear()
+{
+    mEntries.clear();
+    mCells.clear();
+    mLargeObjects.clear();
+    mMaxFixedSizeExtent = 0;
+}
+
+/**
+ * Returns the bounds of the given \a object at the given \a scale, or an
+ * empty rectangle when the object is not part of the index.
+ */
+QRectF MapObjectIndex::bounds(MapObject *object, qreal scale) const
+{
+    const auto it = mEntries.constFind(object);
+    if (it == mEntries.constEnd())
+        return QRectF();
+    return it->boundsAtScale(scale);
+}
+
+/**
+ * Returns whether the bounds of the given \a object overlap the given
+ * \a rect at the given \a scale.
+ */
+bool MapObjectIndex::intersects(MapObject *object, const QRectF &rect, qreal scale) const
+{
+    const auto it = mEntries.constFind(object);
+    if (it == mEntries.constEnd())
+        return false;
+    return overlaps(it->boundsAtScale(scale), rect.normalized());
+}
+
+/**
+ * Returns the objects of which the bounds overlap the given \a rect. The
+ * \a scale is used to determine the bounds of fixed-size objects.
+ *
+ * Each object is returned only once, in no particular order.
+ */
+QList<MapObject*> MapObjectIndex::objects(const QRectF &rect, qreal scale) const
+{
+    QList<MapObject*> result;
+    visitObjects(rect, scale, [&] (MapObject *object) {
+        result.append(object);
+        return true;
+    });
+    return result;
+}
+
+/**
+ * Calls \a visit for each object of which the bounds overlap the given
+ * \a rect, like objects(), but without building a list. Stops as soon as
+ * \a visit returns false, in which case this function returns false.
+ */
+bool MapObjectIndex::visitObjects(const QRectF &rect, qreal scale,
+                                  const std::function<bool (MapObject *)> &visit) const
+{
+    const QRectF queryRect = rect.normalized();
+
+    for (MapObject *object : mLargeObjects)
+        if (overlaps(mEntries.value(object).boundsAtScale(scale), queryRect))
+            if (!visit(object))
+                return false;
+
+    // Fixed-size objects are stored by their anchor, so the cells around the
+    // rect need to be checked as well
+    const qreal margin = mMaxFixedSizeExtent / scale;
+    const QRect range = cellRange(queryRect.adjusted(-margin, -margin, margin, margin));
+
+    auto visitCell = [&] (int x, int y, const QVector<MapObject*> &objects) {
+        for (MapObject *object : objects) {
+            const Entry &entry = *mEntries.constFind(object);
+
+            // Report each object only from the first of its cells in range
+            if (x != qMax(entry.cells.left(), range.left()) ||
+                    y != qMax(entry.cells.top(), range.top()))
+                continue;
+
+            if (overlaps(entry.boundsAtScale(scale), queryRect))
+                if (!visit(object))
+                    return false;
+        }
+        return true;
+    };
+
+    if (qint64(range.width()) * range.height() > mCells.size()) {
+        // Cheaper to go over all the occupied cells
+        for (auto it = mCells.cbegin(), end = mCells.cend(); it != end; ++it) {
+            const int x = int(quint32(it.key() >> 32));
+            const int y = int(quint32(it.key()));
+            if (range.contains(x, y) && !visitCell(x, y, it.value()))
+                return false;
+        }
+    } else {
+        for (int y = range.top(); y <= range.bottom(); ++y) {
+            for (int x = range.left(); x <= range.right(); ++x) {
+                const auto it = mCells.constFind(cellKey(x, y));
+                if (it != mCells.constEnd() && !visitCell(x, y, it.value()))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+QRect MapObjectIndex::cellRange(const QRectF &rect) const
+{
+    auto toCell = [this] (qreal coordinate) {
+        const qreal cell = std::floor(coordinate / mCellSize);
+        return int(qBound<qreal>(-MaxCellCoordinate, cell, MaxCellCoordinate));
+    };
+
+    return QRect(QPoint(toCell(rect.left()), toCell(rect.top())),
+                 QPoint(toCell(rect.right()), toCell(rect.bottom())));
+}
+
+quint64 MapObjectIndex::cellKey(int x, int y)
+{
+    return (quint64(quint32(x)) << 32) | quint32(y);
+}
@@ -0,0 +1,101 @@
+/*
+ * mapobjectindex.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QRectF>
+#include <QVector>
+
+#include <functional>
+
+namespace Tiled {
+
+class MapObject;
+
+/**
+ * A spatial index over the map objects of an object group, used to find the
+ * objects in a certain area without having to go over all of them.
+ *
+ * The objects are stored in a uniform grid of cells. Objects spanning a lot
+ * of cells are kept in a separate list which is checked for each query.
+ *
+ * Objects which are displayed at a fixed size regardless of the zoom level
+ * (like point objects) are stored by their anchor, with their bounds in
+ * device pixels relative to that anchor. Their extent in map coordinates
+ * depends on the \a scale passed to objects().
+ */
+class MapObjectIndex
+{
+public:
+    explicit MapObjectIndex(qreal cellSize = 256);
+
+    void insert(MapObject *object, const QRectF &bounds);
+    void insertFixedSize(MapObject *object,
+                         const QPointF &anchor,
+                         const QRectF &deviceBounds);
+    void remove(MapObject *object);
+    void clear();
+
+    bool contains(MapObject *object) const;
+    int count() const;
+
+    QRectF bounds(MapObject *object, qreal scale = 1.0) const;
+    bool intersects(MapObject *object, const QRectF &rect, qreal scale = 1.0) const;
+    QList<MapObject*> objects(const QRectF &rect, qreal scale = 1.0) const;
+    bool visitObjects(const QRectF &rect, qreal scale,
+                      const std::function<bool (MapObject *)> &visit) const;
+
+private:
+    struct Entry
+    {
+        QRectF bounds;
+        QPointF anchor;
+        QRect cells;
+        bool fixedSize = false;
+        bool large = false;
+
+        QRectF boundsAtScale(qreal scale) const;
+    };
+
+    void insertEntry(MapObject *object, Entry entry);
+    QRect cellRange(const QRectF &rect) const;
+
+    static quint64 cellKey(int x, int y);
+
+    qreal mCellSize;
+    QHash<MapObject*, Entry> mEntries;
+    QHash<quint64, QVector<MapObject*>> mCells;
+    QVector<MapObject*> mLargeObjects;
+    qreal mMaxFixedSizeExtent = 0;
+};
+
+inline bool MapObjectIndex::contains(MapObject *object) const
+{
+    return mEntries.contains(object);
+}
+
+inline int MapObjectIndex::count() const
+{
+    return mEntries.size();
+}
+
+} // namespace Tiled
@@ -24,6 +24,7 @@
 
 #include "geometry.h"
 #include "mapdocument.h"
+#include "mapobjectindex.h"
 #include "maprenderer.h"
 #include "mapscene.h"
 #include "objectgroup.h"
@@ -70,14 +71,8 @@ void MapObjectItem::syncWithMapObject()
         toolTip += QStringLiteral(" (") + className + QLatin1Char(')');
     setToolTip(toolTip);
 
-    MapRenderer *renderer = mMapDocument->renderer();
-    QPointF pixelPos = renderer->pixelToScreenCoords(mObject->position());
-    QRectF bounds = renderer->boundingRect(mObject);
-
-    bounds.translate(-pixelPos);
-
-    if (renderer->flags().testFlag(ShowTileCollisionShapes))
-        expandBoundsToCoverTileCollisionObjects(bounds);
+    QPointF pixelPos;
+    const QRectF bounds = itemBounds(mObject, mMapDocument, pixelPos);
 
     if (ObjectGroup *objectGroup = mObject->objectGroup()) {
         if (mIsHoveredIndicator) {
@@ -102,6 +97,30 @@ void MapObjectItem::syncWithMapObject()
             mObject->shape() == MapObject::Point);
 }
 
+/**
+ * Inserts the given \a object into the \a index, or updates its entry, using
+ * the bounds a MapObjectItem representing the object would have within its
+ * ObjectGroupItem.
+ */
+void MapObjectItem::updateIndex(MapObjectIndex &index,
+                                MapObject *object,
+                                const MapDocument *mapDocument)
+{
+    QPointF pixelPos;
+    const QRectF bounds = itemBounds(object, mapDocument, pixelPos);
+
+    QTransform transform;
+    if (object->shape() == MapObject::Point) {
+        // Point objects ignore the view transformation
+        transform.rotate(object->rotation());
+        index.insertFixedSize(object, pixelPos, transform.mapRect(bounds));
+    } else {
+        transform.translate(pixelPos.x(), pixelPos.y());
+        transform.rotate(object->rotation());
+        index.insert(object, transform.mapRect(bounds));
+    }
+}
+
 void MapObjectItem::setIsHoverIndicator(bool isHoverIndicator)
 {
     if (mIsHoveredIndicator == isHoverIndicator)
@@ -200,9 +219,31 @@ void MapObjectItem::setPolygon(const QPolygonF &polygon)
     syncWithMapObject();
 }
 
-void MapObjectItem::expandBoundsToCoverTileCollisionObjects(QRectF &bounds)
+/**
+ * Returns the bounding rect of an item representing the given \a object,
+ * relative to its position, which is stored in \a pixelPos.
+ */
+QRectF MapObjectItem::itemBounds(const MapObject *object,
+                                 const MapDocument *mapDocument,
+                                 QPointF &pixelPos)
+{
+    const MapRenderer *renderer = mapDocument->renderer();
+    pixelPos = renderer->pixelToScreenCoords(object->position());
+
+    QRectF bounds = renderer->boundingRect(object);
+    bounds.translate(-pixelPos);
+
+    if (renderer->flags().testFlag(ShowTileCollisionShapes))
+        expandBoundsToCoverTileCollisionObjects(object, mapDocument->map(), bounds);
+
+    return bounds;
+}
+
+void MapObjectItem::expandBoundsToCoverTileCollisionObjects(const MapObject *mapObject,
+                                                            const Map *map,
+                                                            QRectF &bounds)
 {
-    const Cell &cell = mObject->cell();
+    const Cell &cell = mapObject->cell();
     const Tile *tile = cell.tile();
     if (!tile || !tile->objectGroup())
         return;
@@ -215,9 +256,9 @@ void MapObjectItem::expandBoundsToCoverTileCollisionObjects(QRectF &bounds)
     mapParameters.tileWidth = tileset->gridSize().width();
     mapParameters.tileHeight = tileset->gridSize().height();
 
-    const Map map(mapParameters);
-    const auto renderer = MapRenderer::create(&map);
-    const QTransform tileTransform = tileCollisionObjectsTransform(*tile);
+    const Map collisionMap(mapParameters);
+    const auto renderer = MapRenderer::create(&collisionMap);
+    const QTransform tileTransform = tileCollisionObjectsTransform(mapObject, map, *tile);
 
     for (MapObject *object : tile->objectGroup()->objects()) {
         auto transform = rotateAt(object->position(), object->rotation());
@@ -227,25 +268,27 @@ void MapObjectItem::expandBoundsToCoverTileCollisionObjects(QRectF &bounds)
     }
 }
 
-QTransform MapObjectItem::tileCollisionObjectsTransform(const Tile &tile) const
+QTransform MapObjectItem::tileCollisionObjectsTransform(const MapObject *mapObject,
+                                                       const Map *map,
+                                                       const Tile &tile)
 {
     const Tileset *tileset = tile.tileset();
 
     QTransform tileTransform;
 
-    tileTransform.scale(mObject->width() / tile.width(),
-                        mObject->height() / tile.height());
+    tileTransform.scale(mapObject->width() / tile.width(),
+                        mapObject->height() / tile.height());
 
-    if (mMapDocument->map()->orientation() == Map::Isometric)
+    if (map->orientation() == Map::Isometric)
         tileTransform.translate(-tile.width() / 2, 0.0);
 
     tileTransform.translate(tileset->tileOffset().x(), tileset->tileOffset().y());
 
-    if (mObject->cell().flippedVertically()) {
+    if (mapObject->cell().flippedVertically()) {
         tileTransform.scale(1, -1);
         tileTransform.translate(0, tile.height());
     }
-    if (mObject->cell().flippedHorizontally()) {
+    if (mapObject->cell().flippedHorizontally()) {
         tileTransform.scale(-1, 1);
         tileTransform.translate(-tile.width(), 0);
     }
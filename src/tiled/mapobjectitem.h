@@ -29,11 +29,13 @@
 
 namespace Tiled {
 
+class Map;
 class MapObject;
 class Tile;
 
 class Handle;
 class MapDocument;
+class MapObjectIndex;
 class ObjectGroupItem;
 class PointHandle;
 class ResizeHandle;
@@ -81,11 +83,22 @@ public:
      */
     void setPolygon(const QPolygonF &polygon);
 
+    static void updateIndex(MapObjectIndex &index,
+                            MapObject *object,
+                            const MapDocument *mapDocument);
+
     static Preference<bool> preciseTileObjectSelection;
 
 private:
-    void expandBoundsToCoverTileCollisionObjects(QRectF &bounds);
-    QTransform tileCollisionObjectsTransform(const Tile &tile) const;
+    static QRectF itemBounds(const MapObject *object,
+                             const MapDocument *mapDocument,
+                             QPointF &pixelPos);
+    static void expandBoundsToCoverTileCollisionObjects(const MapObject *mapObject,
+                                                        const Map *map,
+                                                        QRectF &bounds);
+    static QTransform tileCollisionObjectsTransform(const MapObject *mapObject,
+                                                    const Map *map,
+                                                    const Tile &tile);
 
     MapDocument *mapDocument() const { return mMapDocument; }
 
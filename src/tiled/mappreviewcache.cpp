@@ -0,0 +1,418 @@
+/*
+ * mappreviewcache.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mappreviewcache.h"
+
+#include "filesystemwatcher.h"
+#include "imagelayer.h"
+#include "map.h"
+#include "mapformat.h"
+#include "mapobject.h"
+#include "minimaprenderer.h"
+#include "objectgroup.h"
+#include "objecttemplate.h"
+#include "tile.h"
+#include "tileset.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+using namespace Tiled;
+
+// Maximum width or height of a preview
+static const int PreviewSize = 512;
+
+// Memory budget for the previews kept in memory
+static const int PreviewCacheBudgetKb = 128 * 1024;
+
+// Limits for the previews stored on disk. Previews not used for longer than
+// the maximum age are removed, followed by the least recently used ones while
+// the cache is larger than the maximum size.
+static const qint64 MaxDiskCacheSize = qint64(256) * 1024 * 1024;
+static const int MaxDiskCacheAgeDays = 30;
+
+static QString previewCacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+            + QLatin1String("/map-previews");
+}
+
+static QString previewCacheFileName(const QString &fileName)
+{
+    const QByteArray hash = QCryptographicHash::hash(fileName.toUtf8(),
+                                                     QCryptographicHash::Sha1);
+
+    return previewCacheDir() + QLatin1Char('/')
+            + QString::fromLatin1(hash.toHex())
+            + QLatin1String(".png");
+}
+
+static QString lastModifiedString(const QString &fileName)
+{
+    return QString::number(QFileInfo(fileName).lastModified().toMSecsSinceEpoch());
+}
+
+static void addDependencies(const Tileset &tileset, QSet<QString> &dependencies)
+{
+    if (tileset.isExternal())
+        dependencies.insert(tileset.fileName());
+    if (tileset.imageSource().isLocalFile())
+        dependencies.insert(tileset.imageSource().toLocalFile());
+
+    for (const Tile *tile : tileset.tiles())
+        if (tile->imageSource().isLocalFile())
+            dependencies.insert(tile->imageSource().toLocalFile());
+}
+
+/**
+ * Returns the files other than the map file itself that affect the preview of
+ * the given \a map: its external tilesets, images and object templates.
+ */
+static QStringList previewDependencies(const Map &map)
+{
+    QSet<QString> dependencies;
+
+    for (const SharedTileset &tileset : map.tilesets())
+        addDependencies(*tileset, dependencies);
+
+    LayerIterator iterator(&map, Layer::ImageLayerType | Layer::ObjectGroupType);
+    while (const Layer *layer = iterator.next()) {
+        if (layer->isImageLayer()) {
+            auto imageLayer = static_cast<const ImageLayer*>(layer);
+            if (imageLayer->imageSource().isLocalFile())
+                dependencies.insert(imageLayer->imageSource().toLocalFile());
+        } else {
+            auto objectGroup = static_cast<const ObjectGroup*>(layer);
+            for (const MapObject *object : objectGroup->objects())
+                if (const ObjectTemplate *objectTemplate = object->objectTemplate())
+                    dependencies.insert(objectTemplate->fileName());
+        }
+    }
+
+    dependencies.remove(QString());
+
+    QStringList sorted(dependencies.begin(), dependencies.end());
+    sorted.sort();
+    return sorted;
+}
+
+/**
+ * Stores the modification times of the \a dependencies in a form that can be
+ * saved along with the preview, one file per line.
+ */
+static QString dependenciesText(const QStringList &dependencies)
+{
+    QStringList lines;
+    lines.reserve(dependencies.size());
+
+    for (const QString &fileName : dependencies)
+        lines.append(lastModifiedString(fileName) + QLatin1Char(' ') + fileName);
+
+    return lines.join(QLatin1Char('\n'));
+}
+
+/**
+ * Returns the dependencies stored by dependenciesText(), or fails when any of
+ * them has been modified since.
+ */
+static bool upToDateDependencies(const QString &text, QStringList &dependencies)
+{
+    const QStringList lines = text.split(QLatin1Char('\n'), Qt::SkipEmptyParts);
+
+    for (const QString &line : lines) {
+        const int separator = line.indexOf(QLatin1Char(' '));
+        if (separator == -1)
+            return false;
+
+        const QString fileName = line.mid(separator + 1);
+        if (lastModifiedString(fileName) != QStringView(line).left(separator))
+            return false;
+
+        dependencies.append(fileName);
+    }
+
+    return true;
+}
+
+/**
+ * Reads the preview of the given map from the disk cache, provided neither
+ * the map nor any of the files it depends on changed since it was rendered.
+ * Called from a worker thread.
+ */
+static MapPreviewCache::Preview loadCachedPreview(const QString &fileName)
+{
+    const QString cacheFileName = previewCacheFileName(fileName);
+
+    QImageReader reader(cacheFileName);
+    MapPreviewCache::Preview preview;
+
+    if (reader.text(QStringLiteral("Source")) != fileName ||
+            reader.text(QStringLiteral("SourceModified")) != lastModifiedString(fileName) ||
+            !upToDateDependencies(reader.text(QStringLiteral("Dependencies")), preview.dependencies)) {
+        return {};
+    }
+
+    preview.image = reader.read();
+    if (preview.image.isNull())
+        return {};
+
+    // Mark the preview as recently used, see pruneDiskCache()
+    QFile file(cacheFileName);
+    if (file.open(QIODevice::ReadWrite))
+        file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+
+    return preview;
+}
+
+/**
+ * Renders the preview of the given map and stores it in the disk cache. The
+ * map should not share its tilesets with the rest of the application, since
+ * this is called from a worker thread.
+ */
+static MapPreviewCache::Preview renderPreview(const QString &fileName,
+                                              const QString &lastModified,
+                                              const Map &map)
+{
+    MapPreviewCache::Preview preview;
+    preview.dependencies = previewDependencies(map);
+
+    MiniMapRenderer miniMapRenderer(&map);
+
+    QSize size = miniMapRenderer.mapSize();
+    if (size.isEmpty())
+        return preview;
+    if (size.width() > PreviewSize || size.height() > PreviewSize)
+        size.scale(PreviewSize, PreviewSize, Qt::KeepAspectRatio);
+
+    const MiniMapRenderer::RenderFlags renderFlags(MiniMapRenderer::DrawTileLayers |
+                                                   MiniMapRenderer::DrawMapObjects |
+                                                   MiniMapRenderer::DrawImageLayers |
+                                                   MiniMapRenderer::IgnoreInvisibleLayer |
+                                                   MiniMapRenderer::SmoothPixmapTransform);
+
+    preview.image = miniMapRenderer.render(size, renderFlags);
+    preview.image.setText(QStringLiteral("Source"), fileName);
+    preview.image.setText(QStringLiteral("SourceModified"), lastModified);
+    preview.image.setText(QStringLiteral("Dependencies"), dependenciesText(preview.dependencies));
+
+    const QString cacheFileName = previewCacheFileName(fileName);
+    QDir().mkpath(QFileInfo(cacheFileName).path());
+    preview.image.save(cacheFileName, "PNG");
+
+    return preview;
+}
+
+/**
+ * Removes the previews that were not used for a long time from the disk cache,
+ * as well as the least recently used ones when it has grown too large.
+ */
+static void pruneDiskCache()
+{
+    QFileInfoList files;
+
+    QDirIterator it(previewCacheDir(), { QStringLiteral("*.png") }, QDir::Files);
+    while (it.hasNext()) {
+        it.next();
+        files.append(it.fileInfo());
+    }
+
+    std::sort(files.begin(), files.end(), [] (const QFileInfo &a, const QFileInfo &b) {
+        return a.lastModified() > b.lastModified();
+    });
+
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-MaxDiskCacheAgeDays);
+    qint64 totalSize = 0;
+
+    for (const QFileInfo &file : std::as_const(files)) {
+        totalSize += file.size();
+
+        if (totalSize > MaxDiskCacheSize || file.lastModified() < oldest)
+            QFile::remove(file.filePath());
+    }
+}
+
+
+MapPreviewCache *MapPreviewCache::mInstance;
+
+MapPreviewCache &MapPreviewCache::instance()
+{
+    if (!mInstance)
+        mInstance = new MapPreviewCache;
+
+    return *mInstance;
+}
+
+void MapPreviewCache::deleteInstance()
+{
+    delete mInstance;
+    mInstance = nullptr;
+}
+
+MapPreviewCache::MapPreviewCache()
+    : mPreviews(PreviewCacheBudgetKb)
+    , mWatcher(new FileSystemWatcher(this))
+{
+    // Leave most threads for rendering the current map
+    mThreadPool.setMaxThreadCount(2);
+
+    connect(mWatcher, &FileSystemWatcher::pathsChanged,
+            this, &MapPreviewCache::filesChanged);
+
+    mThreadPool.start(pruneDiskCache);
+}
+
+MapPreviewCache::~MapPreviewCache()
+{
+    mThreadPool.clear();
+    mThreadPool.waitForDone();
+}
+
+/**
+ * Returns the preview of the given map file. When it is not available yet,
+ * a null pixmap is returned and the preview is loaded in the background.
+ * The previewChanged() signal is emitted once it is available.
+ *
+ * A null pixmap is also returned for maps that could not be loaded. These are
+ * tried again once the map or any of its dependencies changes.
+ */
+QPixmap MapPreviewCache::preview(const QString &fileName)
+{
+    if (const QPixmap *pixmap = mPreviews.object(fileName))
+        return *pixmap;
+
+    if (mUnloadableMaps.contains(fileName))
+        return QPixmap();
+
+    if (!mPendingPreviews.contains(fileName)) {
+        mPendingPreviews.insert(fileName);
+
+        mThreadPool.start([this, fileName] {
+            const Preview preview = loadCachedPreview(fileName);
+            if (!preview.image.isNull()) {
+                QMetaObject::invokeMethod(this, [=] { previewLoaded(fileName, preview); },
+                                          Qt::QueuedConnection);
+                return;
+            }
+
+            readAndRenderMap(fileName);
+        });
+    }
+
+    return QPixmap();
+}
+
+/**
+ * Reads the given map and renders its preview. Called from a worker thread.
+ *
+ * Tilesets that are already loaded are shared with the map, and these may be
+ * changed on the main thread at any time. So before the map is rendered, its
+ * tilesets are replaced by copies on the main thread.
+ */
+void MapPreviewCache::readAndRenderMap(const QString &fileName)
+{
+    // Only formats that support it can be read outside of the main thread
+    MapFormat *format = findSupportingMapFormat(fileName);
+    if (!format || !format->hasCapabilities(FileFormat::ReadInBackground)) {
+        QMetaObject::invokeMethod(this, [=] { previewLoaded(fileName, Preview()); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+
+    const QString lastModified = lastModifiedString(fileName);
+    const std::shared_ptr<Map> map = format->read(fileName);
+
+    QMetaObject::invokeMethod(this, [=] {
+        if (!map) {
+            previewLoaded(fileName, Preview());
+            return;
+        }
+
+        // Includes the tilesets of template instances
+        map->addTilesets(map->usedTilesets());
+
+        const auto tilesets = map->tilesets();
+        for (const SharedTileset &tileset : tilesets)
+            map->replaceTileset(tileset, tileset->clone());
+
+        mThreadPool.start([=] {
+            const Preview preview = renderPreview(fileName, lastModified, *map);
+            QMetaObject::invokeMethod(this, [=] { previewLoaded(fileName, preview); },
+                                      Qt::QueuedConnection);
+        });
+    }, Qt::QueuedConnection);
+}
+
+void MapPreviewCache::previewLoaded(const QString &fileName, const Preview &preview)
+{
+    mPendingPreviews.remove(fileName);
+
+    if (preview.image.isNull()) {
+        mUnloadableMaps.insert(fileName);
+    } else {
+        auto pixmap = new QPixmap(QPixmap::fromImage(preview.image));
+        const qint64 bytes = qint64(pixmap->width()) * pixmap->height() * pixmap->depth() / 8;
+        mPreviews.insert(fileName, pixmap, qMax<qint64>(1, bytes / 1024));
+    }
+
+    watch(fileName, fileName);
+    for (const QString &dependency : preview.dependencies)
+        watch(dependency, fileName);
+
+    emit previewChanged(fileName);
+}
+
+/**
+ * Watches the given \a file, so that the preview of \a mapFileName is updated
+ * when it changes.
+ */
+void MapPreviewCache::watch(const QString &file, const QString &mapFileName)
+{
+    QSet<QString> &mapFileNames = mDependentMaps[file];
+    if (mapFileNames.isEmpty())
+        mWatcher->addPath(file);
+
+    mapFileNames.insert(mapFileName);
+}
+
+void MapPreviewCache::filesChanged(const QStringList &fileNames)
+{
+    QSet<QString> changedMaps;
+
+    for (const QString &fileName : fileNames) {
+        const auto it = mDependentMaps.constFind(fileName);
+        if (it != mDependentMaps.constEnd())
+            changedMaps.unite(it.value());
+    }
+
+    for (const QString &fileName : std::as_const(changedMaps)) {
+        const bool removed = mPreviews.remove(fileName);
+        if (mUnloadableMaps.remove(fileName) || removed)
+            emit previewChanged(fileName);
+    }
+}
+
+#include "moc_mappreviewcache.cpp"
@@ -0,0 +1,82 @@
+/*
+ * mappreviewcache.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPixmap>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+namespace Tiled {
+
+class FileSystemWatcher;
+
+/**
+ * Provides small previews of map files, used to display the other maps of a
+ * world without loading them.
+ *
+ * Previews are rendered in the background and stored on disk, so that they
+ * only need to be rendered again when the map file or any of the files it
+ * depends on has changed.
+ */
+class MapPreviewCache : public QObject
+{
+    Q_OBJECT
+
+    MapPreviewCache();
+    ~MapPreviewCache() override;
+
+public:
+    static MapPreviewCache &instance();
+    static void deleteInstance();
+
+    QPixmap preview(const QString &fileName);
+
+    struct Preview
+    {
+        QImage image;
+        QStringList dependencies;
+    };
+
+signals:
+    void previewChanged(const QString &fileName);
+
+private:
+    void readAndRenderMap(const QString &fileName);
+    void previewLoaded(const QString &fileName, const Preview &preview);
+    void watch(const QString &file, const QString &mapFileName);
+    void filesChanged(const QStringList &fileNames);
+
+    QCache<QString, QPixmap> mPreviews;     // cost in KB
+    QSet<QString> mPendingPreviews;
+    QSet<QString> mUnloadableMaps;
+    QHash<QString, QSet<QString>> mDependentMaps;   // file -> map files
+    QThreadPool mThreadPool;
+    FileSystemWatcher *mWatcher;
+
+    static MapPreviewCache *mInstance;
+};
+
+} // namespace Tiled
@@ -0,0 +1,126 @@
+/*
+ * mappreviewitem.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mappreviewitem.h"
+
+#include "documentmanager.h"
+#include "mappreviewcache.h"
+#include "mapview.h"
+#include "preferences.h"
+#include "zoomable.h"
+
+#include <QGraphicsSceneMouseEvent>
+#include <QPainter>
+
+using namespace Tiled;
+
+MapPreviewItem::MapPreviewItem(const QString &fileName, QGraphicsItem *parent)
+    : QGraphicsObject(parent)
+    , mFileName(fileName)
+{
+    setAcceptHoverEvents(true);
+    setZValue(-1);
+
+    connect(&MapPreviewCache::instance(), &MapPreviewCache::previewChanged,
+            this, &MapPreviewItem::previewChanged);
+    connect(Preferences::instance(), &Preferences::gridColorChanged,
+            this, [this] { update(); });
+}
+
+void MapPreviewItem::setSize(const QSize &size)
+{
+    if (mSize == size)
+        return;
+
+    prepareGeometryChange();
+    mSize = size;
+}
+
+QRectF MapPreviewItem::boundingRect() const
+{
+    return QRectF(QPointF(), mSize);
+}
+
+void MapPreviewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
+{
+    const QRectF rect = boundingRect();
+    const QPixmap preview = MapPreviewCache::instance().preview(mFileName);
+
+    if (!preview.isNull()) {
+        painter->setRenderHint(QPainter::SmoothPixmapTransform);
+        painter->drawPixmap(rect, preview, preview.rect());
+    }
+
+    // Matches the look of a MapItem in read-only mode
+    QPen pen(Preferences::instance()->gridColor());
+    pen.setCosmetic(true);
+    painter->setPen(pen);
+    painter->setBrush(QColor(0, 0, 0, mIsHovered ? 32 : 64));
+    painter->drawRect(rect);
+}
+
+void MapPreviewItem::hoverEnterEvent(QGraphicsSceneHoverEvent *)
+{
+    setCursor(Qt::PointingHandCursor);
+    mIsHovered = true;
+    update();
+}
+
+void MapPreviewItem::hoverLeaveEvent(QGraphicsSceneHoverEvent *)
+{
+    unsetCursor();
+    mIsHovered = false;
+    update();
+}
+
+void MapPreviewItem::mousePressEvent(QGraphicsSceneMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || !mIsHovered)
+        QGraphicsItem::mousePressEvent(event);
+}
+
+/**
+ * Loads the map and switches to it.
+ */
+void MapPreviewItem::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && isUnderMouse()) {
+        auto documentManager = DocumentManager::instance();
+        auto doc = documentManager->loadDocument(mFileName);
+
+        if (auto mapDocument = doc.objectCast<MapDocument>()) {
+            MapView *view = static_cast<MapView*>(event->widget()->parent());
+            documentManager->switchToDocumentAndHandleSimiliarTileset(mapDocument.data(),
+                                                                      view->viewCenter() - pos(),
+                                                                      view->zoomable()->scale());
+        }
+        return;
+    }
+
+    QGraphicsItem::mouseReleaseEvent(event);
+}
+
+void MapPreviewItem::previewChanged(const QString &fileName)
+{
+    if (fileName == mFileName)
+        update();
+}
+
+#include "moc_mappreviewitem.cpp"
@@ -0,0 +1,66 @@
+/*
+ * mappreviewitem.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of Tiled.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <QGraphicsObject>
+
+namespace Tiled {
+
+/**
+ * Displays a preview of a map in a world, used instead of a MapItem for maps
+ * that are not loaded. Clicking it opens the map.
+ */
+class MapPreviewItem : public QGraphicsObject
+{
+    Q_OBJECT
+
+public:
+    MapPreviewItem(const QString &fileName, QGraphicsItem *parent = nullptr);
+
+    const QString &fileName() const;
+
+    void setSize(const QSize &size);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter,
+               const QStyleOptionGraphicsItem *option,
+               QWidget *widget = nullptr) override;
+
+protected:
+    void hoverEnterEvent(QGraphicsSceneHoverEvent *event) override;
+    void hoverLeaveEvent(QGraphicsSceneHoverEvent *event) override;
+    void mousePressEvent(QGraphicsSceneMouseEvent *event) override;
+    void mouseReleaseEvent(QGraphicsSceneMouseEvent *event) override;
+
+private:
+    void previewChanged(const QString &fileName);
+
+    QString mFileName;
+    QSize mSize;
+    bool mIsHovered = false;
+};
+
+inline const QString &MapPreviewItem::fileName() const
+{
+    return mFileName;
+}
+
+} // namespace Tiled
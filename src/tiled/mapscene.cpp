@@ -23,13 +23,17 @@
 
 #include "mapscene.h"
 
+#include "abstracttiletool.h"
 #include "abstracttool.h"
+#include "abstractworldtool.h"
 #include "addremovemapobject.h"
+#include "brushitem.h"
 #include "containerhelpers.h"
 #include "debugdrawitem.h"
 #include "documentmanager.h"
 #include "map.h"
 #include "mapobject.h"
+#include "mappreviewitem.h"
 #include "maprenderer.h"
 #include "objectgroup.h"
 #include "objecttemplate.h"
@@ -53,6 +57,9 @@
 
 using namespace Tiled;
 
+// Below this scale, the other maps of a world are displayed using previews
+static const qreal MinimumFullMapScale = 0.25;
+
 SessionOption<bool> MapScene::enableWorlds { "mapScene.enableWorlds", true };
 
 MapScene::MapScene(QObject *parent)
@@ -67,8 +74,8 @@ MapScene::MapScene(QObject *parent)
     TilesetManager *tilesetManager = TilesetManager::instance();
     connect(tilesetManager, &TilesetManager::tilesetImagesChanged,
             this, &MapScene::repaintTileset);
-    connect(tilesetManager, &TilesetManager::repaintTileset,
-            this, &MapScene::repaintTileset);
+    connect(tilesetManager, &TilesetManager::repaintTiles,
+            this, &MapScene::repaintTiles);
 
     WorldManager &worldManager = WorldManager::instance();
     connect(&worldManager, &WorldManager::worldsChanged, this, &MapScene::refreshScene);
@@ -148,8 +155,12 @@ void MapScene::setParallaxEnabled(bool enabled)
  */
 void MapScene::setPainterScale(qreal painterScale)
 {
+    mPainterScale = painterScale;
+
     for (auto mapItem : std::as_const(mMapItems))
         mapItem->mapDocument()->renderer()->setPainterScale(painterScale);
+
+    updateWorldMaps();
 }
 
 void MapScene::setSuppressMouseMoveEvents(bool suppress)
@@ -191,6 +202,10 @@ void MapScene::setSelectedTool(AbstractTool *tool)
 
     if (tool && mMapDocument) {
         mSelectedTool = tool;
+
+        // The world tools need all maps to be loaded
+        updateWorldMaps();
+
         mSelectedTool->activate(this);
 
         if (!mSelectedTool)
@@ -218,6 +233,43 @@ void MapScene::setViewRect(const QRectF &rect)
 
     if (mParallaxEnabled)
         emit parallaxParametersChanged();
+
+    for (MapItem *mapItem : std::as_const(mMapItems))
+        mapItem->updateObjectItemsInView();
+
+    updateWorldMaps();
+}
+
+/**
+ * Calls \a visit for the items of the map objects at the given scene
+ * position \a pos, from top to bottom, until it returns false.
+ *
+ * Uses the spatial index of the object groups rather than the scene, since
+ * not all objects have an item when the object groups are large.
+ */
+bool MapScene::visitMapObjectItemsAt(const QPointF &pos,
+                                     const QTransform &viewTransform,
+                                     const MapItem::ObjectItemVisitor &visit) const
+{
+    for (MapItem *mapItem : std::as_const(mMapItems))
+        if (mapItem->isVisible() && !mapItem->visitObjectItemsAt(pos, viewTransform, visit))
+            return false;
+    return true;
+}
+
+/**
+ * Calls \a visit for the items of the map objects within the given scene
+ * \a rect, from top to bottom, until it returns false.
+ */
+bool MapScene::visitMapObjectItemsIn(const QRectF &rect,
+                                     Qt::ItemSelectionMode mode,
+                                     const QTransform &viewTransform,
+                                     const MapItem::ObjectItemVisitor &visit) const
+{
+    for (MapItem *mapItem : std::as_const(mMapItems))
+        if (mapItem->isVisible() && !mapItem->visitObjectItemsIn(rect, mode, viewTransform, visit))
+            return false;
+    return true;
 }
 
 void MapScene::setOverrideBackgroundColor(QColor backgroundColor)
@@ -291,10 +343,15 @@ QPointF MapScene::parallaxOffset(const Layer &layer) const
 void MapScene::refreshScene()
 {
     QHash<MapDocument*, MapItem*> mapItems;
+    QHash<QString, MapPreviewItem*> previewItems;
 
     if (!mMapDocument) {
         mMapItems.swap(mapItems);
+        mPreviewItems.swap(previewItems);
         qDeleteAll(mapItems);
+        qDeleteAll(previewItems);
+        mLoadingMaps.clear();
+        mUnloadableMaps.clear();
         updateSceneRect();
         return;
     }
@@ -306,15 +363,36 @@ void MapScene::refreshScene()
         const auto world = worldDocument->world();
         const QPoint currentMapPosition = world->mapRect(currentMapFile).topLeft();
         auto const contextMaps = world->contextMaps(currentMapFile);
+        auto documentManager = DocumentManager::instance();
 
         for (const WorldMapEntry &mapEntry : contextMaps) {
+            const QPointF pos = mapEntry.rect.topLeft() - currentMapPosition;
             MapDocumentPtr mapDocument;
 
             if (mapEntry.fileName == currentMapFile) {
                 mapDocument = mMapDocument->sharedFromThis();
             } else {
-                auto doc = DocumentManager::instance()->loadDocument(mapEntry.fileName);
-                mapDocument = doc.objectCast<MapDocument>();
+                // Other maps are only loaded when needed, and only kept
+                // loaded by this scene while they are needed
+                auto doc = documentManager->loadedDocument(mapEntry.fileName).objectCast<MapDocument>();
+                const bool displayedFully = doc && mMapItems.contains(doc.data());
+                const bool keepLoaded = doc && (doc->isModified() ||
+                                                documentManager->findDocument(doc.data()) != -1);
+
+                if (keepLoaded || needsFullMap(QRectF(pos, mapEntry.rect.size()), displayedFully)) {
+                    if (doc)
+                        mapDocument = doc;
+                    else
+                        loadMapInBackground(mapEntry.fileName);
+                }
+
+                if (!mapDocument) {
+                    auto previewItem = takeOrCreatePreviewItem(mapEntry.fileName);
+                    previewItem->setPos(pos);
+                    previewItem->setSize(mapEntry.rect.size());
+                    previewItem->setVisible(mWorldsEnabled);
+                    previewItems.insert(mapEntry.fileName, previewItem);
+                }
             }
 
             if (mapDocument) {
@@ -323,7 +401,7 @@ void MapScene::refreshScene()
                     displayMode = MapItem::Editable;
 
                 auto mapItem = takeOrCreateMapItem(mapDocument, displayMode);
-                mapItem->setPos(mapEntry.rect.topLeft() - currentMapPosition);
+                mapItem->setPos(pos);
                 mapItem->setVisible(mWorldsEnabled || mapDocument == mMapDocument);
                 mapItems.insert(mapDocument.data(), mapItem);
             }
@@ -334,7 +412,9 @@ void MapScene::refreshScene()
     }
 
     mMapItems.swap(mapItems);
+    mPreviewItems.swap(previewItems);
     qDeleteAll(mapItems);       // delete all map items that didn't get reused
+    qDeleteAll(previewItems);
 
     for (MapItem *mapItem : std::as_const(mMapItems))
         mapItem->updateLayerPositions();
@@ -378,6 +458,8 @@ void MapScene::updateSceneRect()
 
     for (MapItem *mapItem : std::as_const(mMapItems))
         sceneRect |= mapItem->boundingRect().translated(mapItem->pos());
+    for (MapPreviewItem *previewItem : std::as_const(mPreviewItems))
+        sceneRect |= previewItem->boundingRect().translated(previewItem->pos());
 
     setSceneRect(sceneRect);
 }
@@ -388,9 +470,7 @@ void MapScene::setWorldsEnabled(bool enabled)
         return;
 
     mWorldsEnabled = enabled;
-
-    for (MapItem *mapItem : std::as_const(mMapItems))
-        mapItem->setVisible(mWorldsEnabled || mapItem->mapDocument() == mMapDocument);
+    refreshScene();
 }
 
 MapItem *MapScene::takeOrCreateMapItem(const MapDocumentPtr &mapDocument, MapItem::DisplayMode displayMode)
@@ -409,6 +489,99 @@ MapItem *MapScene::takeOrCreateMapItem(const MapDocumentPtr &mapDocument, MapIte
     return mapItem;
 }
 
+MapPreviewItem *MapScene::takeOrCreatePreviewItem(const QString &fileName)
+{
+    auto previewItem = mPreviewItems.take(fileName);
+    if (!previewItem) {
+        previewItem = new MapPreviewItem(fileName);
+        addItem(previewItem);
+    }
+    return previewItem;
+}
+
+/**
+ * Returns whether the other map of the world at the given \a rect should be
+ * displayed fully rather than as preview. This is the case while a world
+ * tool is selected, or when the map is near the view and the view is zoomed
+ * in far enough.
+ *
+ * Maps that are \a displayedFully are kept a little longer, to avoid them
+ * getting loaded and unloaded repeatedly.
+ */
+bool MapScene::needsFullMap(const QRectF &rect, bool displayedFully) const
+{
+    if (!mWorldsEnabled)
+        return false;
+
+    // Without a size there is nothing to show as preview
+    if (rect.isEmpty() || qobject_cast<AbstractWorldTool*>(mSelectedTool))
+        return true;
+
+    const qreal minimumScale = displayedFully ? MinimumFullMapScale / 2
+                                              : MinimumFullMapScale;
+    if (mPainterScale < minimumScale)
+        return false;
+
+    const qreal margin = displayedFully ? 1.0 : 0.5;
+    const qreal dx = mViewRect.width() * margin;
+    const qreal dy = mViewRect.height() * margin;
+    return mViewRect.adjusted(-dx, -dy, dx, dy).intersects(rect);
+}
+
+void MapScene::loadMapInBackground(const QString &fileName)
+{
+    if (mLoadingMaps.contains(fileName) || mUnloadableMaps.contains(fileName))
+        return;
+
+    mLoadingMaps.insert(fileName);
+
+    auto callback = [this, fileName] (const DocumentPtr &document, const QString &) {
+        mLoadingMaps.remove(fileName);
+
+        if (document)
+            refreshScene();
+        else
+            mUnloadableMaps.insert(fileName);
+    };
+
+    DocumentManager::instance()->loadDocumentInBackground(fileName, nullptr, this, callback);
+}
+
+/**
+ * Refreshes the scene when any of the other maps of the world need to be
+ * loaded or can be unloaded, based on the view and the selected tool.
+ */
+void MapScene::updateWorldMaps()
+{
+    if (!mMapDocument)
+        return;
+
+    for (MapPreviewItem *previewItem : std::as_const(mPreviewItems)) {
+        const QString &fileName = previewItem->fileName();
+        if (mLoadingMaps.contains(fileName) || mUnloadableMaps.contains(fileName))
+            continue;
+
+        if (needsFullMap(previewItem->sceneBoundingRect(), false)) {
+            refreshScene();
+            return;
+        }
+    }
+
+    auto documentManager = DocumentManager::instance();
+
+    for (auto it = mMapItems.cbegin(), it_end = mMapItems.cend(); it != it_end; ++it) {
+        MapDocument *mapDocument = it.key();
+        if (mapDocument == mMapDocument || mapDocument->isModified() ||
+                documentManager->findDocument(mapDocument) != -1)
+            continue;
+
+        if (!needsFullMap(it.value()->sceneBoundingRect(), true)) {
+            refreshScene();
+            return;
+        }
+    }
+}
+
 void MapScene::changeEvent(const ChangeEvent &change)
 {
     switch (change.type) {
@@ -445,12 +618,34 @@ void MapScene::changeEvent(const ChangeEvent &change)
 
 void MapScene::repaintTileset(Tileset *tileset)
 {
+    bool needsUpdate = false;
+
     for (MapItem *mapItem : std::as_const(mMapItems)) {
         if (contains(mapItem->mapDocument()->map()->tilesets(), tileset)) {
-            update();
-            return;
+            mapItem->repaintTileset(tileset);
+            needsUpdate = true;
         }
     }
+
+    if (needsUpdate)
+        update();
+}
+
+/**
+ * Repaints only the areas showing any of the given \a tiles, which happens
+ * for each frame of their animations.
+ */
+void MapScene::repaintTiles(const QList<Tile*> &tiles)
+{
+    for (MapItem *mapItem : std::as_const(mMapItems))
+        mapItem->repaintTiles(tiles);
+
+    // The brush of tile tools may show animated tiles as well
+    if (auto tileTool = qobject_cast<AbstractTileTool*>(mSelectedTool)) {
+        BrushItem *brushItem = tileTool->brushItem();
+        if (brushItem && brushItem->isVisible())
+            brushItem->update();
+    }
 }
 
 void MapScene::tilesetReplaced(int index, Tileset *tileset, Tileset *oldTileset)
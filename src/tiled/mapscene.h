@@ -30,6 +30,7 @@
 #include <QColor>
 #include <QGraphicsScene>
 #include <QHash>
+#include <QSet>
 
 namespace Tiled {
 
@@ -45,6 +46,7 @@ class DebugDrawItem;
 class LayerItem;
 class MapDocument;
 class MapObjectItem;
+class MapPreviewItem;
 class MapScene;
 class ObjectGroupItem;
 
@@ -78,6 +80,14 @@ public:
     const QRectF &viewRect() const;
     void setViewRect(const QRectF &rect);
 
+    bool visitMapObjectItemsAt(const QPointF &pos,
+                               const QTransform &viewTransform,
+                               const MapItem::ObjectItemVisitor &visit) const;
+    bool visitMapObjectItemsIn(const QRectF &rect,
+                               Qt::ItemSelectionMode mode,
+                               const QTransform &viewTransform,
+                               const MapItem::ObjectItemVisitor &visit) const;
+
     void setOverrideBackgroundColor(QColor backgroundColor);
 
     QPointF absolutePositionForLayer(const Layer &layer) const;
@@ -115,6 +125,7 @@ private:
 
     void changeEvent(const ChangeEvent &change);
     void repaintTileset(Tileset *tileset);
+    void repaintTiles(const QList<Tile*> &tiles);
 
     void tilesetReplaced(int index, Tileset *tileset, Tileset *oldTileset);
 
@@ -126,6 +137,11 @@ private:
 
     MapItem *takeOrCreateMapItem(const MapDocumentPtr &mapDocument,
                                  MapItem::DisplayMode displayMode);
+    MapPreviewItem *takeOrCreatePreviewItem(const QString &fileName);
+
+    bool needsFullMap(const QRectF &rect, bool displayedFully) const;
+    void loadMapInBackground(const QString &fileName);
+    void updateWorldMaps();
 
     bool eventFilter(QObject *object, QEvent *event) override;
 
@@ -133,6 +149,9 @@ private:
 
     MapDocument *mMapDocument = nullptr;
     QHash<MapDocument*, MapItem*> mMapItems;
+    QHash<QString, MapPreviewItem*> mPreviewItems;
+    QSet<QString> mLoadingMaps;
+    QSet<QString> mUnloadableMaps;
     AbstractTool *mSelectedTool = nullptr;
     DebugDrawItem *mDebugDrawItem = nullptr;
     bool mUnderMouse = false;
@@ -146,6 +165,7 @@ private:
     Qt::KeyboardModifiers mLastModifiers = Qt::NoModifier;
     QPointF mLastMousePos;
     QRectF mViewRect;
+    qreal mPainterScale = 1.0;
     QColor mDefaultBackgroundColor;
     QColor mOverrideBackgroundColor;
 };
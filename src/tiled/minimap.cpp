@@ -21,12 +21,19 @@
 
 #include "minimap.h"
 
+#include "changeevents.h"
+#include "containerhelpers.h"
 #include "documentmanager.h"
+#include "geometry.h"
 #include "map.h"
 #include "mapdocument.h"
+#include "mapobject.h"
 #include "maprenderer.h"
 #include "mapscene.h"
 #include "mapview.h"
+#include "objectgroup.h"
+#include "tile.h"
+#include "tilesetmanager.h"
 #include "utils.h"
 #include "zoomable.h"
 
@@ -34,6 +41,9 @@
 #include <QResizeEvent>
 #include <QScrollBar>
 #include <QUndoStack>
+#include <QtConcurrent>
+
+#include <memory>
 
 using namespace Tiled;
 
@@ -42,12 +52,15 @@ MiniMap::MiniMap(QWidget *parent)
     , mMapDocument(nullptr)
     , mDragging(false)
     , mMouseMoveCursorState(false)
-    , mRedrawMapImage(false)
+    , mFullRedraw(true)
+    , mChangeTracked(false)
     , mRenderFlags(MiniMapRenderer::DrawTileLayers
                    | MiniMapRenderer::DrawMapObjects
                    | MiniMapRenderer::DrawImageLayers
                    | MiniMapRenderer::IgnoreInvisibleLayer
                    | MiniMapRenderer::SmoothPixmapTransform)
+    , mRenderGeneration(0)
+    , mPendingGeneration(0)
 {
     setFrameStyle(QFrame::StyledPanel | QFrame::Sunken);
     setMinimumSize(50, 50);
@@ -57,7 +70,16 @@ MiniMap::MiniMap(QWidget *parent)
 
     mMapImageUpdateTimer.setSingleShot(true);
     connect(&mMapImageUpdateTimer, &QTimer::timeout,
-            this, &MiniMap::redrawTimeout);
+            this, &MiniMap::startRender);
+    connect(&mRenderWatcher, &QFutureWatcherBase::finished,
+            this, &MiniMap::renderFinished);
+    connect(TilesetManager::instance(), &TilesetManager::tilesetImagesChanged,
+            this, &MiniMap::tilesetChanged);
+}
+
+MiniMap::~MiniMap()
+{
+    mRenderWatcher.waitForFinished();
 }
 
 void MiniMap::setMapDocument(MapDocument *map)
@@ -66,6 +88,7 @@ void MiniMap::setMapDocument(MapDocument *map)
 
     if (mMapDocument) {
         mMapDocument->disconnect(this);
+        mMapDocument->undoStack()->disconnect(this);
 
         if (MapView *mapView = dm->viewForDocument(mMapDocument))
             mapView->disconnect(this);
@@ -73,9 +96,41 @@ void MiniMap::setMapDocument(MapDocument *map)
 
     mMapDocument = map;
 
+    // Any render in progress is for the previous map
+    ++mRenderGeneration;
+    mDirtyMapRegion = QRegion();
+    mObjectBounds.clear();
+    mTilesetCopies.clear();
+
     if (mMapDocument) {
         connect(mMapDocument->undoStack(), &QUndoStack::indexChanged,
+                this, &MiniMap::undoIndexChanged);
+        connect(mMapDocument, &Document::changed,
+                this, &MiniMap::documentChanged);
+        connect(mMapDocument, &MapDocument::regionChanged,
+                this, &MiniMap::regionChanged);
+
+        connect(mMapDocument, &MapDocument::mapResized,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::layerAdded,
                 this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::layerRemoved,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tileLayerChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tilesetReplaced,
+                this, [this] (int, Tileset *, Tileset *oldTileset) {
+            mTilesetCopies.remove(oldTileset);
+            scheduleMapImageUpdate();
+        });
+        connect(mMapDocument, &MapDocument::tilesetRemoved,
+                this, [this] (Tileset *tileset) { mTilesetCopies.remove(tileset); });
+        connect(mMapDocument, &MapDocument::objectsIndexChanged,
+                this, &MiniMap::scheduleMapImageUpdate);
+        connect(mMapDocument, &MapDocument::tilesetTilePositioningChanged,
+                this, &MiniMap::tilesetChanged);
+        connect(mMapDocument, &MapDocument::tileImageSourceChanged,
+                this, &MiniMap::tileImageSourceChanged);
 
         if (MapView *mapView = dm->viewForDocument(mMapDocument))
             connect(mapView, &MapView::viewRectChanged, this, [this] { update(); });
@@ -91,17 +146,169 @@ QSize MiniMap::sizeHint() const
 
 void MiniMap::scheduleMapImageUpdate()
 {
+    mFullRedraw = true;
+    mChangeTracked = true;
     mMapImageUpdateTimer.start(100);
 }
 
-void MiniMap::paintEvent(QPaintEvent *pe)
+/**
+ * Marks the given \a area of the map, in pixel coordinates, to be repainted.
+ *
+ * While changes keep coming in, the image is still updated at a regular
+ * interval, rather than waiting until the changes stop.
+ */
+void MiniMap::invalidateMapArea(const QRectF &area)
 {
-    QFrame::paintEvent(pe);
+    mChangeTracked = true;
+
+    if (area.isEmpty())
+        return;
+
+    mDirtyMapRegion += area.toAlignedRect();
+
+    if (!mMapImageUpdateTimer.isActive())
+        mMapImageUpdateTimer.start(100);
+}
+
+void MiniMap::regionChanged(const QRegion &region, TileLayer *tileLayer)
+{
+    mChangeTracked = true;
+
+    if (mRenderFlags.testFlag(MiniMapRenderer::IgnoreInvisibleLayer) && tileLayer->isHidden())
+        return;
+
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QMargins margins = mMapDocument->map()->drawMargins();
+    const QPointF offset = tileLayer->totalOffset();
+
+    auto invalidateTiles = [&] (const QRect &rect) {
+        const QRectF area = renderer->boundingRect(rect).marginsAdded(margins);
+        invalidateMapArea(area.translated(offset));
+    };
+
+    // Avoid building up a complex dirty region for scattered changes
+    if (region.rectCount() > 16) {
+        invalidateTiles(region.boundingRect());
+        return;
+    }
+
+    for (const QRect &rect : region)
+        invalidateTiles(rect);
+}
 
-    if (mRedrawMapImage) {
-        renderMapToImage();
-        mRedrawMapImage = false;
+void MiniMap::documentChanged(const ChangeEvent &change)
+{
+    switch (change.type) {
+    case ChangeEvent::MapObjectsAdded:
+    case ChangeEvent::MapObjectsChanged:
+        for (const MapObject *object : static_cast<const MapObjectsEvent&>(change).mapObjects) {
+            const auto it = mObjectBounds.constFind(object);
+            if (it != mObjectBounds.constEnd()) {
+                invalidateMapArea(*it);
+            } else if (change.type == ChangeEvent::MapObjectsChanged) {
+                // Unknown where the object was drawn before
+                scheduleMapImageUpdate();
+            }
+
+            const QRectF bounds = objectBounds(object);
+            mObjectBounds.insert(object, bounds);
+            invalidateMapArea(bounds);
+        }
+        break;
+    case ChangeEvent::MapObjectsAboutToBeRemoved:
+        for (const MapObject *object : static_cast<const MapObjectsEvent&>(change).mapObjects) {
+            const QRectF bounds = mObjectBounds.take(object);
+            invalidateMapArea(bounds.isNull() ? objectBounds(object) : bounds);
+        }
+        break;
+    case ChangeEvent::TilesetChanged:
+        tilesetChanged(static_cast<const TilesetChangeEvent&>(change).tileset);
+        break;
+
+    // Covered by the above events or not affecting the minimap
+    case ChangeEvent::DocumentAboutToReload:
+    case ChangeEvent::MapObjectAboutToBeAdded:
+    case ChangeEvent::MapObjectAboutToBeRemoved:
+    case ChangeEvent::MapObjectAdded:
+    case ChangeEvent::MapObjectRemoved:
+    case ChangeEvent::MapObjectsRemoved:
+    case ChangeEvent::TilesAboutToBeRemoved:
+    case ChangeEvent::WangSetAboutToBeAdded:
+    case ChangeEvent::WangSetAboutToBeRemoved:
+    case ChangeEvent::WangSetAdded:
+    case ChangeEvent::WangSetRemoved:
+    case ChangeEvent::WangSetChanged:
+    case ChangeEvent::WangColorAboutToBeRemoved:
+    case ChangeEvent::WangColorChanged:
+        mChangeTracked = true;
+        break;
+
+    default:
+        scheduleMapImageUpdate();
+        break;
     }
+}
+
+/**
+ * Falls back to a full redraw for undo commands that changed the map without
+ * any of the above signals.
+ */
+void MiniMap::undoIndexChanged()
+{
+    if (!mChangeTracked)
+        scheduleMapImageUpdate();
+
+    mChangeTracked = false;
+}
+
+/**
+ * Drops the copy of the given \a tileset used for rendering, since it
+ * changed in a way that may affect the minimap.
+ */
+void MiniMap::tilesetChanged(Tileset *tileset)
+{
+    mTilesetCopies.remove(tileset);
+
+    if (mMapDocument && contains(mMapDocument->map()->tilesets(), tileset))
+        scheduleMapImageUpdate();
+}
+
+void MiniMap::tileImageSourceChanged(Tile *tile)
+{
+    tilesetChanged(tile->tileset());
+}
+
+/**
+ * Returns the area covered by the given \a object, in map pixel coordinates.
+ */
+QRectF MiniMap::objectBounds(const MapObject *object) const
+{
+    const MapRenderer *renderer = mMapDocument->renderer();
+    QRectF bounds = renderer->boundingRect(object);
+
+    if (object->rotation() != qreal(0)) {
+        const QPointF origin = renderer->pixelToScreenCoords(object->position());
+        bounds = rotateAt(origin, object->rotation()).mapRect(bounds);
+    }
+
+    if (const ObjectGroup *objectGroup = object->objectGroup())
+        bounds.translate(objectGroup->totalOffset());
+
+    return bounds;
+}
+
+void MiniMap::updateObjectBounds()
+{
+    mObjectBounds.clear();
+
+    for (const Layer *layer : mMapDocument->map()->objectGroups())
+        for (const MapObject *object : static_cast<const ObjectGroup*>(layer)->objects())
+            mObjectBounds.insert(object, objectBounds(object));
+}
+
+void MiniMap::paintEvent(QPaintEvent *pe)
+{
+    QFrame::paintEvent(pe);
 
     if (mMapImage.isNull() || mImageRect.isEmpty())
         return;
@@ -155,10 +362,69 @@ void MiniMap::updateImageRect()
     mImageRect = imageRect;
 }
 
-void MiniMap::renderMapToImage()
+/**
+ * Returns a copy of \a map that can be rendered on another thread.
+ *
+ * Map::clone() copies the layers, which takes time linear in the number of
+ * chunks and objects, but still shares the tilesets. Since tilesets and
+ * their tiles may change on the GUI thread at any time (for example when a
+ * tileset image is reloaded), each tileset is replaced by a copy as well.
+ * The tile images themselves are implicitly shared with those copies.
+ *
+ * The copies are kept between renders and are never modified, so they can
+ * be shared with renders still in progress. A copy is dropped when its
+ * tileset changes, or when tiles were added or removed since it was made.
+ *
+ * Tile animations don't need to be frozen, since the MiniMapRenderer always
+ * draws the tiles themselves rather than their current frame.
+ */
+std::shared_ptr<const Map> MiniMap::snapshotForRendering()
 {
-    if (!mMapDocument) {
+    std::shared_ptr<Map> snapshot = mMapDocument->map()->clone();
+    QHash<Tileset*, SharedTileset> tilesetCopies;
+
+    const auto tilesets = snapshot->tilesets();
+    for (const SharedTileset &tileset : tilesets) {
+        SharedTileset copy = mTilesetCopies.value(tileset.data());
+        if (!copy || copy->tileCount() != tileset->tileCount() ||
+                copy->nextTileId() != tileset->nextTileId()) {
+            copy = tileset->clone();
+        }
+
+        tilesetCopies.insert(tileset.data(), copy);
+        snapshot->replaceTileset(tileset, copy);
+    }
+
+    // Only keep the copies of tilesets that are still used by the map
+    mTilesetCopies.swap(tilesetCopies);
+
+    return snapshot;
+}
+
+/**
+ * Starts rendering the changed parts of the map, or the whole map when
+ * necessary, in the background.
+ *
+ * The rendering is done on a snapshot of the map, so the map can keep
+ * changing while the minimap is rendered. See snapshotForRendering().
+ */
+void MiniMap::startRender()
+{
+    // Another render is started when this one finishes
+    if (mRenderWatcher.isRunning())
+        return;
+
+    auto clearImage = [this] {
         mMapImage = QImage();
+        mImageTransform = QTransform();
+        mDirtyMapRegion = QRegion();
+        mFullRedraw = false;
+        updateImageRect();
+        update();
+    };
+
+    if (!mMapDocument) {
+        clearImage();
         return;
     }
 
@@ -166,7 +432,7 @@ void MiniMap::renderMapToImage()
 
     const QSize mapSize = miniMapRenderer.mapSize();
     if (mapSize.isEmpty()) {
-        mMapImage = QImage();
+        clearImage();
         return;
     }
 
@@ -181,16 +447,65 @@ void MiniMap::renderMapToImage()
     if (imageSize.width() < 512 && imageSize.height() < 512)
         imageSize *= 2;
 
-    // Allocate a new image when the size changed
-    if (mMapImage.size() != imageSize) {
-        mMapImage = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
-        updateImageRect();
+    if (imageSize.isEmpty()) {
+        clearImage();
+        return;
     }
 
-    if (imageSize.isEmpty())
-        return;
+    const QTransform transform = miniMapRenderer.transform(imageSize, mRenderFlags);
+
+    QImage image;
+    QRegion exposed;
 
-    miniMapRenderer.renderToImage(mMapImage, mRenderFlags);
+    if (mFullRedraw || mMapImage.size() != imageSize || mImageTransform != transform) {
+        image = QImage(imageSize, QImage::Format_ARGB32_Premultiplied);
+        updateObjectBounds();
+    } else {
+        const QRect imageRect(QPoint(), imageSize);
+
+        // Include a margin for the smooth scaling of the tiles
+        for (const QRect &rect : std::as_const(mDirtyMapRegion)) {
+            const QRect imageArea = transform.mapRect(QRectF(rect)).toAlignedRect();
+            exposed += imageArea.adjusted(-2, -2, 2, 2) & imageRect;
+        }
+
+        if (exposed.isEmpty()) {
+            mDirtyMapRegion = QRegion();
+            return;
+        }
+
+        image = mMapImage;
+    }
+
+    mFullRedraw = false;
+    mDirtyMapRegion = QRegion();
+    mRenderTransform = transform;
+    mPendingGeneration = mRenderGeneration;
+
+    const std::shared_ptr<const Map> map = snapshotForRendering();
+    const MiniMapRenderer::RenderFlags renderFlags = mRenderFlags;
+
+    mRenderWatcher.setFuture(QtConcurrent::run([map, image, exposed, renderFlags] {
+        QImage result = image;
+        MiniMapRenderer(map.get()).renderToImage(result, renderFlags, exposed);
+        return result;
+    }));
+}
+
+void MiniMap::renderFinished()
+{
+    QImage image = mRenderWatcher.future().takeResult();
+
+    // Ignore the result when the map was changed in the meantime
+    if (mPendingGeneration == mRenderGeneration) {
+        mMapImage = image;
+        mImageTransform = mRenderTransform;
+        updateImageRect();
+        update();
+    }
+
+    if ((mFullRedraw || !mDirtyMapRegion.isEmpty()) && !mMapImageUpdateTimer.isActive())
+        mMapImageUpdateTimer.start(100);
 }
 
 void MiniMap::centerViewOnLocalPixel(const QPointF &centerPos, int delta)
@@ -205,12 +520,6 @@ void MiniMap::centerViewOnLocalPixel(const QPointF &centerPos, int delta)
     mapView->forceCenterOn(mapToScene(centerPos));
 }
 
-void MiniMap::redrawTimeout()
-{
-    mRedrawMapImage = true;
-    update();
-}
-
 void MiniMap::wheelEvent(QWheelEvent *event)
 {
     if (event->angleDelta().y()) {
@@ -22,14 +22,26 @@
 #pragma once
 
 #include "minimaprenderer.h"
+#include "tileset.h"
 
 #include <QFrame>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QImage>
+#include <QRegion>
 #include <QTimer>
+#include <QTransform>
+
+#include <memory>
 
 namespace Tiled {
 
+class ChangeEvent;
+class Map;
 class MapDocument;
+class MapObject;
+class Tile;
+class TileLayer;
 
 class MiniMap : public QFrame
 {
@@ -37,6 +49,7 @@ class MiniMap : public QFrame
 
 public:
     MiniMap(QWidget *parent);
+    ~MiniMap() override;
 
     void setMapDocument(MapDocument *);
 
@@ -46,7 +59,7 @@ public:
     QSize sizeHint() const override;
 
 public slots:
-    /** Schedules a redraw of the minimap image. */
+    /** Schedules a full redraw of the minimap image. */
     void scheduleMapImageUpdate();
 
 protected:
@@ -58,22 +71,52 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
 
 private:
-    void redrawTimeout();
+    void renderFinished();
+
+    void invalidateMapArea(const QRectF &area);
+    void regionChanged(const QRegion &region, TileLayer *tileLayer);
+    void documentChanged(const ChangeEvent &change);
+    void undoIndexChanged();
+    void tilesetChanged(Tileset *tileset);
+    void tileImageSourceChanged(Tile *tile);
+
+    std::shared_ptr<const Map> snapshotForRendering();
+
+    QRectF objectBounds(const MapObject *object) const;
+    void updateObjectBounds();
 
     MapDocument *mMapDocument;
     QImage mMapImage;
+    QTransform mImageTransform;
     QRect mImageRect;
     QTimer mMapImageUpdateTimer;
     bool mDragging;
     QPoint mDragOffset;
     bool mMouseMoveCursorState;
-    bool mRedrawMapImage;
+    bool mFullRedraw;
+    bool mChangeTracked;
     MiniMapRenderer::RenderFlags mRenderFlags;
 
+    // Changed parts of the map since the last render, in pixel coordinates
+    QRegion mDirtyMapRegion;
+
+    // Bounds of the objects as last rendered, to know what to repaint when
+    // they move or are removed
+    QHash<const MapObject*, QRectF> mObjectBounds;
+
+    // Copies of the tilesets of the map, reused between renders until the
+    // original tileset changes
+    QHash<Tileset*, SharedTileset> mTilesetCopies;
+
+    QFutureWatcher<QImage> mRenderWatcher;
+    QTransform mRenderTransform;
+    int mRenderGeneration;
+    int mPendingGeneration;
+
     QRect viewportRect() const;
     QPointF mapToScene(QPointF p) const;
     void updateImageRect();
-    void renderMapToImage();
+    void startRender();
     void centerViewOnLocalPixel(const QPointF &centerPos, int delta = 0);
 };
 
@@ -21,14 +21,16 @@
 #pragma once
 
 #include "layeritem.h"
+#include "mapobjectindex.h"
 
 #include "objectgroup.h"
 
 namespace Tiled {
 
 /**
- * A graphics item representing an object group in a QGraphicsView. It only
- * serves to group together the objects belonging to the same object group.
+ * A graphics item representing an object group in a QGraphicsView. It
+ * serves to group together the objects belonging to the same object group,
+ * and keeps a spatial index of those objects in its coordinates.
  *
  * @see MapObjectItem
  */
@@ -39,11 +41,17 @@ public:
 
     ObjectGroup *objectGroup() const;
 
+    MapObjectIndex &objectIndex() { return mObjectIndex; }
+    const MapObjectIndex &objectIndex() const { return mObjectIndex; }
+
     // QGraphicsItem
     QRectF boundingRect() const override;
     void paint(QPainter *painter,
                const QStyleOptionGraphicsItem *option,
                QWidget *widget = nullptr) override;
+
+private:
+    MapObjectIndex mObjectIndex;
 };
 
 inline ObjectGroup *ObjectGroupItem::objectGroup() const
@@ -1179,17 +1179,12 @@ QList<MapObject*> ObjectSelectionTool::objectsAboutToBeSelected(const QPointF &p
     }
 
     const QTransform viewTransform = mapScene()->views().first()->transform();
-    const QList<QGraphicsItem *> items = mapScene()->items(rect,
-                                                           selectionMode,
-                                                           Qt::DescendingOrder,
-                                                           viewTransform);
-    for (QGraphicsItem *item : items) {
-        if (!item->isEnabled())
-            continue;
-        MapObjectItem *mapObjectItem = qgraphicsitem_cast<MapObjectItem*>(item);
-        if (mapObjectItem && mapObjectItem->mapObject()->objectGroup()->isUnlocked())
+    mapScene()->visitMapObjectItemsIn(rect, selectionMode, viewTransform,
+                                      [&] (MapObjectItem *mapObjectItem) {
+        if (mapObjectItem->isEnabled() && mapObjectItem->mapObject()->objectGroup()->isUnlocked())
             selectedObjects.append(mapObjectItem->mapObject());
-    }
+        return true;
+    });
 
     filterMapObjects(selectedObjects);
 
@@ -35,7 +35,7 @@ OffsetMapDialog::OffsetMapDialog(MapDocument *mapDocument, QWidget *parent)
 {
     mUi->setupUi(this);
 
-    if (mMapDocument->selectedArea().isEmpty()) {
+    if (mMapDocument->selectedTiles().isEmpty()) {
         setBoundsSelection(WholeMap);
         mUi->boundsSelection->setEnabled(false);
     } else {
@@ -60,13 +60,13 @@ void PaintTileLayer::paint(TileLayer *target,
                            const QRegion &paintRegion)
 {
     PaintTileLayer::LayerData data;
+    data.mPaintedRegion = TileRegion(paintRegion);
     data.mSource = std::make_unique<TileLayer>();
     data.mSource->setCells(x + target->x(),
-                           y + target->y(), source, paintRegion);
+                           y + target->y(), source, data.mPaintedRegion);
     data.mErased = std::make_unique<TileLayer>();
     data.mErased->setCells(target->x(),
-                           target->y(), target, paintRegion);
-    data.mPaintedRegion = paintRegion;
+                           target->y(), target, data.mPaintedRegion);
 
     mLayerData[target].mergeWith(std::move(data));
 }
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "tileregion.h"
 #include "undocommands.h"
 
 #include <QRegion>
@@ -98,7 +99,7 @@ private:
 
         std::unique_ptr<TileLayer> mSource;
         std::unique_ptr<TileLayer> mErased;
-        QRegion mPaintedRegion;
+        TileRegion mPaintedRegion;
 
     private:
         void copy(const LayerData &o);
@@ -21,10 +21,12 @@
 
 #include "preferences.h"
 
+#include "imagecache.h"
 #include "languagemanager.h"
 #include "pluginmanager.h"
 #include "savefile.h"
 #include "session.h"
+#include "tilelayeritem.h"
 #include "tilesetmanager.h"
 
 #include <QApplication>
@@ -117,6 +119,12 @@ void Preferences::initialize()
     tilesetManager->setReloadTilesetsOnChange(reloadTilesetsOnChange());
     tilesetManager->setAnimateTiles(showTileAnimations());
 
+    // Memory limit of the image cache in MB
+    ImageCache::setMaxMemory(get<qint64>("Storage/ImageCacheSize", 512) * 1024 * 1024);
+
+    // Memory limit of the cached tile layer renderings in MB
+    TileLayerItem::setRenderCacheMaxMemory(get<qint64>("Storage/TileRenderCacheSize", 256) * 1024 * 1024);
+
     // Read the lists of enabled and disabled plugins
     const auto disabledPlugins = get<QStringList>("Plugins/Disabled");
     const auto enabledPlugins = get<QStringList>("Plugins/Enabled");
@@ -26,9 +26,13 @@
 
 namespace Tiled {
 
+/**
+ * Returns a random engine for the current thread. Each thread has its own
+ * engine, so that random picking can be done from multiple threads.
+ */
 inline std::default_random_engine &globalRandomEngine()
 {
-    static std::default_random_engine engine(std::random_device{}());
+    static thread_local std::default_random_engine engine(std::random_device{}());
     return engine;
 }
 
@@ -22,6 +22,7 @@
 
 #include "expressionspinbox.h"
 #include "languagemanager.h"
+#include "mappreviewcache.h"
 #include "newsfeed.h"
 #include "newversionchecker.h"
 #include "pluginmanager.h"
@@ -61,6 +62,7 @@ TiledApplication::TiledApplication(int &argc, char **argv)
 
 TiledApplication::~TiledApplication()
 {
+    MapPreviewCache::deleteInstance();
     TemplateManager::deleteInstance();
     ScriptManager::deleteInstance();
     TilesetManager::deleteInstance();
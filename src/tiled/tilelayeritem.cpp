@@ -23,14 +23,108 @@
 #include "map.h"
 #include "mapdocument.h"
 #include "maprenderer.h"
+#include "tile.h"
+#include "tilesetmanager.h"
 
+#include <QCache>
+#include <QPainter>
 #include <QStyleOptionGraphicsItem>
+#include <QVarLengthArray>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace Tiled;
 
+namespace {
+
+/**
+ * The tile layers are rendered into cached blocks of this many device
+ * independent pixels squared, aligned to the origin of the layer at the
+ * current scale.
+ */
+constexpr int BlockSize = 256;
+
+/**
+ * The render cache is shared by all tile layers, so that its memory budget
+ * applies to the whole application. The least recently used blocks are
+ * evicted first. The budget can be changed with setRenderCacheMaxMemory().
+ */
+constexpr int DefaultRenderCacheBudgetKb = 256 * 1024;
+
+/**
+ * The number of scales for which blocks are kept per layer. While zooming
+ * smoothly, each step renders at a new scale, and the blocks of older scales
+ * are removed to keep invalidating changed areas cheap.
+ */
+constexpr int MaxCachedScales = 3;
+
+struct RenderCacheKey
+{
+    quint64 generation;
+    qreal scale;
+    qreal devicePixelRatio;
+    QPoint block;
+
+    bool operator==(const RenderCacheKey &other) const
+    {
+        return generation == other.generation &&
+                scale == other.scale &&
+                devicePixelRatio == other.devicePixelRatio &&
+                block == other.block;
+    }
+};
+
+size_t qHash(const RenderCacheKey &key, size_t seed = 0) noexcept
+{
+    return qHashMulti(seed, key.generation, key.scale, key.devicePixelRatio,
+                      key.block.x(), key.block.y());
+}
+
+QCache<RenderCacheKey, QPixmap> &renderCache()
+{
+    static QCache<RenderCacheKey, QPixmap> cache { DefaultRenderCacheBudgetKb };
+    return cache;
+}
+
+/**
+ * Each cache generation is unique, so that entries of a layer that has been
+ * invalidated or deleted can never be mistaken for current ones. Such stale
+ * entries are no longer accessed and will be evicted first.
+ */
+quint64 nextCacheGeneration()
+{
+    static quint64 generation = 0;
+    return ++generation;
+}
+
+QRect blockRange(const QRectF &rect, qreal scale)
+{
+    return QRect(QPoint(std::floor(rect.left() * scale / BlockSize),
+                        std::floor(rect.top() * scale / BlockSize)),
+                 QPoint(std::floor(rect.right() * scale / BlockSize),
+                        std::floor(rect.bottom() * scale / BlockSize)));
+}
+
+} // anonymous namespace
+
+/**
+ * Sets the memory budget of the render cache shared by all tile layer items
+ * to \a bytes. The least recently used blocks are evicted when the cache
+ * is larger than the new budget.
+ */
+void TileLayerItem::setRenderCacheMaxMemory(qint64 bytes)
+{
+    const qint64 maxCostKb = qBound<qint64>(0, bytes / 1024,
+                                            std::numeric_limits<qsizetype>::max());
+    renderCache().setMaxCost(qsizetype(maxCostKb));
+}
+
 TileLayerItem::TileLayerItem(TileLayer *layer, MapDocument *mapDocument, QGraphicsItem *parent)
     : LayerItem(layer, parent)
     , mMapDocument(mapDocument)
+    , mCacheGeneration(nextCacheGeneration())
 {
     setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
 
@@ -55,6 +149,66 @@ void TileLayerItem::syncWithTileLayer()
     }
 
     mBoundingRect = boundingRect.marginsAdded(margins);
+
+    invalidateRenderCache();
+    mAnimatedTilesValid = false;
+}
+
+void TileLayerItem::invalidateRenderCache()
+{
+    mCacheGeneration = nextCacheGeneration();
+    mCachedScales.clear();
+}
+
+void TileLayerItem::invalidateRenderCache(const QRectF &rect)
+{
+    auto &cache = renderCache();
+
+    // The changed area may have different animated tiles now
+    if (mAnimatedTilesValid) {
+        const QRect area = tileArea(rect);
+        if (!area.isEmpty()) {
+            indexAnimatedTiles(QRect(QPoint(area.left() >> CHUNK_BITS, area.top() >> CHUNK_BITS),
+                                     QPoint(area.right() >> CHUNK_BITS, area.bottom() >> CHUNK_BITS)));
+        }
+    }
+
+    for (CachedScale &cachedScale : mCachedScales) {
+        const QRect blocks = blockRange(rect, cachedScale.scale);
+
+        for (int y = blocks.top(); y <= blocks.bottom(); ++y) {
+            for (int x = blocks.left(); x <= blocks.right(); ++x) {
+                if (cachedScale.blocks.remove(QPoint(x, y))) {
+                    cache.remove({ mCacheGeneration, cachedScale.scale,
+                                   cachedScale.devicePixelRatio, QPoint(x, y) });
+                }
+            }
+        }
+    }
+}
+
+void TileLayerItem::repaintTiles(const QSet<const Tile*> &tiles)
+{
+    if (!isVisible())
+        return;
+
+    updateAnimatedTiles();
+
+    const TileLayer *layer = tileLayer();
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const QMargins margins = mMapDocument->map()->drawMargins();
+
+    for (auto it = mAnimatedTiles.cbegin(), end = mAnimatedTiles.cend(); it != end; ++it) {
+        const auto &chunkTiles = it.value();
+        const bool changed = std::any_of(chunkTiles.begin(), chunkTiles.end(),
+                                         [&] (const Tile *tile) { return tiles.contains(tile); });
+        if (!changed)
+            continue;
+
+        const QRect chunkRect(it.key() * CHUNK_SIZE + layer->position(),
+                              QSize(CHUNK_SIZE, CHUNK_SIZE));
+        update(renderer->boundingRect(chunkRect).marginsAdded(margins));
+    }
 }
 
 QRectF TileLayerItem::boundingRect() const
@@ -66,8 +220,302 @@ void TileLayerItem::paint(QPainter *painter,
                           const QStyleOptionGraphicsItem *option,
                           QWidget *)
 {
-    MapRenderer *renderer = mMapDocument->renderer();
     // TODO: Display a border around the layer when selected
     painter->setCompositionMode(layer()->compositionMode());
+
+    if (canUseRenderCache(painter)) {
+        paintCached(painter, option->exposedRect);
+        return;
+    }
+
+    MapRenderer *renderer = mMapDocument->renderer();
     renderer->drawTileLayer(painter, tileLayer(), option->exposedRect);
 }
+
+/**
+ * Returns whether the layer can be painted from cached blocks. This requires
+ * the blocks to be composited like individual tiles and the painter to be
+ * only scaled and translated. Layers showing animated tiles are always
+ * painted directly.
+ *
+ * Also discards the cached blocks when the render flags or the tint color
+ * have changed.
+ */
+bool TileLayerItem::canUseRenderCache(QPainter *painter)
+{
+    if (painter->compositionMode() != QPainter::CompositionMode_SourceOver)
+        return false;
+
+    const QTransform &transform = painter->transform();
+    if (transform.type() > QTransform::TxScale ||
+            transform.m11() <= 0 || transform.m11() != transform.m22())
+        return false;
+
+    const MapRenderer *renderer = mMapDocument->renderer();
+    if (renderer->testFlag(ShowTileAnimations) && usesAnimatedTiles())
+        return false;
+
+    const QColor tintColor = layer()->effectiveTintColor();
+    if (mCachedRenderFlags != renderer->flags() || mCachedTintColor != tintColor) {
+        invalidateRenderCache();
+        mCachedRenderFlags = renderer->flags();
+        mCachedTintColor = tintColor;
+    }
+
+    return true;
+}
+
+void TileLayerItem::paintCached(QPainter *painter, const QRectF &exposed)
+{
+    const QTransform transform = painter->transform();
+    const qreal scale = transform.m11();
+    const qreal devicePixelRatio = painter->device()->devicePixelRatioF();
+
+    // Align the blocks to device pixels, to blit them without resampling
+    const QPointF origin(std::round(transform.dx()), std::round(transform.dy()));
+    const QRectF area = exposed & mBoundingRect;
+    if (area.isEmpty())
+        return;
+
+    const QRect blocks = blockRange(area, scale);
+    CachedScale &cachedScale = useCachedScale(scale, devicePixelRatio);
+
+    painter->save();
+    painter->setTransform(QTransform::fromTranslate(origin.x(), origin.y()));
+
+    for (int y = blocks.top(); y <= blocks.bottom(); ++y) {
+        for (int x = blocks.left(); x <= blocks.right(); ++x) {
+            const QPixmap pixmap = cachedBlock(QPoint(x, y), cachedScale,
+                                               painter->renderHints());
+            if (!pixmap.isNull())
+                painter->drawPixmap(QPointF(x * BlockSize, y * BlockSize), pixmap);
+        }
+    }
+
+    painter->restore();
+}
+
+/**
+ * Returns the entry for the blocks cached at the given scale, marking it as
+ * most recently used. When there are too many scales, the blocks of the
+ * least recently used scale are removed from the cache.
+ */
+TileLayerItem::CachedScale &TileLayerItem::useCachedScale(qreal scale, qreal devicePixelRatio)
+{
+    auto it = std::find_if(mCachedScales.begin(), mCachedScales.end(),
+                           [=] (const CachedScale &cachedScale) {
+        return cachedScale.scale == scale && cachedScale.devicePixelRatio == devicePixelRatio;
+    });
+
+    if (it != mCachedScales.end()) {
+        std::rotate(it, it + 1, mCachedScales.end());
+        return mCachedScales.last();
+    }
+
+    if (mCachedScales.size() == MaxCachedScales) {
+        auto &cache = renderCache();
+        const CachedScale &oldest = mCachedScales.first();
+        for (const QPoint &block : oldest.blocks)
+            cache.remove({ mCacheGeneration, oldest.scale, oldest.devicePixelRatio, block });
+        mCachedScales.removeFirst();
+    }
+
+    mCachedScales.append({ scale, devicePixelRatio, {} });
+    return mCachedScales.last();
+}
+
+/**
+ * Returns the rendering of the given \a block at the scale of
+ * \a cachedScale, rendering it when it isn't cached yet. Returns a null
+ * pixmap for blocks without any tiles.
+ */
+QPixmap TileLayerItem::cachedBlock(QPoint block, CachedScale &cachedScale,
+                                   QPainter::RenderHints renderHints)
+{
+    const qreal scale = cachedScale.scale;
+    const qreal devicePixelRatio = cachedScale.devicePixelRatio;
+
+    auto &cache = renderCache();
+    const RenderCacheKey key { mCacheGeneration, scale, devicePixelRatio, block };
+
+    if (const QPixmap *cached = cache.object(key))
+        return *cached;
+
+    cachedScale.blocks.insert(block);
+
+    const QRectF rect(block.x() * BlockSize / scale,
+                      block.y() * BlockSize / scale,
+                      BlockSize / scale,
+                      BlockSize / scale);
+
+    if (!blockHasTiles(rect)) {
+        cache.insert(key, new QPixmap, 1);
+        return QPixmap();
+    }
+
+    QPixmap pixmap(QSize(BlockSize, BlockSize) * devicePixelRatio);
+    pixmap.setDevicePixelRatio(devicePixelRatio);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+    painter.setRenderHints(renderHints);
+    painter.setTransform(QTransform(scale, 0, 0, scale,
+                                    -block.x() * BlockSize,
+                                    -block.y() * BlockSize));
+    mMapDocument->renderer()->drawTileLayer(&painter, tileLayer(), rect);
+    painter.end();
+
+    const qsizetype cost = qMax<qsizetype>(1, qsizetype(pixmap.width()) * pixmap.height()
+                                           * pixmap.depth() / (8 * 1024));
+    cache.insert(key, new QPixmap(pixmap), cost);
+
+    return pixmap;
+}
+
+/**
+ * Returns the area of the layer, in local tile coordinates, of which the
+ * tiles may be drawn within the given \a rect, in item coordinates. This is
+ * a conservative estimate, limited to the bounds of the layer.
+ */
+QRect TileLayerItem::tileArea(const QRectF &rect) const
+{
+    const TileLayer *layer = tileLayer();
+    const MapRenderer *renderer = mMapDocument->renderer();
+    const Map *map = mMapDocument->map();
+
+    // Tiles may be drawn outside of their cell, so look beyond the rect
+    const QMargins drawMargins = layer->drawMargins();
+    const int margin = std::max({ drawMargins.left(), drawMargins.top(),
+                                  drawMargins.right(), drawMargins.bottom(),
+                                  map->tileWidth(), map->tileHeight() });
+    const QRectF area = rect.adjusted(-margin, -margin, margin, margin);
+
+    const QPointF corners[] = {
+        renderer->screenToTileCoords(area.topLeft()),
+        renderer->screenToTileCoords(area.topRight()),
+        renderer->screenToTileCoords(area.bottomLeft()),
+        renderer->screenToTileCoords(area.bottomRight()),
+    };
+
+    qreal left = corners[0].x(), right = left;
+    qreal top = corners[0].y(), bottom = top;
+    for (const QPointF &corner : corners) {
+        left = std::min(left, corner.x());
+        right = std::max(right, corner.x());
+        top = std::min(top, corner.y());
+        bottom = std::max(bottom, corner.y());
+    }
+
+    QRect tileArea(QPoint(std::floor(left) - 1, std::floor(top) - 1),
+                   QPoint(std::floor(right) + 1, std::floor(bottom) + 1));
+    return tileArea.translated(-layer->position()) & layer->localBounds();
+}
+
+/**
+ * Returns whether any tiles may be drawn within the given \a rect, in item
+ * coordinates. This is a conservative check, which looks for non-empty
+ * chunks in the area covered by the rect.
+ */
+bool TileLayerItem::blockHasTiles(const QRectF &rect) const
+{
+    const TileLayer *layer = tileLayer();
+    const QRect area = tileArea(rect);
+
+    if (area.isEmpty())
+        return false;
+
+    for (int y = area.top() >> CHUNK_BITS; y <= area.bottom() >> CHUNK_BITS; ++y) {
+        for (int x = area.left() >> CHUNK_BITS; x <= area.right() >> CHUNK_BITS; ++x) {
+            const Chunk *chunk = layer->findChunk(x << CHUNK_BITS, y << CHUNK_BITS);
+            if (chunk && !chunk->isEmpty())
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Returns whether any animated tiles are placed on this layer.
+ */
+bool TileLayerItem::usesAnimatedTiles()
+{
+    updateAnimatedTiles();
+    return !mAnimatedTiles.isEmpty();
+}
+
+/**
+ * Makes sure the index of the animated tiles placed on this layer is up to
+ * date. It is rebuilt when tiles have gained or lost their animation.
+ */
+void TileLayerItem::updateAnimatedTiles()
+{
+    const quint64 generation = TilesetManager::instance()->animatedTilesGeneration();
+    if (mAnimatedTilesValid && mAnimatedTilesGeneration == generation)
+        return;
+
+    mAnimatedTiles.clear();
+    mAnimatedTilesValid = true;
+    mAnimatedTilesGeneration = generation;
+
+    const QRect bounds = tileLayer()->localBounds();
+    if (bounds.isEmpty())
+        return;
+
+    indexAnimatedTiles(QRect(QPoint(bounds.left() >> CHUNK_BITS, bounds.top() >> CHUNK_BITS),
+                             QPoint(bounds.right() >> CHUNK_BITS, bounds.bottom() >> CHUNK_BITS)));
+}
+
+/**
+ * Updates the index of the animated tiles for the given range of \a chunks.
+ */
+void TileLayerItem::indexAnimatedTiles(const QRect &chunks)
+{
+    const TileLayer *layer = tileLayer();
+
+    for (auto it = mAnimatedTiles.begin(); it != mAnimatedTiles.end(); ) {
+        if (chunks.contains(it.key()))
+            it = mAnimatedTiles.erase(it);
+        else
+            ++it;
+    }
+
+    // Only the cells referring to tilesets with animated tiles need checking
+    QVarLengthArray<const Tileset*, 8> tilesets;
+    const auto animatedTiles = TilesetManager::instance()->animatedTiles();
+    for (const Tile *tile : animatedTiles) {
+        const Tileset *tileset = tile->tileset();
+        if (!tilesets.contains(tileset) && layer->referencesTileset(tileset))
+            tilesets.append(tileset);
+    }
+
+    if (tilesets.isEmpty())
+        return;
+
+    for (int y = chunks.top(); y <= chunks.bottom(); ++y) {
+        for (int x = chunks.left(); x <= chunks.right(); ++x) {
+            const QPoint chunkPos(x, y);
+
+            const Chunk *chunk = layer->findChunk(x << CHUNK_BITS, y << CHUNK_BITS);
+            if (!chunk)
+                continue;
+
+            QVector<const Tile*> tiles;
+
+            for (int cellY = 0; cellY < CHUNK_SIZE; ++cellY) {
+                for (int cellX = 0; cellX < CHUNK_SIZE; ++cellX) {
+                    const Cell cell = chunk->cellAt(cellX, cellY);
+                    if (!tilesets.contains(cell.tileset()))
+                        continue;
+
+                    const Tile *tile = cell.tile();
+                    if (tile && tile->isAnimated() && !tiles.contains(tile))
+                        tiles.append(tile);
+                }
+            }
+
+            if (!tiles.isEmpty())
+                mAnimatedTiles.insert(chunkPos, tiles);
+        }
+    }
+}
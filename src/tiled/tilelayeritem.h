@@ -22,8 +22,14 @@
 
 #include "layeritem.h"
 
+#include "maprenderer.h"
 #include "tilelayer.h"
 
+#include <QColor>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
 namespace Tiled {
 
 class MapDocument;
@@ -44,6 +50,8 @@ public:
 
     TileLayer *tileLayer() const;
 
+    static void setRenderCacheMaxMemory(qint64 bytes);
+
     /**
      * Updates the size and position of this item. Should be called when the
      * size of either the tile layer or its associated map have changed.
@@ -54,6 +62,23 @@ public:
      */
     void syncWithTileLayer();
 
+    /**
+     * Discards all cached renderings of this layer.
+     */
+    void invalidateRenderCache();
+
+    /**
+     * Discards the cached renderings intersecting the given \a rect, in item
+     * coordinates.
+     */
+    void invalidateRenderCache(const QRectF &rect);
+
+    /**
+     * Repaints the areas of this layer where any of the given \a tiles are
+     * placed.
+     */
+    void repaintTiles(const QSet<const Tile*> &tiles);
+
     // QGraphicsItem
     QRectF boundingRect() const override;
     void paint(QPainter *painter,
@@ -61,8 +86,38 @@ public:
                QWidget *widget = nullptr) override;
 
 private:
+    // The blocks cached at a certain scale and device pixel ratio
+    struct CachedScale
+    {
+        qreal scale;
+        qreal devicePixelRatio;
+        QSet<QPoint> blocks;
+    };
+
+    bool canUseRenderCache(QPainter *painter);
+    void paintCached(QPainter *painter, const QRectF &exposed);
+    CachedScale &useCachedScale(qreal scale, qreal devicePixelRatio);
+    QPixmap cachedBlock(QPoint block, CachedScale &cachedScale,
+                        QPainter::RenderHints renderHints);
+    QRect tileArea(const QRectF &rect) const;
+    bool blockHasTiles(const QRectF &rect) const;
+    bool usesAnimatedTiles();
+    void updateAnimatedTiles();
+    void indexAnimatedTiles(const QRect &chunks);
+
     MapDocument *mMapDocument;
     QRectF mBoundingRect;
+
+    // Render cache state
+    quint64 mCacheGeneration;
+    QVector<CachedScale> mCachedScales;     // most recently used last
+    RenderFlags mCachedRenderFlags;
+    QColor mCachedTintColor;
+
+    // The animated tiles placed in each chunk, by chunk coordinates
+    QHash<QPoint, QVector<const Tile*>> mAnimatedTiles;
+    quint64 mAnimatedTilesGeneration = 0;
+    bool mAnimatedTilesValid = false;
 };
 
 inline TileLayer *TileLayerItem::tileLayer() const
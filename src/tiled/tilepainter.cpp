@@ -24,7 +24,10 @@
 #include "mapdocument.h"
 #include "map.h"
 
-#include <QQueue>
+#include <QHash>
+#include <QVector>
+
+#include <array>
 
 using namespace Tiled;
 
@@ -98,6 +101,23 @@ void TilePainter::setCells(int x, int y,
     emit mMapDocument->regionChanged(region, mTileLayer);
 }
 
+void TilePainter::setCells(int x, int y,
+                           const TileLayer *tileLayer,
+                           const TileRegion &mask)
+{
+    const TileRegion region = paintableRegion(mask);
+    if (region.isEmpty())
+        return;
+
+    TileLayerChangeWatcher watcher(mMapDocument, mTileLayer);
+    mTileLayer->setCells(x - mTileLayer->x(),
+                         y - mTileLayer->y(),
+                         tileLayer,
+                         region.translated(-mTileLayer->position()));
+
+    emit mMapDocument->regionChanged(region.toRegion(), mTileLayer);
+}
+
 void TilePainter::drawCells(int x, int y, TileLayer *tileLayer)
 {
     const QRegion region = paintableRegion(tileLayer->localBounds().translated(x, y));
@@ -169,168 +189,386 @@ void TilePainter::erase(const QRegion &region)
     emit mMapDocument->regionChanged(paintable, mTileLayer);
 }
 
-static QRegion fillRegion(const TileLayer &layer,
-                          const QRegion &region,
-                          QPoint fillOrigin,
-                          std::function<bool(const Cell &)> condition,
-                          Map::Orientation orientation,
-                          Map::StaggerAxis staggerAxis,
-                          Map::StaggerIndex staggerIndex)
+namespace {
+
+/**
+ * Matches cells equal to the given cell.
+ */
+struct SameCell
+{
+    bool operator()(const Cell &cell) const { return cell == matchCell; }
+
+    const Cell matchCell;
+};
+
+/**
+ * Matches cells equal to any of the given cells.
+ */
+struct AnyOfCells
+{
+    bool operator()(const Cell &cell) const { return matchCells.contains(cell); }
+
+    const QVector<Cell> &matchCells;
+};
+
+/**
+ * Determines the connected cells of a tile layer for which a condition
+ * holds, starting from a given cell.
+ *
+ * The layer is processed in blocks matching the chunks of TileRegion. When
+ * the fill first reaches a block, the condition is evaluated for each of its
+ * cells, going through the layer a chunk at a time, and the cells that can be
+ * filled are stored as one word per row. The fill itself then only needs bit
+ * operations, and the memory used depends on the size of the filled area
+ * rather than the size of the layer.
+ */
+template <typename Condition>
+class FloodFill
+{
+public:
+    /**
+     * The fill is limited to the given \a bounds, in local coordinates of
+     * the \a layer.
+     */
+    FloodFill(const TileLayer &layer,
+              const Condition &condition,
+              const QRect &bounds)
+        : mLayer(layer)
+        , mCondition(condition)
+        , mBounds(bounds)
+        , mEmptyCellMatches(condition(Cell()))
+    {}
+
+    TileRegion fill(QPoint origin,
+                    Map::Orientation orientation,
+                    Map::StaggerAxis staggerAxis,
+                    Map::StaggerIndex staggerIndex);
+
+private:
+    static constexpr int BlockBits = TileRegion::CHUNK_BITS;
+    static constexpr int BlockSize = TileRegion::CHUNK_SIZE;
+    static constexpr int BlockMask = TileRegion::CHUNK_MASK;
+
+    // The cells that can be filled and were not filled yet, one word per row
+    using Block = std::array<quint64, BlockSize>;
+
+    Block computeBlock(QPoint blockPos) const;
+
+    quint64 &openCells(int x, int y);
+    bool isOpen(int x, int y) { return openCells(x, y) & (quint64(1) << (x & BlockMask)); }
+
+    int runStart(int x, int y);
+    int runEnd(int x, int y);
+    void takeRun(int left, int right, int y, TileRegion &result);
+    void addSeeds(int left, int right, int y);
+
+    const TileLayer &mLayer;
+    const Condition &mCondition;
+    const QRect mBounds;
+    const bool mEmptyCellMatches;
+
+    QHash<QPoint, Block> mBlocks;
+    Block *mLastBlock = nullptr;    // only valid until the next insertion
+    QPoint mLastBlockPos;
+    QVector<QPoint> mSeeds;
+};
+
+template <typename Condition>
+TileRegion FloodFill<Condition>::fill(QPoint origin,
+                                      Map::Orientation orientation,
+                                      Map::StaggerAxis staggerAxis,
+                                      Map::StaggerIndex staggerIndex)
 {
-    // Return empty region when the bounds do not contain the fill origin
-    if (!region.contains(fillOrigin))
-        return QRegion();
+    TileRegion result;
 
-    const QRect bounds = region.boundingRect();
-    const int width = bounds.width();
-    const int height = bounds.height();
-    const int indexOffset = -(bounds.left() + bounds.top() * width);
+    if (!isOpen(origin.x(), origin.y()))
+        return result;
 
     const bool isStaggered = orientation == Map::Hexagonal || orientation == Map::Staggered;
 
-    // Create a queue to hold cells that need filling
-    QQueue<QPoint> fillPositions;
-    fillPositions.enqueue(fillOrigin);
-
-    // Create an array that will store which cells have been processed
-    // This is faster than checking if a given cell is in the region/list
-    QVector<bool> processedCellsVec(width * height);
-    bool *processedCells = processedCellsVec.data();
-    QRegion fillRegion;
-
-    // Loop through queued positions and fill them, while at the same time
-    // checking adjacent positions to see if they should be added
-    while (!fillPositions.isEmpty()) {
-        const QPoint currentPoint = fillPositions.dequeue();
-        const int startOfLine = currentPoint.y() * width;
-
-        // Seek as far left as we can
-        int left = currentPoint.x();
-        while (left > bounds.left() && condition(layer.cellAt(left - 1, currentPoint.y()))) {
-            --left;
-            processedCells[indexOffset + startOfLine + left] = true;
-        }
+    mSeeds.append(origin);
 
-        // Seek as far right as we can
-        int right = currentPoint.x();
-        while (right < bounds.right() && condition(layer.cellAt(right + 1, currentPoint.y()))) {
-            ++right;
-            processedCells[indexOffset + startOfLine + right] = true;
-        }
+    while (!mSeeds.isEmpty()) {
+        const QPoint seed = mSeeds.takeLast();
+        const int y = seed.y();
 
-        // Add cells between left and right to the region
-        fillRegion += QRegion(left, currentPoint.y(), right - left + 1, 1);
+        // The seed may have been filled since it was added
+        if (!isOpen(seed.x(), y))
+            continue;
 
-        bool leftColumnIsStaggered = false;
-        bool rightColumnIsStaggered = false;
+        const int left = runStart(seed.x(), y);
+        const int right = runEnd(seed.x(), y);
+        takeRun(left, right, y, result);
+
+        // For staggered maps, we may need to extend the search range
+        int aboveLeft = left;
+        int aboveRight = right;
+        int belowLeft = left;
+        int belowRight = right;
 
-        // For hexagonal maps with a staggered Y-axis, we may need to extend the search range
         if (isStaggered) {
             if (staggerAxis == Map::StaggerY) {
-                bool rowIsStaggered = ((layer.y() + currentPoint.y()) & 1) ^ staggerIndex;
-                if (rowIsStaggered)
-                    right = qMin(right + 1, bounds.right());
-                else
-                    left = qMax(left - 1, bounds.left());
+                const bool rowIsStaggered = ((mLayer.y() + y) & 1) ^ staggerIndex;
+                if (rowIsStaggered) {
+                    ++aboveRight;
+                    ++belowRight;
+                } else {
+                    --aboveLeft;
+                    --belowLeft;
+                }
             } else {
-                leftColumnIsStaggered = ((layer.x() + left) & 1) ^ staggerIndex;
-                rightColumnIsStaggered = ((layer.x() + right) & 1) ^ staggerIndex;
+                const bool leftColumnIsStaggered = ((mLayer.x() + left) & 1) ^ staggerIndex;
+                const bool rightColumnIsStaggered = ((mLayer.x() + right) & 1) ^ staggerIndex;
+
+                if (leftColumnIsStaggered)
+                    --belowLeft;
+                else
+                    --aboveLeft;
+
+                if (rightColumnIsStaggered)
+                    ++belowRight;
+                else
+                    ++aboveRight;
             }
         }
 
-        // Loop between left and right and check if cells above or below need
-        // to be added to the queue.
-        auto findFillPositions = [=,&fillPositions](int left, int right, int y) {
-            bool adjacentCellAdded = false;
+        addSeeds(aboveLeft, aboveRight, y - 1);
+        addSeeds(belowLeft, belowRight, y + 1);
+    }
 
-            for (int x = left; x <= right; ++x) {
-                const int index = y * width + x;
+    return result;
+}
 
-                if (!processedCells[indexOffset + index] && condition(layer.cellAt(x, y))) {
-                    // Do not add the cell to the queue if an adjacent cell was added.
-                    if (!adjacentCellAdded) {
-                        fillPositions.enqueue(QPoint(x, y));
-                        adjacentCellAdded = true;
-                    }
-                } else {
-                    adjacentCellAdded = false;
+template <typename Condition>
+typename FloodFill<Condition>::Block FloodFill<Condition>::computeBlock(QPoint blockPos) const
+{
+    Block block {};
+
+    const QRect blockRect(blockPos.x() << BlockBits, blockPos.y() << BlockBits,
+                          BlockSize, BlockSize);
+    const QRect area = blockRect & mBounds;
+    if (area.isEmpty())
+        return block;
+
+    // Evaluate the condition for each cell, a chunk at a time
+    const quint64 chunkRow = (quint64(1) << CHUNK_SIZE) - 1;
+
+    for (int y = area.top() & ~CHUNK_MASK; y <= area.bottom(); y += CHUNK_SIZE) {
+        for (int x = area.left() & ~CHUNK_MASK; x <= area.right(); x += CHUNK_SIZE) {
+            const Chunk *chunk = mLayer.findChunk(x, y);
+            const int shift = x - blockRect.left();
+
+            for (int row = 0; row < CHUNK_SIZE; ++row) {
+                quint64 bits = 0;
+
+                if (chunk) {
+                    for (int column = 0; column < CHUNK_SIZE; ++column)
+                        if (mCondition(chunk->cellAt(column, row)))
+                            bits |= quint64(1) << column;
+                } else if (mEmptyCellMatches) {
+                    bits = chunkRow;
                 }
 
-                processedCells[indexOffset + index] = true;
+                block[y - blockRect.top() + row] |= bits << shift;
             }
-        };
+        }
+    }
 
-        if (currentPoint.y() > bounds.top()) {
-            int _left = left;
-            int _right = right;
+    // Limit the cells to the bounds
+    const quint64 columns = TileRegion::rowMask(area.left() - blockRect.left(),
+                                                area.right() - blockRect.left());
 
-            if (isStaggered && staggerAxis == Map::StaggerX) {
-                if (!leftColumnIsStaggered)
-                    _left = qMax(left - 1, bounds.left());
-                if (!rightColumnIsStaggered)
-                    _right = qMin(right + 1, bounds.right());
-            }
+    for (int row = 0; row < BlockSize; ++row) {
+        const int y = blockRect.top() + row;
 
-            findFillPositions(_left, _right, currentPoint.y() - 1);
-        }
+        if (y < area.top() || y > area.bottom())
+            block[row] = 0;
+        else
+            block[row] &= columns;
+    }
 
-        if (currentPoint.y() < bounds.bottom()) {
-            int _left = left;
-            int _right = right;
+    return block;
+}
 
-            if (isStaggered && staggerAxis == Map::StaggerX) {
-                if (leftColumnIsStaggered)
-                    _left = qMax(left - 1, bounds.left());
-                if (rightColumnIsStaggered)
-                    _right = qMin(right + 1, bounds.right());
-            }
+/**
+ * Returns the open cells of the block row containing the cell at \a x, \a y.
+ * The returned reference is only valid until the next block is inserted.
+ */
+template <typename Condition>
+quint64 &FloodFill<Condition>::openCells(int x, int y)
+{
+    const QPoint blockPos(x >> BlockBits, y >> BlockBits);
 
-            findFillPositions(_left, _right, currentPoint.y() + 1);
-        }
+    // Consecutive lookups are usually for the same block
+    if (!mLastBlock || mLastBlockPos != blockPos) {
+        auto it = mBlocks.find(blockPos);
+        if (it == mBlocks.end())
+            it = mBlocks.insert(blockPos, computeBlock(blockPos));
+
+        mLastBlock = &*it;
+        mLastBlockPos = blockPos;
     }
 
-    return fillRegion;
+    return (*mLastBlock)[y & BlockMask];
 }
 
-QRegion TilePainter::computePaintableFillRegion(QPoint fillOrigin,
-                                                std::function<bool(const Cell &)> condition) const
+/**
+ * Returns the first cell of the run of open cells containing \a x, \a y.
+ */
+template <typename Condition>
+int FloodFill<Condition>::runStart(int x, int y)
+{
+    while (true) {
+        const int blockLeft = x & ~BlockMask;
+        const quint64 before = (quint64(1) << (x & BlockMask)) - 1;
+
+        if (const quint64 closed = ~openCells(x, y) & before)
+            return blockLeft + BlockSize - int(qCountLeadingZeroBits(closed));
+
+        // The run continues until the start of this block
+        if (!isOpen(blockLeft - 1, y))
+            return blockLeft;
+
+        x = blockLeft - 1;
+    }
+}
+
+/**
+ * Returns the last cell of the run of open cells containing \a x, \a y.
+ */
+template <typename Condition>
+int FloodFill<Condition>::runEnd(int x, int y)
+{
+    while (true) {
+        const int blockLeft = x & ~BlockMask;
+        const int offset = x & BlockMask;
+        const quint64 after = offset == BlockMask ? 0 : ~quint64(0) << (offset + 1);
+
+        if (const quint64 closed = ~openCells(x, y) & after)
+            return blockLeft + int(qCountTrailingZeroBits(closed)) - 1;
+
+        // The run continues until the end of this block
+        if (!isOpen(blockLeft + BlockSize, y))
+            return blockLeft + BlockMask;
+
+        x = blockLeft + BlockSize;
+    }
+}
+
+/**
+ * Marks the cells from \a left to \a right on row \a y as filled, adding
+ * them to the \a result.
+ */
+template <typename Condition>
+void FloodFill<Condition>::takeRun(int left, int right, int y, TileRegion &result)
+{
+    for (int blockLeft = left & ~BlockMask; blockLeft <= right; blockLeft += BlockSize) {
+        const quint64 run = TileRegion::rowMask(qMax(left, blockLeft) - blockLeft,
+                                                qMin(right, blockLeft + BlockMask) - blockLeft);
+
+        openCells(blockLeft, y) &= ~run;
+        result.addRowBits(blockLeft, y, run);
+    }
+}
+
+/**
+ * Adds a seed for each run of open cells from \a left to \a right on row
+ * \a y.
+ */
+template <typename Condition>
+void FloodFill<Condition>::addSeeds(int left, int right, int y)
+{
+    for (int blockLeft = left & ~BlockMask; blockLeft <= right; blockLeft += BlockSize) {
+        quint64 open = openCells(blockLeft, y) &
+                TileRegion::rowMask(qMax(left, blockLeft) - blockLeft,
+                                    qMin(right, blockLeft + BlockMask) - blockLeft);
+
+        while (open) {
+            const int start = qCountTrailingZeroBits(open);
+            mSeeds.append(QPoint(blockLeft + start, y));
+
+            // Skip the rest of this run
+            const quint64 inverted = ~(open >> start);
+            const int end = inverted ? start + int(qCountTrailingZeroBits(inverted)) : BlockSize;
+            open = end >= BlockSize ? 0 : open & (~quint64(0) << end);
+        }
+    }
+}
+
+/**
+ * Computes the fill region starting at \a fillOrigin. When the \a selection
+ * is not empty, the resulting region is limited to the selection.
+ */
+template <typename Condition>
+QRegion fillRegion(const Map &map,
+                   const TileLayer &layer,
+                   const TileRegion &selection,
+                   QPoint fillOrigin,
+                   const Condition &condition)
 {
-    const Map *map = mMapDocument->map();
-    const QRegion &selection = mMapDocument->selectedArea();
+    QRect bounds = map.infinite() ? layer.bounds() : layer.rect();
 
-    QRegion bounds;
+    // On infinite maps, the fill is limited to the selection
+    if (map.infinite() && !selection.isEmpty()) {
+        if (!selection.contains(fillOrigin))
+            return QRegion();
+
+        bounds = selection.boundingRect();
+    }
 
-    if (map->infinite())
-        bounds = selection.isEmpty() ? mTileLayer->bounds() : selection;
-    else
-        bounds = mTileLayer->rect();
+    const QPoint position = layer.position();
 
-    QRegion region = fillRegion(*mTileLayer,
-                                bounds.translated(-mTileLayer->position()),
-                                fillOrigin - mTileLayer->position(),
-                                condition,
-                                map->orientation(), map->staggerAxis(), map->staggerIndex());
+    FloodFill<Condition> floodFill(layer, condition, bounds.translated(-position));
+    TileRegion region = floodFill.fill(fillOrigin - position,
+                                       map.orientation(),
+                                       map.staggerAxis(),
+                                       map.staggerIndex());
 
-    region.translate(mTileLayer->position());
+    region.translate(position);
 
     if (!selection.isEmpty())
         region &= selection;
 
-    return region;
+    return region.toRegion();
+}
+
+} // anonymous namespace
+
+QRegion TilePainter::computePaintableFillRegion(QPoint fillOrigin,
+                                                std::function<bool(const Cell &)> condition) const
+{
+    return fillRegion(*mMapDocument->map(), *mTileLayer,
+                      mMapDocument->selectedTiles(), fillOrigin, condition);
+}
+
+QRegion TilePainter::computePaintableFillRegion(QPoint fillOrigin,
+                                                const QVector<Cell> &matchCells) const
+{
+    const Map &map = *mMapDocument->map();
+    const TileRegion &selection = mMapDocument->selectedTiles();
+
+    if (matchCells.size() == 1)
+        return fillRegion(map, *mTileLayer, selection, fillOrigin, SameCell { matchCells.first() });
+
+    return fillRegion(map, *mTileLayer, selection, fillOrigin, AnyOfCells { matchCells });
 }
 
 QRegion TilePainter::computeFillRegion(QPoint fillOrigin,
                                        std::function<bool(const Cell &)> condition) const
 {
-    const Map *map = mMapDocument->map();
-    QRegion bounds = map->infinite() ? mTileLayer->bounds() : mTileLayer->rect();
-    QRegion region = fillRegion(*mTileLayer,
-                                bounds.translated(-mTileLayer->position()),
-                                fillOrigin - mTileLayer->position(),
-                                condition,
-                                map->orientation(), map->staggerAxis(), map->staggerIndex());
-
-    return region.translated(mTileLayer->position());
+    return fillRegion(*mMapDocument->map(), *mTileLayer,
+                      TileRegion(), fillOrigin, condition);
+}
+
+QRegion TilePainter::computeFillRegion(QPoint fillOrigin,
+                                       const QVector<Cell> &matchCells) const
+{
+    const Map &map = *mMapDocument->map();
+
+    if (matchCells.size() == 1)
+        return fillRegion(map, *mTileLayer, TileRegion(), fillOrigin, SameCell { matchCells.first() });
+
+    return fillRegion(map, *mTileLayer, TileRegion(), fillOrigin, AnyOfCells { matchCells });
 }
 
 QRegion TilePainter::paintableRegion(const QRegion &region) const
@@ -339,7 +577,25 @@ QRegion TilePainter::paintableRegion(const QRegion &region) const
     if (!mMapDocument->map()->infinite())
         intersection &= QRegion(mTileLayer->rect());
 
-    const QRegion &selection = mMapDocument->selectedArea();
+    // Intersecting with a fragmented selection is much cheaper as TileRegion
+    const TileRegion &selection = mMapDocument->selectedTiles();
+    if (!selection.isEmpty())
+        intersection = (TileRegion(intersection) & selection).toRegion();
+
+    return intersection;
+}
+
+/**
+ * Like the QRegion overload, but intersects with the selection as a
+ * TileRegion, which is much cheaper for large and fragmented selections.
+ */
+TileRegion TilePainter::paintableRegion(const TileRegion &region) const
+{
+    TileRegion intersection = region;
+    if (!mMapDocument->map()->infinite())
+        intersection.intersect(mTileLayer->rect());
+
+    const TileRegion &selection = mMapDocument->selectedTiles();
     if (!selection.isEmpty())
         intersection &= selection;
 
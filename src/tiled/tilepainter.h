@@ -22,6 +22,7 @@
 #pragma once
 
 #include "tilelayer.h"
+#include "tileregion.h"
 
 #include <QRegion>
 
@@ -64,6 +65,7 @@ public:
      * map coordinates.
      */
     void setCells(int x, int y, const TileLayer *tileLayer, const QRegion &mask);
+    void setCells(int x, int y, const TileLayer *tileLayer, const TileRegion &mask);
 
     /**
      * Draws the cells in the given tile layer at the given coordinates. The
@@ -91,15 +93,25 @@ public:
     QRegion computePaintableFillRegion(QPoint fillOrigin,
                                        std::function<bool(const Cell &)> condition) const;
 
+    /**
+     * Computes the paintable fill region starting at \a fillOrigin containing
+     * all connected cells matching any of the given \a matchCells. This is
+     * faster than passing the equivalent condition.
+     */
+    QRegion computePaintableFillRegion(QPoint fillOrigin,
+                                       const QVector<Cell> &matchCells) const;
+
     /**
      * Computes a fill region starting at \a fillOrigin containing all
      * connected cells for which the given \a condition returns true. Does not
      * take into account the current selection.
      */
     QRegion computeFillRegion(QPoint fillOrigin, std::function<bool(const Cell &)> condition) const;
+    QRegion computeFillRegion(QPoint fillOrigin, const QVector<Cell> &matchCells) const;
 
 private:
     QRegion paintableRegion(const QRegion &region) const;
+    TileRegion paintableRegion(const TileRegion &region) const;
     QRegion paintableRegion(int x, int y, int width, int height) const
     { return paintableRegion(QRect(x, y, width, height)); }
 
@@ -65,21 +65,33 @@ void TileSelectionItem::paint(QPainter *painter,
                               const QStyleOptionGraphicsItem *option,
                               QWidget *)
 {
-    const QRegion &selection = mMapDocument->selectedArea();
+    MapRenderer *renderer = mMapDocument->renderer();
+
+    // Only the exposed part of the selection is converted to a QRegion
+    const QRectF &exposed = option->exposedRect;
+    const QPolygonF exposedTiles {
+        renderer->screenToTileCoords(exposed.topLeft()),
+        renderer->screenToTileCoords(exposed.topRight()),
+        renderer->screenToTileCoords(exposed.bottomRight()),
+        renderer->screenToTileCoords(exposed.bottomLeft()),
+    };
+    const QRect exposedArea = exposedTiles.boundingRect().toAlignedRect().adjusted(-2, -2, 2, 2);
+
+    TileRegion selection = mMapDocument->selectedTiles();
+    selection.intersect(exposedArea);
+
     QColor highlight = QApplication::palette().highlight().color();
     highlight.setAlpha(128);
 
-    MapRenderer *renderer = mMapDocument->renderer();
-    renderer->drawTileSelection(painter, selection, highlight,
-                                option->exposedRect);
+    renderer->drawTileSelection(painter, selection.toRegion(), highlight, exposed);
 }
 
 void TileSelectionItem::documentChanged(const ChangeEvent &change)
 {
     switch (change.type) {
     case ChangeEvent::DocumentReloaded:
-        selectionChanged(mMapDocument->selectedArea(),
-                         mMapDocument->selectedArea());
+        selectionChanged(mMapDocument->selectedTiles(),
+                         mMapDocument->selectedTiles());
         break;
     case ChangeEvent::LayerChanged: {
         const auto &layerChange = static_cast<const LayerChangeEvent&>(change);
@@ -94,20 +106,21 @@ void TileSelectionItem::documentChanged(const ChangeEvent &change)
     }
 }
 
-void TileSelectionItem::selectionChanged(const QRegion &newSelection,
-                                         const QRegion &oldSelection)
+void TileSelectionItem::selectionChanged(const TileRegion &newSelection,
+                                         const TileRegion &oldSelection)
 {
     prepareGeometryChange();
     updateBoundingRect();
 
     // Make sure changes within the bounding rect are updated
-    const QRect changedArea = newSelection.xored(oldSelection).boundingRect();
+    const QRect changedArea = ((newSelection - oldSelection) |
+                               (oldSelection - newSelection)).boundingRect();
     update(mMapDocument->renderer()->boundingRect(changedArea));
 }
 
 void TileSelectionItem::updateBoundingRect()
 {
-    const QRect b = mMapDocument->selectedArea().boundingRect();
+    const QRect b = mMapDocument->selectedTiles().boundingRect();
     mBoundingRect = mMapDocument->renderer()->boundingRect(b);
 
     // Adjust for border drawn at tile selection edges
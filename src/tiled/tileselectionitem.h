@@ -25,6 +25,7 @@
 namespace Tiled {
 
 class Layer;
+class TileRegion;
 
 class ChangeEvent;
 class MapDocument;
@@ -51,8 +52,8 @@ public:
 
 private:
     void documentChanged(const ChangeEvent &change);
-    void selectionChanged(const QRegion &newSelection,
-                          const QRegion &oldSelection);
+    void selectionChanged(const TileRegion &newSelection,
+                          const TileRegion &oldSelection);
 
     void currentLayerChanged(Layer *layer);
 
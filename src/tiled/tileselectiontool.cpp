@@ -98,7 +98,7 @@ void TileSelectionTool::mousePressed(QGraphicsSceneMouseEvent *event)
         }
 
         if (event->modifiers() == Qt::NoModifier) {
-            changeSelectedArea(QRegion());
+            changeSelectedArea(TileRegion());
             return;
         }
     }
@@ -119,7 +119,7 @@ void TileSelectionTool::mouseReleased(QGraphicsSceneMouseEvent *event)
         updateStatusInfo();
     } else if (mMouseDown) {
         // Clicked without dragging and not cancelled
-        changeSelectedArea(QRegion());
+        changeSelectedArea(TileRegion());
     }
 
     mMouseDown = false;
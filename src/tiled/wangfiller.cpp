@@ -29,6 +29,10 @@
 #include "tilelayer.h"
 #include "wangset.h"
 
+#include <QtConcurrent>
+
+#include <vector>
+
 using namespace Tiled;
 
 static constexpr QPoint aroundTilePoints[WangId::NumIndexes] = {
@@ -233,6 +237,132 @@ void WangFiller::apply(TileLayer &target)
         }
     }
 
+    // Make sure the cached data of the Wang set is up to date, since it may
+    // be accessed from multiple threads below.
+    mWangSet.wangIdsAndCells();
+    mWangSet.maximumColorDistance();
+
+    const auto parts = independentParts(region);
+
+    if (parts.size() <= 1) {
+        mInvalidRegion = resolveRegion(target, grid, region);
+    } else {
+        // Resolve each part on a copy of the grid and the target layer
+        // covering only the area it can affect.
+        struct Part {
+            QRegion region;
+            QRect reach;
+            Grid<CellInfo> grid;
+            std::unique_ptr<TileLayer> target;
+            QRegion invalidRegion;
+        };
+
+        std::vector<Part> jobs(parts.size());
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            jobs[i].region = parts.at(int(i));
+            jobs[i].reach = reachOf(jobs[i].region);
+        }
+
+        QtConcurrent::blockingMap(jobs, [&] (Part &part) {
+            const QRect reach = part.reach;
+            part.target = std::make_unique<TileLayer>(QString(), reach.topLeft(), reach.size());
+
+            for (int y = reach.top(); y <= reach.bottom(); ++y) {
+                for (int x = reach.left(); x <= reach.right(); ++x) {
+                    const CellInfo &info = grid.get(x, y);
+                    if (!(info == CellInfo()))
+                        part.grid.set(x, y, info);
+
+                    const Cell cell = target.cellAt(x - target.x(), y - target.y());
+                    if (cell.checked())
+                        part.target->setCell(x - reach.x(), y - reach.y(), cell);
+                }
+            }
+
+            part.invalidRegion = resolveRegion(*part.target, part.grid, part.region);
+        });
+
+        for (const Part &part : jobs) {
+            const QRect reach = part.reach;
+
+            for (int y = reach.top(); y <= reach.bottom(); ++y) {
+                for (int x = reach.left(); x <= reach.right(); ++x) {
+                    const Cell cell = part.target->cellAt(x - reach.x(), y - reach.y());
+                    if (cell.checked())
+                        target.setCell(x - target.x(), y - target.y(), cell);
+                }
+            }
+
+            mInvalidRegion += part.invalidRegion;
+        }
+    }
+
+    mFillRegion = FillRegion();
+}
+
+/**
+ * Returns the area around the given \a region that is involved when resolving
+ * it. This includes the area in which corrections may be made, as well as
+ * the adjacent cells of which the desired WangIds are adjusted.
+ */
+QRect WangFiller::reachOf(const QRegion &region) const
+{
+    // Adjacent cells are up to 2 tiles away for hexagonal maps
+    const int margin = mWangSet.maximumColorDistance() + (mHexagonalRenderer != nullptr) + 2;
+    return region.boundingRect().adjusted(-margin, -margin, margin, margin);
+}
+
+/**
+ * Splits the \a region into parts that can be resolved independently of each
+ * other, because they are far enough apart for their changes not to interact.
+ */
+QVector<QRegion> WangFiller::independentParts(const QRegion &region) const
+{
+    QVector<QRegion> parts;
+    QVector<QRect> reaches;
+
+    for (const QRect &rect : region) {
+        parts.append(QRegion(rect));
+        reaches.append(reachOf(rect));
+    }
+
+    // Merge parts until none of them can affect each other
+    bool merged;
+    do {
+        merged = false;
+
+        for (int i = 0; i < parts.size(); ++i) {
+            for (int j = i + 1; j < parts.size(); ++j) {
+                if (!reaches.at(i).intersects(reaches.at(j)))
+                    continue;
+
+                parts[i] += parts.at(j);
+                reaches[i] = reachOf(parts.at(i));
+                parts.removeAt(j);
+                reaches.removeAt(j);
+
+                merged = true;
+                j = i;  // the grown part may now reach earlier parts
+            }
+        }
+    } while (merged);
+
+    return parts;
+}
+
+/**
+ * Resolves the cells in the given \a region, placing them on the \a target
+ * layer. The \a grid holds the desired WangIds, which are updated based on
+ * the placed cells.
+ *
+ * Returns the region with locations for which no matching tile was found.
+ */
+QRegion WangFiller::resolveRegion(TileLayer &target,
+                                  Grid<CellInfo> &grid,
+                                  const QRegion &region) const
+{
+    QRegion invalidRegion;
+
     // Determine the bounds of the affected area
     QRect bounds = region.boundingRect();
     int margin = mWangSet.maximumColorDistance() + (mHexagonalRenderer != nullptr);
@@ -254,7 +384,7 @@ void WangFiller::apply(TileLayer &target)
 
         Cell cell;
         if (!findBestMatch(target, grid, QPoint(x, y), cell)) {
-            mInvalidRegion += QRect(x, y, 1, 1);
+            invalidRegion += QRect(x, y, 1, 1);
             return;
         }
 
@@ -308,7 +438,7 @@ void WangFiller::apply(TileLayer &target)
         processing.clear();
     }
 
-    mFillRegion = FillRegion();
+    return invalidRegion;
 }
 
 /**
@@ -430,9 +560,15 @@ bool WangFiller::findBestMatch(const TileLayer &target,
         }
     };
 
+    // Only consider the cells matching the masked indexes
+    QVector<int> candidates;
+    mWangSet.findMatchingCells(info.desired, info.mask, candidates);
+
     const auto &wangIdsAndCells = mWangSet.wangIdsAndCells();
-    for (const auto &wangIdAndCell : wangIdsAndCells)
+    for (const int index : std::as_const(candidates)) {
+        const auto &wangIdAndCell = wangIdsAndCells.at(index);
         processCandidate(wangIdAndCell.wangId, wangIdAndCell.cell);
+    }
 
     if (mErasingEnabled)
         processCandidate(WangId(), Cell());
@@ -28,6 +28,8 @@
 #include <QList>
 #include <QMap>
 #include <QPoint>
+#include <QRegion>
+#include <QVector>
 
 #include <memory>
 
@@ -100,6 +102,12 @@ private:
     WangId wangIdFromSurroundings(QPoint point) const;
     WangId wangIdFromSurroundingCells(const Cell surroundingCells[]) const;
 
+    QRect reachOf(const QRegion &region) const;
+    QVector<QRegion> independentParts(const QRegion &region) const;
+    QRegion resolveRegion(TileLayer &target,
+                          Grid<CellInfo> &grid,
+                          const QRegion &region) const;
+
     bool findBestMatch(const TileLayer &target,
                        const Grid<CellInfo> &grid,
                        QPoint position,
@@ -54,6 +54,11 @@ WorldDocument::WorldDocument(std::unique_ptr<World> world, QObject *parent)
     , mWorld(std::move(world))
 {
     setCurrentObject(mWorld.get());
+
+    connect(&mDirectoryWatcher, &FileSystemWatcher::pathsChanged,
+            this, &WorldDocument::directoryChanged);
+
+    updateDirectoryWatch();
 }
 
 WorldDocument::~WorldDocument()
@@ -133,9 +138,38 @@ void WorldDocument::swapWorld(std::unique_ptr<World> &other)
     emit changed(ReloadEvent());
 
     setCurrentObject(mWorld.get());
+    updateDirectoryWatch();
     emit worldChanged();
 }
 
+/**
+ * Watches the directory of the world while it uses patterns, so that maps
+ * added to or removed from it are picked up.
+ */
+void WorldDocument::updateDirectoryWatch()
+{
+    QString directory;
+    if (!mWorld->patterns.isEmpty())
+        directory = QFileInfo(mWorld->fileName).path();
+
+    if (directory == mWatchedDirectory)
+        return;
+
+    if (!mWatchedDirectory.isEmpty())
+        mDirectoryWatcher.removePath(mWatchedDirectory);
+
+    mWatchedDirectory = directory;
+
+    if (!mWatchedDirectory.isEmpty())
+        mDirectoryWatcher.addPath(mWatchedDirectory);
+}
+
+void WorldDocument::directoryChanged()
+{
+    if (mWorld->refreshPatternMaps())
+        emit worldChanged();
+}
+
 std::unique_ptr<EditableAsset> WorldDocument::createEditable()
 {
     return std::make_unique<EditableWorld>(this, this);
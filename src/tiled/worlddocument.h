@@ -23,6 +23,7 @@
 
 #include "document.h"
 #include "editableasset.h"
+#include "filesystemwatcher.h"
 
 namespace Tiled {
 
@@ -76,7 +77,12 @@ private:
     // Document interface
     std::unique_ptr<EditableAsset> createEditable() override;
 
+    void updateDirectoryWatch();
+    void directoryChanged();
+
     std::unique_ptr<World> mWorld;
+    FileSystemWatcher mDirectoryWatcher;
+    QString mWatchedDirectory;
 };
 
 } // namespace Tiled
@@ -20,6 +20,7 @@
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "binarymapformat.h"
 #include "commandlineparser.h"
 #include "exporthelper.h"
 #include "logginginterface.h"
@@ -445,6 +446,9 @@ int main(int argc, char *argv[])
     TmxMapFormat tmxMapFormat;
     PluginManager::addObject(&tmxMapFormat);
 
+    BinaryMapFormat binaryMapFormat;
+    PluginManager::addObject(&binaryMapFormat);
+
     TsxTilesetFormat tsxTilesetFormat;
     PluginManager::addObject(&tsxTilesetFormat);
 
@@ -26,6 +26,7 @@
  * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "binarymapformat.h"
 #include "pluginmanager.h"
 #include "tmxrasterizer.h"
 #include "tmxmapformat.h"
@@ -54,6 +55,10 @@ int main(int argc, char *argv[])
 
     PluginManager::instance()->loadPlugins();
 
+    // Support reading maps in the binary format
+    BinaryMapFormat binaryMapFormat;
+    PluginManager::addObject(&binaryMapFormat);
+
     // Necessary to enable loading of object templates in XML format
     XmlObjectTemplateFormat xmlObjectTemplateFormat;
     PluginManager::addObject(&xmlObjectTemplateFormat);
@@ -105,6 +110,14 @@ int main(int argc, char *argv[])
                           { QStringLiteral("frame-duration"),
                             QCoreApplication::translate("main", "Duration of each frame in milliseconds, defaults to 100."),
                             QCoreApplication::translate("main", "number") },
+                          { QStringLiteral("threads"),
+                            QCoreApplication::translate("main", "Number of threads used for rendering (default: 1). Use 0 to use one thread per processor core. When using multiple threads, PNG images are written while rendering without keeping the whole image in memory, and the maps of a world are loaded and rendered in parallel."),
+                            QCoreApplication::translate("main", "number") },
+                          { QStringLiteral("progress"),
+                            QCoreApplication::translate("main", "When rendering a world, report the time taken to load and render each map.") },
+                          { QStringLiteral("output-tile-size"),
+                            QCoreApplication::translate("main", "Split the output into separate images of SIZE x SIZE pixels, rendered in parallel. The column and row of each tile are appended to the image names."),
+                            QCoreApplication::translate("main", "size") },
                       });
     parser.addPositionalArgument(QStringLiteral("map|world"), QCoreApplication::translate("main", "Map or world file to render."));
     parser.addPositionalArgument(QStringLiteral("image"), QCoreApplication::translate("main", "Image file to output."));
@@ -131,6 +144,7 @@ int main(int argc, char *argv[])
     w.setLayerTypeVisible(Layer::ImageLayerType, !parser.isSet(QLatin1String("hide-image-layers")));
     w.setObjectsToHide(parser.values(QLatin1String("hide-object")));
     w.setObjectsToShow(parser.values(QLatin1String("show-object")));
+    w.setShowProgress(parser.isSet(QLatin1String("progress")));
 
     if (parser.isSet(QLatin1String("size"))) {
         bool ok;
@@ -186,5 +200,25 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (parser.isSet(QLatin1String("threads"))) {
+        bool ok;
+        w.setThreadCount(parser.value(QLatin1String("threads")).toInt(&ok));
+        if (!ok || w.threadCount() < 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid number of threads specified: \"%1\"").arg(parser.value(QLatin1String("threads")));
+            exit(1);
+        }
+    } else if (parser.isSet(QLatin1String("output-tile-size"))) {
+        w.setThreadCount(0);
+    }
+
+    if (parser.isSet(QLatin1String("output-tile-size"))) {
+        bool ok;
+        w.setOutputTileSize(parser.value(QLatin1String("output-tile-size")).toInt(&ok));
+        if (!ok || w.outputTileSize() <= 0) {
+            qWarning().noquote() << QCoreApplication::translate("main", "Invalid output tile size specified: \"%1\"").arg(parser.value(QLatin1String("output-tile-size")));
+            exit(1);
+        }
+    }
+
     return w.render(fileToOpen, fileToSave);
 }
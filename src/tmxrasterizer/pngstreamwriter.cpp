@@ -0,0 +1,288 @@
+/*
+ * pngstreamwriter.cpp
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of the TMX Rasterizer.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "pngstreamwriter.h"
+
+#if (defined(Q_OS_WIN) && defined(Q_CC_MSVC)) || defined(Q_OS_WASM)
+#include "QtZlib/zlib.h"
+#else
+#include <zlib.h>
+#endif
+
+#include <QImage>
+#include <QtEndian>
+
+#include <array>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+namespace {
+
+void appendUInt32(QByteArray &data, quint32 value)
+{
+    const quint32 bigEndian = qToBigEndian(value);
+    data.append(reinterpret_cast<const char*>(&bigEndian), sizeof(bigEndian));
+}
+
+enum FilterType {
+    FilterNone,
+    FilterSub,
+    FilterUp,
+    FilterAverage,
+    FilterPaeth,
+    FilterTypeCount
+};
+
+constexpr int BytesPerPixel = 4;
+
+int paethPredictor(int left, int up, int upLeft)
+{
+    const int p = left + up - upLeft;
+    const int pLeft = std::abs(p - left);
+    const int pUp = std::abs(p - up);
+    const int pUpLeft = std::abs(p - upLeft);
+
+    if (pLeft <= pUp && pLeft <= pUpLeft)
+        return left;
+    if (pUp <= pUpLeft)
+        return up;
+    return upLeft;
+}
+
+/**
+ * Filters the given \a row into \a out, which starts with the filter type
+ * byte. The \a previous row may be null, in which case only the None and Sub
+ * filters may be used.
+ */
+void filterRow(FilterType type, const uchar *row, const uchar *previous,
+               qsizetype rowLength, uchar *out)
+{
+    out[0] = uchar(type);
+    ++out;
+
+    for (qsizetype i = 0; i < rowLength; ++i) {
+        const int left = i >= BytesPerPixel ? row[i - BytesPerPixel] : 0;
+        const int up = previous ? previous[i] : 0;
+        const int upLeft = previous && i >= BytesPerPixel ? previous[i - BytesPerPixel] : 0;
+
+        int prediction = 0;
+        switch (type) {
+        case FilterNone:        prediction = 0; break;
+        case FilterSub:         prediction = left; break;
+        case FilterUp:          prediction = up; break;
+        case FilterAverage:     prediction = (left + up) / 2; break;
+        case FilterPaeth:       prediction = paethPredictor(left, up, upLeft); break;
+        case FilterTypeCount:   break;
+        }
+
+        out[i] = uchar(row[i] - prediction);
+    }
+}
+
+/**
+ * The heuristic recommended by the PNG specification for choosing a filter:
+ * the sum of the filtered bytes, taken as signed values.
+ */
+quint64 filterCost(const uchar *filtered, qsizetype rowLength)
+{
+    quint64 cost = 0;
+    for (qsizetype i = 1; i <= rowLength; ++i)
+        cost += std::abs(int(static_cast<signed char>(filtered[i])));
+    return cost;
+}
+
+} // anonymous namespace
+
+PngStreamWriter::PngStreamWriter(const QString &fileName)
+    : mFile(fileName)
+{
+}
+
+/**
+ * Opens the file and writes the PNG header for an image of the given \a size.
+ */
+bool PngStreamWriter::open(QSize size)
+{
+    if (!mFile.open(QIODevice::WriteOnly)) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+
+    mAdler = adler32(0, Z_NULL, 0);
+
+    static const char signature[] = { '\x89', 'P', 'N', 'G', '\r', '\n', '\x1a', '\n' };
+    if (mFile.write(signature, sizeof(signature)) != qint64(sizeof(signature))) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+
+    QByteArray header;
+    appendUInt32(header, size.width());
+    appendUInt32(header, size.height());
+    header.append(char(8));     // bit depth
+    header.append(char(6));     // color type (RGBA)
+    header.append(char(0));     // compression method
+    header.append(char(0));     // filter method
+    header.append(char(0));     // interlace method
+
+    if (!writeChunk("IHDR", header))
+        return false;
+
+    // The zlib header for the image data (deflate, 32K window, default level)
+    return writeChunk("IDAT", QByteArray("\x78\x9c", 2));
+}
+
+/**
+ * Compresses the given \a band of rows, which is expected to be as wide as
+ * the image.
+ *
+ * The band is compressed as a raw deflate stream ending on a byte boundary,
+ * so that the compressed bands can be concatenated into a single zlib stream.
+ * This function is thread-safe.
+ *
+ * Each row is filtered adaptively, using the filter that minimizes the sum
+ * of the filtered bytes. Since the bands are compressed independently, the
+ * first row of a band can only use the None and Sub filters, which don't
+ * refer to the row above.
+ */
+PngStreamWriter::CompressedBand PngStreamWriter::compressBand(const QImage &band)
+{
+    CompressedBand result;
+
+    const QImage image = band.convertToFormat(QImage::Format_RGBA8888);
+    const qsizetype rowLength = qsizetype(image.width()) * 4;
+
+    z_stream stream {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        return result;
+
+    result.data.resize(deflateBound(&stream, (rowLength + 1) * image.height()) + 16);
+    stream.next_out = reinterpret_cast<Bytef*>(result.data.data());
+    stream.avail_out = result.data.size();
+
+    std::array<std::vector<uchar>, FilterTypeCount> filtered;
+    for (auto &buffer : filtered)
+        buffer.resize(rowLength + 1);
+
+    bool ok = true;
+
+    for (int y = 0; y < image.height() && ok; ++y) {
+        const uchar *row = image.constScanLine(y);
+        const uchar *previous = y > 0 ? image.constScanLine(y - 1) : nullptr;
+        const int filterCount = previous ? FilterTypeCount : FilterSub + 1;
+
+        int best = FilterNone;
+        quint64 bestCost = std::numeric_limits<quint64>::max();
+
+        for (int type = FilterNone; type < filterCount; ++type) {
+            filterRow(FilterType(type), row, previous, rowLength, filtered[type].data());
+
+            const quint64 cost = filterCost(filtered[type].data(), rowLength);
+            if (cost < bestCost) {
+                best = type;
+                bestCost = cost;
+            }
+        }
+
+        const uchar *data = filtered[best].data();
+        result.adler = adler32(result.adler, data, rowLength + 1);
+
+        stream.next_in = const_cast<Bytef*>(data);
+        stream.avail_in = rowLength + 1;
+        ok = deflate(&stream, Z_NO_FLUSH) == Z_OK;
+    }
+
+    // A sync flush aligns the output to a byte boundary without marking the
+    // last block as final.
+    ok = ok && deflate(&stream, Z_SYNC_FLUSH) == Z_OK && stream.avail_in == 0;
+
+    result.data.resize(result.data.size() - stream.avail_out);
+    result.length = (rowLength + 1) * image.height();
+    result.ok = ok;
+
+    deflateEnd(&stream);
+    return result;
+}
+
+bool PngStreamWriter::writeBand(const CompressedBand &band)
+{
+    if (!band.ok) {
+        mErrorString = QStringLiteral("Error compressing image data");
+        return false;
+    }
+
+    mAdler = adler32_combine(mAdler, band.adler, band.length);
+    return writeChunk("IDAT", band.data);
+}
+
+/**
+ * Terminates the image data and commits the file. When anything failed to
+ * be written, the file is left untouched.
+ */
+bool PngStreamWriter::finish()
+{
+    // An empty final block using fixed Huffman codes, followed by the
+    // checksum of the uncompressed data
+    QByteArray trailer("\x03\x00", 2);
+    appendUInt32(trailer, mAdler);
+
+    if (!writeChunk("IDAT", trailer) || !writeChunk("IEND", QByteArray())) {
+        mFile.cancelWriting();
+        return false;
+    }
+
+    if (!mFile.commit()) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool PngStreamWriter::writeChunk(const char *type, const QByteArray &data)
+{
+    QByteArray chunk;
+    chunk.reserve(data.size() + 12);
+    appendUInt32(chunk, data.size());
+    chunk.append(type, 4);
+    chunk.append(data);
+
+    const auto crc = crc32(crc32(0, Z_NULL, 0),
+                           reinterpret_cast<const Bytef*>(chunk.constData() + 4),
+                           data.size() + 4);
+    appendUInt32(chunk, crc);
+
+    if (mFile.write(chunk) != chunk.size()) {
+        mErrorString = mFile.errorString();
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,75 @@
+/*
+ * pngstreamwriter.h
+ * Copyright 2026, agent <agent@local>
+ *
+ * This file is part of the TMX Rasterizer.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *    1. Redistributions of source code must retain the above copyright notice,
+ *       this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE CONTRIBUTORS ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO
+ * EVENT SHALL THE CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QSaveFile>
+#include <QSize>
+#include <QString>
+
+class QImage;
+
+/**
+ * Writes a PNG image in horizontal bands, so that the whole image never needs
+ * to be kept in memory.
+ *
+ * The bands can be compressed independently, for example on several threads,
+ * using compressBand(). The compressed bands need to be written in order from
+ * top to bottom using writeBand().
+ *
+ * The file is only replaced once finish() succeeds.
+ */
+class PngStreamWriter
+{
+public:
+    struct CompressedBand
+    {
+        QByteArray data;
+        quint32 adler = 1;
+        qint64 length = 0;
+        bool ok = false;
+    };
+
+    explicit PngStreamWriter(const QString &fileName);
+
+    bool open(QSize size);
+    bool writeBand(const CompressedBand &band);
+    bool finish();
+
+    QString errorString() const { return mErrorString; }
+
+    static CompressedBand compressBand(const QImage &band);
+
+private:
+    bool writeChunk(const char *type, const QByteArray &data);
+
+    QSaveFile mFile;
+    quint32 mAdler = 1;
+    QString mErrorString;
+};
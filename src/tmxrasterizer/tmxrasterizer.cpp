@@ -28,18 +28,25 @@
 
 #include "tmxrasterizer.h"
 
+#include "pngstreamwriter.h"
+
 #include "grouplayer.h"
 #include "imagelayer.h"
 #include "map.h"
 #include "mapformat.h"
 #include "objectgroup.h"
+#include "templatemanager.h"
 #include "tilelayer.h"
 #include "tilesetmanager.h"
 #include "world.h"
 
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QImageWriter>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 
 #include <memory>
 
@@ -47,9 +54,17 @@ using namespace Tiled;
 
 TmxRasterizer::TmxRasterizer() = default;
 
+/**
+ * Draws the layers of the map rendered by the given \a renderer.
+ *
+ * When an \a exposed rectangle is given, in the coordinates of the map (or
+ * the world, when a \a mapOffset is given), tile and image layers are only
+ * drawn within this rectangle.
+ */
 void TmxRasterizer::drawMapLayers(const MapRenderer &renderer,
                                   QPainter &painter,
-                                  QPoint mapOffset) const
+                                  QPoint mapOffset,
+                                  const QRectF &exposed) const
 {
     // Perform a similar rendering than found in minimaprenderer.cpp
     LayerIterator iterator(renderer.map());
@@ -64,10 +79,13 @@ void TmxRasterizer::drawMapLayers(const MapRenderer &renderer,
         painter.setOpacity(layerOpacity);
         painter.translate(offset);
 
+        const QRectF layerExposed = exposed.isNull() ? QRectF()
+                                                     : exposed.translated(-offset);
+
         switch (layer->layerType()) {
         case Layer::TileLayerType:
             painter.setCompositionMode(compositionMode);
-            renderer.drawTileLayer(&painter, static_cast<const TileLayer*>(layer));
+            renderer.drawTileLayer(&painter, static_cast<const TileLayer*>(layer), layerExposed);
             break;
         case Layer::ObjectGroupType: {
             const auto objectGroup = static_cast<const ObjectGroup*>(layer);
@@ -103,7 +121,7 @@ void TmxRasterizer::drawMapLayers(const MapRenderer &renderer,
         }
         case Layer::ImageLayerType:
             painter.setCompositionMode(compositionMode);
-            renderer.drawImageLayer(&painter, static_cast<const ImageLayer*>(layer));
+            renderer.drawImageLayer(&painter, static_cast<const ImageLayer*>(layer), layerExposed);
             break;
         case Layer::GroupLayerType:
             // Recursion handled by LayerIterator
@@ -234,21 +252,191 @@ int TmxRasterizer::renderMap(const MapRenderer &renderer,
     mapSize.rwidth() *= xScale;
     mapSize.rheight() *= yScale;
 
+    QTransform transform = QTransform::fromScale(xScale, yScale);
+    transform.translate(-mapBoundingRect.left(), -mapBoundingRect.top());
+
+    if (!mapSize.isEmpty()) {
+        if (mOutputTileSize > 0)
+            return renderImageTiles(renderer, transform, mapSize, imageFileName);
+        if (mThreadCount != 1)
+            return renderImageBands(renderer, transform, mapSize, imageFileName);
+    }
+
     QImage image(mapSize, QImage::Format_ARGB32);
     image.fill(Qt::transparent);
     QPainter painter(&image);
 
     painter.setRenderHint(QPainter::Antialiasing, mUseAntiAliasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, mSmoothImages);
-    painter.setTransform(QTransform::fromScale(xScale, yScale));
-
-    painter.translate(-mapBoundingRect.left(), -mapBoundingRect.top());
+    painter.setTransform(transform);
 
     drawMapLayers(renderer, painter);
 
     return saveImage(imageFileName, image);
 }
 
+/**
+ * Renders the given \a region of the output image into \a image, which is
+ * expected to match the size of the region. The \a transform maps from map
+ * (or world) coordinates to output image coordinates. The \a mapOffset is
+ * the position of the map within the world.
+ *
+ * Since this function only reads from the map, it can be called from multiple
+ * threads at the same time.
+ */
+void TmxRasterizer::renderRegion(const MapRenderer &renderer,
+                                 const QTransform &transform,
+                                 const QRect &region,
+                                 QImage &image,
+                                 QPoint mapOffset) const
+{
+    QPainter painter(&image);
+
+    painter.setRenderHint(QPainter::Antialiasing, mUseAntiAliasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform, mSmoothImages);
+    painter.setTransform(transform * QTransform::fromTranslate(-region.x(), -region.y()));
+
+    const QRectF exposed = transform.inverted().mapRect(QRectF(region));
+    drawMapLayers(renderer, painter, mapOffset, exposed);
+}
+
+int TmxRasterizer::effectiveThreadCount() const
+{
+    return mThreadCount > 0 ? mThreadCount : QThread::idealThreadCount();
+}
+
+/**
+ * Renders the output image as separate tiles of mOutputTileSize pixels, which
+ * are saved next to the given \a imageFileName with their column and row
+ * appended to the name.
+ */
+int TmxRasterizer::renderImageTiles(const MapRenderer &renderer,
+                                    const QTransform &transform,
+                                    QSize imageSize,
+                                    const QString &imageFileName) const
+{
+    const QFileInfo imageFileInfo(imageFileName);
+    const QString imagePath = imageFileInfo.path();
+    const QString imageBaseName = imageFileInfo.completeBaseName();
+    const QString imageSuffix = imageFileInfo.suffix();
+
+    QVector<QRect> tiles;
+    for (int y = 0; y < imageSize.height(); y += mOutputTileSize)
+        for (int x = 0; x < imageSize.width(); x += mOutputTileSize)
+            tiles.append(QRect(x, y,
+                               qMin(mOutputTileSize, imageSize.width() - x),
+                               qMin(mOutputTileSize, imageSize.height() - y)));
+
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(effectiveThreadCount());
+
+    const auto results = QtConcurrent::blockingMapped<QVector<int>>(&threadPool, tiles, [&] (const QRect &tile) {
+        QImage image(tile.size(), QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+        renderRegion(renderer, transform, tile, image);
+
+        const QString tileFileName = QStringLiteral("%1/%2_%3_%4.%5")
+                .arg(imagePath, imageBaseName,
+                     QString::number(tile.x() / mOutputTileSize),
+                     QString::number(tile.y() / mOutputTileSize),
+                     imageSuffix);
+
+        return saveImage(tileFileName, image);
+    });
+
+    return results.contains(1) ? 1 : 0;
+}
+
+static bool isPngFile(const QString &fileName)
+{
+    const QByteArray suffix = QFileInfo(fileName).suffix().toLower().toLatin1();
+
+    // saveImage falls back to PNG for unsupported formats
+    return suffix == "png" || !QImageWriter::supportedImageFormats().contains(suffix);
+}
+
+/**
+ * Renders the output image in horizontal bands on multiple threads.
+ *
+ * When writing a PNG file, the bands are compressed on the worker threads
+ * and streamed to the file in order, so that only a few bands are kept in
+ * memory at any time.
+ */
+int TmxRasterizer::renderImageBands(const MapRenderer &renderer,
+                                    const QTransform &transform,
+                                    QSize imageSize,
+                                    const QString &imageFileName) const
+{
+    constexpr int BandHeight = 128;
+
+    QVector<QRect> bands;
+    for (int y = 0; y < imageSize.height(); y += BandHeight)
+        bands.append(QRect(0, y, imageSize.width(),
+                           qMin(BandHeight, imageSize.height() - y)));
+
+    const int threadCount = effectiveThreadCount();
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(threadCount);
+
+    if (!isPngFile(imageFileName)) {
+        QImage image(imageSize, QImage::Format_ARGB32);
+        image.fill(Qt::transparent);
+
+        // Each band is rendered into a QImage sharing the memory of the image
+        uchar *bits = image.bits();
+        const qsizetype bytesPerLine = image.bytesPerLine();
+
+        QtConcurrent::blockingMap(&threadPool, bands, [&] (const QRect &band) {
+            QImage bandImage(bits + band.y() * bytesPerLine,
+                             band.width(), band.height(),
+                             bytesPerLine, QImage::Format_ARGB32);
+            renderRegion(renderer, transform, band, bandImage);
+        });
+
+        return saveImage(imageFileName, image);
+    }
+
+    PngStreamWriter writer(imageFileName);
+    if (!writer.open(imageSize)) {
+        qWarning("Error while writing \"%s\": %s",
+                 qUtf8Printable(imageFileName),
+                 qUtf8Printable(writer.errorString()));
+        return 1;
+    }
+
+    // Render a limited number of bands at a time to bound the memory usage
+    const int batchSize = threadCount * 2;
+
+    for (qsizetype start = 0; start < bands.size(); start += batchSize) {
+        const QVector<QRect> batch = bands.mid(start, batchSize);
+
+        const auto compressedBands = QtConcurrent::blockingMapped<QVector<PngStreamWriter::CompressedBand>>(&threadPool, batch, [&] (const QRect &band) {
+            QImage bandImage(band.size(), QImage::Format_ARGB32);
+            bandImage.fill(Qt::transparent);
+            renderRegion(renderer, transform, band, bandImage);
+            return PngStreamWriter::compressBand(bandImage);
+        });
+
+        for (const auto &compressedBand : compressedBands) {
+            if (!writer.writeBand(compressedBand)) {
+                qWarning("Error while writing \"%s\": %s",
+                         qUtf8Printable(imageFileName),
+                         qUtf8Printable(writer.errorString()));
+                return 1;
+            }
+        }
+    }
+
+    if (!writer.finish()) {
+        qWarning("Error while writing \"%s\": %s",
+                 qUtf8Printable(imageFileName),
+                 qUtf8Printable(writer.errorString()));
+        return 1;
+    }
+
+    return 0;
+}
+
 
 int TmxRasterizer::saveImage(const QString &imageFileName,
                              const QImage &image) const
@@ -268,6 +456,81 @@ int TmxRasterizer::saveImage(const QString &imageFileName,
     return 0;
 }
 
+namespace {
+
+struct WorldMap
+{
+    QString fileName;
+    QString errorString;
+    QPoint offset;
+    std::unique_ptr<Map> map;
+    std::unique_ptr<MapRenderer> renderer;
+    QRect boundingRect;     // in world coordinates
+    QRect renderRect;       // includes layer offsets and image layers
+    bool renderSeparately = false;
+    QImage image;           // set when rendered separately
+    QPoint imagePosition;
+    qint64 loadTime = 0;
+    qint64 renderTime = 0;
+};
+
+} // anonymous namespace
+
+static std::shared_ptr<WorldMap> loadWorldMap(const WorldMapEntry &mapEntry)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    auto worldMap = std::make_shared<WorldMap>();
+    worldMap->fileName = mapEntry.fileName;
+    worldMap->offset = mapEntry.rect.topLeft();
+    worldMap->map = readMap(mapEntry.fileName, &worldMap->errorString);
+
+    if (worldMap->map) {
+        worldMap->renderer = MapRenderer::create(worldMap->map.get());
+
+        QRect mapBoundingRect = worldMap->renderer->mapBoundingRect();
+        worldMap->boundingRect = mapBoundingRect.translated(worldMap->offset);
+
+        worldMap->map->adjustBoundingRectForOffsetsAndImageLayers(mapBoundingRect);
+        worldMap->renderRect = mapBoundingRect.translated(worldMap->offset);
+    }
+
+    worldMap->loadTime = timer.elapsed();
+    return worldMap;
+}
+
+/**
+ * Returns whether the given \a map can be rendered into its own image, which
+ * is then drawn on top of the maps before it. This gives the same result as
+ * drawing its layers directly, unless any of them uses a composition mode
+ * other than SourceOver.
+ */
+bool TmxRasterizer::canRenderSeparately(const Map &map) const
+{
+    LayerIterator iterator(&map);
+    while (const Layer *layer = iterator.next()) {
+        if (shouldDrawLayer(layer) &&
+                layer->compositionMode() != QPainter::CompositionMode_SourceOver) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Renders all maps of the given world.
+ *
+ * The maps are loaded and rendered on multiple threads, a limited number at a
+ * time to bound the memory usage. Since the size of the world is only known
+ * once all maps have been loaded, the maps are loaded twice, like before. The
+ * second time, the tileset images are usually still in the ImageCache.
+ *
+ * Each map is rendered into its own image, which are drawn in the order of the
+ * maps in the world. Maps with layers using other composition modes than
+ * SourceOver depend on the maps below them, so these are drawn directly onto
+ * the world image when it is their turn.
+ */
 int TmxRasterizer::renderWorld(const QString &worldFileName,
                                const QString &imageFileName)
 {
@@ -286,20 +549,33 @@ int TmxRasterizer::renderWorld(const QString &worldFileName,
                  qUtf8Printable(worldFileName));
         return 1;
     }
+
+    // Make sure these managers are created on the main thread
+    TilesetManager::instance();
+    TemplateManager::instance();
+
+    const int threadCount = effectiveThreadCount();
+    QThreadPool threadPool;
+    threadPool.setMaxThreadCount(threadCount);
+
+    // Load a limited number of maps at a time to bound the memory usage
+    const int batchSize = threadCount * 2;
+
     QRect worldBoundingRect;
-    for (const WorldMapEntry &mapEntry : maps) {
-        std::unique_ptr<Map> map { readMap(mapEntry.fileName, &errorString) };
-        if (!map) {
-            qWarning("Error while reading \"%s\":\n%s",
-                     qUtf8Printable(mapEntry.fileName),
-                     qUtf8Printable(errorString));
-            continue;
-        }
-        const auto renderer = MapRenderer::create(map.get());
-        QRect mapBoundingRect = renderer->mapBoundingRect();
-        mapBoundingRect.translate(mapEntry.rect.topLeft());
+    for (qsizetype start = 0; start < maps.size(); start += batchSize) {
+        const auto batch = maps.mid(start, batchSize);
+        const auto worldMaps = QtConcurrent::blockingMapped<QVector<std::shared_ptr<WorldMap>>>(&threadPool, batch, loadWorldMap);
+
+        for (const auto &worldMap : worldMaps) {
+            if (!worldMap->map) {
+                qWarning("Error while reading \"%s\":\n%s",
+                         qUtf8Printable(worldMap->fileName),
+                         qUtf8Printable(worldMap->errorString));
+                continue;
+            }
 
-        worldBoundingRect = worldBoundingRect.united(mapBoundingRect);
+            worldBoundingRect = worldBoundingRect.united(worldMap->boundingRect);
+        }
     }
 
     QSize worldSize = worldBoundingRect.size();
@@ -320,25 +596,81 @@ int TmxRasterizer::renderWorld(const QString &worldFileName,
 
     painter.setRenderHint(QPainter::Antialiasing, mUseAntiAliasing);
     painter.setRenderHint(QPainter::SmoothPixmapTransform, mSmoothImages);
-    painter.setTransform(QTransform::fromScale(xScale, yScale));
 
-    painter.translate(-worldBoundingRect.topLeft());
+    QTransform transform = QTransform::fromScale(xScale, yScale);
+    transform.translate(-worldBoundingRect.left(), -worldBoundingRect.top());
 
-    for (const WorldMapEntry &mapEntry : maps) {
-        std::unique_ptr<Map> map { readMap(mapEntry.fileName, &errorString) };
-        if (!map) {
-            qWarning("Error while reading \"%s\":\n%s",
-                    qUtf8Printable(mapEntry.fileName),
-                    qUtf8Printable(errorString));
-            continue;
+    auto renderWorldMap = [&] (std::shared_ptr<WorldMap> &worldMap) {
+        if (!worldMap->map || !canRenderSeparately(*worldMap->map))
+            return;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        const QRect region = transform.mapRect(QRectF(worldMap->renderRect)).toAlignedRect()
+                & image.rect();
+
+        worldMap->renderSeparately = true;
+
+        if (!region.isEmpty()) {
+            worldMap->image = QImage(region.size(), QImage::Format_ARGB32);
+            worldMap->image.fill(Qt::transparent);
+            worldMap->imagePosition = region.topLeft();
+
+            renderRegion(*worldMap->renderer, transform, region,
+                         worldMap->image, worldMap->offset);
         }
+
+        worldMap->renderTime = timer.elapsed();
+    };
+
+    for (qsizetype start = 0; start < maps.size(); start += batchSize) {
+        const auto batch = maps.mid(start, batchSize);
+        auto worldMaps = QtConcurrent::blockingMapped<QVector<std::shared_ptr<WorldMap>>>(&threadPool, batch, loadWorldMap);
+
+        // Only the tilesets of the maps in this batch are affected
         if (mAdvanceAnimations > 0)
             TilesetManager::instance()->advanceTileAnimations(mAdvanceAnimations);
 
-        const auto renderer = MapRenderer::create(map.get());
-        drawMapLayers(*renderer, painter, mapEntry.rect.topLeft());
+        QtConcurrent::blockingMap(&threadPool, worldMaps, renderWorldMap);
+
+        for (qsizetype i = 0; i < worldMaps.size(); ++i) {
+            WorldMap &worldMap = *worldMaps.at(i);
+            if (!worldMap.map)
+                continue;   // already reported
+
+            if (worldMap.renderSeparately) {
+                if (!worldMap.image.isNull())
+                    painter.drawImage(worldMap.imagePosition, worldMap.image);
+            } else {
+                QElapsedTimer timer;
+                timer.start();
+
+                painter.setTransform(transform);
+                drawMapLayers(*worldMap.renderer, painter, worldMap.offset);
+                painter.resetTransform();
+                painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+                painter.setOpacity(1.0);
+
+                worldMap.renderTime = timer.elapsed();
+            }
+
+            if (mShowProgress) {
+                qInfo("[%lld/%lld] %s: loaded in %lld ms, rendered in %lld ms",
+                      static_cast<long long>(start + i + 1),
+                      static_cast<long long>(maps.size()),
+                      qUtf8Printable(worldMap.fileName),
+                      static_cast<long long>(worldMap.loadTime),
+                      static_cast<long long>(worldMap.renderTime));
+            }
+        }
+
+        // Release the maps before loading the next batch
+        worldMaps.clear();
         TilesetManager::instance()->resetTileAnimations();
     }
 
+    painter.end();
+
     return saveImage(imageFileName, image);
 }
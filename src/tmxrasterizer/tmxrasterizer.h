@@ -39,6 +39,7 @@ using namespace Tiled;
 
 class QImage;
 class QPainter;
+class QThreadPool;
 
 class TmxRasterizer
 {
@@ -54,6 +55,9 @@ public:
     bool useAntiAliasing() const { return mUseAntiAliasing; }
     bool smoothImages() const { return mSmoothImages; }
     bool ignoreVisibility() const { return mIgnoreVisibility; }
+    int threadCount() const { return mThreadCount; }
+    int outputTileSize() const { return mOutputTileSize; }
+    bool showProgress() const { return mShowProgress; }
 
     void setScale(qreal scale) { mScale = scale; }
     void setTileSize(int tileSize) { mTileSize = tileSize; }
@@ -64,6 +68,9 @@ public:
     void setAntiAliasing(bool useAntiAliasing) { mUseAntiAliasing = useAntiAliasing; }
     void setSmoothImages(bool smoothImages) { mSmoothImages = smoothImages; }
     void setIgnoreVisibility(bool IgnoreVisibility) { mIgnoreVisibility = IgnoreVisibility; }
+    void setThreadCount(int threadCount) { mThreadCount = threadCount; }
+    void setOutputTileSize(int outputTileSize) { mOutputTileSize = outputTileSize; }
+    void setShowProgress(bool showProgress) { mShowProgress = showProgress; }
 
     void setLayersToHide(QStringList layersToHide) { mLayersToHide = layersToHide; }
     void setLayersToShow(QStringList layersToShow) { mLayersToShow = layersToShow; }
@@ -85,15 +92,28 @@ private:
     bool mUseAntiAliasing = false;
     bool mSmoothImages = true;
     bool mIgnoreVisibility = false;
+    int mThreadCount = 1;
+    int mOutputTileSize = 0;
+    bool mShowProgress = false;
     QStringList mLayersToHide;
     QStringList mLayersToShow;
     QStringList mObjectsToHide;
     QStringList mObjectsToShow;
     int mLayerTypesToShow = Layer::AnyLayerType & ~Layer::GroupLayerType;
 
-    void drawMapLayers(const MapRenderer &renderer, QPainter &painter, QPoint mapOffset = QPoint(0, 0)) const;
+    void drawMapLayers(const MapRenderer &renderer, QPainter &painter, QPoint mapOffset = QPoint(0, 0),
+                       const QRectF &exposed = QRectF()) const;
+    void renderRegion(const MapRenderer &renderer, const QTransform &transform,
+                      const QRect &region, QImage &image,
+                      QPoint mapOffset = QPoint(0, 0)) const;
     int renderMap(const MapRenderer &renderer, const QString &imageFileName);
+    int renderImageTiles(const MapRenderer &renderer, const QTransform &transform,
+                         QSize imageSize, const QString &imageFileName) const;
+    int renderImageBands(const MapRenderer &renderer, const QTransform &transform,
+                         QSize imageSize, const QString &imageFileName) const;
+    int effectiveThreadCount() const;
     int renderWorld(const QString &worldFileName, const QString &imageFileName);
+    bool canRenderSeparately(const Map &map) const;
     int saveImage(const QString &imageFileName, const QImage &image) const;
     bool shouldDrawLayer(const Layer *layer) const;
     bool shouldDrawObject(const MapObject *object) const;
@@ -28,6 +28,7 @@
 
 #include "tmxviewer.h"
 
+#include "binarymapformat.h"
 #include "pluginmanager.h"
 #include "tiled.h"
 #include "tmxmapformat.h"
@@ -61,6 +62,10 @@ int main(int argc, char *argv[])
 
     Tiled::PluginManager::instance()->loadPlugins();
 
+    // Support reading maps in the binary format
+    Tiled::BinaryMapFormat binaryMapFormat;
+    Tiled::PluginManager::addObject(&binaryMapFormat);
+
     // Necessary to enable loading of object templates in XML format
     Tiled::XmlObjectTemplateFormat xmlObjectTemplateFormat;
     Tiled::PluginManager::addObject(&xmlObjectTemplateFormat);
@@ -1,11 +1,14 @@
 #include "map.h"
 #include "tilelayer.h"
+#include "tileset.h"
 #include "mapreader.h"
 
 #include "automapper.h"
 #include "mapdocument.h"
 
 #include <QtTest/QtTest>
+#include <QRandomGenerator>
+#include <QThreadPool>
 
 using namespace Tiled;
 
@@ -16,8 +19,28 @@ class test_AutoMapping : public QObject
 private slots:
     void autoMap_data();
     void autoMap();
+
+    void anchorIndex_data();
+    void anchorIndex();
+
+    void threadCount_data();
+    void threadCount();
 };
 
+/**
+ * Applies the changes done by AutoMapping to the map (only tile layers).
+ */
+static void applyOutput(AutoMappingContext &context, Map *map)
+{
+    for (auto& [original, outputLayer] : context.originalToOutputLayerMapping) {
+        const QRegion diffRegion = original->computeDiffRegion(*outputLayer);
+        original->setCells(0, 0, outputLayer.get(), diffRegion);
+    }
+    for (auto &layer : context.newLayers)
+        if (!layer->isEmpty())
+            map->addLayer(std::move(layer));
+}
+
 void test_AutoMapping::autoMap_data()
 {
     QTest::addColumn<QString>("directory");
@@ -75,13 +98,7 @@ void test_AutoMapping::autoMap()
     }
 
     // Apply the changes done by AutoMapping (only checking tile layers for now)
-    for (auto& [original, outputLayer] : context.originalToOutputLayerMapping) {
-        const QRegion diffRegion = original->computeDiffRegion(*outputLayer);
-        original->setCells(0, 0, outputLayer.get(), diffRegion);
-    }
-    for (auto &layer : context.newLayers)
-        if (!layer->isEmpty())
-            mapDocument.map()->addLayer(std::move(layer));
+    applyOutput(context, mapDocument.map());
 
     QCOMPARE(mapDocument.map()->layerCount(), resultMap->layerCount());
 
@@ -107,5 +124,191 @@ void test_AutoMapping::autoMap()
     }
 }
 
+/**
+ * Creates a rules map with rules that require specific tiles on the "ground"
+ * layer, as well as a rule that matches nearly everywhere. None of the rules
+ * output to the layer they read from.
+ */
+static std::unique_ptr<Map> createRulesMap(const SharedTileset &tileset, bool matchInOrder)
+{
+    auto rulesMap = std::make_unique<Map>(Map::Orthogonal, 16, 4, 16, 16);
+    rulesMap->addTileset(tileset);
+    rulesMap->setProperty(QStringLiteral("MatchInOrder"), matchInOrder);
+
+    auto input = std::make_unique<TileLayer>(QStringLiteral("input_ground"), 0, 0, 16, 4);
+    auto outputDecor = std::make_unique<TileLayer>(QStringLiteral("output_decor"), 0, 0, 16, 4);
+    auto outputFill = std::make_unique<TileLayer>(QStringLiteral("output_fill"), 0, 0, 16, 4);
+
+    auto cell = [&] (int tileId) { return Cell(tileset.data(), tileId); };
+
+    // Two different tiles next to each other
+    input->setCell(0, 0, cell(1));
+    input->setCell(1, 0, cell(2));
+    outputDecor->setCell(0, 0, cell(3));
+
+    // A single tile
+    input->setCell(4, 0, cell(3));
+    outputDecor->setCell(4, 0, cell(1));
+
+    // The same tile twice, above each other
+    input->setCell(7, 0, cell(2));
+    input->setCell(7, 1, cell(2));
+    outputDecor->setCell(7, 0, cell(2));
+    outputDecor->setCell(7, 1, cell(2));
+
+    // The most common tile, for which the full scan is used
+    input->setCell(10, 0, cell(0));
+    outputFill->setCell(10, 0, cell(1));
+
+    // A common tile with a rare one
+    input->setCell(13, 0, cell(0));
+    input->setCell(14, 0, cell(3));
+    outputFill->setCell(13, 0, cell(2));
+
+    rulesMap->addLayer(std::move(input));
+    rulesMap->addLayer(std::move(outputDecor));
+    rulesMap->addLayer(std::move(outputFill));
+
+    return rulesMap;
+}
+
+static std::unique_ptr<Map> createMap(const SharedTileset &tileset, bool infinite)
+{
+    auto map = std::make_unique<Map>(Map::Orthogonal, 96, 96, 16, 16);
+    map->setInfinite(infinite);
+    map->addTileset(tileset);
+
+    // Infinite maps are filled a bit outside of their initial size
+    const QRect area = infinite ? QRect(-20, -20, 136, 136) : QRect(0, 0, 96, 96);
+
+    QRandomGenerator random(12);
+    auto ground = std::make_unique<TileLayer>(QStringLiteral("ground"), 0, 0, 96, 96);
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            const int r = random.bounded(100);
+            if (r < 5)
+                continue;   // leave some cells empty
+            ground->setCell(x, y, Cell(tileset.data(), r < 90 ? 0 : 1 + r % 3));
+        }
+    }
+
+    map->addLayer(std::move(ground));
+    map->addLayer(std::make_unique<TileLayer>(QStringLiteral("decor"), 0, 0, 96, 96));
+    map->addLayer(std::make_unique<TileLayer>(QStringLiteral("fill"), 0, 0, 96, 96));
+
+    return map;
+}
+
+static std::unique_ptr<Map> autoMapped(const SharedTileset &tileset,
+                                       bool infinite,
+                                       const QRect &where,
+                                       bool matchInOrder)
+{
+    MapDocument mapDocument(createMap(tileset, infinite));
+    AutoMapper autoMapper(createRulesMap(tileset, matchInOrder));
+    AutoMappingContext context(&mapDocument);
+
+    autoMapper.prepareAutoMap(context);
+    autoMapper.autoMap(where, nullptr, context);
+    applyOutput(context, mapDocument.map());
+
+    return mapDocument.map()->clone();
+}
+
+static SharedTileset createTileset()
+{
+    auto tileset = Tileset::create(QStringLiteral("tiles"), 16, 16);
+    QImage image(64, 16, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+    tileset->loadFromImage(image, QStringLiteral("tiles.png"));
+    return tileset;
+}
+
+/**
+ * Compares the tile layers of two AutoMapped maps.
+ */
+static void compareTileLayers(const Map &actual, const Map &expected)
+{
+    QCOMPARE(actual.layerCount(), expected.layerCount());
+
+    for (int i = 0; i < expected.layerCount(); ++i) {
+        const auto *expectedLayer = expected.layerAt(i)->asTileLayer();
+        const auto *actualLayer = actual.layerAt(i)->asTileLayer();
+        QVERIFY(expectedLayer && actualLayer);
+        QCOMPARE(actualLayer->name(), expectedLayer->name());
+        QCOMPARE(actualLayer->region(), expectedLayer->region());
+
+        for (auto it = expectedLayer->begin(); it != expectedLayer->end(); ++it)
+            QCOMPARE(actualLayer->cellAt(it.key()), it.value());
+    }
+}
+
+void test_AutoMapping::anchorIndex_data()
+{
+    QTest::addColumn<bool>("infinite");
+    QTest::addColumn<QRect>("where");
+
+    QTest::newRow("fixed") << false << QRect(0, 0, 96, 96);
+    QTest::newRow("fixed-part") << false << QRect(17, 9, 40, 23);
+    QTest::newRow("infinite") << true << QRect(-20, -20, 136, 136);
+    QTest::newRow("infinite-part") << true << QRect(-13, 50, 70, 31);
+}
+
+/**
+ * Matching rules only at the positions where their anchor tile occurs gives
+ * the same result as the full scan done with MatchInOrder, since none of the
+ * rules change the layer they match against.
+ */
+void test_AutoMapping::anchorIndex()
+{
+    QFETCH(bool, infinite);
+    QFETCH(QRect, where);
+
+    const SharedTileset tileset = createTileset();
+    QCOMPARE(tileset->tileCount(), 4);
+
+    const auto indexed = autoMapped(tileset, infinite, where, false);
+    const auto serial = autoMapped(tileset, infinite, where, true);
+
+    compareTileLayers(*indexed, *serial);
+    if (QTest::currentTestFailed())
+        return;
+
+    // Make sure the rules actually matched
+    const auto *decor = serial->layerAt(1)->asTileLayer();
+    QVERIFY(!decor->isEmpty());
+}
+
+void test_AutoMapping::threadCount_data()
+{
+    anchorIndex_data();
+}
+
+/**
+ * Matching the rules on a single thread gives the same result as matching
+ * them on several threads, since the matches are applied in the same order.
+ */
+void test_AutoMapping::threadCount()
+{
+    QFETCH(bool, infinite);
+    QFETCH(QRect, where);
+
+    const SharedTileset tileset = createTileset();
+    QCOMPARE(tileset->tileCount(), 4);
+
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    const int maxThreadCount = threadPool->maxThreadCount();
+
+    threadPool->setMaxThreadCount(1);
+    const auto singleThreaded = autoMapped(tileset, infinite, where, false);
+
+    threadPool->setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+    const auto multiThreaded = autoMapped(tileset, infinite, where, false);
+
+    threadPool->setMaxThreadCount(maxThreadCount);
+
+    compareTileLayers(*multiThreaded, *singleThreaded);
+}
+
 QTEST_MAIN(test_AutoMapping)
 #include "test_automapping.moc"
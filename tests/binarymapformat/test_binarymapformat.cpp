@@ -0,0 +1,274 @@
+#include "binarymapformat.h"
+#include "compression.h"
+#include "grouplayer.h"
+#include "map.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+
+using namespace Tiled;
+
+class test_BinaryMapFormat : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void roundTrip_data();
+    void roundTrip();
+    void readRegion();
+    void corruptFile_data();
+    void corruptFile();
+
+private:
+    std::unique_ptr<Map> createMap(bool infinite, Map::LayerDataFormat format) const;
+    QString filePath(const QString &fileName) const;
+
+    QTemporaryDir mTemporaryDir;
+    QVector<SharedTileset> mTilesets;
+};
+
+void test_BinaryMapFormat::initTestCase()
+{
+    QVERIFY(mTemporaryDir.isValid());
+
+    // Tileset images are written next to the maps, so they can be loaded
+    // again when reading
+    for (int i = 0; i < 2; ++i) {
+        const QString imageFileName = filePath(QStringLiteral("tiles%1.png").arg(i));
+        QImage image(128, 64 * (i + 1), QImage::Format_ARGB32);
+        image.fill(i == 0 ? Qt::red : Qt::blue);
+        QVERIFY(image.save(imageFileName));
+
+        auto tileset = Tileset::create(QStringLiteral("tiles%1").arg(i), 16, 16);
+        QVERIFY(tileset->loadFromImage(imageFileName));
+        mTilesets.append(tileset);
+    }
+}
+
+QString test_BinaryMapFormat::filePath(const QString &fileName) const
+{
+    return mTemporaryDir.filePath(fileName);
+}
+
+/**
+ * Creates a map with tile layers spanning several blocks, including partial
+ * blocks at the edges and, for infinite maps, at negative coordinates.
+ */
+std::unique_ptr<Map> test_BinaryMapFormat::createMap(bool infinite,
+                                                     Map::LayerDataFormat format) const
+{
+    auto map = std::make_unique<Map>(Map::Orthogonal, 150, 100, 16, 16);
+    map->setInfinite(infinite);
+    map->setLayerDataFormat(format);
+    map->setCompressionLevel(3);
+    map->setProperty(QStringLiteral("name"), QStringLiteral("binary"));
+    for (const SharedTileset &tileset : mTilesets)
+        map->addTileset(tileset);
+
+    const QRect area = infinite ? QRect(-70, -40, 220, 150) : QRect(0, 0, 150, 100);
+
+    QRandomGenerator random(19);
+    auto ground = std::make_unique<TileLayer>(QStringLiteral("ground"), 0, 0, 150, 100);
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            if (random.bounded(8) == 0)
+                continue;
+
+            const SharedTileset &tileset = mTilesets.at(random.bounded(int(mTilesets.size())));
+            Cell cell(tileset.data(), random.bounded(tileset->tileCount()));
+            cell.setFlags(random.bounded(Cell::VisualFlags + 1));
+            ground->setCell(x, y, cell);
+        }
+    }
+
+    // A layer with only a few tiles, in a group
+    auto group = std::make_unique<GroupLayer>(QStringLiteral("group"), 0, 0);
+    auto details = std::make_unique<TileLayer>(QStringLiteral("details"), 0, 0, 150, 100);
+    details->setCell(3, 4, Cell(mTilesets.last().data(), 7));
+    details->setCell(149, 99, Cell(mTilesets.first().data(), 0));
+    details->setOpacity(0.5);
+    group->addLayer(std::move(details));
+
+    auto objects = std::make_unique<ObjectGroup>(QStringLiteral("objects"), 0, 0);
+    objects->addObject(std::make_unique<MapObject>(QStringLiteral("object"), QStringLiteral("spawn"),
+                                                   QPointF(32, 48), QSizeF(16, 16)));
+
+    map->addLayer(std::move(ground));
+    map->addLayer(std::make_unique<TileLayer>(QStringLiteral("empty"), 0, 0, 150, 100));
+    map->addLayer(std::move(group));
+    map->addLayer(std::move(objects));
+
+    return map;
+}
+
+/**
+ * Compares the cells of two tile layers of different maps, by comparing the
+ * tilesets by name.
+ */
+static void compareCells(const TileLayer &expected, const TileLayer &actual,
+                         const QRect &area)
+{
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            const Cell &expectedCell = expected.cellAt(x, y);
+            const Cell &actualCell = actual.cellAt(x, y);
+
+            QCOMPARE(actualCell.isEmpty(), expectedCell.isEmpty());
+            if (expectedCell.isEmpty())
+                continue;
+
+            QCOMPARE(actualCell.tileset()->name(), expectedCell.tileset()->name());
+            QCOMPARE(actualCell.tileId(), expectedCell.tileId());
+            QCOMPARE(actualCell.flags(), expectedCell.flags());
+        }
+    }
+}
+
+void test_BinaryMapFormat::roundTrip_data()
+{
+    QTest::addColumn<bool>("infinite");
+    QTest::addColumn<Map::LayerDataFormat>("format");
+
+    QTest::newRow("fixed") << false << Map::Base64;
+    QTest::newRow("fixed-zlib") << false << Map::Base64Zlib;
+    QTest::newRow("infinite") << true << Map::CSV;
+    QTest::newRow("infinite-gzip") << true << Map::Base64Gzip;
+    if (compressionSupported(Zstandard))
+        QTest::newRow("infinite-zstd") << true << Map::Base64Zstandard;
+}
+
+void test_BinaryMapFormat::roundTrip()
+{
+    QFETCH(bool, infinite);
+    QFETCH(Map::LayerDataFormat, format);
+
+    const auto map = createMap(infinite, format);
+    const QString fileName = filePath(QStringLiteral("roundtrip.tmb"));
+
+    BinaryMapFormat binaryFormat;
+    QVERIFY2(binaryFormat.write(map.get(), fileName, FileFormat::Options()),
+             qPrintable(binaryFormat.errorString()));
+    QVERIFY(binaryFormat.supportsFile(fileName));
+
+    const auto readMap = binaryFormat.read(fileName);
+    QVERIFY2(readMap, qPrintable(binaryFormat.errorString()));
+
+    QCOMPARE(readMap->infinite(), infinite);
+    QCOMPARE(readMap->size(), map->size());
+    QCOMPARE(readMap->layerDataFormat(), format);
+    QCOMPARE(readMap->compressionLevel(), 3);
+    QCOMPARE(readMap->property(QStringLiteral("name")).toString(), QStringLiteral("binary"));
+    QCOMPARE(readMap->tilesetCount(), map->tilesetCount());
+    QCOMPARE(readMap->layerCount(), map->layerCount());
+
+    LayerIterator expectedIterator(map.get());
+    LayerIterator actualIterator(readMap.get());
+
+    while (Layer *expected = expectedIterator.next()) {
+        Layer *actual = actualIterator.next();
+        QVERIFY(actual);
+        QCOMPARE(actual->layerType(), expected->layerType());
+        QCOMPARE(actual->name(), expected->name());
+        QCOMPARE(actual->opacity(), expected->opacity());
+
+        if (auto expectedTileLayer = expected->asTileLayer()) {
+            auto actualTileLayer = actual->asTileLayer();
+            QCOMPARE(actualTileLayer->region(), expectedTileLayer->region());
+
+            const QRect bounds = expectedTileLayer->bounds();
+            compareCells(*expectedTileLayer, *actualTileLayer, bounds);
+            if (QTest::currentTestFailed())
+                return;
+        }
+    }
+    QVERIFY(!actualIterator.next());
+
+    auto objects = static_cast<ObjectGroup*>(readMap->layerAt(3));
+    QCOMPARE(objects->objectCount(), 1);
+    QCOMPARE(objects->objectAt(0)->className(), QStringLiteral("spawn"));
+    QCOMPARE(objects->objectAt(0)->position(), QPointF(32, 48));
+}
+
+/**
+ * Only the blocks overlapping the region are decoded.
+ */
+void test_BinaryMapFormat::readRegion()
+{
+    const auto map = createMap(true, Map::Base64Zlib);
+    const QString fileName = filePath(QStringLiteral("region.tmb"));
+
+    BinaryMapFormat binaryFormat;
+    QVERIFY(binaryFormat.write(map.get(), fileName, FileFormat::Options()));
+
+    const QRect region(10, 70, 20, 10);
+    const auto readMap = binaryFormat.readRegion(fileName, region);
+    QVERIFY2(readMap, qPrintable(binaryFormat.errorString()));
+
+    const auto expected = map->layerAt(0)->asTileLayer();
+    const auto actual = readMap->layerAt(0)->asTileLayer();
+
+    // The region lies within the block at (0, 64), which is read entirely
+    compareCells(*expected, *actual, QRect(0, 64, 64, 64));
+    if (QTest::currentTestFailed())
+        return;
+
+    QVERIFY(actual->region().boundingRect().contains(region));
+    QVERIFY(actual->cellAt(-1, 70).isEmpty());
+    QVERIFY(actual->cellAt(64, 70).isEmpty());
+    QVERIFY(actual->cellAt(10, 63).isEmpty());
+}
+
+void test_BinaryMapFormat::corruptFile_data()
+{
+    QTest::addColumn<int>("truncateTo");
+    QTest::addColumn<QByteArray>("replaceHeader");
+
+    QTest::newRow("empty") << 0 << QByteArray();
+    QTest::newRow("header-only") << 16 << QByteArray();
+    QTest::newRow("truncated") << -100 << QByteArray();
+    QTest::newRow("magic") << -1 << QByteArray("TMX");
+    QTest::newRow("version") << -1 << QByteArray("TMB\0\x02", 5);
+}
+
+/**
+ * Broken files are reported as errors rather than read partially.
+ */
+void test_BinaryMapFormat::corruptFile()
+{
+    QFETCH(int, truncateTo);
+    QFETCH(QByteArray, replaceHeader);
+
+    const auto map = createMap(false, Map::Base64);
+    const QString fileName = filePath(QStringLiteral("corrupt.tmb"));
+
+    BinaryMapFormat binaryFormat;
+    QVERIFY(binaryFormat.write(map.get(), fileName, FileFormat::Options()));
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QByteArray contents = file.readAll();
+
+    if (truncateTo < 0 && truncateTo != -1)
+        contents.chop(-truncateTo);
+    else if (truncateTo >= 0)
+        contents.truncate(truncateTo);
+    contents.replace(0, replaceHeader.size(), replaceHeader);
+
+    file.resize(0);
+    file.seek(0);
+    file.write(contents);
+    file.close();
+
+    QVERIFY(!binaryFormat.read(fileName));
+    QVERIFY(!binaryFormat.errorString().isEmpty());
+}
+
+QTEST_MAIN(test_BinaryMapFormat)
+#include "test_binarymapformat.moc"
@@ -0,0 +1,219 @@
+#include "compression.h"
+#include "gidmapper.h"
+#include "map.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+#include <QtEndian>
+
+using namespace Tiled;
+
+class test_GidMapper : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void decodeLayerData_data();
+    void decodeLayerData();
+
+    void decodeChunks_data();
+    void decodeChunks();
+
+    void decodeWhitespace();
+    void decodeCorruptData();
+
+private:
+    void fillLayer(TileLayer &layer, quint32 seed) const;
+    void compareLayers(const TileLayer &actual, const TileLayer &expected) const;
+
+    QVector<SharedTileset> mTilesets;
+};
+
+void test_GidMapper::initTestCase()
+{
+    for (int i = 0; i < 3; ++i) {
+        SharedTileset tileset = Tileset::create(QStringLiteral("tileset%1").arg(i), 16, 16);
+        tileset->setNextTileId(100 * (i + 1));
+        mTilesets.append(tileset);
+    }
+}
+
+/**
+ * Fills the layer with a deterministic mix of empty cells and cells from all
+ * tilesets, including flipped and rotated ones.
+ */
+void test_GidMapper::fillLayer(TileLayer &layer, quint32 seed) const
+{
+    QRandomGenerator random(seed);
+
+    for (int y = 0; y < layer.height(); ++y) {
+        for (int x = 0; x < layer.width(); ++x) {
+            if (random.bounded(4) == 0)
+                continue;
+
+            const SharedTileset &tileset = mTilesets.at(random.bounded(int(mTilesets.size())));
+            Cell cell(tileset.data(), random.bounded(tileset->nextTileId()));
+            cell.setFlags(random.bounded(Cell::VisualFlags + 1));
+            layer.setCell(x, y, cell);
+        }
+    }
+}
+
+void test_GidMapper::compareLayers(const TileLayer &actual, const TileLayer &expected) const
+{
+    QCOMPARE(actual.size(), expected.size());
+
+    for (int y = 0; y < expected.height(); ++y)
+        for (int x = 0; x < expected.width(); ++x)
+            if (actual.cellAt(x, y) != expected.cellAt(x, y))
+                QFAIL(qPrintable(QStringLiteral("Cell mismatch at %1,%2").arg(x).arg(y)));
+}
+
+void test_GidMapper::decodeLayerData_data()
+{
+    QTest::addColumn<int>("format");
+
+    QTest::newRow("base64") << int(Map::Base64);
+    QTest::newRow("base64-gzip") << int(Map::Base64Gzip);
+    QTest::newRow("base64-zlib") << int(Map::Base64Zlib);
+}
+
+/**
+ * Checks the decoded layer against both the original layer and a plain serial
+ * decode using QByteArray::fromBase64 and GidMapper::gidToCell.
+ */
+void test_GidMapper::decodeLayerData()
+{
+    QFETCH(int, format);
+    const auto dataFormat = static_cast<Map::LayerDataFormat>(format);
+
+    // Deliberately not a multiple of the chunk size
+    TileLayer layer(QString(), 0, 0, 70, 45);
+    fillLayer(layer, 1);
+
+    const GidMapper gidMapper(mTilesets);
+    const QByteArray encoded = gidMapper.encodeLayerData(layer, dataFormat);
+
+    TileLayer decoded(QString(), 0, 0, layer.width(), layer.height());
+    QCOMPARE(gidMapper.decodeLayerData(decoded, encoded, dataFormat, decoded.rect()),
+             GidMapper::NoError);
+    compareLayers(decoded, layer);
+
+    QByteArray data = QByteArray::fromBase64(encoded);
+    const int size = layer.width() * layer.height() * 4;
+    if (dataFormat == Map::Base64Gzip)
+        data = decompress(data, size, Gzip);
+    else if (dataFormat == Map::Base64Zlib)
+        data = decompress(data, size, Zlib);
+    QCOMPARE(data.size(), size);
+
+    for (int y = 0; y < layer.height(); ++y) {
+        for (int x = 0; x < layer.width(); ++x) {
+            const int index = (x + y * layer.width()) * 4;
+            const unsigned gid = qFromLittleEndian<quint32>(data.constData() + index);
+
+            bool ok;
+            const Cell cell = gidMapper.gidToCell(gid, ok);
+            QVERIFY(ok);
+            QCOMPARE(decoded.cellAt(x, y), cell);
+        }
+    }
+}
+
+void test_GidMapper::decodeChunks_data()
+{
+    decodeLayerData_data();
+}
+
+/**
+ * Decodes the chunks of an infinite layer in parallel and compares the result
+ * to decoding each chunk by itself.
+ */
+void test_GidMapper::decodeChunks()
+{
+    QFETCH(int, format);
+    const auto dataFormat = static_cast<Map::LayerDataFormat>(format);
+
+    TileLayer layer(QString(), 0, 0, 100, 60);
+    fillLayer(layer, 2);
+
+    QVector<QRect> chunks;
+    for (int y = -CHUNK_SIZE; y < layer.height(); y += CHUNK_SIZE)
+        for (int x = -CHUNK_SIZE; x < layer.width(); x += CHUNK_SIZE)
+            chunks.append(QRect(x, y, CHUNK_SIZE, CHUNK_SIZE));
+
+    const GidMapper gidMapper(mTilesets);
+    const QVector<QByteArray> encodedChunks = gidMapper.encodeLayerData(layer, dataFormat, chunks);
+    QCOMPARE(encodedChunks.size(), chunks.size());
+
+    QVector<GidMapper::EncodedLayerData> layerData;
+    TileLayer serial;
+
+    for (int i = 0; i < chunks.size(); ++i) {
+        QCOMPARE(encodedChunks.at(i), gidMapper.encodeLayerData(layer, dataFormat, chunks.at(i)));
+        QCOMPARE(gidMapper.decodeLayerData(serial, encodedChunks.at(i), dataFormat, chunks.at(i)),
+                 GidMapper::NoError);
+
+        layerData.append({ chunks.at(i), encodedChunks.at(i) });
+    }
+
+    TileLayer parallel;
+    QCOMPARE(gidMapper.decodeLayerData(parallel, layerData, dataFormat), GidMapper::NoError);
+
+    QCOMPARE(parallel.region(), serial.region());
+
+    for (const QRect &chunk : std::as_const(chunks))
+        for (int y = chunk.top(); y <= chunk.bottom(); ++y)
+            for (int x = chunk.left(); x <= chunk.right(); ++x)
+                QCOMPARE(parallel.cellAt(x, y), serial.cellAt(x, y));
+
+    for (int y = 0; y < layer.height(); ++y)
+        for (int x = 0; x < layer.width(); ++x)
+            QCOMPARE(parallel.cellAt(x, y), layer.cellAt(x, y));
+}
+
+/**
+ * Like QByteArray::fromBase64, the decoder skips whitespace anywhere in the
+ * data, such as the line breaks and indentation in TMX files.
+ */
+void test_GidMapper::decodeWhitespace()
+{
+    TileLayer layer(QString(), 0, 0, 20, 20);
+    fillLayer(layer, 3);
+
+    const GidMapper gidMapper(mTilesets);
+    const QByteArray encoded = gidMapper.encodeLayerData(layer, Map::Base64);
+
+    QByteArray formatted = "\n   ";
+    for (int i = 0; i < encoded.size(); i += 7)
+        formatted += encoded.mid(i, 7) + "\n   ";
+
+    TileLayer decoded(QString(), 0, 0, layer.width(), layer.height());
+    QCOMPARE(gidMapper.decodeLayerData(decoded, formatted, Map::Base64, decoded.rect()),
+             GidMapper::NoError);
+    compareLayers(decoded, layer);
+}
+
+void test_GidMapper::decodeCorruptData()
+{
+    TileLayer layer(QString(), 0, 0, 20, 20);
+    fillLayer(layer, 4);
+
+    const GidMapper gidMapper(mTilesets);
+    const QByteArray encoded = gidMapper.encodeLayerData(layer, Map::Base64);
+
+    TileLayer decoded(QString(), 0, 0, layer.width(), layer.height());
+    QCOMPARE(gidMapper.decodeLayerData(decoded, encoded.left(encoded.size() / 2),
+                                       Map::Base64, decoded.rect()),
+             GidMapper::CorruptLayerData);
+    QCOMPARE(gidMapper.decodeLayerData(decoded, "not zlib data",
+                                       Map::Base64Zlib, decoded.rect()),
+             GidMapper::CorruptLayerData);
+}
+
+QTEST_MAIN(test_GidMapper)
+#include "test_gidmapper.moc"
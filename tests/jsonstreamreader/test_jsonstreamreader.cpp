@@ -0,0 +1,277 @@
+#include "jsonstreamreader.h"
+
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+
+using namespace Json;
+
+class test_JsonStreamReader : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readValues_data();
+    void readValues();
+    void readLargeMap();
+    void errors_data();
+    void errors();
+    void truncated();
+};
+
+/**
+ * Converts the special tile data values produced by the JsonStreamReader
+ * to what QJsonDocument::toVariant() would have produced.
+ */
+static QVariant normalized(const QVariant &value)
+{
+    switch (value.userType()) {
+    case QMetaType::QVariantMap: {
+        QVariantMap map = value.toMap();
+        for (auto it = map.begin(); it != map.end(); ++it)
+            it.value() = normalized(it.value());
+        return map;
+    }
+    case QMetaType::QVariantList: {
+        QVariantList list = value.toList();
+        for (QVariant &element : list)
+            element = normalized(element);
+        return list;
+    }
+    case QMetaType::QByteArray:
+        return QString::fromUtf8(value.toByteArray());
+    default:
+        break;
+    }
+
+    if (value.userType() == qMetaTypeId<QVector<unsigned>>()) {
+        QVariantList list;
+        for (const unsigned gid : value.value<QVector<unsigned>>())
+            list.append(qlonglong(gid));
+        return list;
+    }
+
+    return value;
+}
+
+static QVariant streamRead(const QByteArray &json, QString *errorString = nullptr,
+                           qint64 *errorOffset = nullptr)
+{
+    QBuffer buffer;
+    buffer.setData(json);
+    buffer.open(QIODevice::ReadOnly);
+
+    JsonStreamReader reader(&buffer);
+    const QVariant result = reader.read();
+
+    if (errorString)
+        *errorString = reader.hasError() ? reader.errorString() : QString();
+    if (errorOffset)
+        *errorOffset = reader.hasError() ? reader.errorOffset() : -1;
+
+    return result;
+}
+
+/**
+ * Generates a map with tile layer data in the various forms the reader
+ * handles specially, large enough to be read in several buffers.
+ */
+static QByteArray largeMap(QJsonDocument::JsonFormat format)
+{
+    QRandomGenerator random(18);
+
+    QVariantList data;
+    for (int i = 0; i < 300 * 300; ++i)
+        data.append(qlonglong(random.bounded(1u << 31) * 2u + random.bounded(2u)));
+
+    QVariantList chunkData;
+    for (int i = 0; i < 16 * 16; ++i)
+        chunkData.append(qlonglong(random.bounded(100)));
+
+    const QVariantMap chunk {
+        { QStringLiteral("x"), -16 },
+        { QStringLiteral("y"), 32 },
+        { QStringLiteral("width"), 16 },
+        { QStringLiteral("height"), 16 },
+        { QStringLiteral("data"), chunkData },
+    };
+
+    const QVariantList layers {
+        QVariantMap {
+            { QStringLiteral("type"), QStringLiteral("tilelayer") },
+            { QStringLiteral("name"), QStringLiteral("csv \"quoted\" é中") },
+            { QStringLiteral("data"), data },
+        },
+        QVariantMap {
+            { QStringLiteral("type"), QStringLiteral("tilelayer") },
+            { QStringLiteral("encoding"), QStringLiteral("base64") },
+            { QStringLiteral("data"), QStringLiteral("AQAAAAIAAAADAAAA") },
+        },
+        QVariantMap {
+            { QStringLiteral("type"), QStringLiteral("group") },
+            { QStringLiteral("layers"), QVariantList {
+                QVariantMap {
+                    { QStringLiteral("type"), QStringLiteral("tilelayer") },
+                    { QStringLiteral("chunks"), QVariantList { chunk, chunk } },
+                },
+                QVariantMap {
+                    { QStringLiteral("type"), QStringLiteral("tilelayer") },
+                    { QStringLiteral("data"), QVariantList { 1, 2, -1, 1.5, QStringLiteral("x") } },
+                },
+                QVariantMap {
+                    { QStringLiteral("type"), QStringLiteral("tilelayer") },
+                    { QStringLiteral("data"), QVariantList() },
+                },
+            }},
+        },
+    };
+
+    const QVariantMap map {
+        { QStringLiteral("version"), QStringLiteral("1.10") },
+        { QStringLiteral("infinite"), false },
+        { QStringLiteral("parallaxoriginx"), 0.25 },
+        { QStringLiteral("backgroundcolor"), QVariant::fromValue(nullptr) },
+        { QStringLiteral("layers"), layers },
+        { QStringLiteral("properties"), QVariantList {
+            QVariantMap {
+                { QStringLiteral("name"), QStringLiteral("data") },
+                { QStringLiteral("value"), QVariantList { 4, 5, 6 } },
+            },
+        }},
+    };
+
+    return QJsonDocument::fromVariant(map).toJson(format);
+}
+
+void test_JsonStreamReader::readValues_data()
+{
+    QTest::addColumn<QByteArray>("json");
+
+    QTest::newRow("empty-object") << QByteArray("{}");
+    QTest::newRow("empty-array") << QByteArray("[ ]");
+    QTest::newRow("literals") << QByteArray("[true, false, null]");
+    QTest::newRow("numbers") << QByteArray("[0, -1, 42, 1.5, -2.25e3, 1E-2, 9007199254740993]");
+    QTest::newRow("large-integer") << QByteArray("[123456789012345678901234567890]");
+    QTest::newRow("escapes") << QByteArray(R"(["a\"b\\c\/d\b\f\n\r\t", "é中", "😀"])");
+    QTest::newRow("utf8") << QByteArray("{\"\xc3\xa9\": \"\xe4\xb8\xad\xf0\x9f\x98\x80\"}");
+    QTest::newRow("nested") << QByteArray(R"({"a": {"b": [1, [2, {"c": []}]]}, "d": {}})");
+    QTest::newRow("duplicate-keys") << QByteArray(R"({"a": 1, "a": 2})");
+    QTest::newRow("whitespace") << QByteArray(" \r\n\t{ \"a\" :\n[ 1 ,\t2 ] } \n");
+    QTest::newRow("tile-data") << QByteArray(R"({"layers": [{"data": [1, 2, 3]}, {"data": "AQAAAA=="}]})");
+    QTest::newRow("tile-data-mixed") << QByteArray(R"({"layers": [{"data": [1, 2, -3, 4]}, {"data": [1, true]}]})");
+    QTest::newRow("tile-data-too-large") << QByteArray(R"({"layers": [{"data": [4294967295, 4294967296]}]})");
+    QTest::newRow("data-outside-layer") << QByteArray(R"({"data": [1, 2], "properties": [{"data": [3]}]})");
+    QTest::newRow("indented-map") << largeMap(QJsonDocument::Indented);
+}
+
+/**
+ * The reader produces the same values as QJsonDocument.
+ */
+void test_JsonStreamReader::readValues()
+{
+    QFETCH(QByteArray, json);
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    QString errorString;
+    const QVariant result = streamRead(json, &errorString);
+    QVERIFY2(errorString.isEmpty(), qPrintable(errorString));
+
+    QCOMPARE(normalized(result), document.toVariant());
+}
+
+/**
+ * Numeric tile layer data is read as a vector of GIDs, including the data
+ * of chunks and of layers in groups.
+ */
+void test_JsonStreamReader::readLargeMap()
+{
+    const QByteArray json = largeMap(QJsonDocument::Compact);
+    const QVariantMap map = streamRead(json).toMap();
+    const QVariantList layers = map.value(QStringLiteral("layers")).toList();
+    QCOMPARE(layers.size(), qsizetype(3));
+
+    const QVariant data = layers.at(0).toMap().value(QStringLiteral("data"));
+    QCOMPARE(data.userType(), qMetaTypeId<QVector<unsigned>>());
+    QCOMPARE(data.value<QVector<unsigned>>().size(), qsizetype(300 * 300));
+
+    const QVariant base64 = layers.at(1).toMap().value(QStringLiteral("data"));
+    QCOMPARE(base64.userType(), int(QMetaType::QByteArray));
+    QCOMPARE(base64.toByteArray(), QByteArray("AQAAAAIAAAADAAAA"));
+
+    const QVariantList groupLayers = layers.at(2).toMap().value(QStringLiteral("layers")).toList();
+    const QVariantList chunks = groupLayers.at(0).toMap().value(QStringLiteral("chunks")).toList();
+    QCOMPARE(chunks.size(), qsizetype(2));
+    QCOMPARE(chunks.at(1).toMap().value(QStringLiteral("data")).userType(), qMetaTypeId<QVector<unsigned>>());
+
+    // Data that isn't all GIDs falls back to a regular list
+    QCOMPARE(groupLayers.at(1).toMap().value(QStringLiteral("data")).userType(), int(QMetaType::QVariantList));
+
+    // Only the data of layers is read as GIDs
+    const QVariantList properties = map.value(QStringLiteral("properties")).toList();
+    QCOMPARE(properties.at(0).toMap().value(QStringLiteral("value")).userType(), int(QMetaType::QVariantList));
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(json, &error);
+    QCOMPARE(error.error, QJsonParseError::NoError);
+    QCOMPARE(normalized(map), document.toVariant());
+}
+
+void test_JsonStreamReader::errors_data()
+{
+    QTest::addColumn<QByteArray>("json");
+
+    QTest::newRow("garbage") << QByteArray("{\"a\": 1} x");
+    QTest::newRow("unterminated-array") << QByteArray("[1, 2");
+    QTest::newRow("missing-value-separator") << QByteArray("[1 2]");
+    QTest::newRow("unterminated-object") << QByteArray("{\"a\": 1");
+    QTest::newRow("unterminated-string") << QByteArray("{\"a\": \"abc");
+    QTest::newRow("missing-name-separator") << QByteArray("{\"a\" 1}");
+    QTest::newRow("unterminated-tile-data") << QByteArray("{\"layers\": [{\"data\": [1, 2");
+    QTest::newRow("tile-data-separator") << QByteArray("{\"layers\": [{\"data\": [1 2]}]}");
+
+    // Errors after the first buffer has been read
+    QTest::newRow("large-garbage") << largeMap(QJsonDocument::Indented) + "  }";
+    QTest::newRow("large-unterminated") << largeMap(QJsonDocument::Compact).chopped(1);
+}
+
+/**
+ * Invalid documents are reported at the same offset as by QJsonDocument.
+ */
+void test_JsonStreamReader::errors()
+{
+    QFETCH(QByteArray, json);
+
+    QJsonParseError error;
+    QJsonDocument::fromJson(json, &error);
+    QVERIFY(error.error != QJsonParseError::NoError);
+
+    QString errorString;
+    qint64 errorOffset;
+    const QVariant result = streamRead(json, &errorString, &errorOffset);
+
+    QVERIFY(!result.isValid());
+    QVERIFY(!errorString.isEmpty());
+    QCOMPARE(errorOffset, qint64(error.offset));
+}
+
+/**
+ * Any truncated document results in an error, rather than a partial value.
+ */
+void test_JsonStreamReader::truncated()
+{
+    const QByteArray json = R"({"a": [1, 2.5, true, null, "b\n"], "layers": [{"data": [1, 2]}]})";
+
+    for (int length = 0; length < json.size(); ++length) {
+        qint64 errorOffset;
+        const QVariant result = streamRead(json.left(length), nullptr, &errorOffset);
+        QVERIFY2(!result.isValid(), json.left(length).constData());
+        QVERIFY(errorOffset <= length);
+    }
+}
+
+QTEST_MAIN(test_JsonStreamReader)
+#include "test_jsonstreamreader.moc"
@@ -0,0 +1,166 @@
+#include "grouplayer.h"
+#include "map.h"
+#include "mapobject.h"
+#include "objectgroup.h"
+
+#include <QtTest/QtTest>
+
+#include <memory>
+
+using namespace Tiled;
+
+class test_Map : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void findObjectById();
+    void findObjectByIdChangedId();
+    void findObjectByIdLayers();
+    void findObjectByIdDuplicates();
+};
+
+static MapObject *createObject(int id)
+{
+    auto object = new MapObject;
+    object->setId(id);
+    return object;
+}
+
+void test_Map::findObjectById()
+{
+    Map map;
+    auto objectGroup = new ObjectGroup;
+    map.addLayer(objectGroup);
+
+    MapObject *a = createObject(1);
+    MapObject *b = createObject(2);
+    objectGroup->addObject(a);
+    objectGroup->insertObject(0, b);
+
+    QCOMPARE(map.findObjectById(1), a);
+    QCOMPARE(map.findObjectById(2), b);
+    QCOMPARE(map.findObjectById(3), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(0), static_cast<MapObject*>(nullptr));
+
+    QCOMPARE(objectGroup->removeObject(a), 1);
+    QCOMPARE(map.findObjectById(1), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(2), b);
+    delete a;
+
+    objectGroup->removeObjectAt(0);
+    QCOMPARE(map.findObjectById(2), static_cast<MapObject*>(nullptr));
+    delete b;
+}
+
+void test_Map::findObjectByIdChangedId()
+{
+    Map map;
+    auto objectGroup = new ObjectGroup;
+    map.addLayer(objectGroup);
+
+    MapObject *object = createObject(5);
+    objectGroup->addObject(object);
+
+    object->setId(7);
+    QCOMPARE(map.findObjectById(5), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(7), object);
+
+    // Objects without an id are not found
+    object->setId(0);
+    QCOMPARE(map.findObjectById(7), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(0), static_cast<MapObject*>(nullptr));
+
+    object->setId(9);
+    QCOMPARE(map.findObjectById(9), object);
+
+    // Changing the id of an object outside of the map doesn't affect it
+    objectGroup->removeObject(object);
+    object->setId(10);
+    QCOMPARE(map.findObjectById(9), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(10), static_cast<MapObject*>(nullptr));
+    delete object;
+}
+
+/**
+ * Objects are found when their layer is added to the map, also when it is
+ * part of a group layer, and are no longer found when it is removed.
+ */
+void test_Map::findObjectByIdLayers()
+{
+    Map map;
+
+    auto objectGroup = new ObjectGroup;
+    MapObject *a = createObject(3);
+    objectGroup->addObject(a);
+
+    auto groupLayer = new GroupLayer(QString(), 0, 0);
+    groupLayer->addLayer(std::unique_ptr<Layer>(objectGroup));
+    QCOMPARE(map.findObjectById(3), static_cast<MapObject*>(nullptr));
+
+    map.addLayer(groupLayer);
+    QCOMPARE(map.findObjectById(3), a);
+
+    // Objects added to a nested layer already part of the map are found
+    MapObject *b = createObject(4);
+    objectGroup->addObject(b);
+    QCOMPARE(map.findObjectById(4), b);
+
+    std::unique_ptr<Layer> taken(groupLayer->takeLayerAt(0));
+    QCOMPARE(map.findObjectById(3), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(4), static_cast<MapObject*>(nullptr));
+
+    groupLayer->insertLayer(0, taken.release());
+    QCOMPARE(map.findObjectById(3), a);
+
+    std::unique_ptr<Layer> takenGroup(map.takeLayerAt(0));
+    QCOMPARE(map.findObjectById(3), static_cast<MapObject*>(nullptr));
+    QCOMPARE(map.findObjectById(4), static_cast<MapObject*>(nullptr));
+}
+
+/**
+ * When several objects share an id, the first one in layer and object order
+ * is returned, like the linear search did before the objects were indexed.
+ */
+void test_Map::findObjectByIdDuplicates()
+{
+    Map map;
+    auto first = new ObjectGroup;
+    auto second = new ObjectGroup;
+    map.addLayer(first);
+    map.addLayer(second);
+
+    MapObject *a = createObject(6);
+    MapObject *b = createObject(6);
+    MapObject *c = createObject(6);
+
+    // Added in a different order than they appear in the map
+    second->addObject(c);
+    first->addObject(b);
+    first->insertObject(0, a);
+
+    QCOMPARE(map.findObjectById(6), a);
+
+    first->removeObject(a);
+    QCOMPARE(map.findObjectById(6), b);
+    delete a;
+
+    b->setId(8);
+    QCOMPARE(map.findObjectById(6), c);
+    QCOMPARE(map.findObjectById(8), b);
+
+    // The index stays consistent when a duplicate changes its id back
+    b->setId(6);
+    QCOMPARE(map.findObjectById(6), b);
+
+    first->removeObject(b);
+    QCOMPARE(map.findObjectById(6), c);
+    delete b;
+
+    second->removeObject(c);
+    QCOMPARE(map.findObjectById(6), static_cast<MapObject*>(nullptr));
+    delete c;
+}
+
+QTEST_MAIN(test_Map)
+#include "test_map.moc"
@@ -0,0 +1,282 @@
+#include "compression.h"
+#include "gidmapper.h"
+#include "map.h"
+#include "maptovariantconverter.h"
+#include "mapwriter.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+#include <QBuffer>
+#include <QRandomGenerator>
+#include <QXmlStreamReader>
+
+using namespace Tiled;
+
+/**
+ * Encodes the layer data one cell at a time, the way it was done before the
+ * data was encoded chunk by chunk and in parallel. The output is expected to
+ * stay byte-identical.
+ */
+static QByteArray referenceLayerData(const GidMapper &gidMapper,
+                                     const TileLayer &tileLayer,
+                                     Map::LayerDataFormat format,
+                                     QRect bounds)
+{
+    QByteArray tileData;
+    tileData.reserve(bounds.width() * bounds.height() * 4);
+
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        for (int x = bounds.left(); x <= bounds.right(); ++x) {
+            const unsigned gid = gidMapper.cellToGid(tileLayer.cellAt(x, y));
+            tileData.append(static_cast<char>(gid));
+            tileData.append(static_cast<char>(gid >> 8));
+            tileData.append(static_cast<char>(gid >> 16));
+            tileData.append(static_cast<char>(gid >> 24));
+        }
+    }
+
+    if (format == Map::Base64Gzip)
+        tileData = compress(tileData, Gzip);
+    else if (format == Map::Base64Zlib)
+        tileData = compress(tileData, Zlib);
+    else if (format == Map::Base64Zstandard)
+        tileData = compress(tileData, Zstandard);
+
+    return tileData.toBase64();
+}
+
+class test_MapWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void encodeLayerData_data();
+    void encodeLayerData();
+
+    void writeTmx_data();
+    void writeTmx();
+
+    void writeJson_data();
+    void writeJson();
+
+private:
+    std::unique_ptr<Map> createMap(bool infinite, Map::LayerDataFormat format) const;
+};
+
+static void addFormatRows(bool withInfinite)
+{
+    QTest::addColumn<int>("format");
+    QTest::addColumn<bool>("infinite");
+
+    const QList<QPair<const char*, Map::LayerDataFormat>> formats {
+        { "base64", Map::Base64 },
+        { "base64-gzip", Map::Base64Gzip },
+        { "base64-zlib", Map::Base64Zlib },
+    };
+
+    for (const auto &format : formats) {
+        QTest::newRow(format.first) << int(format.second) << false;
+        if (withInfinite) {
+            QTest::newRow(QByteArray(format.first).append("-infinite").constData())
+                    << int(format.second) << true;
+        }
+    }
+
+    if (compressionSupported(Zstandard)) {
+        QTest::newRow("base64-zstd") << int(Map::Base64Zstandard) << false;
+        if (withInfinite)
+            QTest::newRow("base64-zstd-infinite") << int(Map::Base64Zstandard) << true;
+    }
+}
+
+/**
+ * Creates a map using two tilesets, with a tile layer that has cells with
+ * all kinds of flags and some empty chunks. On infinite maps, the layer also
+ * has cells at negative coordinates.
+ */
+std::unique_ptr<Map> test_MapWriter::createMap(bool infinite,
+                                               Map::LayerDataFormat format) const
+{
+    Map::Parameters parameters;
+    parameters.width = 50;
+    parameters.height = 40;
+    parameters.tileWidth = 16;
+    parameters.tileHeight = 16;
+    parameters.infinite = infinite;
+
+    auto map = std::make_unique<Map>(parameters);
+    map->setLayerDataFormat(format);
+
+    for (int i = 0; i < 2; ++i) {
+        SharedTileset tileset = Tileset::create(QStringLiteral("tileset%1").arg(i), 16, 16);
+        tileset->setNextTileId(300);
+        map->addTileset(tileset);
+    }
+
+    auto tileLayer = new TileLayer(QStringLiteral("Tiles"), 0, 0, map->width(), map->height());
+    QRandomGenerator random(42);
+
+    const QRect area = infinite ? QRect(-37, -21, 120, 90) : tileLayer->rect();
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            // Leave a few chunks empty
+            if (((x >> 4) + (y >> 4)) % 5 == 0 || random.bounded(3) == 0)
+                continue;
+
+            Cell cell(map->tilesetAt(random.bounded(2)).data(), random.bounded(300));
+            cell.setFlags(random.bounded(Cell::VisualFlags + 1));
+            tileLayer->setCell(x, y, cell);
+        }
+    }
+
+    map->addLayer(tileLayer);
+    return map;
+}
+
+void test_MapWriter::encodeLayerData_data()
+{
+    addFormatRows(false);
+}
+
+void test_MapWriter::encodeLayerData()
+{
+    QFETCH(int, format);
+    const auto dataFormat = static_cast<Map::LayerDataFormat>(format);
+
+    const auto map = createMap(true, dataFormat);
+    const auto tileLayer = static_cast<const TileLayer*>(map->layerAt(0));
+    const GidMapper gidMapper(map->tilesets());
+
+    // Includes areas that are not aligned to chunks, and empty ones
+    const QVector<QRect> areas {
+        QRect(0, 0, 16, 16),
+        QRect(-37, -21, 120, 90),
+        QRect(5, 3, 17, 29),
+        QRect(-200, -200, 16, 16),
+    };
+
+    for (const QRect &area : areas) {
+        QCOMPARE(gidMapper.encodeLayerData(*tileLayer, dataFormat, area),
+                 referenceLayerData(gidMapper, *tileLayer, dataFormat, area));
+    }
+
+    const QVector<QByteArray> encoded = gidMapper.encodeLayerData(*tileLayer, dataFormat, areas);
+    QCOMPARE(encoded.size(), areas.size());
+
+    for (int i = 0; i < areas.size(); ++i)
+        QCOMPARE(encoded.at(i), referenceLayerData(gidMapper, *tileLayer, dataFormat, areas.at(i)));
+}
+
+void test_MapWriter::writeTmx_data()
+{
+    addFormatRows(true);
+}
+
+/**
+ * Checks the layer data written to a TMX file, for each chunk in case of an
+ * infinite map.
+ */
+void test_MapWriter::writeTmx()
+{
+    QFETCH(int, format);
+    QFETCH(bool, infinite);
+    const auto dataFormat = static_cast<Map::LayerDataFormat>(format);
+
+    const auto map = createMap(infinite, dataFormat);
+    const auto tileLayer = static_cast<const TileLayer*>(map->layerAt(0));
+    const GidMapper gidMapper(map->tilesets());
+
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    MapWriter().writeMap(map.get(), &buffer);
+    buffer.close();
+
+    QXmlStreamReader xml(buffer.data());
+    int dataCount = 0;
+
+    while (xml.readNextStartElement()) {
+        if (xml.name() == QLatin1String("map") ||
+                xml.name() == QLatin1String("layer") ||
+                (infinite && xml.name() == QLatin1String("data"))) {
+            continue;   // descend
+        }
+
+        const bool isChunk = xml.name() == QLatin1String("chunk");
+        if (!isChunk && xml.name() != QLatin1String("data")) {
+            xml.skipCurrentElement();
+            continue;
+        }
+
+        QRect bounds = tileLayer->rect();
+        if (isChunk) {
+            const QXmlStreamAttributes atts = xml.attributes();
+            bounds = QRect(atts.value(QLatin1String("x")).toInt(),
+                           atts.value(QLatin1String("y")).toInt(),
+                           atts.value(QLatin1String("width")).toInt(),
+                           atts.value(QLatin1String("height")).toInt());
+        }
+
+        const QByteArray data = xml.readElementText().trimmed().toLatin1();
+        QCOMPARE(data, referenceLayerData(gidMapper, *tileLayer, dataFormat, bounds));
+        ++dataCount;
+    }
+
+    QVERIFY(!xml.hasError());
+
+    if (infinite)
+        QCOMPARE(dataCount, int(tileLayer->sortedChunksToWrite(map->chunkSize()).size()));
+    else
+        QCOMPARE(dataCount, 1);
+}
+
+void test_MapWriter::writeJson_data()
+{
+    addFormatRows(true);
+}
+
+/**
+ * Checks the layer data as converted for writing JSON (and Lua) files.
+ */
+void test_MapWriter::writeJson()
+{
+    QFETCH(int, format);
+    QFETCH(bool, infinite);
+    const auto dataFormat = static_cast<Map::LayerDataFormat>(format);
+
+    const auto map = createMap(infinite, dataFormat);
+    const auto tileLayer = static_cast<const TileLayer*>(map->layerAt(0));
+    const GidMapper gidMapper(map->tilesets());
+
+    MapToVariantConverter converter;
+    const QVariantMap mapVariant = converter.toVariant(*map, QDir()).toMap();
+    const QVariantList layers = mapVariant.value(QStringLiteral("layers")).toList();
+    QCOMPARE(layers.size(), qsizetype(1));
+
+    const QVariantMap layerVariant = layers.first().toMap();
+
+    if (!infinite) {
+        QCOMPARE(layerVariant.value(QStringLiteral("data")).toByteArray(),
+                 referenceLayerData(gidMapper, *tileLayer, dataFormat, tileLayer->rect()));
+        return;
+    }
+
+    const QVector<QRect> chunks = tileLayer->sortedChunksToWrite(map->chunkSize());
+    const QVariantList chunkVariants = layerVariant.value(QStringLiteral("chunks")).toList();
+    QCOMPARE(chunkVariants.size(), chunks.size());
+
+    for (int i = 0; i < chunks.size(); ++i) {
+        const QVariantMap chunkVariant = chunkVariants.at(i).toMap();
+        const QRect bounds(chunkVariant.value(QStringLiteral("x")).toInt(),
+                           chunkVariant.value(QStringLiteral("y")).toInt(),
+                           chunkVariant.value(QStringLiteral("width")).toInt(),
+                           chunkVariant.value(QStringLiteral("height")).toInt());
+
+        QCOMPARE(bounds, chunks.at(i));
+        QCOMPARE(chunkVariant.value(QStringLiteral("data")).toByteArray(),
+                 referenceLayerData(gidMapper, *tileLayer, dataFormat, bounds));
+    }
+}
+
+QTEST_MAIN(test_MapWriter)
+#include "test_mapwriter.moc"
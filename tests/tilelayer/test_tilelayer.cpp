@@ -0,0 +1,504 @@
+#include "map.h"
+#include "tilelayer.h"
+#include "tileset.h"
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+
+#include <limits>
+#include <memory>
+
+using namespace Tiled;
+
+class test_TileLayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void chunkRoundTrip();
+    void chunkLargeTileId();
+    void chunkInvalidCell();
+    void chunkManyTilesets();
+    void chunkReplaceAndRemoveTileset_data();
+    void chunkReplaceAndRemoveTileset();
+    void chunkIsEmpty();
+
+    void layerLargeTileIds();
+
+    void directoryDenseAndSparse();
+    void directoryGrowDenseArea();
+    void directoryRandom();
+    void directoryCopyAndMove();
+    void layerChunksOutsideBounds();
+
+private:
+    Cell randomCell(QRandomGenerator &random) const;
+    Cell markerCell(QPoint chunkCoordinates) const;
+    void verifyDirectory(const ChunkDirectory &directory,
+                         const QVector<QPoint> &positions) const;
+
+    QVector<SharedTileset> mTilesets;
+};
+
+void test_TileLayer::initTestCase()
+{
+    for (int i = 0; i < 4; ++i)
+        mTilesets.append(Tileset::create(QStringLiteral("tileset%1").arg(i), 16, 16));
+}
+
+Cell test_TileLayer::randomCell(QRandomGenerator &random) const
+{
+    if (random.bounded(4) == 0)
+        return Cell();
+
+    Cell cell(mTilesets.at(random.bounded(int(mTilesets.size()))).data(),
+              random.bounded(1 << 18));
+    cell.setFlags(random.bounded(Cell::VisualFlags + 1));
+    cell.setChecked(random.bounded(2));
+    return cell;
+}
+
+/**
+ * Cells within the limits of the compact form are stored and read back
+ * unchanged, including their flags.
+ */
+void test_TileLayer::chunkRoundTrip()
+{
+    QRandomGenerator random(1);
+    Chunk chunk;
+    Cell expected[CHUNK_SIZE][CHUNK_SIZE];
+
+    // Overwrite each cell a few times
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                expected[y][x] = randomCell(random);
+                chunk.setCell(x, y, expected[y][x]);
+            }
+        }
+    }
+
+    QVERIFY(chunk.isCompact());
+
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            const Cell cell = chunk.cellAt(x, y);
+            QCOMPARE(cell, expected[y][x]);
+            QCOMPARE(cell.tileId(), expected[y][x].tileId());
+            QCOMPARE(cell.checked(), expected[y][x].checked());
+        }
+    }
+}
+
+/**
+ * A tile ID that doesn't fit the compact form switches the chunk to storing
+ * full cells, keeping the cells set before.
+ */
+void test_TileLayer::chunkLargeTileId()
+{
+    QRandomGenerator random(2);
+    Chunk chunk;
+    Cell expected[CHUNK_SIZE][CHUNK_SIZE];
+
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            expected[y][x] = randomCell(random);
+            chunk.setCell(x, y, expected[y][x]);
+        }
+    }
+
+    Cell largeCell(mTilesets.first().data(), 1 << 18);
+    largeCell.setFlippedVertically(true);
+
+    QVERIFY(chunk.isCompact());
+    chunk.setCell(3, 5, largeCell);
+    expected[5][3] = largeCell;
+    QVERIFY(!chunk.isCompact());
+
+    Cell largestCell(mTilesets.last().data(), std::numeric_limits<int>::max());
+    chunk.setCell(15, 15, largestCell);
+    expected[15][15] = largestCell;
+
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            QCOMPARE(chunk.cellAt(x, y), expected[y][x]);
+            QCOMPARE(chunk.cellAt(x, y).checked(), expected[y][x].checked());
+        }
+    }
+}
+
+/**
+ * Cells that can't be represented in compact form, like a tile ID without
+ * tileset, are preserved as well.
+ */
+void test_TileLayer::chunkInvalidCell()
+{
+    Chunk chunk;
+    const Cell cell(mTilesets.first().data(), 7);
+    chunk.setCell(0, 0, cell);
+
+    const Cell withoutTileset(nullptr, 12);
+    chunk.setCell(1, 0, withoutTileset);
+
+    QVERIFY(!chunk.isCompact());
+    QCOMPARE(chunk.cellAt(0, 0), cell);
+    QCOMPARE(chunk.cellAt(1, 0).tileId(), 12);
+    QVERIFY(!chunk.cellAt(1, 0).tileset());
+}
+
+/**
+ * Tilesets no longer referred to are dropped from the table of a chunk, so
+ * using many different tilesets over time doesn't force it to expand.
+ */
+void test_TileLayer::chunkManyTilesets()
+{
+    QVector<SharedTileset> tilesets;
+    for (int i = 0; i < 600; ++i)
+        tilesets.append(Tileset::create(QStringLiteral("many%1").arg(i), 16, 16));
+
+    Chunk chunk;
+    const Cell fixed(mTilesets.first().data(), 1);
+    chunk.setCell(0, 0, fixed);
+
+    for (const SharedTileset &tileset : std::as_const(tilesets)) {
+        const Cell cell(tileset.data(), 3);
+        chunk.setCell(1, 1, cell);
+        QCOMPARE(chunk.cellAt(1, 1), cell);
+    }
+
+    QVERIFY(chunk.isCompact());
+    QCOMPARE(chunk.cellAt(0, 0), fixed);
+
+    // Different tilesets in all cells at once still fit
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+        chunk.setCell(i % CHUNK_SIZE, i / CHUNK_SIZE, Cell(tilesets.at(i).data(), i));
+
+    QVERIFY(chunk.isCompact());
+
+    for (int i = 0; i < CHUNK_SIZE * CHUNK_SIZE; ++i)
+        QCOMPARE(chunk.cellAt(i % CHUNK_SIZE, i / CHUNK_SIZE), Cell(tilesets.at(i).data(), i));
+}
+
+void test_TileLayer::chunkReplaceAndRemoveTileset_data()
+{
+    QTest::addColumn<bool>("compact");
+
+    QTest::newRow("compact") << true;
+    QTest::newRow("expanded") << false;
+}
+
+void test_TileLayer::chunkReplaceAndRemoveTileset()
+{
+    QFETCH(bool, compact);
+
+    Tileset *a = mTilesets.at(0).data();
+    Tileset *b = mTilesets.at(1).data();
+    Tileset *c = mTilesets.at(2).data();
+
+    Chunk chunk;
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        Cell cell(x % 2 ? a : b, x);
+        cell.setFlippedHorizontally(x % 3 == 0);
+        chunk.setCell(x, 0, cell);
+    }
+
+    if (!compact)
+        chunk.setCell(0, 1, Cell(c, 1 << 20));
+    QCOMPARE(chunk.isCompact(), compact);
+
+    chunk.replaceReferencesToTileset(a, c);
+
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        Cell cell(x % 2 ? c : b, x);
+        cell.setFlippedHorizontally(x % 3 == 0);
+        QCOMPARE(chunk.cellAt(x, 0), cell);
+    }
+
+    chunk.removeReferencesToTileset(b);
+
+    for (int x = 0; x < CHUNK_SIZE; ++x) {
+        if (x % 2) {
+            Cell cell(c, x);
+            cell.setFlippedHorizontally(x % 3 == 0);
+            QCOMPARE(chunk.cellAt(x, 0), cell);
+        } else {
+            QVERIFY(chunk.cellAt(x, 0).isEmpty());
+        }
+    }
+
+    // Tiles from the removed tileset can be added again
+    chunk.setCell(2, 2, Cell(b, 5));
+    QCOMPARE(chunk.cellAt(2, 2), Cell(b, 5));
+}
+
+void test_TileLayer::chunkIsEmpty()
+{
+    Chunk chunk;
+    QVERIFY(chunk.isEmpty());
+
+    // Flags alone don't make a cell non-empty
+    Cell flagged;
+    flagged.setFlippedHorizontally(true);
+    flagged.setChecked(true);
+    chunk.setCell(4, 4, flagged);
+    QVERIFY(chunk.isEmpty());
+    QVERIFY(chunk.cellAt(4, 4).checked());
+
+    chunk.setCell(5, 5, Cell(mTilesets.first().data(), 0));
+    QVERIFY(!chunk.isEmpty());
+
+    chunk.setCell(5, 5, Cell());
+    QVERIFY(chunk.isEmpty());
+}
+
+/**
+ * Large tile IDs on a layer survive cloning and copying, which go through the
+ * same chunk storage.
+ */
+void test_TileLayer::layerLargeTileIds()
+{
+    TileLayer layer(QString(), 0, 0, 40, 40);
+    const Cell small(mTilesets.first().data(), 10);
+    const Cell large(mTilesets.last().data(), 1 << 24);
+
+    layer.setCell(1, 1, small);
+    layer.setCell(20, 20, large);
+    layer.setCell(21, 20, small);
+
+    std::unique_ptr<TileLayer> clone(layer.clone());
+    QCOMPARE(clone->cellAt(1, 1), small);
+    QCOMPARE(clone->cellAt(20, 20), large);
+    QCOMPARE(clone->cellAt(21, 20), small);
+
+    const auto copy = layer.copy(QRegion(16, 16, 16, 16));
+    QCOMPARE(copy->cellAt(4, 4), large);
+    QCOMPARE(copy->cellAt(5, 4), small);
+
+    QCOMPARE(layer.usedTilesets().size(), qsizetype(2));
+}
+
+/**
+ * Returns a cell identifying the chunk at the given coordinates, used to
+ * check that a lookup found the right chunk.
+ */
+Cell test_TileLayer::markerCell(QPoint chunkCoordinates) const
+{
+    return Cell(mTilesets.first().data(),
+                (chunkCoordinates.x() & 0x1ff) << 9 | (chunkCoordinates.y() & 0x1ff));
+}
+
+/**
+ * Verifies that each of the \a positions is found and that the directory
+ * contains these chunks in insertion order.
+ */
+void test_TileLayer::verifyDirectory(const ChunkDirectory &directory,
+                                     const QVector<QPoint> &positions) const
+{
+    QCOMPARE(directory.size(), int(positions.size()));
+
+    for (const QPoint &position : positions) {
+        const Chunk *chunk = directory.find(position);
+        QVERIFY(chunk);
+        QCOMPARE(chunk->cellAt(0, 0), markerCell(position));
+    }
+
+    int index = 0;
+    for (auto it = directory.begin(); it != directory.end(); ++it, ++index) {
+        QCOMPARE(it.key(), positions.at(index));
+        QCOMPARE(it.value().cellAt(0, 0), markerCell(positions.at(index)));
+    }
+}
+
+/**
+ * Chunks inside the dense area and outside of it, including at negative
+ * and far away coordinates, are all found.
+ */
+void test_TileLayer::directoryDenseAndSparse()
+{
+    ChunkDirectory directory;
+    directory.setDenseArea(QRect(0, 0, 4, 3));
+
+    const QVector<QPoint> positions {
+        QPoint(0, 0), QPoint(3, 2), QPoint(1, 1),           // dense
+        QPoint(-1, 0), QPoint(4, 0), QPoint(0, 3),          // just outside
+        QPoint(-100000, 5), QPoint(7, 1 << 20), QPoint(-3, -3),
+    };
+
+    for (const QPoint &position : positions)
+        directory.findOrInsert(position).setCell(0, 0, markerCell(position));
+
+    verifyDirectory(directory, positions);
+
+    QVERIFY(!directory.find(QPoint(2, 2)));
+    QVERIFY(!directory.find(QPoint(-2, 0)));
+    QVERIFY(!directory.find(QPoint(5, 5)));
+
+    // Inserting an existing chunk returns it
+    QCOMPARE(directory.findOrInsert(QPoint(4, 0)).cellAt(0, 0), markerCell(QPoint(4, 0)));
+    QCOMPARE(directory.findOrInsert(QPoint(1, 1)).cellAt(0, 0), markerCell(QPoint(1, 1)));
+    QCOMPARE(directory.size(), int(positions.size()));
+
+    // Moving the dense area rebuilds the index
+    directory.setDenseArea(QRect(-3, -3, 8, 8));
+    verifyDirectory(directory, positions);
+
+    directory.setDenseArea(QRect());
+    verifyDirectory(directory, positions);
+
+    directory.clear();
+    QVERIFY(directory.isEmpty());
+    QVERIFY(!directory.find(QPoint(0, 0)));
+    QVERIFY(!directory.find(QPoint(-3, -3)));
+}
+
+/**
+ * Many chunks found just outside of the dense area cause it to grow, while
+ * chunks spread too far apart stay in the sparse table. Without a dense area,
+ * one is only created once there are enough chunks close together.
+ */
+void test_TileLayer::directoryGrowDenseArea()
+{
+    ChunkDirectory directory;
+    directory.setDenseArea(QRect(0, 0, 2, 2));
+
+    QVector<QPoint> positions;
+    for (int y = 0; y < 12; ++y) {
+        for (int x = -4; x < 8; ++x) {
+            const QPoint position(x, y);
+            positions.append(position);
+            directory.findOrInsert(position).setCell(0, 0, markerCell(position));
+        }
+    }
+
+    // The most recently added chunks may not be part of the dense area yet
+    QVERIFY(directory.denseArea().contains(QRect(-4, 0, 12, 8)));
+    verifyDirectory(directory, positions);
+
+    ChunkDirectory scattered;
+    QVector<QPoint> scatteredPositions;
+    for (int i = 0; i < 128; ++i) {
+        const QPoint position(i * 1000, -i * 1000);
+        scatteredPositions.append(position);
+        scattered.findOrInsert(position).setCell(0, 0, markerCell(position));
+    }
+
+    QVERIFY(scattered.denseArea().isEmpty());
+    verifyDirectory(scattered, scatteredPositions);
+
+    ChunkDirectory fresh;
+    QVector<QPoint> freshPositions { QPoint(0, 0), QPoint(1, 0), QPoint(0, 1) };
+    for (const QPoint &position : std::as_const(freshPositions))
+        fresh.findOrInsert(position).setCell(0, 0, markerCell(position));
+
+    QVERIFY(fresh.denseArea().isEmpty());
+    verifyDirectory(fresh, freshPositions);
+
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            const QPoint position(x, y);
+            if (freshPositions.contains(position))
+                continue;
+            freshPositions.append(position);
+            fresh.findOrInsert(position).setCell(0, 0, markerCell(position));
+        }
+    }
+
+    QCOMPARE(fresh.denseArea(), QRect(0, 0, 8, 8));
+    verifyDirectory(fresh, freshPositions);
+}
+
+/**
+ * Compares lookups against a QHash while inserting chunks at random, which
+ * exercises the growing of both the sparse table and the dense area.
+ */
+void test_TileLayer::directoryRandom()
+{
+    QRandomGenerator random(3);
+    ChunkDirectory directory;
+    QHash<QPoint, int> reference;
+    QVector<QPoint> positions;
+
+    for (int i = 0; i < 5000; ++i) {
+        const QPoint position(random.bounded(-60, 60), random.bounded(-40, 40));
+
+        Chunk &chunk = directory.findOrInsert(position);
+        if (!reference.contains(position)) {
+            reference.insert(position, int(positions.size()));
+            positions.append(position);
+            chunk.setCell(0, 0, markerCell(position));
+        }
+
+        const QPoint lookup(random.bounded(-70, 70), random.bounded(-50, 50));
+        const Chunk *found = directory.find(lookup);
+        QCOMPARE(found != nullptr, reference.contains(lookup));
+        if (found)
+            QCOMPARE(found->cellAt(0, 0), markerCell(lookup));
+    }
+
+    verifyDirectory(directory, positions);
+}
+
+void test_TileLayer::directoryCopyAndMove()
+{
+    ChunkDirectory directory;
+    directory.setDenseArea(QRect(0, 0, 2, 2));
+
+    const QVector<QPoint> positions { QPoint(0, 0), QPoint(1, 1), QPoint(10, -10) };
+    for (const QPoint &position : positions)
+        directory.findOrInsert(position).setCell(0, 0, markerCell(position));
+
+    ChunkDirectory copy(directory);
+    verifyDirectory(copy, positions);
+
+    // The copy is independent
+    copy.findOrInsert(QPoint(5, 5)).setCell(0, 0, markerCell(QPoint(5, 5)));
+    QVERIFY(!directory.find(QPoint(5, 5)));
+
+    ChunkDirectory moved(std::move(copy));
+    verifyDirectory(moved, positions + QVector<QPoint> { QPoint(5, 5) });
+
+    ChunkDirectory assigned;
+    assigned = directory;
+    verifyDirectory(assigned, positions);
+
+    assigned = std::move(moved);
+    verifyDirectory(assigned, positions + QVector<QPoint> { QPoint(5, 5) });
+}
+
+/**
+ * Cells set far outside of the bounds of a layer end up in the sparse table
+ * of its chunk directory, and are found again and copied along with the layer.
+ */
+void test_TileLayer::layerChunksOutsideBounds()
+{
+    TileLayer layer(QString(), 0, 0, 64, 64);
+    const Cell cell(mTilesets.first().data(), 3);
+
+    const QVector<QPoint> points {
+        QPoint(0, 0), QPoint(63, 63), QPoint(-1, -1), QPoint(1000, 5), QPoint(-5000, -7000),
+    };
+
+    for (const QPoint &point : points)
+        layer.setCell(point.x(), point.y(), cell);
+
+    for (const QPoint &point : points)
+        QCOMPARE(layer.cellAt(point), cell);
+
+    QVERIFY(layer.cellAt(500, 500).isEmpty());
+    QCOMPARE(layer.region().rectCount(), int(points.size()));
+
+    std::unique_ptr<TileLayer> clone(layer.clone());
+    for (const QPoint &point : points)
+        QCOMPARE(clone->cellAt(point), cell);
+
+    // Resizing only keeps the cells within the new size
+    layer.resize(QSize(80, 80), QPoint(10, 10));
+    QCOMPARE(layer.cellAt(10, 10), cell);
+    QCOMPARE(layer.cellAt(73, 73), cell);
+    QCOMPARE(layer.region().rectCount(), 2);
+}
+
+QTEST_MAIN(test_TileLayer)
+#include "test_tilelayer.moc"
@@ -0,0 +1,318 @@
+#include "map.h"
+#include "tilelayer.h"
+#include "tileregion.h"
+#include "tileset.h"
+
+#include "mapdocument.h"
+#include "tilepainter.h"
+
+#include <QtTest/QtTest>
+#include <QQueue>
+#include <QRandomGenerator>
+
+using namespace Tiled;
+
+class test_TilePainter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void fill_data();
+    void fill();
+
+private:
+    SharedTileset mTileset;
+};
+
+/**
+ * The flood fill as it was implemented before it worked on blocks of cells,
+ * used as reference.
+ */
+static QRegion referenceFillRegion(const TileLayer &layer,
+                                   const QRegion &region,
+                                   QPoint fillOrigin,
+                                   std::function<bool(const Cell &)> condition,
+                                   Map::Orientation orientation,
+                                   Map::StaggerAxis staggerAxis,
+                                   Map::StaggerIndex staggerIndex)
+{
+    // Return empty region when the bounds do not contain the fill origin
+    if (!region.contains(fillOrigin))
+        return QRegion();
+
+    const QRect bounds = region.boundingRect();
+    const int width = bounds.width();
+    const int height = bounds.height();
+    const int indexOffset = -(bounds.left() + bounds.top() * width);
+
+    const bool isStaggered = orientation == Map::Hexagonal || orientation == Map::Staggered;
+
+    QQueue<QPoint> fillPositions;
+    fillPositions.enqueue(fillOrigin);
+
+    QVector<bool> processedCellsVec(width * height);
+    bool *processedCells = processedCellsVec.data();
+    QRegion fillRegion;
+
+    while (!fillPositions.isEmpty()) {
+        const QPoint currentPoint = fillPositions.dequeue();
+        const int startOfLine = currentPoint.y() * width;
+
+        int left = currentPoint.x();
+        while (left > bounds.left() && condition(layer.cellAt(left - 1, currentPoint.y()))) {
+            --left;
+            processedCells[indexOffset + startOfLine + left] = true;
+        }
+
+        int right = currentPoint.x();
+        while (right < bounds.right() && condition(layer.cellAt(right + 1, currentPoint.y()))) {
+            ++right;
+            processedCells[indexOffset + startOfLine + right] = true;
+        }
+
+        fillRegion += QRegion(left, currentPoint.y(), right - left + 1, 1);
+
+        bool leftColumnIsStaggered = false;
+        bool rightColumnIsStaggered = false;
+
+        if (isStaggered) {
+            if (staggerAxis == Map::StaggerY) {
+                bool rowIsStaggered = ((layer.y() + currentPoint.y()) & 1) ^ staggerIndex;
+                if (rowIsStaggered)
+                    right = qMin(right + 1, bounds.right());
+                else
+                    left = qMax(left - 1, bounds.left());
+            } else {
+                leftColumnIsStaggered = ((layer.x() + left) & 1) ^ staggerIndex;
+                rightColumnIsStaggered = ((layer.x() + right) & 1) ^ staggerIndex;
+            }
+        }
+
+        auto findFillPositions = [=,&fillPositions](int left, int right, int y) {
+            bool adjacentCellAdded = false;
+
+            for (int x = left; x <= right; ++x) {
+                const int index = y * width + x;
+
+                if (!processedCells[indexOffset + index] && condition(layer.cellAt(x, y))) {
+                    if (!adjacentCellAdded) {
+                        fillPositions.enqueue(QPoint(x, y));
+                        adjacentCellAdded = true;
+                    }
+                } else {
+                    adjacentCellAdded = false;
+                }
+
+                processedCells[indexOffset + index] = true;
+            }
+        };
+
+        if (currentPoint.y() > bounds.top()) {
+            int _left = left;
+            int _right = right;
+
+            if (isStaggered && staggerAxis == Map::StaggerX) {
+                if (!leftColumnIsStaggered)
+                    _left = qMax(left - 1, bounds.left());
+                if (!rightColumnIsStaggered)
+                    _right = qMin(right + 1, bounds.right());
+            }
+
+            findFillPositions(_left, _right, currentPoint.y() - 1);
+        }
+
+        if (currentPoint.y() < bounds.bottom()) {
+            int _left = left;
+            int _right = right;
+
+            if (isStaggered && staggerAxis == Map::StaggerX) {
+                if (leftColumnIsStaggered)
+                    _left = qMax(left - 1, bounds.left());
+                if (rightColumnIsStaggered)
+                    _right = qMin(right + 1, bounds.right());
+            }
+
+            findFillPositions(_left, _right, currentPoint.y() + 1);
+        }
+    }
+
+    return fillRegion;
+}
+
+/**
+ * The reference for TilePainter::computePaintableFillRegion.
+ */
+static QRegion referencePaintableFillRegion(const Map &map,
+                                            const TileLayer &layer,
+                                            const QRegion &selection,
+                                            QPoint fillOrigin,
+                                            std::function<bool(const Cell &)> condition)
+{
+    QRegion bounds;
+
+    if (map.infinite())
+        bounds = selection.isEmpty() ? layer.bounds() : selection;
+    else
+        bounds = layer.rect();
+
+    QRegion region = referenceFillRegion(layer,
+                                         bounds.translated(-layer.position()),
+                                         fillOrigin - layer.position(),
+                                         condition,
+                                         map.orientation(), map.staggerAxis(), map.staggerIndex());
+
+    region.translate(layer.position());
+
+    if (!selection.isEmpty())
+        region &= selection;
+
+    return region;
+}
+
+void test_TilePainter::initTestCase()
+{
+    mTileset = Tileset::create(QStringLiteral("tiles"), 16, 16);
+}
+
+void test_TilePainter::fill_data()
+{
+    QTest::addColumn<Map::Orientation>("orientation");
+    QTest::addColumn<Map::StaggerAxis>("staggerAxis");
+    QTest::addColumn<Map::StaggerIndex>("staggerIndex");
+    QTest::addColumn<bool>("infinite");
+    QTest::addColumn<QPoint>("layerPosition");
+    QTest::addColumn<bool>("withSelection");
+
+    struct Orientation {
+        const char *name;
+        Map::Orientation orientation;
+        Map::StaggerAxis staggerAxis;
+        Map::StaggerIndex staggerIndex;
+    };
+
+    const Orientation orientations[] = {
+        { "orthogonal", Map::Orthogonal, Map::StaggerY, Map::StaggerOdd },
+        { "staggered-x-odd", Map::Staggered, Map::StaggerX, Map::StaggerOdd },
+        { "staggered-x-even", Map::Staggered, Map::StaggerX, Map::StaggerEven },
+        { "staggered-y-odd", Map::Staggered, Map::StaggerY, Map::StaggerOdd },
+        { "staggered-y-even", Map::Staggered, Map::StaggerY, Map::StaggerEven },
+        { "hexagonal-x", Map::Hexagonal, Map::StaggerX, Map::StaggerOdd },
+        { "hexagonal-y", Map::Hexagonal, Map::StaggerY, Map::StaggerEven },
+    };
+
+    for (const Orientation &o : orientations) {
+        for (const bool infinite : { false, true }) {
+            for (const bool withSelection : { false, true }) {
+                // Layers of infinite maps are also tested at an odd offset,
+                // which affects which rows or columns are staggered
+                const QPoint layerPosition = infinite ? QPoint(3, 1) : QPoint();
+
+                const QByteArray name = QByteArray(o.name) +
+                        (infinite ? "-infinite" : "-fixed") +
+                        (withSelection ? "-selection" : "");
+
+                QTest::newRow(name.constData())
+                        << o.orientation << o.staggerAxis << o.staggerIndex
+                        << infinite << layerPosition << withSelection;
+            }
+        }
+    }
+}
+
+/**
+ * The fill regions are the same as those determined by the old flood fill,
+ * with and without a selection, for both the condition and the match cells
+ * overloads.
+ */
+void test_TilePainter::fill()
+{
+    QFETCH(Map::Orientation, orientation);
+    QFETCH(Map::StaggerAxis, staggerAxis);
+    QFETCH(Map::StaggerIndex, staggerIndex);
+    QFETCH(bool, infinite);
+    QFETCH(QPoint, layerPosition);
+    QFETCH(bool, withSelection);
+
+    auto map = std::make_unique<Map>(orientation, 100, 80, 16, 16);
+    map->setStaggerAxis(staggerAxis);
+    map->setStaggerIndex(staggerIndex);
+    map->setInfinite(infinite);
+    map->addTileset(mTileset);
+
+    const Cell cells[] = {
+        Cell(mTileset.data(), 0),
+        Cell(mTileset.data(), 1),
+        Cell(),
+    };
+
+    // Mostly large connected areas of the first tile. On infinite maps, a
+    // few chunks are left out entirely.
+    QRandomGenerator random(23);
+    auto layer = std::make_unique<TileLayer>(QStringLiteral("layer"), layerPosition, QSize(100, 80));
+    const QRect area = infinite ? QRect(-70, -40, 200, 150) : QRect(0, 0, 100, 80);
+    const QRect hole(0, 0, 64, 64);
+
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x) {
+            if (infinite && hole.contains(x, y))
+                continue;
+
+            const int r = random.bounded(100);
+            layer->setCell(x, y, cells[r < 60 ? 0 : r < 92 ? 1 : 2]);
+        }
+    }
+
+    TileLayer *tileLayer = layer.get();
+    map->addLayer(std::move(layer));
+
+    MapDocument mapDocument(std::move(map));
+    const Map &documentMap = *mapDocument.map();
+
+    QRegion selection;
+    if (withSelection) {
+        selection |= QRect(-10, -5, 50, 30);
+        selection |= QRect(20, 20, 70, 10);
+        selection |= QRect(60, 35, 15, 60);
+        selection |= QRect(5, 50, 20, 20);
+        mapDocument.setSelectedTiles(TileRegion(selection));
+    }
+
+    TilePainter painter(&mapDocument, tileLayer);
+
+    const QRect layerBounds = infinite ? tileLayer->bounds() : tileLayer->rect();
+
+    for (int i = 0; i < 40; ++i) {
+        const QPoint origin(random.bounded(layerBounds.left(), layerBounds.right() + 1),
+                            random.bounded(layerBounds.top(), layerBounds.bottom() + 1));
+
+        const Cell matchCell = painter.cellAt(origin);
+        auto condition = [&] (const Cell &cell) { return cell == matchCell; };
+
+        const QRegion expected = referencePaintableFillRegion(documentMap, *tileLayer, selection,
+                                                              origin, condition);
+
+        QCOMPARE(painter.computePaintableFillRegion(origin, condition), expected);
+        QCOMPARE(painter.computePaintableFillRegion(origin, QVector<Cell> { matchCell }), expected);
+
+        // Matching any of two cells
+        const Cell otherCell = cells[(i % 2) + (matchCell == cells[0] ? 1 : 0)];
+        const QVector<Cell> matchCells { matchCell, otherCell };
+        auto anyCondition = [&] (const Cell &cell) { return matchCells.contains(cell); };
+
+        QCOMPARE(painter.computePaintableFillRegion(origin, matchCells),
+                 referencePaintableFillRegion(documentMap, *tileLayer, selection,
+                                              origin, anyCondition));
+
+        // The selection is ignored by computeFillRegion
+        const QRegion expectedUnlimited = referencePaintableFillRegion(documentMap, *tileLayer, QRegion(),
+                                                                       origin, condition);
+
+        QCOMPARE(painter.computeFillRegion(origin, condition), expectedUnlimited);
+        QCOMPARE(painter.computeFillRegion(origin, QVector<Cell> { matchCell }), expectedUnlimited);
+    }
+}
+
+QTEST_MAIN(test_TilePainter)
+#include "test_tilepainter.moc"
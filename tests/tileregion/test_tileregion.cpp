@@ -0,0 +1,281 @@
+#include "tileregion.h"
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+
+#include <climits>
+
+using namespace Tiled;
+
+class test_TileRegion : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fromRects_data();
+    void fromRects();
+    void booleanOperations_data();
+    void booleanOperations();
+    void translated_data();
+    void translated();
+    void remove();
+    void intersectRect();
+    void addRowBits();
+    void rowMask();
+    void queries();
+
+private:
+    void addRandomData();
+};
+
+/**
+ * Returns a random region made of a few rectangles, some of which cross
+ * chunk borders and lie at negative coordinates.
+ */
+static QRegion randomRegion(QRandomGenerator &random, int rectCount)
+{
+    QRegion region;
+    for (int i = 0; i < rectCount; ++i) {
+        const int size = random.bounded(2) ? 8 : 150;
+        region |= QRect(random.bounded(-200, 200), random.bounded(-200, 200),
+                        random.bounded(1, size), random.bounded(1, size));
+    }
+    return region;
+}
+
+static qint64 tileCount(const QRegion &region)
+{
+    qint64 count = 0;
+    for (const QRect &rect : region)
+        count += qint64(rect.width()) * rect.height();
+    return count;
+}
+
+/**
+ * Verifies that the tile region covers the same tiles as the QRegion, and
+ * that rects() returns the same rectangles as the QRegion.
+ */
+static void compareRegions(const TileRegion &tileRegion, const QRegion &region)
+{
+    QCOMPARE(tileRegion.isEmpty(), region.isEmpty());
+    QCOMPARE(tileRegion.toRegion(), region);
+    QCOMPARE(tileRegion.rects(), QVector<QRect>(region.begin(), region.end()));
+    QCOMPARE(tileRegion.boundingRect(), region.boundingRect());
+    QCOMPARE(tileRegion.tileCount(), tileCount(region));
+
+    // Runs are ordered by row and together cover the region
+    QRegion runs;
+    QPoint previous(INT_MIN, INT_MIN);
+    tileRegion.forEachRun([&] (const QRect &run) {
+        QCOMPARE(run.height(), 1);
+        QVERIFY(run.y() > previous.y() || (run.y() == previous.y() && run.x() > previous.x()));
+        QVERIFY(!runs.intersects(run));
+        previous = run.topLeft();
+        runs |= run;
+    });
+    QCOMPARE(runs, region);
+}
+
+void test_TileRegion::addRandomData()
+{
+    QTest::addColumn<int>("seed");
+
+    for (int seed = 0; seed < 20; ++seed)
+        QTest::newRow(qPrintable(QStringLiteral("seed-%1").arg(seed))) << seed;
+}
+
+void test_TileRegion::fromRects_data()
+{
+    addRandomData();
+}
+
+void test_TileRegion::fromRects()
+{
+    QFETCH(int, seed);
+
+    QRandomGenerator random(seed);
+    const QRegion region = randomRegion(random, 1 + seed % 8);
+
+    compareRegions(TileRegion(region), region);
+
+    TileRegion added;
+    for (const QRect &rect : region)
+        added |= rect;
+    compareRegions(added, region);
+    QVERIFY(added == TileRegion(region));
+
+    const QRect rect = region.boundingRect();
+    compareRegions(TileRegion(rect), QRegion(rect));
+}
+
+void test_TileRegion::booleanOperations_data()
+{
+    addRandomData();
+}
+
+void test_TileRegion::booleanOperations()
+{
+    QFETCH(int, seed);
+
+    QRandomGenerator random(seed);
+    const QRegion a = randomRegion(random, 1 + seed % 6);
+    const QRegion b = randomRegion(random, 1 + seed % 5);
+
+    const TileRegion tileA(a);
+    const TileRegion tileB(b);
+
+    compareRegions(tileA | tileB, a | b);
+    compareRegions(tileA & tileB, a & b);
+    compareRegions(tileA - tileB, a - b);
+    compareRegions(tileB - tileA, b - a);
+
+    QCOMPARE(tileA.intersects(tileB), a.intersects(b));
+    QCOMPARE(tileB.intersects(tileA), a.intersects(b));
+
+    // Operations with itself and the empty region
+    compareRegions(tileA | tileA, a);
+    compareRegions(tileA & tileA, a);
+    compareRegions(tileA - tileA, QRegion());
+    compareRegions(tileA | TileRegion(), a);
+    compareRegions(TileRegion() | tileA, a);
+    compareRegions(tileA & TileRegion(), QRegion());
+    compareRegions(tileA - TileRegion(), a);
+
+    // Empty chunks are dropped, so equal regions compare equal
+    QVERIFY(((tileA - tileB) | (tileA & tileB)) == tileA);
+}
+
+void test_TileRegion::translated_data()
+{
+    addRandomData();
+}
+
+void test_TileRegion::translated()
+{
+    QFETCH(int, seed);
+
+    QRandomGenerator random(seed);
+    const QRegion region = randomRegion(random, 1 + seed % 6);
+    const TileRegion tileRegion(region);
+
+    // Offsets aligned and not aligned to the chunk size
+    const QVector<QPoint> offsets {
+        QPoint(0, 0),
+        QPoint(64, -128),
+        QPoint(1, 0),
+        QPoint(0, -1),
+        QPoint(random.bounded(-300, 300), random.bounded(-300, 300)),
+    };
+
+    for (const QPoint &offset : offsets) {
+        compareRegions(tileRegion.translated(offset), region.translated(offset));
+
+        TileRegion copy = tileRegion;
+        copy.translate(offset);
+        QVERIFY(copy == tileRegion.translated(offset));
+        QVERIFY(copy.translated(-offset) == tileRegion);
+    }
+}
+
+void test_TileRegion::remove()
+{
+    QRandomGenerator random(22);
+    QRegion region = randomRegion(random, 8);
+    TileRegion tileRegion(region);
+
+    for (int i = 0; i < 20; ++i) {
+        const QRect rect(random.bounded(-250, 250), random.bounded(-250, 250),
+                         random.bounded(0, 100), random.bounded(0, 100));
+        region -= rect;
+        tileRegion -= rect;
+        compareRegions(tileRegion, region);
+    }
+
+    tileRegion.remove(region.boundingRect());
+    QVERIFY(tileRegion.isEmpty());
+    QVERIFY(tileRegion == TileRegion());
+}
+
+void test_TileRegion::intersectRect()
+{
+    QRandomGenerator random(24);
+    const QRegion region = randomRegion(random, 8);
+    const TileRegion tileRegion(region);
+
+    // Rects aligned and not aligned to the chunk size
+    const QVector<QRect> rects {
+        QRect(-64, -64, 128, 128),
+        QRect(-250, -250, 500, 500),
+        QRect(1000, 1000, 10, 10),
+        QRect(),
+        QRect(random.bounded(-200, 200), random.bounded(-200, 200),
+              random.bounded(1, 200), random.bounded(1, 200)),
+        QRect(random.bounded(-200, 200), random.bounded(-200, 200), 1, 1),
+    };
+
+    for (const QRect &rect : rects) {
+        TileRegion intersected = tileRegion;
+        intersected &= rect;
+        compareRegions(intersected, region & rect);
+        QVERIFY(intersected == (tileRegion & TileRegion(rect)));
+    }
+}
+
+void test_TileRegion::rowMask()
+{
+    QCOMPARE(TileRegion::rowMask(0, 0), quint64(0x1));
+    QCOMPARE(TileRegion::rowMask(0, 63), ~quint64(0));
+    QCOMPARE(TileRegion::rowMask(63, 63), quint64(0x8000000000000000ull));
+    QCOMPARE(TileRegion::rowMask(4, 7), quint64(0xf0));
+
+    for (int first = 0; first < TileRegion::CHUNK_SIZE; ++first) {
+        for (int last = first; last < TileRegion::CHUNK_SIZE; ++last) {
+            const quint64 mask = TileRegion::rowMask(first, last);
+            QCOMPARE(qPopulationCount(mask), uint(last - first + 1));
+            QCOMPARE(qCountTrailingZeroBits(mask), uint(first));
+        }
+    }
+}
+
+void test_TileRegion::addRowBits()
+{
+    TileRegion tileRegion;
+    tileRegion.addRowBits(-64, 3, 0x1);
+    tileRegion.addRowBits(0, 3, 0x8000000000000003ull);
+    tileRegion.addRowBits(64, -1, 0xf0);
+
+    QRegion region;
+    region |= QRect(-64, 3, 1, 1);
+    region |= QRect(0, 3, 2, 1);
+    region |= QRect(63, 3, 1, 1);
+    region |= QRect(68, -1, 4, 1);
+
+    compareRegions(tileRegion, region);
+
+    // Adding no bits does not add a chunk
+    TileRegion empty;
+    empty.addRowBits(128, 128, 0);
+    QVERIFY(empty.isEmpty());
+}
+
+void test_TileRegion::queries()
+{
+    QRandomGenerator random(23);
+    const QRegion region = randomRegion(random, 6);
+    const TileRegion tileRegion(region);
+
+    for (int i = 0; i < 2000; ++i) {
+        const QPoint point(random.bounded(-260, 260), random.bounded(-260, 260));
+        QCOMPARE(tileRegion.contains(point), region.contains(point));
+
+        const QRect rect(point, QSize(random.bounded(1, 40), random.bounded(1, 40)));
+        QCOMPARE(tileRegion.intersects(rect), region.intersects(rect));
+    }
+
+    QVERIFY(!tileRegion.intersects(QRect()));
+    QVERIFY(!TileRegion().intersects(tileRegion));
+    QVERIFY(!TileRegion().contains(0, 0));
+}
+
+QTEST_MAIN(test_TileRegion)
+#include "test_tileregion.moc"
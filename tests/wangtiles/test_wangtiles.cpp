@@ -0,0 +1,274 @@
+#include "map.h"
+#include "orthogonalrenderer.h"
+#include "tilelayer.h"
+#include "tileset.h"
+#include "wangset.h"
+
+#include "wangfiller.h"
+
+#include <QtTest/QtTest>
+#include <QRandomGenerator>
+
+using namespace Tiled;
+
+class test_WangTiles : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void findMatchingCells_data();
+    void findMatchingCells();
+
+    void independentParts_data();
+    void independentParts();
+};
+
+static SharedTileset createTileset(int tileCount)
+{
+    auto tileset = Tileset::create(QStringLiteral("tiles"), 16, 16);
+    QImage image(16 * tileCount, 16, QImage::Format_ARGB32);
+    image.fill(Qt::white);
+    tileset->loadFromImage(image, QStringLiteral("tiles.png"));
+    return tileset;
+}
+
+void test_WangTiles::findMatchingCells_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("transformationFlags");
+
+    QTest::newRow("corner") << int(WangSet::Corner) << 0;
+    QTest::newRow("edge") << int(WangSet::Edge) << 0;
+    QTest::newRow("mixed") << int(WangSet::Mixed) << 0;
+    QTest::newRow("mixed-transformed") << int(WangSet::Mixed)
+                                       << int(Tileset::AllowFlipHorizontally |
+                                              Tileset::AllowFlipVertically |
+                                              Tileset::AllowRotate);
+}
+
+/**
+ * The cells found using the match table are the same as the ones found by
+ * comparing the masked WangId of each cell.
+ */
+void test_WangTiles::findMatchingCells()
+{
+    QFETCH(int, type);
+    QFETCH(int, transformationFlags);
+
+    constexpr int tileCount = 150;
+    constexpr int colorCount = 3;
+
+    const SharedTileset tileset = createTileset(tileCount);
+    QCOMPARE(tileset->tileCount(), tileCount);
+    tileset->setTransformationFlags(Tileset::TransformationFlags(transformationFlags));
+
+    auto wangSet = std::make_unique<WangSet>(tileset.data(), QStringLiteral("set"),
+                                             WangSet::Type(type));
+    wangSet->setColorCount(colorCount);
+
+    // Random WangIds, including unset indexes and duplicates
+    QRandomGenerator random(20);
+    for (int tileId = 0; tileId < tileCount; ++tileId) {
+        WangId wangId;
+        for (int i = 0; i < WangId::NumIndexes; ++i)
+            wangId.setIndexColor(i, random.bounded(colorCount + 1));
+        wangId = wangId & wangSet->typeMask();
+        if (!wangId.isEmpty())
+            wangSet->setWangId(tileId, wangId);
+    }
+
+    const auto &wangIdsAndCells = wangSet->wangIdsAndCells();
+    QVERIFY(wangIdsAndCells.size() > 64);
+
+    for (int i = 0; i < 1000; ++i) {
+        WangId desired;
+        WangId mask;
+
+        // Colors beyond the color count don't occur in the set
+        for (int index = 0; index < WangId::NumIndexes; ++index) {
+            desired.setIndexColor(index, random.bounded(colorCount + 2));
+            if (random.bounded(3) == 0)
+                mask.setIndexColor(index, WangId::INDEX_MASK);
+        }
+
+        QVector<int> expected;
+        for (int c = 0; c < wangIdsAndCells.size(); ++c)
+            if ((wangIdsAndCells.at(c).wangId & mask) == (desired & mask))
+                expected.append(c);
+
+        QVector<int> found;
+        wangSet->findMatchingCells(desired, mask, found);
+        QCOMPARE(found, expected);
+    }
+}
+
+/**
+ * Creates a corner set with two colors and one tile for each combination of
+ * corners, in which tile n has the second color at the corners for which
+ * its bit is set.
+ */
+static std::unique_ptr<WangSet> createCompleteCornerSet(Tileset *tileset)
+{
+    auto wangSet = std::make_unique<WangSet>(tileset, QStringLiteral("corners"),
+                                             WangSet::Corner);
+    wangSet->setColorCount(2);
+
+    static const WangId::Index corners[] = {
+        WangId::TopRight, WangId::BottomRight, WangId::BottomLeft, WangId::TopLeft
+    };
+
+    for (int tileId = 0; tileId < 16; ++tileId) {
+        WangId wangId;
+        for (int c = 0; c < 4; ++c)
+            wangId.setIndexColor(corners[c], tileId & (1 << c) ? 2 : 1);
+        wangSet->setWangId(tileId, wangId);
+    }
+
+    return wangSet;
+}
+
+/**
+ * Returns the tile of the complete corner set matching the given colors at
+ * the vertices surrounding the cell at \a x, \a y.
+ */
+static Cell cornerCell(Tileset *tileset, const QVector<QVector<int>> &vertexColors, int x, int y)
+{
+    const int topRight = vertexColors[y][x + 1];
+    const int bottomRight = vertexColors[y + 1][x + 1];
+    const int bottomLeft = vertexColors[y + 1][x];
+    const int topLeft = vertexColors[y][x];
+
+    const int tileId = (topRight == 2 ? 1 : 0) |
+            (bottomRight == 2 ? 2 : 0) |
+            (bottomLeft == 2 ? 4 : 0) |
+            (topLeft == 2 ? 8 : 0);
+
+    return Cell(tileset, tileId);
+}
+
+static QVector<QVector<int>> randomVertexColors(QRandomGenerator &random, QSize size)
+{
+    QVector<QVector<int>> vertexColors(size.height() + 1);
+    for (auto &row : vertexColors) {
+        row.resize(size.width() + 1);
+        for (int &color : row)
+            color = 1 + random.bounded(2);
+    }
+    return vertexColors;
+}
+
+/**
+ * Fills the given \a region by setting the color of each of its vertices,
+ * and returns the region that could not be filled.
+ */
+static QRegion wangFill(const WangSet &wangSet,
+                        const TileLayer &back,
+                        const MapRenderer &renderer,
+                        const QVector<QVector<int>> &vertexColors,
+                        const QRegion &region,
+                        bool corrections,
+                        TileLayer &target)
+{
+    WangFiller wangFiller(wangSet, back, &renderer);
+    wangFiller.setCorrectionsEnabled(corrections);
+    wangFiller.setErasingEnabled(false);
+
+    for (const QRect &rect : region) {
+        for (int y = rect.top(); y <= rect.bottom() + 1; ++y)
+            for (int x = rect.left(); x <= rect.right() + 1; ++x)
+                wangFiller.setCorner(QPoint(x, y), vertexColors[y][x]);
+    }
+
+    wangFiller.apply(target);
+    return wangFiller.invalidRegion();
+}
+
+void test_WangTiles::independentParts_data()
+{
+    QTest::addColumn<QVector<QRegion>>("parts");
+    QTest::addColumn<bool>("corrections");
+
+    // Parts far enough apart to be resolved in parallel
+    const QVector<QRegion> distant {
+        QRegion(4, 4, 6, 5),
+        QRegion(30, 6, 3, 8),
+        QRegion(8, 40, 10, 1),
+        QRegion(45, 45, 7, 7),
+    };
+
+    // Some parts consist of rects that are close enough to be merged
+    const QVector<QRegion> merged {
+        QRegion(4, 4, 6, 5) + QRegion(12, 4, 4, 4),
+        QRegion(30, 30, 3, 3) + QRegion(34, 36, 5, 2) + QRegion(28, 40, 2, 2),
+        QRegion(50, 4, 4, 10),
+    };
+
+    QTest::newRow("distant") << distant << false;
+    QTest::newRow("distant-corrections") << distant << true;
+    QTest::newRow("merged") << merged << false;
+    QTest::newRow("merged-corrections") << merged << true;
+}
+
+/**
+ * Filling a region made of independent parts, which are resolved in
+ * parallel, gives the same result as filling each of the parts on its own.
+ */
+void test_WangTiles::independentParts()
+{
+    QFETCH(QVector<QRegion>, parts);
+    QFETCH(bool, corrections);
+
+    const QSize mapSize(64, 64);
+
+    const SharedTileset tileset = createTileset(16);
+    QCOMPARE(tileset->tileCount(), 16);
+    tileset->addWangSet(createCompleteCornerSet(tileset.data()));
+    const WangSet &wangSet = *tileset->wangSet(0);
+
+    Map map(Map::Orthogonal, mapSize.width(), mapSize.height(), 16, 16);
+    map.addTileset(tileset);
+    const OrthogonalRenderer renderer(&map);
+
+    // Completely cover the back layer with matching tiles, so that the tile
+    // chosen for each location doesn't depend on chance
+    QRandomGenerator random(7);
+    const auto backColors = randomVertexColors(random, mapSize);
+    const auto fillColors = randomVertexColors(random, mapSize);
+
+    TileLayer back(QStringLiteral("back"), QPoint(), mapSize);
+    for (int y = 0; y < mapSize.height(); ++y)
+        for (int x = 0; x < mapSize.width(); ++x)
+            back.setCell(x, y, cornerCell(tileset.data(), backColors, x, y));
+
+    QRegion region;
+    for (const QRegion &part : std::as_const(parts))
+        region += part;
+
+    TileLayer filled(QString(), QPoint(), mapSize);
+    const QRegion invalid = wangFill(wangSet, back, renderer, fillColors,
+                                     region, corrections, filled);
+
+    TileLayer expected(QString(), QPoint(), mapSize);
+    QRegion expectedInvalid;
+    for (const QRegion &part : std::as_const(parts)) {
+        expectedInvalid += wangFill(wangSet, back, renderer, fillColors,
+                                    part, corrections, expected);
+    }
+
+    QCOMPARE(invalid, expectedInvalid);
+    QCOMPARE(filled.region(), expected.region());
+
+    for (int y = 0; y < mapSize.height(); ++y)
+        for (int x = 0; x < mapSize.width(); ++x)
+            QCOMPARE(filled.cellAt(x, y), expected.cellAt(x, y));
+
+    // Make sure the filled area was changed to the requested colors
+    for (const QRect &rect : region) {
+        for (int y = rect.top(); y <= rect.bottom(); ++y)
+            for (int x = rect.left(); x <= rect.right(); ++x)
+                QCOMPARE(filled.cellAt(x, y), cornerCell(tileset.data(), fillColors, x, y));
+    }
+}
+
+QTEST_MAIN(test_WangTiles)
+#include "test_wangtiles.moc"